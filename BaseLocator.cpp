@@ -52,3 +52,12 @@ void BaseLocator::glRenderActionTransparent(GLContextData& glContextData) const
 void BaseLocator::getName(std::string& name) const
 {
 }
+
+/*
+ * spatialIndex - Shared spatial index of the loaded model
+ *
+ * return - const gvBVH*
+ */
+const gvBVH* BaseLocator::spatialIndex(void) const {
+	return geometryViewer->getSpatialIndex();
+} // end spatialIndex()
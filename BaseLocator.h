@@ -9,6 +9,7 @@ namespace Vrui {
 class LocatorTool;
 }
 class GeometryViewer;
+class gvBVH;
 // end Forward Declarations
 class BaseLocator : public Vrui::LocatorToolAdapter {
 public:
@@ -18,6 +19,11 @@ public:
 	virtual void glRenderAction(GLContextData& contextData) const;
 	virtual void glRenderActionTransparent(GLContextData& contextData) const;
   virtual void getName(std::string& name) const; // Returns a descriptive name for the tool adapter
+protected:
+	/* Spatial index over the model's triangles for picking and clipping
+	 * queries, in the same navigational coordinates as the locator's
+	 * callback transformations. NULL while none is available. */
+	const gvBVH* spatialIndex(void) const;
 private:
 	GeometryViewer* geometryViewer;
 };
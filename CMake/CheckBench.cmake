@@ -0,0 +1,50 @@
+# Run GeometryViewerBench over a short orbit of a small synthetic mesh and
+# check that it rendered every frame and wrote a well-formed report.
+#
+#   cmake -DBENCH=<GeometryViewerBench> -DOUTPUT=<file.json> -P CheckBench.cmake
+
+SET(FRAMES 8)
+
+FILE(REMOVE ${OUTPUT})
+EXECUTE_PROCESS(
+  COMMAND ${BENCH} -frames ${FRAMES} -warmup 2 -size 128x128
+    -chunkTriangles 4096 -o ${OUTPUT} synthetic:sphere:20k
+  RESULT_VARIABLE result
+  )
+IF (NOT result EQUAL 0)
+  MESSAGE(FATAL_ERROR "GeometryViewerBench failed: ${result}")
+ENDIF ()
+IF (NOT EXISTS ${OUTPUT})
+  MESSAGE(FATAL_ERROR "GeometryViewerBench wrote no report to ${OUTPUT}")
+ENDIF ()
+FILE(READ ${OUTPUT} report)
+
+# The report is a single object:
+IF (NOT report MATCHES "^{\n.*\n}\n$")
+  MESSAGE(FATAL_ERROR "Report isn't a JSON object:\n${report}")
+ENDIF ()
+
+# Every frame was rendered and timed:
+IF (NOT report MATCHES "\"frames\": ${FRAMES},")
+  MESSAGE(FATAL_ERROR "Report doesn't count ${FRAMES} frames:\n${report}")
+ENDIF ()
+STRING(REGEX MATCH "\"frameMs\": \\[([^]]*)\\]" frameMs "${report}")
+STRING(REGEX MATCHALL "[0-9.e+-]+" times "${CMAKE_MATCH_1}")
+LIST(LENGTH times count)
+IF (NOT count EQUAL FRAMES)
+  MESSAGE(FATAL_ERROR "Report has ${count} frame times, not ${FRAMES}:\n"
+    "${report}")
+ENDIF ()
+
+# The mesh was split into chunks and some of it was drawn:
+FOREACH (key triangles chunks meanMs p95Ms trianglesPerSecond)
+  IF (NOT report MATCHES "\"${key}\": [0-9.e+-]+,")
+    MESSAGE(FATAL_ERROR "Report has no number for ${key}:\n${report}")
+  ENDIF ()
+ENDFOREACH ()
+IF (report MATCHES "\"chunks\": [01],")
+  MESSAGE(FATAL_ERROR "The mesh wasn't split into chunks:\n${report}")
+ENDIF ()
+IF (report MATCHES "\"trianglesPerSecond\": 0,")
+  MESSAGE(FATAL_ERROR "No triangles were drawn:\n${report}")
+ENDIF ()
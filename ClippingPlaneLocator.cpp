@@ -6,6 +6,7 @@
 #include "BaseLocator.h"
 #include "ClippingPlane.h"
 #include "ClippingPlaneLocator.h"
+#include "gvProfiler.h"
 
 /* Vrui includes */
 #include <Vrui/LocatorTool.h>
@@ -54,6 +55,7 @@ ClippingPlaneLocator::~ClippingPlaneLocator(void) {
  */
 void ClippingPlaneLocator::motionCallback(
 		Vrui::LocatorTool::MotionCallbackData* callbackData) {
+	gvProfiler::Scope profile(gvProfiler::Locator);
 	if (clippingPlane!=0&&clippingPlane->isActive()) {
 		Vrui::Vector planeNormal=
 				callbackData->currentTransformation.transform(Vrui::Vector(0,
@@ -70,6 +72,7 @@ void ClippingPlaneLocator::motionCallback(
  */
 void ClippingPlaneLocator::buttonPressCallback(
 		Vrui::LocatorTool::ButtonPressCallbackData* callbackData) {
+	gvProfiler::Scope profile(gvProfiler::Locator);
 	if (clippingPlane!=0)
 		clippingPlane->setActive(true);
 } // end buttonPressCallback()
@@ -81,6 +84,7 @@ void ClippingPlaneLocator::buttonPressCallback(
  */
 void ClippingPlaneLocator::buttonReleaseCallback(
 		Vrui::LocatorTool::ButtonReleaseCallbackData* callbackData) {
+	gvProfiler::Scope profile(gvProfiler::Locator);
 	if (clippingPlane!=0)
 		clippingPlane->setActive(false);
 } // end buttonReleaseCallback()
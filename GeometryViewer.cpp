@@ -5,24 +5,29 @@
 #include "ClippingPlane.h"
 #include "ClippingPlaneLocator.h"
 #include "gvApplicationState.h"
+#include "gvBrickStreamer.h"
 #include "gvContextState.h"
+#include "gvFrustum.h"
+#include "gvLODChain.h"
+#include "gvProfiler.h"
 #include "Lighting.h"
 #include "RGBAColor.h"
 
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <math.h>
 
 // VTK includes
 #include <ExternalVTKWidget.h>
 #include <vtkActor.h>
-#include <vtkCubeSource.h>
 #include <vtkExternalLight.h>
 #include <vtkLight.h>
+#include <vtkMapper.h>
 #include <vtkNew.h>
-#include <vtkOBJReader.h>
+#include <vtkPolyData.h>
 #include <vtkPolyDataMapper.h>
-#include <vtkProperty.h>
 
 // OpenGL/Motif includes
 #include <GL/GLContextData.h>
@@ -37,8 +42,10 @@
 #include <GLMotif/WidgetManager.h>
 
 // VRUI includes
+#include <Misc/ConfigurationFile.h>
 #include <Vrui/Application.h>
 #include <Vrui/Tool.h>
+#include <Vrui/DisplayState.h>
 #include <Vrui/ToolManager.h>
 #include <Vrui/Vrui.h>
 #include <Vrui/VRWindow.h>
@@ -46,41 +53,60 @@
 
 //----------------------------------------------------------------------------
 GeometryViewer::GeometryViewer(int &argc, char **&argv)
-  : Superclass(argc, argv, new gvApplicationState),
+  : GeometryViewer(argc, argv, new gvApplicationState)
+{
+}
+
+//----------------------------------------------------------------------------
+GeometryViewer::GeometryViewer(int &argc, char **&argv,
+                               gvApplicationState *state)
+  : Superclass(argc, argv, state),
+    ApplicationState(state),
     FileName(0),
+    Streaming(false),
+    OptimizeMesh(false),
+    CompactStorage(false),
+    CullingReportInterval(0.0),
+    FrameRateReportInterval(0.0),
+    FrameRateReportTime(-1.0),
+    FrameRateReportFrames(0),
     intensity(1.0),
     mainMenu(NULL),
     renderingDialog(NULL),
     Opacity(1.0),
     opacityValue(NULL),
+    lodValue(NULL),
     RepresentationType(2),
+    TransparencyMode(gvRenderSettings::Unsorted),
+    MaximumPeels(4),
+    PeelingBudget(0.004),
+    LODLevel(0),
+    PinnedLOD(-1),
+    LODSliderLevel(0),
+    TargetFrameRate(60.0),
+    LODFrameTime(0.0),
+    LODFramesAtLevel(0),
+    LODProbeInterval(120),
+    LODProbing(false),
     FirstFrame(true),
+    StartTime(std::chrono::steady_clock::now()),
+    StartupReported(false),
     analysisTool(0),
     ClippingPlanes(NULL),
-    NumberOfClippingPlanes(6)
+    NumberOfClippingPlanes(0)
 {
-  this->DataBounds = new double[6];
+  /* Start out with the default geometry until a file is set; it stays up as
+   * a placeholder while a file is loading */
+  this->ApplicationState->loadGeometry(NULL);
 
   ambientColor = new RGBAColor(0.0f, 0.0f, 0.0f, 0.0f);
   diffuseColor = new RGBAColor(1.0f, 1.0f, 1.0f, 0.0f);
   specularColor = new RGBAColor(0.0f, 0.0f, 0.0f, 0.0f);
-
-  /* Initialize the clipping planes */
-  ClippingPlanes = new ClippingPlane[NumberOfClippingPlanes];
-  for(int i = 0; i < NumberOfClippingPlanes; ++i)
-    {
-    ClippingPlanes[i].setAllocated(false);
-    ClippingPlanes[i].setActive(false);
-    }
 }
 
 //----------------------------------------------------------------------------
 GeometryViewer::~GeometryViewer()
 {
-  if(this->DataBounds)
-    {
-    delete[] this->DataBounds;
-    }
 }
 
 //----------------------------------------------------------------------------
@@ -88,11 +114,82 @@ void GeometryViewer::initialize()
 {
   this->Superclass::initialize();
 
+  /* Push surfaces back so the chunk edges drawn over them win the depth
+   * test. VTK keeps the coincident topology mode in a static of vtkMapper,
+   * and the per-mapper offsets only apply while it is set to polygon
+   * offset, so it can't be limited to the chunk mappers: every mapper in
+   * every context gets the offset. It is set here, once and before any
+   * context renders, rather than by each context on its own thread. */
+  vtkMapper::SetResolveCoincidentTopologyToPolygonOffset();
+
+  /* Memory budget (MB) for streamed models, from the GeometryViewer section
+   * of the Vrui configuration */
+  Misc::ConfigurationFileSection config = Vrui::getAppConfigurationSection();
+  unsigned int budget =
+    config.retrieveValue<unsigned int>("./streamingMemoryBudget", 2048);
+  this->ApplicationState->setStreamingOptions(
+    this->Streaming, static_cast<size_t>(budget) << 20);
+
+  /* Mesh optimization after loading, welding points closer than this
+   * fraction of a mesh's diagonal */
+  this->ApplicationState->setMeshOptimization(
+    this->OptimizeMesh, config.retrieveValue<double>("./weldTolerance", 1e-6));
+  this->ApplicationState->setCompactStorage(this->CompactStorage);
+#ifdef GV_OPENGL2
+  /* gvCompactMapper draws with shaders of its own, which VTK's depth
+   * peeling passes don't rewrite, so compact chunks would come out
+   * unpeeled; sort them instead */
+  if (this->CompactStorage &&
+      this->TransparencyMode == gvRenderSettings::DepthPeeling)
+    {
+    std::cerr << "WARNING: Depth peeling doesn't work with compact vertex "
+                 "storage, sorting chunks instead." << std::endl;
+    this->TransparencyMode = gvRenderSettings::SortedChunks;
+    }
+#endif
+
+  /* Feature angle (degrees) along which normals computed for meshes without
+   * them are split */
+  this->ApplicationState->setNormalFeatureAngle(
+    config.retrieveValue<double>("./normalFeatureAngle", 30.0));
+
+  /* Triangles per culling chunk */
+  this->ApplicationState->setChunkSize(
+    config.retrieveValue<unsigned int>("./chunkTriangles", 65536));
+
+  /* Frame rate the level-of-detail selection aims for */
+  this->TargetFrameRate =
+    config.retrieveValue<double>("./lodTargetFrameRate", 60.0);
+
+  /* Depth peeling of translucent surfaces: at most this many peels, fewer
+   * while a render takes longer than the budget (milliseconds, 0 to always
+   * peel the maximum) */
+  this->MaximumPeels =
+    std::max(1, config.retrieveValue<int>("./maximumDepthPeels", 4));
+  this->PeelingBudget =
+    config.retrieveValue<double>("./depthPeelingBudget", 4.0) / 1000.0;
+
+  /* Initialize the clipping planes; one per clipping plane locator */
+  this->NumberOfClippingPlanes =
+    std::max(1, config.retrieveValue<int>("./maxClippingPlanes", 32));
+  this->ClippingPlanes = new ClippingPlane[this->NumberOfClippingPlanes];
+  for (int i = 0; i < this->NumberOfClippingPlanes; ++i)
+    {
+    this->ClippingPlanes[i].setAllocated(false);
+    this->ClippingPlanes[i].setActive(false);
+    }
+
   /* Create the user interface: */
   lightingDialog = new Lighting(this);
   renderingDialog = createRenderingDialog();
   mainMenu=createMainMenu();
   Vrui::setMainMenu(mainMenu);
+
+  /* Models set before initialization load with the options above */
+  if (!this->Models.empty())
+    {
+    this->loadModels();
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -108,6 +205,54 @@ void GeometryViewer::setFileName(const char* name)
     }
   this->FileName = new char[strlen(name) + 1];
   strcpy(this->FileName, name);
+
+  gvScene::Entry entry;
+  entry.fileName = name;
+  this->setModels(std::vector<gvScene::Entry>(1, entry));
+}
+
+//----------------------------------------------------------------------------
+void GeometryViewer::setModels(const std::vector<gvScene::Entry>& models)
+{
+  this->Models = models;
+  this->ModelVisibility.clear();
+  for (size_t i = 0; i < models.size(); ++i)
+    {
+    this->ModelVisibility.push_back(models[i].visible);
+    }
+  if (this->mainMenu)
+    {
+    this->loadModels();
+    }
+}
+
+//----------------------------------------------------------------------------
+void GeometryViewer::loadModels()
+{
+  /* Parse the files once in the background; every GL context maps the same
+   * scene once it is published from frame() */
+  this->ApplicationState->loadSceneAsync(this->Models, []()
+    {
+    Vrui::requestUpdate();
+    });
+}
+
+//----------------------------------------------------------------------------
+void GeometryViewer::setStreaming(bool streaming)
+{
+  this->Streaming = streaming;
+}
+
+//----------------------------------------------------------------------------
+void GeometryViewer::setOptimizeMesh(bool optimize)
+{
+  this->OptimizeMesh = optimize;
+}
+
+//----------------------------------------------------------------------------
+void GeometryViewer::setCompactStorage(bool compact)
+{
+  this->CompactStorage = compact;
 }
 
 //----------------------------------------------------------------------------
@@ -116,6 +261,13 @@ const char* GeometryViewer::getFileName()
   return this->FileName;
 }
 
+//----------------------------------------------------------------------------
+void GeometryViewer::setReaderOptions(bool parallel,
+                                      unsigned int numberOfThreads)
+{
+  this->ApplicationState->setReaderOptions(parallel, numberOfThreads);
+}
+
 //----------------------------------------------------------------------------
 GLMotif::PopupMenu* GeometryViewer::createMainMenu()
 {
@@ -134,11 +286,26 @@ GLMotif::PopupMenu* GeometryViewer::createMainMenu()
                                  "Analysis Tools");
   analysisToolsCascade->setPopup(createAnalysisToolsMenu());
 
+  if (this->Models.size() > 1)
+    {
+    GLMotif::CascadeButton *modelsCascade =
+        new GLMotif::CascadeButton("ModelsCascade", mainMenu, "Models");
+    modelsCascade->setPopup(createModelsMenu());
+    }
+
   GLMotif::Button *centerDisplayButton =
       new GLMotif::Button("CenterDisplayButton", mainMenu, "Center Display");
   centerDisplayButton->getSelectCallbacks().add(
         this, &GeometryViewer::centerDisplayCallback);
 
+  if (gvProfiler::active())
+    {
+    GLMotif::Button *writeProfileButton =
+        new GLMotif::Button("WriteProfileButton", mainMenu, "Write Profile");
+    writeProfileButton->getSelectCallbacks().add(
+          this, &GeometryViewer::writeProfileCallback);
+    }
+
   GLMotif::ToggleButton *showRenderingDialog =
       new GLMotif::ToggleButton("ShowRenderingDialog", mainMenu,
                                 "Rendering");
@@ -227,6 +394,35 @@ GLMotif::Popup* GeometryViewer::createAnalysisToolsMenu()
   return analysisToolsMenuPopup;
 }
 
+//----------------------------------------------------------------------------
+GLMotif::Popup* GeometryViewer::createModelsMenu()
+{
+  GLMotif::Popup *modelsMenuPopup =
+      new GLMotif::Popup("modelsMenuPopup", Vrui::getWidgetManager());
+  GLMotif::SubMenu *modelsMenu =
+      new GLMotif::SubMenu("modelsMenu", modelsMenuPopup, false);
+
+  /* One toggle per model entry, named by its index and labeled by its
+   * file; the contexts match scene models to entries, so a file that fails
+   * to load doesn't shift the others */
+  for (size_t i = 0; i < this->Models.size(); ++i)
+    {
+    const std::string &fileName = this->Models[i].fileName;
+    std::string label = fileName.substr(fileName.rfind('/') + 1);
+    std::ostringstream name;
+    name << "Model" << i;
+    GLMotif::ToggleButton *showModel =
+        new GLMotif::ToggleButton(name.str().c_str(), modelsMenu,
+                                  label.c_str());
+    showModel->setToggle(this->ModelVisibility[i]);
+    showModel->getValueChangedCallbacks().add(
+          this, &GeometryViewer::changeModelVisibilityCallback);
+    }
+
+  modelsMenu->manageChild();
+  return modelsMenuPopup;
+}
+
 //----------------------------------------------------------------------------
 GLMotif::PopupWindow* GeometryViewer::createRenderingDialog()
 {
@@ -252,6 +448,62 @@ GLMotif::PopupWindow* GeometryViewer::createRenderingDialog()
   opacityValue->setPrecision(3);
   opacityValue->setValue(Opacity);
 
+  /* Blending of translucent surfaces */
+  GLMotif::RadioBox *transparency_RadioBox =
+      new GLMotif::RadioBox("TransparencyRadioBox", dialog, false);
+  GLMotif::ToggleButton *unsorted =
+      new GLMotif::ToggleButton("Unsorted", transparency_RadioBox,
+                                "Unsorted");
+  unsorted->getValueChangedCallbacks().add(
+        this, &GeometryViewer::changeTransparencyCallback);
+  GLMotif::ToggleButton *sortedChunks =
+      new GLMotif::ToggleButton("SortedChunks", transparency_RadioBox,
+                                "Sorted Chunks");
+  sortedChunks->getValueChangedCallbacks().add(
+        this, &GeometryViewer::changeTransparencyCallback);
+  /* initialize() switches depth peeling off where compact storage rules it
+   * out; don't offer it there */
+  GLMotif::ToggleButton *depthPeeling = NULL;
+  if (this->TransparencyMode == gvRenderSettings::DepthPeeling ||
+      !this->CompactStorage)
+    {
+    depthPeeling =
+        new GLMotif::ToggleButton("DepthPeeling", transparency_RadioBox,
+                                  "Depth Peeling");
+    depthPeeling->getValueChangedCallbacks().add(
+          this, &GeometryViewer::changeTransparencyCallback);
+    }
+  transparency_RadioBox->setSelectionMode(GLMotif::RadioBox::ALWAYS_ONE);
+  if (this->TransparencyMode == gvRenderSettings::SortedChunks)
+    {
+    transparency_RadioBox->setSelectedToggle(sortedChunks);
+    }
+  else if (this->TransparencyMode == gvRenderSettings::DepthPeeling)
+    {
+    transparency_RadioBox->setSelectedToggle(depthPeeling);
+    }
+  else
+    {
+    transparency_RadioBox->setSelectedToggle(unsorted);
+    }
+  transparency_RadioBox->manageChild();
+
+  /* Show the rendered level of detail and allow pinning one */
+  lodValue = new GLMotif::TextField("LODValue", dialog, 12);
+  lodValue->setString("LOD 0 (100%)");
+  GLMotif::ToggleButton *pinLOD =
+      new GLMotif::ToggleButton("PinLOD", dialog, "Pin LOD");
+  pinLOD->setToggle(false);
+  pinLOD->getValueChangedCallbacks().add(
+        this, &GeometryViewer::pinLODCallback);
+  GLMotif::Slider *lodSlider =
+      new GLMotif::Slider("LODSlider", dialog, GLMotif::Slider::HORIZONTAL,
+                          ss.fontHeight * 5.0f);
+  lodSlider->setValueRange(0.0, gvLODChain::NumberOfLevels - 1, 1.0);
+  lodSlider->setValue(this->LODSliderLevel);
+  lodSlider->getValueChangedCallbacks().add(
+        this, &GeometryViewer::lodSliderCallback);
+
   dialog->manageChild();
   return dialogPopup;
 }
@@ -259,19 +511,51 @@ GLMotif::PopupWindow* GeometryViewer::createRenderingDialog()
 //----------------------------------------------------------------------------
 void GeometryViewer::frame()
 {
+  gvProfiler::Scope profile(gvProfiler::Frame);
+
+  if (this->ApplicationState->updateGeometry())
+    {
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - this->StartTime;
+    std::cout << "Loaded ";
+    if (this->Models.size() == 1)
+      {
+      std::cout << this->Models[0].fileName;
+      }
+    else
+      {
+      std::cout << this->Models.size() << " models";
+      }
+    std::cout << " in "
+              << this->ApplicationState->loadSeconds() << " s, shown after "
+              << elapsed.count() << " s" << std::endl;
+
+    /* Re-center on the combined bounds of the models */
+    this->FirstFrame = true;
+    }
+
+  /* Publish changes made in the rendering and lighting dialogs */
+  this->updateRenderSettings();
+
+  /* Take in streamed bricks and schedule the next ones */
+  this->ApplicationState->updateStreaming();
+
+  /* Pick up newly built levels of detail and choose one for this frame */
+  this->ApplicationState->updateLevels();
+  this->selectLevel();
+
   if (this->FirstFrame)
     {
+    const double *bounds = this->ApplicationState->bounds();
+
     /* Compute the data center and Radius once */
-    this->Center[0] = (this->DataBounds[0] + this->DataBounds[1])/2.0;
-    this->Center[1] = (this->DataBounds[2] + this->DataBounds[3])/2.0;
-    this->Center[2] = (this->DataBounds[4] + this->DataBounds[5])/2.0;
-
-    this->Radius = sqrt((this->DataBounds[1] - this->DataBounds[0])*
-                        (this->DataBounds[1] - this->DataBounds[0]) +
-                        (this->DataBounds[3] - this->DataBounds[2])*
-                        (this->DataBounds[3] - this->DataBounds[2]) +
-                        (this->DataBounds[5] - this->DataBounds[4])*
-                        (this->DataBounds[5] - this->DataBounds[4]));
+    this->Center[0] = (bounds[0] + bounds[1])/2.0;
+    this->Center[1] = (bounds[2] + bounds[3])/2.0;
+    this->Center[2] = (bounds[4] + bounds[5])/2.0;
+
+    this->Radius = sqrt((bounds[1] - bounds[0])*(bounds[1] - bounds[0]) +
+                        (bounds[3] - bounds[2])*(bounds[3] - bounds[2]) +
+                        (bounds[5] - bounds[4])*(bounds[5] - bounds[4]));
     /* Scale the Radius */
     this->Radius *= 0.75;
     /* Initialize Vrui navigation transformation: */
@@ -279,107 +563,256 @@ void GeometryViewer::frame()
     this->FirstFrame = false;
     }
 
+  this->publishFrameState();
+
+  if (this->FrameRateReportInterval > 0.0)
+    {
+    this->reportFrameRates();
+    }
+
   this->Superclass::frame();
+
+  if (!this->StartupReported)
+    {
+    std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - this->StartTime;
+    std::cout << "First interactive frame after " << elapsed.count() << " s"
+              << (this->ApplicationState->isLoading() ?
+                    " (model still loading)" : "")
+              << std::endl;
+    this->StartupReported = true;
+    }
 }
 
 //----------------------------------------------------------------------------
-void GeometryViewer::initContext(GLContextData& contextData) const
+void GeometryViewer::updateRenderSettings()
 {
-  this->Superclass::initContext(contextData);
+  gvRenderSettings settings;
+  settings.intensity = this->intensity;
+  for (int i = 0; i < 3; ++i)
+    {
+    settings.ambient[i] = this->ambientColor->getValues(i);
+    settings.diffuse[i] = this->diffuseColor->getValues(i);
+    settings.specular[i] = this->specularColor->getValues(i);
+    }
+  settings.opacity = this->Opacity;
+  settings.representation = this->RepresentationType;
+  settings.transparency = this->TransparencyMode;
+  settings.maximumPeels = this->MaximumPeels;
+  settings.peelingBudget = this->PeelingBudget;
+  this->ApplicationState->setRenderSettings(settings);
+}
 
-  // Created by superclass:
-  gvContextState *state = contextData.retrieveDataItem<gvContextState>(this);
-  assert("Context state initialized by vvApplication." && state);
+//----------------------------------------------------------------------------
+void GeometryViewer::publishFrameState()
+{
+  gvFrameState state;
+  for (int i = 0; i < this->NumberOfClippingPlanes; ++i)
+    {
+    if (this->ClippingPlanes[i].isActive())
+      {
+      std::array<double, 4> clippingPlane;
+      for (int j = 0; j < 3; ++j)
+        {
+        clippingPlane[j] = this->ClippingPlanes[i].getPlane().getNormal()[j];
+        }
+      clippingPlane[3] = -this->ClippingPlanes[i].getPlane().getOffset();
+      state.clipPlanes.push_back(clippingPlane);
+      }
+    }
 
-  vtkNew<vtkPolyDataMapper> mapper;
-  state->actor().SetMapper(mapper.GetPointer());
+  state.renderSettings = this->ApplicationState->renderSettings();
+  state.renderSettingsVersion =
+    this->ApplicationState->renderSettingsVersion();
+  state.level = this->LODLevel;
+  state.modelVisibility = this->ModelVisibility;
 
-  if(this->FileName)
+  this->ApplicationState->publishFrameState(state);
+}
+
+//----------------------------------------------------------------------------
+void GeometryViewer::reportFrameRates()
+{
+  double now = Vrui::getApplicationTime();
+  if (this->FrameRateReportTime < 0.0)
     {
-    vtkNew<vtkOBJReader> reader;
-    reader->SetFileName(this->FileName);
-    reader->Update();
-    reader->GetOutput()->GetBounds(this->DataBounds);
-    mapper->SetInputData(reader->GetOutput());
+    this->FrameRateReportTime = now;
+    this->FrameRateReportFrames = 0;
+    this->ApplicationState->takeWindowFrames();
+    return;
     }
-  else
+
+  ++this->FrameRateReportFrames;
+  double elapsed = now - this->FrameRateReportTime;
+  if (elapsed < this->FrameRateReportInterval)
     {
-    vtkNew<vtkCubeSource> cube;
-    cube->Update();
-    cube->GetOutput()->GetBounds(this->DataBounds);
-    mapper->SetInputData(cube->GetOutput());
+    return;
     }
+
+  /* Window frames add up over all windows, however they are threaded */
+  unsigned long windowFrames = this->ApplicationState->takeWindowFrames();
+  std::cout << Vrui::getNumWindows() << " windows: "
+            << this->FrameRateReportFrames / elapsed << " frames/s, "
+            << windowFrames / elapsed << " window frames/s aggregate"
+            << std::endl;
+  this->FrameRateReportTime = now;
+  this->FrameRateReportFrames = 0;
 }
 
 //----------------------------------------------------------------------------
-void GeometryViewer::display(GLContextData &contextData) const
+void GeometryViewer::selectLevel()
 {
-  int maxClipPlanes;
-  glGetIntegerv(GL_MAX_CLIP_PLANES, &maxClipPlanes);
-  int clipPlaneIdx = 0;
-  for (int i = 0;
-       i < this->NumberOfClippingPlanes && clipPlaneIdx < maxClipPlanes;
-       ++i)
+  gvLODChain *levels = this->ApplicationState->levels();
+  int coarsest = levels ? levels->availableLevels() - 1 : 0;
+  int level = this->LODLevel;
+
+  if (this->PinnedLOD >= 0)
     {
-    if (this->ClippingPlanes[i].isActive())
+    level = this->PinnedLOD;
+    }
+  else
+    {
+    /* Smooth the frame time so single slow frames don't switch levels */
+    double frameTime = Vrui::getFrameTime();
+    this->LODFrameTime = this->LODFrameTime > 0.0 ?
+      0.8 * this->LODFrameTime + 0.2 * frameTime : frameTime;
+    ++this->LODFramesAtLevel;
+    double targetTime = 1.0 / this->TargetFrameRate;
+
+    /* Give the previous switch time to settle before deciding again */
+    if (this->LODFramesAtLevel >= 15)
       {
-      /* Enable the clipping plane: */
-      glEnable(GL_CLIP_PLANE0 + clipPlaneIdx);
-      GLdouble clippingPlane[4];
-      for (int j = 0; j < 3; ++j)
+      if (this->LODFrameTime > 1.2 * targetTime && level < coarsest)
         {
-        clippingPlane[j] = this->ClippingPlanes[i].getPlane().getNormal()[j];
+        /* Too slow: go coarser, and wait longer before trying the finer
+         * level again if it was only just tried */
+        ++level;
+        if (this->LODProbing)
+          {
+          this->LODProbeInterval = std::min(2 * this->LODProbeInterval, 1920);
+          }
+        this->LODProbing = false;
         }
-      clippingPlane[3] = -this->ClippingPlanes[i].getPlane().getOffset();
-      glClipPlane(GL_CLIP_PLANE0 + clipPlaneIdx, clippingPlane);
-      /* Go to the next clipping plane: */
-      ++clipPlaneIdx;
+      else if (this->LODFrameTime <= 1.05 * targetTime)
+        {
+        if (this->LODProbing && this->LODFramesAtLevel >= 60)
+          {
+          this->LODProbing = false;
+          this->LODProbeInterval = 120;
+          }
+        /* Vsync caps the frame time, so it can't tell whether a finer level
+         * would fit. Try one after a stretch on target instead. */
+        if (level > 0 && this->LODFramesAtLevel >= this->LODProbeInterval)
+          {
+          --level;
+          this->LODProbing = true;
+          }
+        }
+      }
+    }
+
+  level = std::max(0, std::min(level, coarsest));
+  if (level != this->LODLevel)
+    {
+    this->LODLevel = level;
+    this->LODFramesAtLevel = 0;
+    this->LODFrameTime = 0.0;
+    if (this->lodValue)
+      {
+      std::ostringstream text;
+      text << "LOD " << level << " ("
+           << 100.0 * gvLODChain::levelFraction(level) << "%)";
+      this->lodValue->setString(text.str().c_str());
       }
     }
+}
+
+//----------------------------------------------------------------------------
+void GeometryViewer::initContext(GLContextData& contextData) const
+{
+  gvProfiler::Scope profile(gvProfiler::InitContext);
+
+  this->Superclass::initContext(contextData);
+
+  // Created by superclass:
+  gvContextState *state = contextData.retrieveDataItem<gvContextState>(this);
+  assert("Context state initialized by vvApplication." && state);
+
+  /* The geometry is loaded once by the application state; each context only
+   * maps it, so the per-context work is the GPU upload. */
+  std::shared_ptr<const gvFrameState> frameState =
+    this->ApplicationState->frameState();
+  state->updateGeometry(frameState->scene, frameState->geometryVersion);
+}
+
+//----------------------------------------------------------------------------
+void GeometryViewer::display(GLContextData &contextData) const
+{
+  const Vrui::DisplayState &displayState = Vrui::getDisplayState(contextData);
+  gvProfiler::Scope profile(gvProfiler::Display,
+                            displayState.window->getWindowIndex(),
+                            displayState.eyeIndex);
 
   /* Get context data item */
   gvContextState *state = contextData.retrieveDataItem<gvContextState>(this);
 
-  /* Set light properties */
-  state->headlight().SetIntensity(this->intensity);
-  state->headlight().SetAmbientColor(this->ambientColor->getValues(0),
-                                     this->ambientColor->getValues(1),
-                                     this->ambientColor->getValues(2));
-  state->headlight().SetDiffuseColor(this->diffuseColor->getValues(0),
-                                     this->diffuseColor->getValues(1),
-                                     this->diffuseColor->getValues(2));
-  state->headlight().SetSpecularColor(this->specularColor->getValues(0),
-                                      this->specularColor->getValues(1),
-                                      this->specularColor->getValues(2));
+  /* This frame's settings and geometry, published by frame(). Holding the
+   * snapshot keeps its geometry alive should frame() replace it meanwhile. */
+  std::shared_ptr<const gvFrameState> snapshot =
+    this->ApplicationState->frameState();
+  const gvFrameState &frameState = *snapshot;
+
+  /* Hand the active clipping planes to the mappers in one go */
+  state->setClipPlanes(frameState.clipPlanes);
+
+  /* Swap in newly loaded geometry */
+  state->updateGeometry(frameState.scene, frameState.geometryVersion);
+  state->setLevel(frameState.levels.get(), frameState.level);
+
+  /* View frustum of this window and eye in model coordinates */
+  gvFrustum frustum;
+  frustum.setFromGL();
 
-  /* Set actor opacity */
-  state->actor().GetProperty()->SetOpacity(this->Opacity);
-  if (this->RepresentationType < 3)
+  /* Skip the models and chunks this window can't see or that are clipped
+   * away */
+  size_t submitted, culled;
+  state->cullScene(frustum, frameState.modelVisibility, submitted, culled);
+  if (this->CullingReportInterval > 0.0)
     {
-    state->actor().GetProperty()->SetRepresentation(this->RepresentationType);
-    state->actor().GetProperty()->EdgeVisibilityOff();
+    state->reportTriangles(displayState.window->getWindowIndex(), submitted,
+                           culled, Vrui::getApplicationTime(),
+                           this->CullingReportInterval);
     }
-  else if (this->RepresentationType == 3)
+
+  /* Show the resident bricks of a streamed model in this window's view and
+   * ask for the ones it is missing */
+  gvBrickStreamer *streamer = frameState.streamer.get();
+  if (streamer)
     {
-    state->actor().GetProperty()->SetRepresentationToSurface();
-    state->actor().GetProperty()->EdgeVisibilityOn();
+    state->updateBricks(*streamer, frustum);
+    streamer->requestVisible(frustum);
     }
 
-  // Render the scene before removing clip planes:
+  /* Light and actor properties, only if they changed since this context
+   * last applied them */
+  state->applyRenderSettings(frameState.renderSettings,
+                             frameState.renderSettingsVersion);
+
+  /* Other windows may be rendering on their own threads; only uploads of
+   * new shared data need to take turns */
+  std::unique_lock<std::mutex> uploadLock = state->uploadLock();
   this->Superclass::display(contextData);
+  uploadLock = std::unique_lock<std::mutex>();
+
+  /* Fewer depth peels if this render went over budget */
+  state->updateTransparency();
 
-  clipPlaneIdx = 0;
-  for (int i = 0;
-       i < this->NumberOfClippingPlanes && clipPlaneIdx < maxClipPlanes;
-       ++i)
+  if (this->FrameRateReportInterval > 0.0 && displayState.eyeIndex == 0)
     {
-    if (ClippingPlanes[i].isActive())
-      {
-      /* Disable the clipping plane: */
-      glDisable(GL_CLIP_PLANE0 + clipPlaneIdx);
-      /* Go to the next clipping plane: */
-      ++clipPlaneIdx;
-      }
+    this->ApplicationState->countWindowFrame();
+    state->reportMemory(displayState.window->getWindowIndex(),
+                        Vrui::getApplicationTime(),
+                        this->FrameRateReportInterval);
     }
 }
 
@@ -415,7 +848,7 @@ void GeometryViewer::setIntensity(float intensity)
 //----------------------------------------------------------------------------
 void GeometryViewer::centerDisplayCallback(Misc::CallbackData *callBackData)
 {
-  if (!this->DataBounds)
+  if (this->ApplicationState->scene()->models().empty())
     {
     std::cerr << "ERROR: Data bounds not set!!" << std::endl;
     return;
@@ -423,6 +856,15 @@ void GeometryViewer::centerDisplayCallback(Misc::CallbackData *callBackData)
   Vrui::setNavigationTransformation(this->Center, this->Radius);
 }
 
+//----------------------------------------------------------------------------
+void GeometryViewer::writeProfileCallback(Misc::CallbackData *callBackData)
+{
+  if (gvProfiler *profiler = gvProfiler::active())
+    {
+    profiler->write();
+    }
+}
+
 //----------------------------------------------------------------------------
 void GeometryViewer::opacitySliderCallback(
   GLMotif::Slider::ValueChangedCallbackData *callBackData)
@@ -431,6 +873,24 @@ void GeometryViewer::opacitySliderCallback(
   this->opacityValue->setValue(callBackData->value);
 }
 
+//----------------------------------------------------------------------------
+void GeometryViewer::lodSliderCallback(
+  GLMotif::Slider::ValueChangedCallbackData *callBackData)
+{
+  this->LODSliderLevel = static_cast<int>(callBackData->value + 0.5f);
+  if (this->PinnedLOD >= 0)
+    {
+    this->PinnedLOD = this->LODSliderLevel;
+    }
+}
+
+//----------------------------------------------------------------------------
+void GeometryViewer::pinLODCallback(
+  GLMotif::ToggleButton::ValueChangedCallbackData *callBackData)
+{
+  this->PinnedLOD = callBackData->set ? this->LODSliderLevel : -1;
+}
+
 //----------------------------------------------------------------------------
 void GeometryViewer::changeRepresentationCallback(
     GLMotif::ToggleButton::ValueChangedCallbackData *callBackData)
@@ -453,6 +913,29 @@ void GeometryViewer::changeRepresentationCallback(
     this->RepresentationType = 3;
     }
 }
+
+//----------------------------------------------------------------------------
+void GeometryViewer::changeTransparencyCallback(
+    GLMotif::ToggleButton::ValueChangedCallbackData *callBackData)
+{
+  /* The radio box also reports the toggle it switched off */
+  if (!callBackData->set)
+    {
+    return;
+    }
+  if (strcmp(callBackData->toggle->getName(), "Unsorted") == 0)
+    {
+    this->TransparencyMode = gvRenderSettings::Unsorted;
+    }
+  else if (strcmp(callBackData->toggle->getName(), "SortedChunks") == 0)
+    {
+    this->TransparencyMode = gvRenderSettings::SortedChunks;
+    }
+  else if (strcmp(callBackData->toggle->getName(), "DepthPeeling") == 0)
+    {
+    this->TransparencyMode = gvRenderSettings::DepthPeeling;
+    }
+}
 //----------------------------------------------------------------------------
 void GeometryViewer::changeAnalysisToolsCallback(
     GLMotif::ToggleButton::ValueChangedCallbackData *callBackData)
@@ -464,6 +947,19 @@ void GeometryViewer::changeAnalysisToolsCallback(
     }
 }
 
+//----------------------------------------------------------------------------
+void GeometryViewer::changeModelVisibilityCallback(
+    GLMotif::ToggleButton::ValueChangedCallbackData *callBackData)
+{
+  /* The toggle's name carries the model index: */
+  size_t model = static_cast<size_t>(
+    atoi(callBackData->toggle->getName() + strlen("Model")));
+  if (model < this->ModelVisibility.size())
+    {
+    this->ModelVisibility[model] = callBackData->set;
+    }
+}
+
 //----------------------------------------------------------------------------
 void GeometryViewer::showRenderingDialogCallback(
     GLMotif::ToggleButton::ValueChangedCallbackData *callBackData)
@@ -507,6 +1003,30 @@ void GeometryViewer::showLightingDialogCallback(
     }
 }
 
+//----------------------------------------------------------------------------
+void GeometryViewer::setTransparency(int mode)
+{
+  this->TransparencyMode = mode;
+}
+
+//----------------------------------------------------------------------------
+void GeometryViewer::setCullingStatistics(bool report)
+{
+  this->CullingReportInterval = report ? 5.0 : 0.0;
+}
+
+//----------------------------------------------------------------------------
+void GeometryViewer::setFrameRateStatistics(bool report)
+{
+  this->FrameRateReportInterval = report ? 5.0 : 0.0;
+}
+
+//----------------------------------------------------------------------------
+const gvBVH* GeometryViewer::getSpatialIndex() const
+{
+  return this->ApplicationState->spatialIndex();
+}
+
 //----------------------------------------------------------------------------
 ClippingPlane *GeometryViewer::getClippingPlanes()
 {
@@ -568,5 +1088,5 @@ void GeometryViewer::toolDestructionCallback(
 //----------------------------------------------------------------------------
 vvContextState *GeometryViewer::createContextState() const
 {
-  return new gvContextState;
+  return new gvContextState(this->NumberOfClippingPlanes);
 }
@@ -9,6 +9,8 @@
 
 #include <vvApplication.h>
 
+#include "gvScene.h"
+
 // Vrui includes
 #include <GL/GLObject.h>
 #include <GLMotif/PopupWindow.h>
@@ -20,6 +22,9 @@
 // VTK includes
 #include <vtkSmartPointer.h>
 
+#include <chrono>
+#include <vector>
+
 /* Forward Declarations */
 namespace GLMotif
 {
@@ -31,6 +36,8 @@ class vtkActor;
 class BaseLocator;
 class ClippingPlane;
 class ExternalVTKWidget;
+class gvApplicationState;
+class gvBVH;
 class Lighting;
 class RGBAColor;
 class vtkExternalLight;
@@ -46,26 +53,82 @@ private:
   GLMotif::PopupMenu* createMainMenu(void);
   GLMotif::Popup* createRepresentationMenu(void);
   GLMotif::Popup* createAnalysisToolsMenu(void);
+  GLMotif::Popup* createModelsMenu(void);
   GLMotif::PopupWindow* lightingDialog;
   GLMotif::PopupWindow* renderingDialog;
   GLMotif::PopupWindow* createRenderingDialog(void);
   GLMotif::TextField* opacityValue;
+  GLMotif::TextField* lodValue;
 
   /* Name of file to load */
   char* FileName;
 
+  /* Models of the scene to load, and which of them are shown */
+  std::vector<gvScene::Entry> Models;
+  std::vector<bool> ModelVisibility;
+  void loadModels(void);
+
   /* Opacity value */
   double Opacity;
 
   /* Representation Type */
   int RepresentationType;
 
-  /* bounds */
-  double* DataBounds;
+  /* Blending of translucent surfaces (gvRenderSettings::Transparency), and
+   * the depth peeling limits: at most MaximumPeels peels, fewer while
+   * renders take longer than PeelingBudget seconds */
+  int TransparencyMode;
+  int MaximumPeels;
+  double PeelingBudget;
+
+  /* Stream the model from on-disk bricks regardless of its size */
+  bool Streaming;
+
+  /* Run loaded meshes through gvMeshOptimizer */
+  bool OptimizeMesh;
+
+  /* Draw chunked meshes from gvCompactMesh's quantized buffers */
+  bool CompactStorage;
+
+  /* Seconds between per-window culling reports, 0 to disable */
+  double CullingReportInterval;
+
+  /* Seconds between aggregate frame rate reports, 0 to disable */
+  double FrameRateReportInterval;
+  double FrameRateReportTime;
+  int FrameRateReportFrames;
+  void reportFrameRates(void);
+
+  /* Shared application state (owned by vvApplication) */
+  gvApplicationState* ApplicationState;
+
+  /* Level of detail: the rendered level, the level pinned from the rendering
+   * dialog (-1 selects automatically) and the frame-time selection state */
+  int LODLevel;
+  int PinnedLOD;
+  int LODSliderLevel;
+  double TargetFrameRate;
+  double LODFrameTime;
+  int LODFramesAtLevel;
+  int LODProbeInterval;
+  bool LODProbing;
+  void selectLevel(void);
+
+  /* Hand the dialog settings below to the application state, which versions
+   * them for the contexts */
+  void updateRenderSettings(void);
+
+  /* Snapshot what display() needs from this frame, along with the geometry
+   * to draw; the callbacks keep writing the members in place */
+  void publishFrameState(void);
 
   /* First Frame */
   bool FirstFrame;
 
+  /* Startup timing, reported once the first frame is up */
+  std::chrono::steady_clock::time_point StartTime;
+  bool StartupReported;
+
   /* Data Center */
   Vrui::Point Center;
 
@@ -98,10 +161,49 @@ public:
   GeometryViewer(int& argc,char**& argv);
   virtual ~GeometryViewer(void);
 
+private:
+  GeometryViewer(int& argc, char**& argv, gvApplicationState* state);
+
+public:
+
   /* Methods to set/get the filename to read */
   void setFileName(const char* name);
   const char* getFileName(void);
 
+  /* Load several models, each placed by its transform. Set them before
+   * initialize() to get a menu that shows and hides each model. */
+  void setModels(const std::vector<gvScene::Entry>& models);
+
+  /* Choose the fast mesh readers (default) or VTK's reader per format */
+  void setReaderOptions(bool parallel, unsigned int numberOfThreads);
+
+  /* Force out-of-core streaming; otherwise only models larger than the
+   * streamingMemoryBudget configuration setting are streamed */
+  void setStreaming(bool streaming);
+
+  /* Weld, reorder and renumber loaded meshes for the GPU's vertex cache;
+   * the weldTolerance configuration setting is relative to each mesh's
+   * diagonal */
+  void setOptimizeMesh(bool optimize);
+
+  /* Keep chunks of large meshes as 16-bit positions and octahedral normals
+   * on the GPU instead of floats; OpenGL2 only, and rules out depth
+   * peeling */
+  void setCompactStorage(bool compact);
+
+  /* Blending of translucent surfaces, a gvRenderSettings::Transparency;
+   * the rendering dialog switches it at run time. Depth peeling falls back
+   * to sorted chunks with compact storage. */
+  void setTransparency(int mode);
+
+  /* Print submitted versus culled triangle counts per window */
+  void setCullingStatistics(bool report);
+  void setFrameRateStatistics(bool report);
+
+  /* Spatial index over the loaded triangles in model coordinates, or NULL
+   * while a streamed model or several models are shown */
+  const gvBVH * getSpatialIndex(void) const;
+
   /* Clipping Planes */
   ClippingPlane * getClippingPlanes(void);
   int getNumberOfClippingPlanes(void);
@@ -120,11 +222,16 @@ public:
 
   /* Callback methods */
   void centerDisplayCallback(Misc::CallbackData* cbData);
+  void writeProfileCallback(Misc::CallbackData* cbData);
   void opacitySliderCallback(GLMotif::Slider::ValueChangedCallbackData* cbData);
+  void lodSliderCallback(GLMotif::Slider::ValueChangedCallbackData* cbData);
+  void pinLODCallback(GLMotif::ToggleButton::ValueChangedCallbackData* callBackData);
   void changeRepresentationCallback(GLMotif::ToggleButton::ValueChangedCallbackData* callBackData);
+  void changeTransparencyCallback(GLMotif::ToggleButton::ValueChangedCallbackData* callBackData);
   void showLightingDialogCallback(GLMotif::ToggleButton::ValueChangedCallbackData* callBackData);
   void showRenderingDialogCallback(GLMotif::ToggleButton::ValueChangedCallbackData* callBackData);
   void changeAnalysisToolsCallback(GLMotif::ToggleButton::ValueChangedCallbackData* callBackData);
+  void changeModelVisibilityCallback(GLMotif::ToggleButton::ValueChangedCallbackData* callBackData);
 
   void setAmbientColor(float r, float g, float b);
   void setDiffuseColor(float r, float g, float b);
@@ -0,0 +1,824 @@
+// Headless frame times of the GeometryViewer rendering pipeline.
+//
+// Renders a model offscreen through the same pieces a GL context uses --
+// chunk actors culled by gvFrustum, the headlight, clipping planes, and the
+// representation and transparency mode from gvRenderSettings -- while
+// replaying a camera path,
+// then reports per-frame times, triangle throughput and peak memory as JSON.
+// Without a display, VTK must be built with OSMesa or EGL.
+
+#include "gvBVH.h"
+#include "gvFrustum.h"
+#include "gvGeometryReader.h"
+#include "gvMeshCache.h"
+#include "gvMeshChunks.h"
+#include "gvMeshNormals.h"
+#include "gvMeshOptimizer.h"
+#include "gvMeshUtilities.h"
+#include "gvRenderSettings.h"
+#include "gvSyntheticMesh.h"
+#include "gvTransparency.h"
+
+#ifdef GV_OPENGL2
+#include "gvClippingMapper.h"
+#include "gvCompactMapper.h"
+#include "gvCompactMesh.h"
+#endif
+
+#include <vtkActor.h>
+#include <vtkCamera.h>
+#include <vtkCubeSource.h>
+#include <vtkLight.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkPlane.h>
+#include <vtkPlaneCollection.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkProperty.h>
+#include <vtkRenderWindow.h>
+#include <vtkRenderer.h>
+#include <vtkSmartPointer.h>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+typedef std::vector<std::array<double, 4> > ClipPlanes;
+
+struct CameraPose
+{
+  double position[3];
+  double focalPoint[3];
+  double viewUp[3];
+  double viewAngle;
+};
+
+struct ChunkActor
+{
+  double bounds[6];
+  std::size_t numberOfTriangles;
+  vtkSmartPointer<vtkActor> actor;
+  vtkSmartPointer<vtkMapper> mapper;
+  vtkSmartPointer<vtkActor> edgeActor; // Edges over a VTK-drawn surface
+};
+
+vtkSmartPointer<vtkPolyData> readGeometry(const std::string &fileName,
+                                         bool optimize, double featureAngle)
+{
+  // GeometryViewer's default weldTolerance:
+  const double weldTolerance = 1e-6;
+  vtkSmartPointer<vtkPolyData> output;
+  gvSyntheticMesh::Specification synthetic;
+  if (gvSyntheticMesh::parse(fileName, synthetic))
+    {
+    output = gvSyntheticMesh::generate(synthetic);
+    output = gvMeshNormals::compute(output, featureAngle);
+    }
+  else if (!fileName.empty())
+    {
+    output = gvMeshCache::read(fileName, optimize, weldTolerance,
+                               featureAngle);
+    if (!output)
+      {
+      output = gvGeometryReader::read(fileName);
+      if (output)
+        {
+        output = gvMeshNormals::compute(output, featureAngle);
+        }
+      }
+    else
+      {
+      optimize = false;
+      }
+    }
+  else
+    {
+    vtkNew<vtkCubeSource> cube;
+    cube->Update();
+    output = vtkSmartPointer<vtkPolyData>::New();
+    output->ShallowCopy(cube->GetOutput());
+    }
+  if (output && optimize && !fileName.empty())
+    {
+    output = gvMeshOptimizer::optimize(output, weldTolerance);
+    }
+  if (output)
+    {
+    gvMeshUtilities::prepareForSharing(output);
+    }
+  return output;
+}
+
+// One pose per line: "px py pz fx fy fz ux uy uz [viewAngle]". Blank lines
+// and lines starting with '#' are skipped.
+bool readCameraPath(const std::string &fileName,
+                    std::vector<CameraPose> &path)
+{
+  std::ifstream in(fileName.c_str());
+  if (!in)
+    {
+    return false;
+    }
+  std::string line;
+  while (std::getline(in, line))
+    {
+    std::size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos || line[start] == '#')
+      {
+      continue;
+      }
+    std::istringstream fields(line);
+    CameraPose pose;
+    for (int i = 0; i < 3; ++i)
+      {
+      fields >> pose.position[i];
+      }
+    for (int i = 0; i < 3; ++i)
+      {
+      fields >> pose.focalPoint[i];
+      }
+    for (int i = 0; i < 3; ++i)
+      {
+      fields >> pose.viewUp[i];
+      }
+    if (!fields)
+      {
+      std::cerr << "ERROR: Bad camera pose \"" << line << "\"" << std::endl;
+      return false;
+      }
+    if (!(fields >> pose.viewAngle))
+      {
+      pose.viewAngle = 30.;
+      }
+    path.push_back(pose);
+    }
+  return !path.empty();
+}
+
+// A full turn around the model's vertical axis, framing its bounds.
+void orbitCameraPath(const double bounds[6], std::size_t numberOfFrames,
+                     std::vector<CameraPose> &path)
+{
+  double center[3];
+  double radius = 0.;
+  for (int i = 0; i < 3; ++i)
+    {
+    center[i] = .5 * (bounds[2 * i] + bounds[2 * i + 1]);
+    double half = .5 * (bounds[2 * i + 1] - bounds[2 * i]);
+    radius += half * half;
+    }
+  radius = std::max(std::sqrt(radius), 1e-6);
+
+  for (std::size_t f = 0; f < numberOfFrames; ++f)
+    {
+    double angle = 2. * M_PI * f / numberOfFrames;
+    CameraPose pose;
+    pose.position[0] = center[0] + 2.5 * radius * std::sin(angle);
+    pose.position[1] = center[1] + .5 * radius;
+    pose.position[2] = center[2] + 2.5 * radius * std::cos(angle);
+    for (int i = 0; i < 3; ++i)
+      {
+      pose.focalPoint[i] = center[i];
+      pose.viewUp[i] = i == 1 ? 1. : 0.;
+      }
+    pose.viewAngle = 30.;
+    path.push_back(pose);
+    }
+}
+
+// Mirrors gvContextState: GPU clipping under OpenGL2, VTK's planes else.
+class Clipping
+{
+public:
+  explicit Clipping(const ClipPlanes &equations)
+    : m_equations(equations)
+  {
+    for (std::size_t i = 0; i < equations.size(); ++i)
+      {
+      const std::array<double, 4> &equation = equations[i];
+#ifdef GV_OPENGL2
+      for (int j = 0; j < 4; ++j)
+        {
+        m_uniforms.push_back(static_cast<float>(equation[j]));
+        }
+#else
+      double lengthSquared = equation[0] * equation[0] +
+        equation[1] * equation[1] + equation[2] * equation[2];
+      if (lengthSquared <= 0.)
+        {
+        continue;
+        }
+      vtkNew<vtkPlane> plane;
+      plane->SetNormal(equation[0], equation[1], equation[2]);
+      double scale = -equation[3] / lengthSquared;
+      plane->SetOrigin(scale * equation[0], scale * equation[1],
+                       scale * equation[2]);
+      m_planes->AddItem(plane.Get());
+#endif
+      }
+  }
+
+  const ClipPlanes& equations() const { return m_equations; }
+
+  vtkSmartPointer<vtkPolyDataMapper> newMapper() const
+  {
+#ifdef GV_OPENGL2
+    vtkSmartPointer<gvClippingMapper> mapper =
+      vtkSmartPointer<gvClippingMapper>::New();
+    mapper->setMaximumNumberOfClipPlanes(
+      std::max(static_cast<int>(m_equations.size()), 1));
+    return mapper;
+#else
+    return vtkSmartPointer<vtkPolyDataMapper>::New();
+#endif
+  }
+
+#ifdef GV_OPENGL2
+  vtkSmartPointer<gvCompactMapper> newCompactMapper() const
+  {
+    vtkSmartPointer<gvCompactMapper> mapper =
+      vtkSmartPointer<gvCompactMapper>::New();
+    mapper->setMaximumNumberOfClipPlanes(
+      std::max(static_cast<int>(m_equations.size()), 1));
+    return mapper;
+  }
+#endif
+
+  void apply(vtkMapper *mapper, bool clip) const
+  {
+#ifdef GV_OPENGL2
+    const std::vector<float> *planes = clip ? &m_uniforms : nullptr;
+    if (gvCompactMapper *compact = gvCompactMapper::SafeDownCast(mapper))
+      {
+      compact->setClipPlanes(planes);
+      }
+    else
+      {
+      static_cast<gvClippingMapper*>(mapper)->setClipPlanes(planes);
+      }
+#else
+    mapper->SetClippingPlanes(clip ? m_planes.Get() : nullptr);
+#endif
+  }
+
+private:
+  ClipPlanes m_equations;
+#ifdef GV_OPENGL2
+  std::vector<float> m_uniforms;
+#else
+  vtkNew<vtkPlaneCollection> m_planes;
+#endif
+};
+
+void applyRenderSettings(const gvRenderSettings &settings, vtkLight *headlight,
+                         vtkProperty *property)
+{
+  headlight->SetIntensity(settings.intensity);
+  headlight->SetAmbientColor(settings.ambient[0], settings.ambient[1],
+                             settings.ambient[2]);
+  headlight->SetDiffuseColor(settings.diffuse[0], settings.diffuse[1],
+                             settings.diffuse[2]);
+  headlight->SetSpecularColor(settings.specular[0], settings.specular[1],
+                              settings.specular[2]);
+
+  property->SetOpacity(settings.opacity);
+  if (settings.representation < 3)
+    {
+    property->SetRepresentation(settings.representation);
+    property->EdgeVisibilityOff();
+    }
+  else
+    {
+    property->SetRepresentationToSurface();
+    property->EdgeVisibilityOn();
+    }
+}
+
+// The camera's view frustum in world space.
+void cameraFrustum(vtkCamera *camera, double aspect, gvFrustum &frustum)
+{
+  // VTK's matrices are row-major, gvFrustum takes OpenGL's column-major:
+  vtkMatrix4x4 *projection =
+    camera->GetProjectionTransformMatrix(aspect, -1., 1.);
+  vtkMatrix4x4 *modelview = camera->GetModelViewTransformMatrix();
+  double p[16], m[16];
+  for (int i = 0; i < 4; ++i)
+    {
+    for (int j = 0; j < 4; ++j)
+      {
+      p[4 * j + i] = projection->GetElement(i, j);
+      m[4 * j + i] = modelview->GetElement(i, j);
+      }
+    }
+  frustum.setFromMatrices(p, m);
+}
+
+// Show the chunks in the frustum and not clipped away, clipping only those
+// that straddle a plane. Returns the number of triangles submitted.
+std::size_t cullChunks(std::vector<ChunkActor> &chunks,
+                       const gvFrustum &frustum, const Clipping &clipping)
+{
+  std::size_t submitted = 0;
+  for (std::size_t i = 0; i < chunks.size(); ++i)
+    {
+    ChunkActor &chunk = chunks[i];
+    gvFrustum::ClipState clip =
+      gvFrustum::classifyClipping(clipping.equations(), chunk.bounds);
+    bool visible = clip != gvFrustum::Clipped &&
+      frustum.intersects(chunk.bounds);
+    chunk.actor->SetVisibility(visible ? 1 : 0);
+    if (chunk.edgeActor)
+      {
+      chunk.edgeActor->SetVisibility(visible ? 1 : 0);
+      }
+    if (visible)
+      {
+      clipping.apply(chunk.mapper, clip == gvFrustum::Straddling);
+      if (chunk.edgeActor)
+        {
+        clipping.apply(chunk.edgeActor->GetMapper(),
+                       clip == gvFrustum::Straddling);
+        }
+      submitted += chunk.numberOfTriangles;
+      }
+    }
+  return submitted;
+}
+
+double percentile(const std::vector<double> &sorted, double p)
+{
+  std::size_t rank = static_cast<std::size_t>(p * (sorted.size() - 1) + .5);
+  return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+double peakResidentMegabytes()
+{
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+    return 0.;
+    }
+  // Kilobytes on Linux, bytes on macOS:
+#ifdef __APPLE__
+  return usage.ru_maxrss / (1024. * 1024.);
+#else
+  return usage.ru_maxrss / 1024.;
+#endif
+}
+
+void printUsage()
+{
+  std::cout << "\nUSAGE:\n\t./GeometryViewerBench [-path <file>] "
+               "[-frames <int>] [-warmup <int>] [-size <w>x<h>]\n"
+               "\t\t[-representation points|wireframe|surface|edges] "
+               "[-opacity <float>]\n"
+               "\t\t[-clip <a> <b> <c> <d>]... [-chunkTriangles <int>] "
+               "[-optimize] [-compact]\n"
+               "\t\t[-featureAngle <degrees>] "
+               "[-transparency unsorted|sorted|peeling]\n"
+               "\t\t[-maxPeels <int>] [-peelingBudget <ms>] "
+               "[-o <file.json>]\n"
+               "\t\t[model.obj | synthetic:<kind>:<triangles>]\n"
+            << "\nWithout a model a cube is rendered; without a path the "
+               "camera orbits the model.\n"
+               "-frames defaults to the length of the path, which repeats "
+               "if shorter.\n"
+               "A path file has one \"px py pz fx fy fz ux uy uz "
+               "[viewAngle]\" pose per line.\n"
+               "-optimize runs the model through gvMeshOptimizer after "
+               "loading.\n"
+               "-compact draws the chunks from gvCompactMesh's quantized "
+               "buffers (OpenGL2 only)\n"
+               "and reports their size next to that of float buffers.\n"
+               "-featureAngle splits the normals gvMeshNormals computes for "
+               "models without\n"
+               "them along sharper edges (30 by default, 180 for none).\n"
+               "-transparency blends surfaces below full opacity in draw "
+               "order (default), with\n"
+               "chunks sorted back to front, or by depth peeling: at most "
+               "-maxPeels peels (4),\n"
+               "fewer while renders take longer than -peelingBudget "
+               "milliseconds (4, 0 for none).\n"
+            << std::endl;
+}
+
+} // end anon namespace
+
+int main(int argc, char *argv[])
+{
+  std::string modelFile;
+  std::string pathFile;
+  std::string outputFile;
+  std::size_t numberOfFrames = 0;
+  std::size_t warmupFrames = 10;
+  std::size_t chunkTriangles = 65536;
+  bool optimize = false;
+  bool compact = false;
+  double featureAngle = 30.;
+  int width = 1280;
+  int height = 720;
+  gvRenderSettings settings;
+  ClipPlanes clipPlanes;
+  for (int i = 1; i < argc; ++i)
+    {
+    if (strcmp(argv[i], "-path") == 0 && i + 1 < argc)
+      {
+      pathFile = argv[++i];
+      }
+    else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+      {
+      numberOfFrames = static_cast<std::size_t>(atol(argv[++i]));
+      }
+    else if (strcmp(argv[i], "-warmup") == 0 && i + 1 < argc)
+      {
+      warmupFrames = static_cast<std::size_t>(atol(argv[++i]));
+      }
+    else if (strcmp(argv[i], "-size") == 0 && i + 1 < argc)
+      {
+      if (sscanf(argv[++i], "%dx%d", &width, &height) != 2 ||
+          width <= 0 || height <= 0)
+        {
+        std::cerr << "ERROR: Bad size " << argv[i] << std::endl;
+        return 1;
+        }
+      }
+    else if (strcmp(argv[i], "-representation") == 0 && i + 1 < argc)
+      {
+      const char *name = argv[++i];
+      static const char *names[] = { "points", "wireframe", "surface",
+                                     "edges" };
+      settings.representation = -1;
+      for (int r = 0; r < 4; ++r)
+        {
+        if (strcmp(name, names[r]) == 0)
+          {
+          settings.representation = r;
+          }
+        }
+      if (settings.representation < 0)
+        {
+        std::cerr << "ERROR: Unknown representation " << name << std::endl;
+        return 1;
+        }
+      }
+    else if (strcmp(argv[i], "-opacity") == 0 && i + 1 < argc)
+      {
+      settings.opacity = atof(argv[++i]);
+      }
+    else if (strcmp(argv[i], "-transparency") == 0 && i + 1 < argc)
+      {
+      const char *name = argv[++i];
+      static const char *names[] = { "unsorted", "sorted", "peeling" };
+      settings.transparency = -1;
+      for (int t = 0; t < 3; ++t)
+        {
+        if (strcmp(name, names[t]) == 0)
+          {
+          settings.transparency = t;
+          }
+        }
+      if (settings.transparency < 0)
+        {
+        std::cerr << "ERROR: Unknown transparency " << name << std::endl;
+        return 1;
+        }
+      }
+    else if (strcmp(argv[i], "-maxPeels") == 0 && i + 1 < argc)
+      {
+      settings.maximumPeels = atoi(argv[++i]);
+      }
+    else if (strcmp(argv[i], "-peelingBudget") == 0 && i + 1 < argc)
+      {
+      settings.peelingBudget = atof(argv[++i]) / 1e3;
+      }
+    else if (strcmp(argv[i], "-clip") == 0 && i + 4 < argc)
+      {
+      std::array<double, 4> plane;
+      for (int j = 0; j < 4; ++j)
+        {
+        plane[j] = atof(argv[++i]);
+        }
+      clipPlanes.push_back(plane);
+      }
+    else if (strcmp(argv[i], "-chunkTriangles") == 0 && i + 1 < argc)
+      {
+      chunkTriangles = static_cast<std::size_t>(atol(argv[++i]));
+      }
+    else if (strcmp(argv[i], "-optimize") == 0)
+      {
+      optimize = true;
+      }
+    else if (strcmp(argv[i], "-compact") == 0)
+      {
+      compact = true;
+      }
+    else if (strcmp(argv[i], "-featureAngle") == 0 && i + 1 < argc)
+      {
+      featureAngle = atof(argv[++i]);
+      }
+    else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+      {
+      outputFile = argv[++i];
+      }
+    else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "-help") == 0)
+      {
+      printUsage();
+      return 0;
+      }
+    else
+      {
+      modelFile = argv[i];
+      }
+    }
+
+  Clock::time_point start = Clock::now();
+  vtkSmartPointer<vtkPolyData> geometry = readGeometry(modelFile, optimize,
+                                                       featureAngle);
+  if (!geometry || geometry->GetNumberOfPoints() == 0)
+    {
+    std::cerr << "ERROR: Could not read " << modelFile << std::endl;
+    return 1;
+    }
+  std::shared_ptr<gvMeshChunks> chunks;
+  gvBVH index;
+  if (index.build(geometry))
+    {
+    chunks = gvMeshChunks::build(geometry, index, chunkTriangles);
+    }
+#ifdef GV_OPENGL2
+  std::shared_ptr<const gvCompactMesh> compactMesh;
+  if (compact && chunks)
+    {
+    compactMesh = gvCompactMesh::build(*chunks);
+    if (compactMesh)
+      {
+      chunks->releaseData();
+      }
+    }
+  if (compact && !compactMesh)
+    {
+    std::cerr << "Warning: The model can't use compact storage; drawing "
+                 "float buffers" << std::endl;
+    }
+  // Depth peeling doesn't rewrite gvCompactMapper's shaders, as in the
+  // viewer:
+  if (compactMesh && settings.transparency == gvRenderSettings::DepthPeeling)
+    {
+    std::cerr << "Warning: Depth peeling doesn't work with compact storage; "
+                 "sorting chunks" << std::endl;
+    settings.transparency = gvRenderSettings::SortedChunks;
+    }
+#else
+  if (compact)
+    {
+    std::cerr << "Warning: Compact storage needs the OpenGL2 backend"
+              << std::endl;
+    }
+#endif
+  double loadSeconds =
+    std::chrono::duration<double>(Clock::now() - start).count();
+
+  double bounds[6];
+  geometry->GetBounds(bounds);
+  std::vector<CameraPose> path;
+  if (pathFile.empty())
+    {
+    orbitCameraPath(bounds, numberOfFrames > 0 ? numberOfFrames : 360, path);
+    }
+  else if (!readCameraPath(pathFile, path))
+    {
+    std::cerr << "ERROR: Could not read camera path " << pathFile
+              << std::endl;
+    return 1;
+    }
+  if (numberOfFrames == 0)
+    {
+    numberOfFrames = path.size();
+    }
+
+  vtkNew<vtkRenderWindow> renderWindow;
+  renderWindow->SetOffScreenRendering(1);
+  renderWindow->SetSize(width, height);
+  vtkNew<vtkRenderer> renderer;
+  renderWindow->AddRenderer(renderer.Get());
+
+  // Depth peeling needs destination alpha and no multisampling:
+  gvTransparency transparency(renderer.Get());
+  transparency.apply(settings);
+  if (settings.transparency == gvRenderSettings::DepthPeeling)
+    {
+    renderWindow->SetAlphaBitPlanes(1);
+    renderWindow->SetMultiSamples(0);
+    }
+
+  vtkNew<vtkLight> headlight;
+  headlight->SetLightTypeToHeadlight();
+  renderer->AddLight(headlight.Get());
+
+  // Chunk actors share one property, as in gvContextState. Chunks drawn by
+  // VTK's mappers get their representation from their input instead, and
+  // draw edges over the surface with a second, unlit actor:
+  vtkNew<vtkProperty> property;
+  applyRenderSettings(settings, headlight.Get(), property.Get());
+  vtkNew<vtkProperty> chunkProperty;
+  chunkProperty->SetOpacity(settings.opacity);
+  vtkNew<vtkProperty> edgeProperty;
+  edgeProperty->SetOpacity(settings.opacity);
+  edgeProperty->LightingOff();
+  edgeProperty->SetColor(property->GetEdgeColor());
+  // Process-wide, as in GeometryViewer::initialize():
+  vtkMapper::SetResolveCoincidentTopologyToPolygonOffset();
+
+  Clipping clipping(clipPlanes);
+  std::vector<ChunkActor> actors;
+  std::size_t numberOfChunks = chunks ? chunks->chunks().size() : 1;
+  for (std::size_t i = 0; i < numberOfChunks; ++i)
+    {
+    ChunkActor chunk;
+    vtkPolyData *data = geometry;
+    vtkPolyData *edges = nullptr;
+    vtkProperty *actorProperty = property.Get();
+    if (chunks)
+      {
+      const gvMeshChunks::Chunk &source = chunks->chunks()[i];
+      std::copy(source.bounds, source.bounds + 6, chunk.bounds);
+      chunk.numberOfTriangles = source.numberOfTriangles;
+      data = settings.representation == VTK_POINTS ? source.vertices :
+        settings.representation == VTK_WIREFRAME ? source.edges :
+        source.data;
+      edges = settings.representation == 3 ? source.edges : nullptr;
+      actorProperty = chunkProperty.Get();
+      }
+    else
+      {
+      std::copy(bounds, bounds + 6, chunk.bounds);
+      chunk.numberOfTriangles =
+        static_cast<std::size_t>(geometry->GetNumberOfPolys());
+      }
+#ifdef GV_OPENGL2
+    if (compactMesh)
+      {
+      vtkSmartPointer<gvCompactMapper> mapper = clipping.newCompactMapper();
+      mapper->setChunk(compactMesh, i);
+      chunk.mapper = mapper;
+      edges = nullptr;
+      actorProperty = property.Get();
+      }
+    else
+#endif
+      {
+      vtkSmartPointer<vtkPolyDataMapper> mapper = clipping.newMapper();
+      mapper->SetInputData(data);
+      chunk.mapper = mapper;
+      }
+    chunk.actor = vtkSmartPointer<vtkActor>::New();
+    chunk.actor->SetMapper(chunk.mapper);
+    chunk.actor->SetProperty(actorProperty);
+    renderer->AddActor(chunk.actor);
+    if (edges)
+      {
+      vtkSmartPointer<vtkPolyDataMapper> mapper = clipping.newMapper();
+      mapper->SetInputData(edges);
+      chunk.edgeActor = vtkSmartPointer<vtkActor>::New();
+      chunk.edgeActor->SetMapper(mapper);
+      chunk.edgeActor->SetProperty(edgeProperty.Get());
+      renderer->AddActor(chunk.edgeActor);
+      }
+    actors.push_back(chunk);
+    }
+
+  // Warm-up frames upload the buffers and compile the shaders:
+  vtkCamera *camera = renderer->GetActiveCamera();
+  double aspect = static_cast<double>(width) / height;
+  std::vector<double> frameSeconds;
+  std::vector<std::size_t> frameTriangles;
+  for (std::size_t f = 0; f < warmupFrames + numberOfFrames; ++f)
+    {
+    const CameraPose &pose =
+      path[(f < warmupFrames ? 0 : f - warmupFrames) % path.size()];
+    camera->SetPosition(pose.position[0], pose.position[1],
+                        pose.position[2]);
+    camera->SetFocalPoint(pose.focalPoint[0], pose.focalPoint[1],
+                          pose.focalPoint[2]);
+    camera->SetViewUp(pose.viewUp[0], pose.viewUp[1], pose.viewUp[2]);
+    camera->SetViewAngle(pose.viewAngle);
+    renderer->ResetCameraClippingRange(bounds);
+
+    start = Clock::now();
+    gvFrustum frustum;
+    cameraFrustum(camera, aspect, frustum);
+    std::size_t submitted = cullChunks(actors, frustum, clipping);
+    renderWindow->Render();
+    renderWindow->WaitForCompletion();
+    double elapsed =
+      std::chrono::duration<double>(Clock::now() - start).count();
+    transparency.update();
+
+    if (f >= warmupFrames)
+      {
+      frameSeconds.push_back(elapsed);
+      frameTriangles.push_back(submitted);
+      }
+    }
+
+  double totalSeconds = 0.;
+  double totalTriangles = 0.;
+  for (std::size_t i = 0; i < frameSeconds.size(); ++i)
+    {
+    totalSeconds += frameSeconds[i];
+    totalTriangles += frameTriangles[i];
+    }
+  std::vector<double> sorted(frameSeconds);
+  std::sort(sorted.begin(), sorted.end());
+
+  std::ofstream file;
+  if (!outputFile.empty())
+    {
+    file.open(outputFile.c_str());
+    if (!file)
+      {
+      std::cerr << "ERROR: Could not write " << outputFile << std::endl;
+      return 1;
+      }
+    }
+  std::ostream &out = outputFile.empty() ? std::cout : file;
+
+  static const char *representations[] = { "points", "wireframe", "surface",
+                                           "edges" };
+  static const char *transparencies[] = { "unsorted", "sorted", "peeling" };
+  out << "{\n"
+      << "  \"model\": \"" << (modelFile.empty() ? "cube" : modelFile)
+      << "\",\n"
+      << "  \"triangles\": " << geometry->GetNumberOfPolys() << ",\n"
+      << "  \"chunks\": " << actors.size() << ",\n"
+      << "  \"loadSeconds\": " << loadSeconds << ",\n"
+      << "  \"width\": " << width << ",\n"
+      << "  \"height\": " << height << ",\n"
+      << "  \"representation\": \""
+      << representations[settings.representation] << "\",\n"
+      << "  \"opacity\": " << settings.opacity << ",\n"
+      << "  \"transparency\": \""
+      << transparencies[settings.transparency] << "\",\n"
+      << "  \"peels\": " << transparency.numberOfPeels() << ",\n"
+      << "  \"usedDepthPeeling\": "
+      << (renderer->GetLastRenderingUsedDepthPeeling() ? "true" : "false")
+      << ",\n"
+      << "  \"clipPlanes\": " << clipPlanes.size() << ",\n"
+      << "  \"frames\": " << frameSeconds.size() << ",\n";
+#ifdef GV_OPENGL2
+  if (compactMesh)
+    {
+    std::size_t bytes = 0;
+    std::size_t floatBytes = 0;
+    for (std::size_t i = 0; i < compactMesh->chunks().size(); ++i)
+      {
+      bytes += gvCompactMesh::bytes(compactMesh->chunks()[i]);
+      floatBytes += gvCompactMesh::floatBytes(compactMesh->chunks()[i]);
+      }
+    out << "  \"compactBufferMB\": " << bytes / (1024. * 1024.) << ",\n"
+        << "  \"floatBufferMB\": " << floatBytes / (1024. * 1024.) << ",\n"
+        << "  \"positionError\": " << compactMesh->positionError() << ",\n"
+        << "  \"normalErrorDegrees\": " << compactMesh->normalError()
+        << ",\n";
+    }
+#endif
+  if (!sorted.empty())
+    {
+    out << "  \"meanMs\": " << 1e3 * totalSeconds / sorted.size() << ",\n"
+        << "  \"p50Ms\": " << 1e3 * percentile(sorted, .5) << ",\n"
+        << "  \"p95Ms\": " << 1e3 * percentile(sorted, .95) << ",\n"
+        << "  \"maxMs\": " << 1e3 * sorted.back() << ",\n"
+        << "  \"trianglesPerSecond\": "
+        << (totalSeconds > 0. ? totalTriangles / totalSeconds : 0.) << ",\n";
+    }
+  out << "  \"peakResidentMB\": " << peakResidentMegabytes() << ",\n"
+      << "  \"frameMs\": [";
+  for (std::size_t i = 0; i < frameSeconds.size(); ++i)
+    {
+    out << (i ? ", " : "") << 1e3 * frameSeconds[i];
+    }
+  out << "],\n  \"frameTriangles\": [";
+  for (std::size_t i = 0; i < frameTriangles.size(); ++i)
+    {
+    out << (i ? ", " : "") << frameTriangles[i];
+    }
+  out << "]\n}\n";
+
+  return out ? 0 : 1;
+}
@@ -1,5 +1,443 @@
 #include "gvApplicationState.h"
 
+#include "gvBVH.h"
+#include "gvBrickStore.h"
+#include "gvBrickStreamer.h"
+#include "gvCompactMesh.h"
+#include "gvGeometryReader.h"
+#include "gvLODChain.h"
+#include "gvMappedFile.h"
+#include "gvMeshChunks.h"
+#include "gvMeshCache.h"
+#include "gvMeshNormals.h"
+#include "gvMeshOptimizer.h"
+#include "gvMeshUtilities.h"
+#include "gvParallel.h"
+#include "gvProfiler.h"
+#include "gvSyntheticMesh.h"
+
+#include <vtkCubeSource.h>
+#include <vtkNew.h>
+#include <vtkOutlineSource.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <utility>
+
 gvApplicationState::gvApplicationState()
+  : m_scene(new gvScene),
+    m_chunkSize(65536),
+    m_geometryVersion(0),
+    m_renderSettingsVersion(1),
+    m_windowFrames(0),
+    m_parallelReader(true),
+    m_readerThreads(0),
+    m_forceStreaming(false),
+    m_streamingBudget(static_cast<std::size_t>(2048) << 20),
+    m_optimizeMesh(false),
+    m_weldTolerance(1e-6),
+    m_featureAngle(30.),
+    m_compactStorage(false),
+    m_loading(false),
+    m_loadSeconds(0.)
+{
+  this->publishFrameState(gvFrameState());
+}
+
+gvApplicationState::~gvApplicationState()
+{
+  this->joinLoader();
+}
+
+void gvApplicationState::loadGeometry(const char *fileName)
+{
+  gvProfiler::Scope profile(gvProfiler::Load);
+  gvScene::Entry entry;
+  vtkSmartPointer<vtkPolyData> geometry =
+    readGeometry(fileName, m_readerThreads);
+  std::shared_ptr<gvBVH> index = this->buildIndex(geometry, m_readerThreads);
+  std::shared_ptr<gvScene> scene(new gvScene);
+  scene->addModel(entry, geometry, index, index ?
+    gvMeshChunks::build(geometry, *index, m_chunkSize, m_readerThreads) :
+    nullptr);
+  scene->buildHierarchy();
+  this->setScene(scene);
+}
+
+void gvApplicationState::setReaderOptions(bool parallel,
+                                          unsigned int numberOfThreads)
+{
+  m_parallelReader = parallel;
+  m_readerThreads = numberOfThreads;
+}
+
+void gvApplicationState::setStreamingOptions(bool force,
+                                             std::size_t budgetBytes)
+{
+  m_forceStreaming = force;
+  m_streamingBudget = budgetBytes;
+}
+
+void gvApplicationState::setMeshOptimization(bool enabled,
+                                             double weldTolerance)
+{
+  m_optimizeMesh = enabled;
+  m_weldTolerance = weldTolerance;
+}
+
+void gvApplicationState::setNormalFeatureAngle(double featureAngle)
+{
+  m_featureAngle = featureAngle;
+}
+
+void gvApplicationState::setCompactStorage(bool enabled)
+{
+#ifndef GV_OPENGL2
+  if (enabled)
+    {
+    std::cerr << "WARNING: Compact vertex storage needs VTK's OpenGL2 "
+                 "backend, keeping float vertices." << std::endl;
+    enabled = false;
+    }
+#endif
+  m_compactStorage = enabled;
+}
+
+void gvApplicationState::setChunkSize(std::size_t numberOfTriangles)
+{
+  m_chunkSize = numberOfTriangles;
+}
+
+bool gvApplicationState::updateStreaming()
+{
+  return m_streamer ? m_streamer->update() : false;
+}
+
+bool gvApplicationState::updateLevels()
+{
+  return m_levels ? m_levels->update() : false;
+}
+
+void gvApplicationState::publishFrameState(gvFrameState state)
+{
+  state.scene = m_scene;
+  state.geometryVersion = m_geometryVersion;
+  state.levels = m_levels;
+  state.level = m_levels ?
+    std::max(0, std::min(state.level, m_levels->availableLevels() - 1)) : 0;
+  state.streamer = m_streamer;
+  std::atomic_store(&m_frameState,
+    std::shared_ptr<const gvFrameState>(new gvFrameState(std::move(state))));
+}
+
+void gvApplicationState::setRenderSettings(const gvRenderSettings &settings)
+{
+  if (settings != m_renderSettings)
+    {
+    m_renderSettings = settings;
+    ++m_renderSettingsVersion;
+    }
+}
+
+void gvApplicationState::loadSceneAsync(
+    const std::vector<gvScene::Entry> &entries,
+    const std::function<void()> &finished)
+{
+  // Only one load at a time; a newer request waits for the previous one.
+  this->joinLoader();
+
+  m_loading = true;
+  m_finished = finished;
+  m_loader = std::thread([this, entries, finished]()
+    {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+
+    std::shared_ptr<gvScene> scene(new gvScene);
+    std::shared_ptr<gvBrickStore> bricks;
+    if (this->shouldStream(entries))
+      {
+      bricks = gvBrickStore::open(entries[0].fileName);
+      if (bricks)
+        {
+        // Show the model's extent until its bricks arrive:
+        vtkNew<vtkOutlineSource> outline;
+        outline->SetBounds(const_cast<double*>(bricks->bounds()));
+        outline->Update();
+        vtkSmartPointer<vtkPolyData> geometry =
+          vtkSmartPointer<vtkPolyData>::New();
+        geometry->ShallowCopy(outline->GetOutput());
+        gvMeshUtilities::prepareForSharing(geometry);
+        scene->addModel(entries[0], geometry, nullptr, nullptr);
+        }
+      }
+    if (!bricks)
+      {
+      // Models load side by side and split the threads between them:
+      struct Loaded
+      {
+        vtkSmartPointer<vtkPolyData> geometry;
+        std::shared_ptr<gvBVH> index;
+        std::shared_ptr<gvMeshChunks> chunks;
+        std::shared_ptr<const gvCompactMesh> compact;
+      };
+      std::vector<Loaded> models(entries.size());
+      unsigned int threads = gvParallel::resolveThreads(m_readerThreads);
+      unsigned int workers = static_cast<unsigned int>(
+        std::min<std::size_t>(threads, entries.size()));
+      unsigned int modelThreads = std::max(1u, threads / workers);
+      gvParallel::forEach(entries.size(), [&](std::size_t i)
+        {
+        Loaded &model = models[i];
+        model.geometry = readGeometry(entries[i].fileName.c_str(),
+                                      modelThreads);
+        model.index = this->buildIndex(model.geometry, modelThreads);
+        // Instances are drawn whole:
+        if (model.index && entries[i].instances.empty())
+          {
+          model.chunks = gvMeshChunks::build(model.geometry, *model.index,
+                                             m_chunkSize, modelThreads);
+          }
+        // The compact copy replaces the chunks' float data:
+        if (model.chunks && m_compactStorage)
+          {
+          model.compact = gvCompactMesh::build(*model.chunks, modelThreads);
+          if (model.compact)
+            {
+            model.chunks->releaseData();
+            }
+          }
+        }, workers);
+
+      for (std::size_t i = 0; i < entries.size(); ++i)
+        {
+        if (models[i].geometry->GetNumberOfPoints() == 0)
+          {
+          std::cerr << "ERROR: " << entries[i].fileName
+                    << " is empty, leaving it out." << std::endl;
+          continue;
+          }
+        scene->addModel(entries[i], models[i].geometry, models[i].index,
+                        models[i].chunks, models[i].compact, i);
+        }
+      }
+    scene->buildHierarchy();
+
+    Clock::time_point end = Clock::now();
+    std::chrono::duration<double> elapsed = end - start;
+    if (gvProfiler *profiler = gvProfiler::active())
+      {
+      profiler->record(gvProfiler::Load, -1, -1, start, end);
+      }
+      {
+      std::lock_guard<std::mutex> lock(m_loaderMutex);
+      m_pending = scene;
+      m_pendingBricks = bricks;
+      m_loadSeconds = elapsed.count();
+      }
+    m_loading = false;
+
+    if (finished)
+      {
+      finished();
+      }
+    });
+}
+
+bool gvApplicationState::updateGeometry()
+{
+  std::shared_ptr<gvScene> pending;
+  std::shared_ptr<gvBrickStore> bricks;
+    {
+    std::lock_guard<std::mutex> lock(m_loaderMutex);
+    pending.swap(m_pending);
+    bricks.swap(m_pendingBricks);
+    }
+
+  if (!pending)
+    {
+    return false;
+    }
+
+  if (pending->models().empty())
+    {
+    std::cerr << "ERROR: Loaded scene is empty, keeping placeholder."
+              << std::endl;
+    return false;
+    }
+
+  if (bricks)
+    {
+    std::cout << "Streaming " << bricks->bricks().size() << " bricks within "
+              << (m_streamingBudget >> 20) << " MB" << std::endl;
+    m_streamer.reset(new gvBrickStreamer(bricks, m_streamingBudget,
+                                         m_finished));
+    }
+  else
+    {
+    m_streamer.reset();
+    }
+
+  std::size_t numberOfChunks = 0;
+  for (std::size_t i = 0; i < pending->models().size(); ++i)
+    {
+    const gvMeshChunks *chunks = pending->models()[i].chunks.get();
+    numberOfChunks += chunks ? chunks->chunks().size() : 0;
+    }
+  if (numberOfChunks > 0)
+    {
+    std::cout << "Split into " << numberOfChunks << " chunks for culling"
+              << std::endl;
+    }
+  this->setScene(pending);
+
+  // Streamed models get their detail from bricks instead, and scenes of
+  // several models or instances are drawn at full detail:
+  m_levels.reset();
+  if (!m_streamer && m_scene->models().size() == 1 &&
+      m_scene->models()[0].instances.empty())
+    {
+    m_levels.reset(new gvLODChain(m_scene->models()[0].geometry,
+                                  m_finished));
+    }
+  return true;
+}
+
+const gvBVH* gvApplicationState::spatialIndex() const
+{
+  return m_scene->models().size() == 1 &&
+    m_scene->models()[0].instances.empty() ?
+    m_scene->models()[0].index.get() : nullptr;
+}
+
+bool gvApplicationState::shouldStream(
+    const std::vector<gvScene::Entry> &entries) const
+{
+  if (entries.size() != 1 || !entries[0].instances.empty() ||
+      entries[0].transform != gvScene::Entry().transform)
+    {
+    return false;
+    }
+
+  // Bricks are only built from OBJ files:
+  const std::string &fileName = entries[0].fileName;
+  if (fileName.size() < 4 ||
+      fileName.compare(fileName.size() - 4, 4, ".obj") != 0)
+    {
+    return false;
+    }
+  if (m_forceStreaming)
+    {
+    return true;
+    }
+  std::uint64_t size;
+  std::int64_t mtime;
+  return gvMappedFile::statFile(fileName, size, mtime) &&
+    size > m_streamingBudget;
+}
+
+vtkSmartPointer<vtkPolyData> gvApplicationState::readGeometry(
+    const char *fileName, unsigned int numberOfThreads) const
+{
+  vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+
+  gvSyntheticMesh::Specification synthetic;
+  if (fileName && gvSyntheticMesh::parse(fileName, synthetic))
+    {
+    output = gvSyntheticMesh::generate(synthetic, numberOfThreads);
+    output = gvMeshNormals::compute(output, m_featureAngle, numberOfThreads);
+    if (m_optimizeMesh)
+      {
+      output = gvMeshOptimizer::optimize(output, m_weldTolerance,
+                                         numberOfThreads);
+      }
+    }
+  else if (fileName)
+    {
+    // A valid cache is mapped straight into the output's arrays:
+    vtkSmartPointer<vtkPolyData> cached =
+      gvMeshCache::read(fileName, m_optimizeMesh, m_weldTolerance,
+                        m_featureAngle);
+    if (cached)
+      {
+      std::cout << "Using mesh cache "
+                << gvMeshCache::cacheFileName(fileName) << std::endl;
+      output = cached;
+      }
+    else
+      {
+      output = gvGeometryReader::read(fileName, numberOfThreads,
+                                      m_parallelReader);
+      // Normals are computed before optimizing, so that welding keeps the
+      // points split along creases apart:
+      double featureAngle = -1.;
+      if (!output)
+        {
+        output = vtkSmartPointer<vtkPolyData>::New();
+        }
+      else if (!output->GetPointData()->GetNormals())
+        {
+        output = gvMeshNormals::compute(output, m_featureAngle,
+                                        numberOfThreads);
+        featureAngle = m_featureAngle;
+        }
+      if (m_optimizeMesh && output->GetNumberOfPolys() > 0)
+        {
+        output = gvMeshOptimizer::optimize(output, m_weldTolerance,
+                                           numberOfThreads);
+        }
+      if (gvMeshCache::write(fileName, output, m_optimizeMesh,
+                             m_weldTolerance, featureAngle))
+        {
+        std::cout << "Wrote mesh cache "
+                  << gvMeshCache::cacheFileName(fileName) << std::endl;
+        }
+      }
+    }
+  else
+    {
+    vtkNew<vtkCubeSource> cube;
+    cube->Update();
+    output->ShallowCopy(cube->GetOutput());
+    }
+
+  gvMeshUtilities::prepareForSharing(output);
+
+  return output;
+}
+
+std::shared_ptr<gvBVH> gvApplicationState::buildIndex(
+    vtkPolyData *geometry, unsigned int numberOfThreads) const
+{
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point start = Clock::now();
+
+  std::shared_ptr<gvBVH> index(new gvBVH);
+  if (!index->build(geometry, numberOfThreads))
+    {
+    return nullptr;
+    }
+
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  std::cout << "Built BVH over " << index->numberOfTriangles()
+            << " triangles (" << index->nodes().size() << " nodes) in "
+            << elapsed.count() << " s" << std::endl;
+  return index;
+}
+
+void gvApplicationState::setScene(const std::shared_ptr<gvScene> &scene)
+{
+  m_scene = scene;
+  ++m_geometryVersion;
+}
+
+void gvApplicationState::joinLoader()
 {
+  if (m_loader.joinable())
+    {
+    m_loader.join();
+    }
 }
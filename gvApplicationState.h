@@ -1,12 +1,184 @@
 #ifndef GVAPPLICATIONSTATE_H
 #define GVAPPLICATIONSTATE_H
 
+#include "gvFrameState.h"
+#include "gvRenderSettings.h"
+#include "gvScene.h"
+
 #include <vvApplicationState.h>
 
+#include <vtkSmartPointer.h>
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class gvBVH;
+class gvBrickStore;
+class gvBrickStreamer;
+class gvLODChain;
+class vtkPolyData;
+
 class gvApplicationState : public vvApplicationState
 {
 public:
   gvApplicationState();
+  ~gvApplicationState();
+
+  // Read the geometry synchronously. A null fileName loads the default cube.
+  // The result replaces any previously loaded scene.
+  void loadGeometry(const char *fileName);
+
+  // Start reading the models of a scene on a background thread, several
+  // at once. The current scene is kept as a placeholder until
+  // updateGeometry() publishes the result. finished is invoked from the
+  // loader thread once the data is ready.
+  void loadSceneAsync(const std::vector<gvScene::Entry> &entries,
+                      const std::function<void()> &finished);
+
+  // Publish the result of a finished background load. Call from the main
+  // thread only; returns true if the scene changed.
+  bool updateGeometry();
+
+  // Choose how mesh files are read: gvGeometryReader's fast paths on
+  // numberOfThreads workers (0 uses all cores), or each format's VTK reader
+  // if parallel is false.
+  void setReaderOptions(bool parallel, unsigned int numberOfThreads);
+
+  // Files larger than budgetBytes (or any file, if force is set) are split
+  // into on-disk bricks and streamed instead of being read whole. The budget
+  // also caps the memory held by resident bricks. Only scenes of a single
+  // untransformed model are streamed.
+  void setStreamingOptions(bool force, std::size_t budgetBytes);
+
+  // Run meshes read from files or generated through gvMeshOptimizer before
+  // they are cached and drawn, welding points within weldTolerance of the
+  // mesh's diagonal.
+  void setMeshOptimization(bool enabled, double weldTolerance);
+
+  // Meshes without point normals get them from gvMeshNormals, split along
+  // edges sharper than featureAngle degrees (180 for none), before they are
+  // optimized and cached.
+  void setNormalFeatureAngle(double featureAngle);
+
+  // Keep chunked models as gvCompactMesh, drawn from 16-bit positions,
+  // octahedral normals and 16-bit indices, instead of float chunk copies.
+  // Needs VTK's OpenGL2 backend.
+  void setCompactStorage(bool enabled);
+
+  // The brick streamer of a streamed model, or null. While streaming, the
+  // scene only holds the model's outline.
+  gvBrickStreamer* streamer() const { return m_streamer.get(); }
+
+  // Advance the brick working set. Call from the main thread once per frame;
+  // returns true if resident bricks changed.
+  bool updateStreaming();
+
+  // Coarser levels of a scene's only model, built in the background after
+  // each load, or null while streaming or for scenes of several models.
+  gvLODChain* levels() const { return m_levels.get(); }
+
+  // Publish finished levels. Call from the main thread once per frame;
+  // returns true if new levels are available.
+  bool updateLevels();
+
+  bool isLoading() const { return m_loading; }
+
+  // Wall-clock seconds spent in the last background load.
+  double loadSeconds() const { return m_loadSeconds; }
+
+  // The loaded scene is shared by every GL context and must be treated as
+  // read-only; contexts only map its models and upload them to their GPU.
+  const gvScene* scene() const { return m_scene.get(); }
+
+  // Combined bounds of the scene's models.
+  const double* bounds() const { return m_scene->bounds(); }
+
+  // Spatial index over the triangles of a scene's only model, built by the
+  // loader before the scene is published. Null while streaming and for
+  // scenes of several models or instances, whose indices are per model.
+  const gvBVH* spatialIndex() const;
+
+  // Target number of triangles per chunk for the next load.
+  void setChunkSize(std::size_t numberOfTriangles);
+
+  // Incremented every time a new scene is published. Contexts compare this
+  // against the version they mapped to pick up replaced geometry.
+  unsigned long geometryVersion() const { return m_geometryVersion; }
+
+  // Display settings for every context. Setting different values bumps
+  // renderSettingsVersion(); contexts compare it against the version they
+  // last applied. Call from the main thread only.
+  void setRenderSettings(const gvRenderSettings &settings);
+  const gvRenderSettings& renderSettings() const { return m_renderSettings; }
+  unsigned long renderSettingsVersion() const
+  {
+    return m_renderSettingsVersion;
+  }
+
+  // Publish state as the snapshot frameState() returns, adding the current
+  // scene, its version, levels and streamer, and clamping state.level to
+  // the levels built so far. Call from the main thread only.
+  void publishFrameState(gvFrameState state);
+
+  // The latest published snapshot, readable from any thread without locks.
+  // Hold on to it for the whole frame: it keeps the geometry it names alive
+  // even after frame() has replaced it.
+  std::shared_ptr<const gvFrameState> frameState() const
+  {
+    return std::atomic_load(&m_frameState);
+  }
+
+  // Count a window drawing a frame; safe from any rendering thread.
+  // takeWindowFrames() returns the count since it was last called.
+  void countWindowFrame() { ++m_windowFrames; }
+  unsigned long takeWindowFrames() { return m_windowFrames.exchange(0); }
+
+private:
+  vtkSmartPointer<vtkPolyData> readGeometry(
+      const char *fileName, unsigned int numberOfThreads) const;
+  std::shared_ptr<gvBVH> buildIndex(vtkPolyData *geometry,
+                                    unsigned int numberOfThreads) const;
+  bool shouldStream(const std::vector<gvScene::Entry> &entries) const;
+  void setScene(const std::shared_ptr<gvScene> &scene);
+  void joinLoader();
+
+  std::shared_ptr<gvScene> m_scene;
+  std::size_t m_chunkSize;
+  unsigned long m_geometryVersion;
+
+  gvRenderSettings m_renderSettings;
+  unsigned long m_renderSettingsVersion;
+
+  std::shared_ptr<const gvFrameState> m_frameState; // Atomic access only
+  std::atomic<unsigned long> m_windowFrames;
+
+  bool m_parallelReader;
+  unsigned int m_readerThreads;
+
+  bool m_forceStreaming;
+  std::size_t m_streamingBudget;
+
+  bool m_optimizeMesh;
+  double m_weldTolerance;
+  double m_featureAngle;
+  bool m_compactStorage;
+  // Shared with the published frame states:
+  std::shared_ptr<gvBrickStreamer> m_streamer;
+  std::shared_ptr<gvLODChain> m_levels;
+
+  std::thread m_loader;
+  std::mutex m_loaderMutex;
+  std::shared_ptr<gvScene> m_pending; // Guarded by m_loaderMutex
+  std::shared_ptr<gvBrickStore> m_pendingBricks; // Guarded by m_loaderMutex
+  std::function<void()> m_finished;
+  std::atomic<bool> m_loading;
+  double m_loadSeconds;
 };
 
 #endif // GVAPPLICATIONSTATE_H
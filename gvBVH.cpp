@@ -0,0 +1,870 @@
+#include "gvBVH.h"
+
+#include "gvFrustum.h"
+#include "gvMeshUtilities.h"
+#include "gvParallel.h"
+
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const int NumberOfBins = 16;
+const std::size_t MaximumLeafSize = 16;
+const double TraversalCost = 1.;
+
+// Below this many triangles a subtree is built by one thread:
+const std::size_t MinimumParallelSubtree = 4096;
+
+inline double halfArea(const float lower[3], const float upper[3])
+{
+  double dx = std::max(0.f, upper[0] - lower[0]);
+  double dy = std::max(0.f, upper[1] - lower[1]);
+  double dz = std::max(0.f, upper[2] - lower[2]);
+  return dx * dy + dy * dz + dz * dx;
+}
+
+inline void resetBox(float lower[3], float upper[3])
+{
+  for (int i = 0; i < 3; ++i)
+    {
+    lower[i] = std::numeric_limits<float>::max();
+    upper[i] = -std::numeric_limits<float>::max();
+    }
+}
+
+inline void growBox(float lower[3], float upper[3], const float *otherLower,
+                    const float *otherUpper)
+{
+  for (int i = 0; i < 3; ++i)
+    {
+    lower[i] = std::min(lower[i], otherLower[i]);
+    upper[i] = std::max(upper[i], otherUpper[i]);
+    }
+}
+
+// Entry distance of a ray into a node's box, or false if it misses within
+// maxDistance.
+inline bool rayBox(const gvBVH::Node &node, const double origin[3],
+                   const double inverse[3], double maxDistance, double &entry)
+{
+  double near = 0.;
+  double far = maxDistance;
+  for (int i = 0; i < 3; ++i)
+    {
+    double t0 = (node.lower[i] - origin[i]) * inverse[i];
+    double t1 = (node.upper[i] - origin[i]) * inverse[i];
+    if (t0 > t1)
+      {
+      std::swap(t0, t1);
+      }
+    near = std::max(near, t0);
+    far = std::min(far, t1);
+    if (near > far)
+      {
+      return false;
+      }
+    }
+  entry = near;
+  return true;
+}
+
+inline double boxDistanceSquared(const gvBVH::Node &node,
+                                 const double point[3])
+{
+  double squared = 0.;
+  for (int i = 0; i < 3; ++i)
+    {
+    double d = std::max(node.lower[i] - point[i],
+                        std::max(0., point[i] - node.upper[i]));
+    squared += d * d;
+    }
+  return squared;
+}
+
+// Range of n.x + d over a node's box.
+inline void planeRange(const gvBVH::Node &node, const double plane[4],
+                       double &minimum, double &maximum)
+{
+  minimum = maximum = plane[3];
+  for (int i = 0; i < 3; ++i)
+    {
+    double a = plane[i] * node.lower[i];
+    double b = plane[i] * node.upper[i];
+    minimum += std::min(a, b);
+    maximum += std::max(a, b);
+    }
+}
+
+inline double dot(const double a[3], const double b[3])
+{
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Closest point to p on triangle abc (Ericson, Real-Time Collision
+// Detection, 5.1.5).
+void closestOnTriangle(const double p[3], const double a[3],
+                       const double b[3], const double c[3], double out[3])
+{
+  double ab[3], ac[3], ap[3];
+  for (int i = 0; i < 3; ++i)
+    {
+    ab[i] = b[i] - a[i];
+    ac[i] = c[i] - a[i];
+    ap[i] = p[i] - a[i];
+    }
+  double d1 = dot(ab, ap);
+  double d2 = dot(ac, ap);
+  if (d1 <= 0. && d2 <= 0.)
+    {
+    std::copy(a, a + 3, out);
+    return;
+    }
+
+  double bp[3];
+  for (int i = 0; i < 3; ++i)
+    {
+    bp[i] = p[i] - b[i];
+    }
+  double d3 = dot(ab, bp);
+  double d4 = dot(ac, bp);
+  if (d3 >= 0. && d4 <= d3)
+    {
+    std::copy(b, b + 3, out);
+    return;
+    }
+
+  double vc = d1 * d4 - d3 * d2;
+  if (vc <= 0. && d1 >= 0. && d3 <= 0.)
+    {
+    double v = d1 / (d1 - d3);
+    for (int i = 0; i < 3; ++i)
+      {
+      out[i] = a[i] + v * ab[i];
+      }
+    return;
+    }
+
+  double cp[3];
+  for (int i = 0; i < 3; ++i)
+    {
+    cp[i] = p[i] - c[i];
+    }
+  double d5 = dot(ab, cp);
+  double d6 = dot(ac, cp);
+  if (d6 >= 0. && d5 <= d6)
+    {
+    std::copy(c, c + 3, out);
+    return;
+    }
+
+  double vb = d5 * d2 - d1 * d6;
+  if (vb <= 0. && d2 >= 0. && d6 <= 0.)
+    {
+    double w = d2 / (d2 - d6);
+    for (int i = 0; i < 3; ++i)
+      {
+      out[i] = a[i] + w * ac[i];
+      }
+    return;
+    }
+
+  double va = d3 * d6 - d5 * d4;
+  if (va <= 0. && (d4 - d3) >= 0. && (d5 - d6) >= 0.)
+    {
+    double w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+    for (int i = 0; i < 3; ++i)
+      {
+      out[i] = b[i] + w * (c[i] - b[i]);
+      }
+    return;
+    }
+
+  double denominator = 1. / (va + vb + vc);
+  double v = vb * denominator;
+  double w = vc * denominator;
+  for (int i = 0; i < 3; ++i)
+    {
+    out[i] = a[i] + v * ab[i] + w * ac[i];
+    }
+}
+
+} // end anon namespace
+
+struct gvBVH::BuildData
+{
+  std::vector<float> lower;     // 3 per triangle
+  std::vector<float> upper;     // 3 per triangle
+  std::vector<float> centroids; // 3 per triangle
+  std::vector<std::uint32_t> order;
+};
+
+gvBVH::gvBVH()
+{
+}
+
+bool gvBVH::build(vtkPolyData *data, unsigned int numberOfThreads)
+{
+  m_nodes.clear();
+  m_points.clear();
+  m_triangles.clear();
+  m_source.clear();
+
+  std::vector<vtkIdType> ids;
+  gvMeshUtilities::extractTriangles(data, ids);
+  std::size_t count = ids.size() / 3;
+  vtkIdType numberOfPoints = data->GetNumberOfPoints();
+  if (count == 0 || count >= InnerFlag ||
+      static_cast<std::uint64_t>(numberOfPoints) >= InnerFlag)
+    {
+    return false;
+    }
+
+  // Positions are copied to floats so queries don't go through VTK:
+  vtkPoints *points = data->GetPoints();
+  m_points.resize(3 * static_cast<std::size_t>(numberOfPoints));
+  gvParallel::forRange(static_cast<std::size_t>(numberOfPoints),
+    [&](std::size_t begin, std::size_t end)
+    {
+    double x[3];
+    for (std::size_t i = begin; i < end; ++i)
+      {
+      points->GetPoint(static_cast<vtkIdType>(i), x);
+      for (int k = 0; k < 3; ++k)
+        {
+        m_points[3 * i + k] = static_cast<float>(x[k]);
+        }
+      }
+    }, numberOfThreads);
+
+  BuildData build;
+  build.lower.resize(3 * count);
+  build.upper.resize(3 * count);
+  build.centroids.resize(3 * count);
+  build.order.resize(count);
+  gvParallel::forRange(count, [&](std::size_t begin, std::size_t end)
+    {
+    for (std::size_t t = begin; t < end; ++t)
+      {
+      float *lower = &build.lower[3 * t];
+      float *upper = &build.upper[3 * t];
+      resetBox(lower, upper);
+      for (int v = 0; v < 3; ++v)
+        {
+        const float *p = &m_points[3 * ids[3 * t + v]];
+        growBox(lower, upper, p, p);
+        }
+      for (int k = 0; k < 3; ++k)
+        {
+        build.centroids[3 * t + k] = .5f * (lower[k] + upper[k]);
+        }
+      build.order[t] = static_cast<std::uint32_t>(t);
+      }
+    }, numberOfThreads);
+
+  // Split the upper levels breadth first, each level's nodes in parallel,
+  // until there are enough subtrees to keep every thread busy:
+  std::size_t grain = std::max(MinimumParallelSubtree,
+    count / (8 * gvParallel::resolveThreads(numberOfThreads)));
+  struct Range
+  {
+    std::uint32_t node;
+    std::size_t begin;
+    std::size_t end;
+  };
+  std::vector<Range> frontier(1);
+  frontier[0].node = 0;
+  frontier[0].begin = 0;
+  frontier[0].end = count;
+  std::vector<Range> subtrees;
+  m_nodes.resize(1);
+  while (!frontier.empty())
+    {
+    std::vector<Range> large;
+    for (std::size_t i = 0; i < frontier.size(); ++i)
+      {
+      (frontier[i].end - frontier[i].begin > grain ? large : subtrees).
+        push_back(frontier[i]);
+      }
+
+    std::vector<Node> split(large.size());
+    std::vector<std::size_t> middle(large.size());
+    std::vector<char> isInner(large.size());
+    gvParallel::forEach(large.size(), [&](std::size_t i)
+      {
+      isInner[i] = this->splitNode(build, split[i], large[i].begin,
+                                   large[i].end, middle[i]);
+      }, numberOfThreads);
+
+    frontier.clear();
+    for (std::size_t i = 0; i < large.size(); ++i)
+      {
+      Node &node = split[i];
+      if (!isInner[i])
+        {
+        node.offset = static_cast<std::uint32_t>(large[i].begin);
+        m_nodes[large[i].node] = node;
+        continue;
+        }
+      std::uint32_t left = static_cast<std::uint32_t>(m_nodes.size());
+      m_nodes.resize(m_nodes.size() + 2);
+      node.offset = left;
+      node.count |= InnerFlag;
+      m_nodes[large[i].node] = node;
+      Range range = { left, large[i].begin, middle[i] };
+      frontier.push_back(range);
+      range.node = left + 1;
+      range.begin = middle[i];
+      range.end = large[i].end;
+      frontier.push_back(range);
+      }
+    }
+
+  // Build the subtrees independently, then append them to the node array:
+  std::vector<std::vector<Node> > subtreeNodes(subtrees.size());
+  gvParallel::forEach(subtrees.size(), [&](std::size_t i)
+    {
+    subtreeNodes[i].resize(1);
+    this->buildSubtree(build, subtreeNodes[i], 0, subtrees[i].begin,
+                       subtrees[i].end);
+    }, numberOfThreads);
+  for (std::size_t i = 0; i < subtrees.size(); ++i)
+    {
+    // Local node j > 0 goes to base + j - 1; the root replaces the
+    // placeholder its parent points to.
+    std::vector<Node> &local = subtreeNodes[i];
+    std::uint32_t base = static_cast<std::uint32_t>(m_nodes.size());
+    for (std::size_t j = 0; j < local.size(); ++j)
+      {
+      if (!local[j].isLeaf())
+        {
+        local[j].offset = base + local[j].offset - 1;
+        }
+      }
+    m_nodes[subtrees[i].node] = local[0];
+    m_nodes.insert(m_nodes.end(), local.begin() + 1, local.end());
+    std::vector<Node>().swap(local);
+    }
+
+  // Store the triangles in leaf order:
+  m_triangles.resize(3 * count);
+  m_source.resize(count);
+  gvParallel::forRange(count, [&](std::size_t begin, std::size_t end)
+    {
+    for (std::size_t i = begin; i < end; ++i)
+      {
+      std::uint32_t t = build.order[i];
+      for (int v = 0; v < 3; ++v)
+        {
+        m_triangles[3 * i + v] = static_cast<std::uint32_t>(ids[3 * t + v]);
+        }
+      m_source[i] = t;
+      }
+    }, numberOfThreads);
+
+  return true;
+}
+
+void gvBVH::buildSubtree(BuildData &data, std::vector<Node> &nodes,
+                         std::uint32_t root, std::size_t begin,
+                         std::size_t end) const
+{
+  struct Range
+  {
+    std::uint32_t node;
+    std::size_t begin;
+    std::size_t end;
+  };
+  std::vector<Range> stack(1);
+  stack[0].node = root;
+  stack[0].begin = begin;
+  stack[0].end = end;
+  while (!stack.empty())
+    {
+    Range range = stack.back();
+    stack.pop_back();
+
+    Node node;
+    std::size_t middle;
+    if (!this->splitNode(data, node, range.begin, range.end, middle))
+      {
+      node.offset = static_cast<std::uint32_t>(range.begin);
+      nodes[range.node] = node;
+      continue;
+      }
+
+    std::uint32_t left = static_cast<std::uint32_t>(nodes.size());
+    nodes.resize(nodes.size() + 2);
+    node.offset = left;
+    node.count |= InnerFlag;
+    nodes[range.node] = node;
+
+    Range child = { left + 1, middle, range.end };
+    stack.push_back(child);
+    child.node = left;
+    child.begin = range.begin;
+    child.end = middle;
+    stack.push_back(child);
+    }
+}
+
+bool gvBVH::splitNode(BuildData &data, Node &node, std::size_t begin,
+                      std::size_t end, std::size_t &middle) const
+{
+  std::uint32_t *order = data.order.data();
+  const float *lower = data.lower.data();
+  const float *upper = data.upper.data();
+  const float *centroids = data.centroids.data();
+
+  float centroidLower[3], centroidUpper[3];
+  resetBox(node.lower, node.upper);
+  resetBox(centroidLower, centroidUpper);
+  for (std::size_t i = begin; i < end; ++i)
+    {
+    std::uint32_t t = order[i];
+    growBox(node.lower, node.upper, lower + 3 * t, upper + 3 * t);
+    growBox(centroidLower, centroidUpper, centroids + 3 * t,
+            centroids + 3 * t);
+    }
+  std::size_t count = end - begin;
+  node.count = static_cast<std::uint32_t>(count);
+  if (count <= 2)
+    {
+    return false;
+    }
+
+  // Binned SAH: cost of each split between bins along each axis.
+  double parentArea = halfArea(node.lower, node.upper);
+  if (parentArea <= 0.)
+    {
+    parentArea = 1.;
+    }
+  int bestAxis = -1;
+  int bestSplit = 0;
+  double bestCost = static_cast<double>(count);
+  double scale[3];
+  for (int axis = 0; axis < 3; ++axis)
+    {
+    float extent = centroidUpper[axis] - centroidLower[axis];
+    scale[axis] = extent > 0.f ? NumberOfBins / extent : 0.;
+    if (extent <= 0.f)
+      {
+      continue;
+      }
+
+    std::size_t binCount[NumberOfBins] = { 0 };
+    float binLower[NumberOfBins][3], binUpper[NumberOfBins][3];
+    for (int b = 0; b < NumberOfBins; ++b)
+      {
+      resetBox(binLower[b], binUpper[b]);
+      }
+    for (std::size_t i = begin; i < end; ++i)
+      {
+      std::uint32_t t = order[i];
+      int b = std::min(NumberOfBins - 1, static_cast<int>(
+        (centroids[3 * t + axis] - centroidLower[axis]) * scale[axis]));
+      ++binCount[b];
+      growBox(binLower[b], binUpper[b], lower + 3 * t, upper + 3 * t);
+      }
+
+    // Sweep from the right, then evaluate splits sweeping from the left:
+    double rightArea[NumberOfBins];
+    std::size_t rightCount[NumberOfBins];
+    float boxLower[3], boxUpper[3];
+    resetBox(boxLower, boxUpper);
+    std::size_t sum = 0;
+    for (int b = NumberOfBins - 1; b > 0; --b)
+      {
+      growBox(boxLower, boxUpper, binLower[b], binUpper[b]);
+      sum += binCount[b];
+      rightArea[b] = halfArea(boxLower, boxUpper);
+      rightCount[b] = sum;
+      }
+    resetBox(boxLower, boxUpper);
+    sum = 0;
+    for (int b = 1; b < NumberOfBins; ++b)
+      {
+      growBox(boxLower, boxUpper, binLower[b - 1], binUpper[b - 1]);
+      sum += binCount[b - 1];
+      if (sum == 0 || rightCount[b] == 0)
+        {
+        continue;
+        }
+      double cost = TraversalCost + (halfArea(boxLower, boxUpper) * sum +
+        rightArea[b] * rightCount[b]) / parentArea;
+      if (cost < bestCost)
+        {
+        bestCost = cost;
+        bestAxis = axis;
+        bestSplit = b;
+        }
+      }
+    }
+
+  if (bestAxis < 0)
+    {
+    if (count <= MaximumLeafSize)
+      {
+      return false;
+      }
+    // Coincident centroids or no split pays off: halve the list so leaves
+    // stay small.
+    middle = begin + count / 2;
+    return true;
+    }
+
+  std::uint32_t *split = std::partition(order + begin, order + end,
+    [&](std::uint32_t t)
+    {
+    return std::min(NumberOfBins - 1, static_cast<int>(
+      (centroids[3 * t + bestAxis] - centroidLower[bestAxis]) *
+      scale[bestAxis])) < bestSplit;
+    });
+  middle = static_cast<std::size_t>(split - order);
+  if (middle == begin || middle == end)
+    {
+    middle = begin + count / 2;
+    }
+  return true;
+}
+
+bool gvBVH::intersectRay(const double origin[3], const double direction[3],
+                         double maxDistance, Hit &hit) const
+{
+  if (m_nodes.empty())
+    {
+    return false;
+    }
+
+  double inverse[3];
+  for (int i = 0; i < 3; ++i)
+    {
+    inverse[i] = direction[i] != 0. ? 1. / direction[i]
+                                    : std::numeric_limits<double>::max();
+    }
+
+  bool found = false;
+  double best = maxDistance;
+  std::vector<std::uint32_t> stack;
+  stack.reserve(64);
+  stack.push_back(0);
+  double entry;
+  while (!stack.empty())
+    {
+    const Node &node = m_nodes[stack.back()];
+    stack.pop_back();
+    if (!rayBox(node, origin, inverse, best, entry))
+      {
+      continue;
+      }
+
+    if (!node.isLeaf())
+      {
+      // Visit the nearer child first so the farther one is pruned more:
+      double leftEntry, rightEntry;
+      bool left = rayBox(m_nodes[node.offset], origin, inverse, best,
+                         leftEntry);
+      bool right = rayBox(m_nodes[node.offset + 1], origin, inverse, best,
+                          rightEntry);
+      if (left && right)
+        {
+        bool leftFirst = leftEntry <= rightEntry;
+        stack.push_back(node.offset + (leftFirst ? 1 : 0));
+        stack.push_back(node.offset + (leftFirst ? 0 : 1));
+        }
+      else if (left || right)
+        {
+        stack.push_back(node.offset + (left ? 0 : 1));
+        }
+      continue;
+      }
+
+    // Moeller-Trumbore against each triangle of the leaf:
+    std::uint32_t last = node.offset + node.numberOfTriangles();
+    for (std::uint32_t t = node.offset; t < last; ++t)
+      {
+      const std::uint32_t *ids = &m_triangles[3 * t];
+      const float *a = &m_points[3 * ids[0]];
+      const float *b = &m_points[3 * ids[1]];
+      const float *c = &m_points[3 * ids[2]];
+      double e1[3], e2[3], s[3];
+      for (int i = 0; i < 3; ++i)
+        {
+        e1[i] = b[i] - a[i];
+        e2[i] = c[i] - a[i];
+        s[i] = origin[i] - a[i];
+        }
+      double p[3] = { direction[1] * e2[2] - direction[2] * e2[1],
+                      direction[2] * e2[0] - direction[0] * e2[2],
+                      direction[0] * e2[1] - direction[1] * e2[0] };
+      double determinant = dot(e1, p);
+      if (std::fabs(determinant) < 1e-300)
+        {
+        continue;
+        }
+      double inverseDeterminant = 1. / determinant;
+      double u = dot(s, p) * inverseDeterminant;
+      if (u < 0. || u > 1.)
+        {
+        continue;
+        }
+      double q[3] = { s[1] * e1[2] - s[2] * e1[1],
+                      s[2] * e1[0] - s[0] * e1[2],
+                      s[0] * e1[1] - s[1] * e1[0] };
+      double v = dot(direction, q) * inverseDeterminant;
+      if (v < 0. || u + v > 1.)
+        {
+        continue;
+        }
+      double distance = dot(e2, q) * inverseDeterminant;
+      if (distance >= 0. && distance < best)
+        {
+        best = distance;
+        found = true;
+        hit.distance = distance;
+        hit.triangle = t;
+        for (int i = 0; i < 3; ++i)
+          {
+          hit.point[i] = origin[i] + distance * direction[i];
+          }
+        }
+      }
+    }
+  return found;
+}
+
+bool gvBVH::closestPoint(const double point[3], double maxDistance,
+                         Hit &hit) const
+{
+  if (m_nodes.empty())
+    {
+    return false;
+    }
+
+  bool found = false;
+  double best = maxDistance * maxDistance;
+  std::vector<std::uint32_t> stack;
+  stack.reserve(64);
+  stack.push_back(0);
+  while (!stack.empty())
+    {
+    const Node &node = m_nodes[stack.back()];
+    stack.pop_back();
+    if (boxDistanceSquared(node, point) >= best)
+      {
+      continue;
+      }
+
+    if (!node.isLeaf())
+      {
+      double left = boxDistanceSquared(m_nodes[node.offset], point);
+      double right = boxDistanceSquared(m_nodes[node.offset + 1], point);
+      bool leftFirst = left <= right;
+      stack.push_back(node.offset + (leftFirst ? 1 : 0));
+      stack.push_back(node.offset + (leftFirst ? 0 : 1));
+      continue;
+      }
+
+    std::uint32_t last = node.offset + node.numberOfTriangles();
+    for (std::uint32_t t = node.offset; t < last; ++t)
+      {
+      const std::uint32_t *ids = &m_triangles[3 * t];
+      double corners[3][3];
+      for (int v = 0; v < 3; ++v)
+        {
+        for (int i = 0; i < 3; ++i)
+          {
+          corners[v][i] = m_points[3 * ids[v] + i];
+          }
+        }
+      double closest[3];
+      closestOnTriangle(point, corners[0], corners[1], corners[2], closest);
+      double squared = 0.;
+      for (int i = 0; i < 3; ++i)
+        {
+        squared += (closest[i] - point[i]) * (closest[i] - point[i]);
+        }
+      if (squared < best)
+        {
+        best = squared;
+        found = true;
+        hit.triangle = t;
+        std::copy(closest, closest + 3, hit.point);
+        }
+      }
+    }
+  if (found)
+    {
+    hit.distance = std::sqrt(best);
+    }
+  return found;
+}
+
+gvBVH::PlaneCounts gvBVH::classifyPlane(const double plane[4]) const
+{
+  PlaneCounts counts = { 0, 0, 0 };
+  if (m_nodes.empty())
+    {
+    return counts;
+    }
+
+  std::vector<std::uint32_t> stack(1, 0);
+  while (!stack.empty())
+    {
+    const Node &node = m_nodes[stack.back()];
+    stack.pop_back();
+
+    double minimum, maximum;
+    planeRange(node, plane, minimum, maximum);
+    if (minimum > 0.)
+      {
+      counts.above += node.numberOfTriangles();
+      }
+    else if (maximum < 0.)
+      {
+      counts.below += node.numberOfTriangles();
+      }
+    else if (!node.isLeaf())
+      {
+      stack.push_back(node.offset);
+      stack.push_back(node.offset + 1);
+      }
+    else
+      {
+      std::uint32_t last = node.offset + node.numberOfTriangles();
+      for (std::uint32_t t = node.offset; t < last; ++t)
+        {
+        int sides = 0;
+        for (int v = 0; v < 3; ++v)
+          {
+          const float *p = &m_points[3 * m_triangles[3 * t + v]];
+          double d = plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2] +
+            plane[3];
+          sides |= d > 0. ? 2 : (d < 0. ? 1 : 3);
+          }
+        if (sides == 2)
+          {
+          ++counts.above;
+          }
+        else if (sides == 1)
+          {
+          ++counts.below;
+          }
+        else
+          {
+          ++counts.straddling;
+          }
+        }
+      }
+    }
+  return counts;
+}
+
+void gvBVH::trianglesOnPlane(const double plane[4],
+                             std::vector<std::size_t> &triangles) const
+{
+  if (m_nodes.empty())
+    {
+    return;
+    }
+
+  std::vector<std::uint32_t> stack(1, 0);
+  while (!stack.empty())
+    {
+    const Node &node = m_nodes[stack.back()];
+    stack.pop_back();
+
+    double minimum, maximum;
+    planeRange(node, plane, minimum, maximum);
+    if (minimum > 0. || maximum < 0.)
+      {
+      continue;
+      }
+    if (!node.isLeaf())
+      {
+      stack.push_back(node.offset);
+      stack.push_back(node.offset + 1);
+      continue;
+      }
+
+    std::uint32_t last = node.offset + node.numberOfTriangles();
+    for (std::uint32_t t = node.offset; t < last; ++t)
+      {
+      double low = std::numeric_limits<double>::max();
+      double high = -low;
+      for (int v = 0; v < 3; ++v)
+        {
+        const float *p = &m_points[3 * m_triangles[3 * t + v]];
+        double d = plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2] +
+          plane[3];
+        low = std::min(low, d);
+        high = std::max(high, d);
+        }
+      if (low <= 0. && high >= 0.)
+        {
+        triangles.push_back(t);
+        }
+      }
+    }
+}
+
+void gvBVH::overlapFrustum(const gvFrustum &frustum,
+    std::vector<std::pair<std::size_t, std::size_t> > &ranges) const
+{
+  if (m_nodes.empty())
+    {
+    return;
+    }
+
+  std::vector<std::uint32_t> stack(1, 0);
+  while (!stack.empty())
+    {
+    const Node &node = m_nodes[stack.back()];
+    stack.pop_back();
+
+    // Classify the box: outside any plane culls it, inside all of them
+    // takes the whole subtree without descending.
+    bool inside = true;
+    bool outside = false;
+    for (int i = 0; i < 6 && !outside; ++i)
+      {
+      double minimum, maximum;
+      planeRange(node, frustum.plane(i), minimum, maximum);
+      outside = maximum < 0.;
+      inside = inside && minimum >= 0.;
+      }
+    if (outside)
+      {
+      continue;
+      }
+    if (!inside && !node.isLeaf())
+      {
+      // Right first so ranges come out in triangle order:
+      stack.push_back(node.offset + 1);
+      stack.push_back(node.offset);
+      continue;
+      }
+
+    // A subtree's triangles start at its leftmost leaf:
+    const Node *leftmost = &node;
+    while (!leftmost->isLeaf())
+      {
+      leftmost = &m_nodes[leftmost->offset];
+      }
+    std::size_t first = leftmost->offset;
+    std::size_t count = node.numberOfTriangles();
+    if (!ranges.empty() &&
+        ranges.back().first + ranges.back().second == first)
+      {
+      ranges.back().second += count;
+      }
+    else
+      {
+      ranges.push_back(std::make_pair(first, count));
+      }
+    }
+}
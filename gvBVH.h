@@ -0,0 +1,110 @@
+#ifndef GVBVH_H
+#define GVBVH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+class gvFrustum;
+class vtkPolyData;
+
+// Bounding volume hierarchy over the triangles of a mesh, the shared spatial
+// index for picking, culling and clipping queries. Nodes live in one flat
+// array (32 bytes each, children stored as adjacent pairs) and the triangles
+// are reordered so every node covers a contiguous range of them. Splits are
+// chosen with a binned surface area heuristic; the build runs the upper
+// levels sequentially and the subtrees below them in parallel.
+//
+// Queries are const and may run on any thread once build() returns.
+class gvBVH
+{
+public:
+  struct Node
+  {
+    float lower[3];
+    float upper[3];
+    // Leaves: first triangle; inner nodes: index of the left child (the
+    // right child follows it).
+    std::uint32_t offset;
+    // Triangles below this node, with InnerFlag set on inner nodes.
+    std::uint32_t count;
+
+    bool isLeaf() const { return (count & InnerFlag) == 0; }
+    std::uint32_t numberOfTriangles() const { return count & ~InnerFlag; }
+  };
+
+  static const std::uint32_t InnerFlag = 0x80000000u;
+
+  struct Hit
+  {
+    double distance;  // Along the ray, or from the query point
+    double point[3];
+    std::size_t triangle; // Index for triangle()
+  };
+
+  // Where triangles lie relative to a plane n.x + d = 0.
+  struct PlaneCounts
+  {
+    std::size_t below;
+    std::size_t above;
+    std::size_t straddling;
+  };
+
+  gvBVH();
+
+  // Index the polygons of data (fanned into triangles). Returns false if
+  // there is nothing to index or the mesh is too large for 32-bit ids.
+  bool build(vtkPolyData *data, unsigned int numberOfThreads = 0);
+
+  std::size_t numberOfTriangles() const { return m_triangles.size() / 3; }
+  const std::vector<Node>& nodes() const { return m_nodes; }
+
+  // Point ids of a triangle in index order.
+  const std::uint32_t* triangle(std::size_t i) const
+  {
+    return &m_triangles[3 * i];
+  }
+
+  // Position of the triangle in the polygons fanned by build(), i.e. in
+  // gvMeshUtilities::extractTriangles() order.
+  std::size_t sourceTriangle(std::size_t i) const { return m_source[i]; }
+
+  // Nearest triangle hit by the ray within maxDistance. direction need not
+  // be normalized; distances are then in units of its length.
+  bool intersectRay(const double origin[3], const double direction[3],
+                    double maxDistance, Hit &hit) const;
+
+  // Closest point on the mesh within maxDistance of point.
+  bool closestPoint(const double point[3], double maxDistance,
+                    Hit &hit) const;
+
+  // Count triangles on each side of a plane, skipping whole subtrees that
+  // are on one side.
+  PlaneCounts classifyPlane(const double plane[4]) const;
+
+  // Triangles crossing a plane.
+  void trianglesOnPlane(const double plane[4],
+                        std::vector<std::size_t> &triangles) const;
+
+  // Ranges (first, count) of triangles whose node bounds overlap the
+  // frustum. Ranges are as coarse as the tree allows.
+  void overlapFrustum(const gvFrustum &frustum,
+      std::vector<std::pair<std::size_t, std::size_t> > &ranges) const;
+
+private:
+  struct BuildData;
+
+  void buildSubtree(BuildData &data, std::vector<Node> &nodes,
+                    std::uint32_t node, std::size_t begin,
+                    std::size_t end) const;
+  bool splitNode(BuildData &data, Node &node, std::size_t begin,
+                 std::size_t end, std::size_t &middle) const;
+
+  std::vector<Node> m_nodes;
+  std::vector<float> m_points;
+  std::vector<std::uint32_t> m_triangles;
+  std::vector<std::uint32_t> m_source;
+};
+
+#endif // GVBVH_H
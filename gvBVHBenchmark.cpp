@@ -0,0 +1,211 @@
+// Build time and query latency of gvBVH on synthetic meshes.
+
+#include "gvBVH.h"
+#include "gvFrustum.h"
+#include "gvMeshUtilities.h"
+#include "gvParallel.h"
+
+#include <vtkFloatArray.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double seconds(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// A bumpy sphere with about numberOfTriangles triangles, so that both the
+// surface and the tree have some structure.
+vtkSmartPointer<vtkPolyData> makeMesh(std::size_t numberOfTriangles)
+{
+  std::size_t n = std::max<std::size_t>(2, static_cast<std::size_t>(
+    std::sqrt(numberOfTriangles / 2.)));
+  std::size_t rowLength = n + 1;
+
+  vtkNew<vtkFloatArray> positions;
+  positions->SetNumberOfComponents(3);
+  positions->SetNumberOfTuples(static_cast<vtkIdType>(rowLength * rowLength));
+  float *p = positions->GetPointer(0);
+  gvParallel::forRange(rowLength, [&](std::size_t begin, std::size_t end)
+    {
+    for (std::size_t j = begin; j < end; ++j)
+      {
+      double theta = M_PI * j / n;
+      for (std::size_t i = 0; i < rowLength; ++i)
+        {
+        double phi = 2. * M_PI * i / n;
+        double r = 1. + .05 * std::sin(40. * theta) * std::cos(30. * phi);
+        float *x = p + 3 * (j * rowLength + i);
+        x[0] = static_cast<float>(r * std::sin(theta) * std::cos(phi));
+        x[1] = static_cast<float>(r * std::sin(theta) * std::sin(phi));
+        x[2] = static_cast<float>(r * std::cos(theta));
+        }
+      }
+    });
+
+  std::vector<vtkIdType> ids(6 * n * n);
+  gvParallel::forRange(n, [&](std::size_t begin, std::size_t end)
+    {
+    for (std::size_t j = begin; j < end; ++j)
+      {
+      for (std::size_t i = 0; i < n; ++i)
+        {
+        vtkIdType a = static_cast<vtkIdType>(j * rowLength + i);
+        vtkIdType *t = &ids[6 * (j * n + i)];
+        t[0] = a;
+        t[1] = a + 1;
+        t[2] = a + rowLength + 1;
+        t[3] = a;
+        t[4] = a + rowLength + 1;
+        t[5] = a + rowLength;
+        }
+      }
+    });
+
+  vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+  vtkNew<vtkPoints> points;
+  points->SetData(positions.Get());
+  mesh->SetPoints(points.Get());
+  mesh->SetPolys(gvMeshUtilities::newTriangles(ids.data(), 2 * n * n));
+  return mesh;
+}
+
+void printUsage()
+{
+  std::cout << "\nUSAGE:\n\t./gvBVHBenchmark [-threads <int>] "
+               "[-queries <int>] [millions of triangles...]\n"
+            << "\nDefaults to meshes of 1, 10 and 100 million triangles.\n"
+            << std::endl;
+}
+
+} // end anon namespace
+
+int main(int argc, char *argv[])
+{
+  unsigned int threads = 0;
+  std::size_t queries = 100000;
+  std::vector<double> sizes;
+  for (int i = 1; i < argc; ++i)
+    {
+    if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+      {
+      threads = static_cast<unsigned int>(atoi(argv[++i]));
+      }
+    else if (strcmp(argv[i], "-queries") == 0 && i + 1 < argc)
+      {
+      queries = static_cast<std::size_t>(atol(argv[++i]));
+      }
+    else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "-help") == 0)
+      {
+      printUsage();
+      return 0;
+      }
+    else
+      {
+      sizes.push_back(atof(argv[i]));
+      }
+    }
+  if (sizes.empty())
+    {
+    sizes.push_back(1.);
+    sizes.push_back(10.);
+    sizes.push_back(100.);
+    }
+
+  std::cout << "triangles, nodes, build s, ray us, closest us, plane us, "
+               "frustum us" << std::endl;
+  for (std::size_t s = 0; s < sizes.size(); ++s)
+    {
+    vtkSmartPointer<vtkPolyData> mesh =
+      makeMesh(static_cast<std::size_t>(sizes[s] * 1e6));
+
+    gvBVH bvh;
+    Clock::time_point start = Clock::now();
+    if (!bvh.build(mesh, threads))
+      {
+      std::cerr << "ERROR: Could not build the BVH." << std::endl;
+      return 1;
+      }
+    double buildSeconds = seconds(start);
+
+    std::mt19937 random(1);
+    std::uniform_real_distribution<double> unit(-1., 1.);
+    std::size_t hits = 0;
+
+    // Rays from outside the model towards points near its center:
+    start = Clock::now();
+    for (std::size_t q = 0; q < queries; ++q)
+      {
+      double origin[3], direction[3];
+      for (int i = 0; i < 3; ++i)
+        {
+        origin[i] = 3. * unit(random);
+        direction[i] = .5 * unit(random) - origin[i];
+        }
+      gvBVH::Hit hit;
+      hits += bvh.intersectRay(origin, direction, 1e30, hit);
+      }
+    double raySeconds = seconds(start);
+
+    start = Clock::now();
+    for (std::size_t q = 0; q < queries; ++q)
+      {
+      double point[3] = { 1.5 * unit(random), 1.5 * unit(random),
+                          1.5 * unit(random) };
+      gvBVH::Hit hit;
+      hits += bvh.closestPoint(point, 1e30, hit);
+      }
+    double closestSeconds = seconds(start);
+
+    std::size_t planeQueries = std::max<std::size_t>(1, queries / 100);
+    start = Clock::now();
+    for (std::size_t q = 0; q < planeQueries; ++q)
+      {
+      double plane[4] = { unit(random), unit(random), unit(random),
+                          .5 * unit(random) };
+      hits += bvh.classifyPlane(plane).straddling;
+      }
+    double planeSeconds = seconds(start);
+
+    // Views from a ring around the model looking at its center:
+    std::vector<std::pair<std::size_t, std::size_t> > ranges;
+    start = Clock::now();
+    for (std::size_t q = 0; q < planeQueries; ++q)
+      {
+      double angle = 2. * M_PI * q / planeQueries;
+      double c = std::cos(angle), sn = std::sin(angle);
+      double projection[16] = { 1.5, 0, 0, 0, 0, 1.5, 0, 0,
+                                0, 0, -1.002, -1, 0, 0, -.02, 0 };
+      double modelview[16] = { c, 0, sn, 0, 0, 1, 0, 0, -sn, 0, c, 0,
+                               0, 0, -2., 1 };
+      gvFrustum frustum;
+      frustum.setFromMatrices(projection, modelview);
+      ranges.clear();
+      bvh.overlapFrustum(frustum, ranges);
+      hits += ranges.size();
+      }
+    double frustumSeconds = seconds(start);
+
+    std::cout << bvh.numberOfTriangles() << ", " << bvh.nodes().size()
+              << ", " << buildSeconds
+              << ", " << 1e6 * raySeconds / queries
+              << ", " << 1e6 * closestSeconds / queries
+              << ", " << 1e6 * planeSeconds / planeQueries
+              << ", " << 1e6 * frustumSeconds / planeQueries
+              << (hits == 0 ? " (no hits)" : "") << std::endl;
+    }
+  return 0;
+}
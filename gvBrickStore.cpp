@@ -0,0 +1,396 @@
+#include "gvBrickStore.h"
+
+#include "gvMappedFile.h"
+#include "gvMeshUtilities.h"
+#include "gvOBJParsing.h"
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+using namespace gvOBJParsing;
+
+const char IndexMagic[8] = { 'G', 'V', 'B', 'R', 'I', 'C', 'K', 'S' };
+const std::uint32_t IndexVersion = 1;
+
+// Aim for bricks of about this much source text, within a bounded count so
+// the per-brick write buffers stay small during the build.
+const std::uint64_t TargetBrickSourceBytes = 32ULL << 20;
+const std::uint64_t MaximumBricks = 512;
+const std::size_t BufferFloats = 1 << 15;
+
+struct IndexHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t dimensions[3];
+  std::uint64_t sourceSize;
+  std::int64_t sourceMTime;
+  std::uint64_t numberOfBricks;
+  double bounds[6];
+};
+
+void resetBounds(double bounds[6])
+{
+  bounds[0] = bounds[2] = bounds[4] = 1e300;
+  bounds[1] = bounds[3] = bounds[5] = -1e300;
+}
+
+void addToBounds(double bounds[6], const float point[3])
+{
+  for (int i = 0; i < 3; ++i)
+    {
+    bounds[2 * i] = std::min(bounds[2 * i], static_cast<double>(point[i]));
+    bounds[2 * i + 1] = std::max(bounds[2 * i + 1],
+                                 static_cast<double>(point[i]));
+    }
+}
+
+} // end anon namespace
+
+std::shared_ptr<gvBrickStore> gvBrickStore::open(
+    const std::string &sourceFileName)
+{
+  std::shared_ptr<gvBrickStore> store(new gvBrickStore(sourceFileName));
+  if (store->readIndex())
+    {
+    std::cout << "Using bricks in " << store->m_directory << std::endl;
+    return store;
+    }
+
+  std::cout << "Splitting " << sourceFileName << " into bricks in "
+            << store->m_directory << std::endl;
+  if (!store->build())
+    {
+    std::cerr << "ERROR: Could not build bricks for " << sourceFileName
+              << std::endl;
+    return nullptr;
+    }
+  return store;
+}
+
+gvBrickStore::gvBrickStore(const std::string &sourceFileName)
+  : m_source(sourceFileName),
+    m_directory(sourceFileName + ".gvbricks")
+{
+  resetBounds(m_bounds);
+}
+
+std::size_t gvBrickStore::brickBytes(std::size_t brick) const
+{
+  // Three float points and three ids plus per-cell bookkeeping per triangle:
+  const std::size_t bytesPerTriangle =
+    9 * sizeof(float) + 4 * sizeof(vtkIdType);
+  return static_cast<std::size_t>(m_bricks[brick].numberOfTriangles) *
+    bytesPerTriangle;
+}
+
+vtkSmartPointer<vtkPolyData> gvBrickStore::load(std::size_t brick) const
+{
+  std::size_t triangles =
+    static_cast<std::size_t>(m_bricks[brick].numberOfTriangles);
+
+  vtkNew<vtkFloatArray> positions;
+  positions->SetNumberOfComponents(3);
+  positions->SetNumberOfTuples(static_cast<vtkIdType>(3 * triangles));
+
+  std::ifstream in(this->brickFileName(brick).c_str(), std::ios::binary);
+  in.read(reinterpret_cast<char*>(positions->GetPointer(0)),
+          static_cast<std::streamsize>(9 * triangles * sizeof(float)));
+  if (!in)
+    {
+    std::cerr << "ERROR: Could not read brick " << brick << " of "
+              << m_source << std::endl;
+    return nullptr;
+    }
+
+  // Bricks are triangle soups, so the ids simply count up:
+  std::vector<vtkIdType> ids(3 * triangles);
+  for (std::size_t i = 0; i < ids.size(); ++i)
+    {
+    ids[i] = static_cast<vtkIdType>(i);
+    }
+
+  vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+  vtkNew<vtkPoints> points;
+  points->SetData(positions.Get());
+  output->SetPoints(points.Get());
+  output->SetPolys(gvMeshUtilities::newTriangles(ids.data(), triangles));
+  gvMeshUtilities::prepareForSharing(output);
+  return output;
+}
+
+std::string gvBrickStore::brickFileName(std::size_t brick) const
+{
+  std::ostringstream name;
+  name << m_directory << "/brick" << brick << ".bin";
+  return name.str();
+}
+
+std::string gvBrickStore::indexFileName() const
+{
+  return m_directory + "/index";
+}
+
+bool gvBrickStore::readIndex()
+{
+  std::uint64_t sourceSize;
+  std::int64_t sourceMTime;
+  if (!gvMappedFile::statFile(m_source, sourceSize, sourceMTime))
+    {
+    return false;
+    }
+
+  std::ifstream in(this->indexFileName().c_str(), std::ios::binary);
+  IndexHeader header;
+  if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, IndexMagic, sizeof(IndexMagic)) != 0 ||
+      header.version != IndexVersion ||
+      header.sourceSize != sourceSize || header.sourceMTime != sourceMTime)
+    {
+    return false;
+    }
+
+  m_bricks.resize(static_cast<std::size_t>(header.numberOfBricks));
+  if (!in.read(reinterpret_cast<char*>(m_bricks.data()),
+               static_cast<std::streamsize>(m_bricks.size() * sizeof(Brick))))
+    {
+    m_bricks.clear();
+    return false;
+    }
+  std::copy(header.bounds, header.bounds + 6, m_bounds);
+  return true;
+}
+
+bool gvBrickStore::build()
+{
+  IndexHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, IndexMagic, sizeof(IndexMagic));
+  header.version = IndexVersion;
+
+  gvMappedFile source;
+  if (!gvMappedFile::statFile(m_source, header.sourceSize,
+                              header.sourceMTime) ||
+      !source.open(m_source))
+    {
+    return false;
+    }
+  source.adviseSequential();
+  const char *begin = source.data();
+  const char *end = begin + source.size();
+
+  if (mkdir(m_directory.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+    return false;
+    }
+
+  // Pass 1: stream the vertex positions into a scratch file and find the
+  // bounds. Only the scratch file's pages are needed to resolve faces later.
+  std::string vertexFileName = m_directory + "/vertices.tmp";
+  std::uint64_t numberOfVertices = 0;
+    {
+    std::ofstream vertices(vertexFileName.c_str(),
+                           std::ios::binary | std::ios::trunc);
+    std::vector<float> buffer;
+    buffer.reserve(BufferFloats);
+    for (const char *p = begin; p < end; p = nextLine(p, end))
+      {
+      const char *line = skipBlanks(p, end);
+      if (end - line < 2 || line[0] != 'v' || !isBlank(line[1]))
+        {
+        continue;
+        }
+      const char *q = line + 2;
+      float xyz[3];
+      if (!parseFloat(q, end, xyz[0]) || !parseFloat(q, end, xyz[1]) ||
+          !parseFloat(q, end, xyz[2]))
+        {
+        return false;
+        }
+      buffer.insert(buffer.end(), xyz, xyz + 3);
+      addToBounds(m_bounds, xyz);
+      ++numberOfVertices;
+      if (buffer.size() + 3 > BufferFloats)
+        {
+        vertices.write(reinterpret_cast<const char*>(buffer.data()),
+          static_cast<std::streamsize>(buffer.size() * sizeof(float)));
+        buffer.clear();
+        }
+      }
+    vertices.write(reinterpret_cast<const char*>(buffer.data()),
+                   static_cast<std::streamsize>(buffer.size() * sizeof(float)));
+    if (!vertices)
+      {
+      return false;
+      }
+    }
+
+  gvMappedFile vertexFile;
+  if (numberOfVertices == 0 || !vertexFile.open(vertexFileName))
+    {
+    std::remove(vertexFileName.c_str());
+    return false;
+    }
+  const float *positions = reinterpret_cast<const float*>(vertexFile.data());
+
+  // Pick the grid so cells are roughly cubic and hold about
+  // TargetBrickSourceBytes of the source each:
+  std::uint64_t targetBricks = std::max<std::uint64_t>(1, std::min(
+    MaximumBricks, header.sourceSize / TargetBrickSourceBytes));
+  double extent[3];
+  double largest = 0.;
+  for (int i = 0; i < 3; ++i)
+    {
+    extent[i] = m_bounds[2 * i + 1] - m_bounds[2 * i];
+    largest = std::max(largest, extent[i]);
+    }
+  double volume = 1.;
+  for (int i = 0; i < 3; ++i)
+    {
+    extent[i] = std::max(extent[i], largest * 1e-3);
+    volume *= extent[i];
+    }
+  double cellSize = std::cbrt(volume / static_cast<double>(targetBricks));
+  for (int i = 0; i < 3; ++i)
+    {
+    header.dimensions[i] = static_cast<std::uint32_t>(std::max(1., std::min(
+      64., std::ceil(extent[i] / cellSize))));
+    }
+  std::size_t numberOfBricks = static_cast<std::size_t>(
+    header.dimensions[0]) * header.dimensions[1] * header.dimensions[2];
+
+  m_bricks.resize(numberOfBricks);
+  for (std::size_t b = 0; b < numberOfBricks; ++b)
+    {
+    m_bricks[b].numberOfTriangles = 0;
+    resetBounds(m_bricks[b].bounds);
+    }
+
+  std::vector<std::vector<float> > buffers(numberOfBricks);
+  std::vector<bool> started(numberOfBricks, false);
+  bool writeFailed = false;
+  auto flush = [&](std::size_t b)
+    {
+    std::ofstream out(this->brickFileName(b).c_str(), std::ios::binary |
+                      (started[b] ? std::ios::app : std::ios::trunc));
+    out.write(reinterpret_cast<const char*>(buffers[b].data()),
+              static_cast<std::streamsize>(buffers[b].size() * sizeof(float)));
+    writeFailed |= !out;
+    started[b] = true;
+    buffers[b].clear();
+    };
+
+  // Pass 2: fan-triangulate every face and append the triangle to the brick
+  // containing its centroid.
+  std::uint64_t vertexCount = 0;
+  std::vector<std::int64_t> corners;
+  for (const char *p = begin; p < end && !writeFailed; p = nextLine(p, end))
+    {
+    const char *line = skipBlanks(p, end);
+    if (end - line < 2 || !isBlank(line[1]))
+      {
+      continue;
+      }
+    if (line[0] == 'v')
+      {
+      ++vertexCount;
+      continue;
+      }
+    if (line[0] != 'f')
+      {
+      continue;
+      }
+
+    corners.clear();
+    for (const char *q = skipBlanks(line + 2, end);
+         q < end && *q != '\n' && *q != '#'; q = skipBlanks(q, end))
+      {
+      std::int64_t index;
+      if (!parseIndex(q, end, index))
+        {
+        break;
+        }
+      index = index > 0 ? index - 1 :
+        static_cast<std::int64_t>(vertexCount) + index;
+      if (index < 0 || index >= static_cast<std::int64_t>(numberOfVertices))
+        {
+        std::remove(vertexFileName.c_str());
+        return false;
+        }
+      corners.push_back(index);
+      // Texture coordinate and normal indices aren't kept in bricks:
+      while (q < end && !isBlank(*q) && *q != '\n')
+        {
+        ++q;
+        }
+      }
+
+    for (std::size_t k = 2; k < corners.size(); ++k)
+      {
+      const float *vertex[3] = { positions + 3 * corners[0],
+                                 positions + 3 * corners[k - 1],
+                                 positions + 3 * corners[k] };
+      std::size_t cell[3];
+      for (int i = 0; i < 3; ++i)
+        {
+        double centroid = (vertex[0][i] + vertex[1][i] + vertex[2][i]) / 3.;
+        double t = (centroid - m_bounds[2 * i]) / extent[i];
+        cell[i] = static_cast<std::size_t>(std::max(0., std::min(
+          t * header.dimensions[i], header.dimensions[i] - 1.)));
+        }
+      std::size_t b = (cell[2] * header.dimensions[1] + cell[1]) *
+        header.dimensions[0] + cell[0];
+
+      Brick &brick = m_bricks[b];
+      for (int v = 0; v < 3; ++v)
+        {
+        buffers[b].insert(buffers[b].end(), vertex[v], vertex[v] + 3);
+        addToBounds(brick.bounds, vertex[v]);
+        }
+      ++brick.numberOfTriangles;
+      if (buffers[b].size() + 9 > BufferFloats)
+        {
+        flush(b);
+        }
+      }
+    }
+  for (std::size_t b = 0; b < numberOfBricks; ++b)
+    {
+    if (!buffers[b].empty())
+      {
+      flush(b);
+      }
+    }
+
+  vertexFile.close();
+  std::remove(vertexFileName.c_str());
+  if (writeFailed)
+    {
+    return false;
+    }
+
+  header.numberOfBricks = numberOfBricks;
+  std::copy(m_bounds, m_bounds + 6, header.bounds);
+  std::ofstream index(this->indexFileName().c_str(),
+                      std::ios::binary | std::ios::trunc);
+  index.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  index.write(reinterpret_cast<const char*>(m_bricks.data()),
+              static_cast<std::streamsize>(m_bricks.size() * sizeof(Brick)));
+  return static_cast<bool>(index);
+}
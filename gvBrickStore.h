@@ -0,0 +1,56 @@
+#ifndef GVBRICKSTORE_H
+#define GVBRICKSTORE_H
+
+#include <vtkSmartPointer.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class vtkPolyData;
+
+// On-disk spatial bricks of an OBJ model too large to hold in memory. The
+// model is split on a regular grid by triangle centroid; each brick is a
+// triangle soup file in "<source>.gvbricks/", described by an index with the
+// brick bounds and triangle counts. Building streams through the source file
+// twice and never holds more than the vertex positions' pages and a small
+// write buffer per brick in memory.
+class gvBrickStore
+{
+public:
+  struct Brick
+  {
+    std::uint64_t numberOfTriangles;
+    double bounds[6];
+  };
+
+  // Open the bricks of sourceFileName, building them first if they are
+  // missing or older than the source. Returns null on failure.
+  static std::shared_ptr<gvBrickStore> open(const std::string &sourceFileName);
+
+  const double* bounds() const { return m_bounds; }
+  const std::vector<Brick>& bricks() const { return m_bricks; }
+
+  // Memory a brick occupies once loaded, used for the streaming budget.
+  std::size_t brickBytes(std::size_t brick) const;
+
+  // Read one brick from disk. Safe to call from any thread.
+  vtkSmartPointer<vtkPolyData> load(std::size_t brick) const;
+
+private:
+  gvBrickStore(const std::string &sourceFileName);
+
+  std::string brickFileName(std::size_t brick) const;
+  std::string indexFileName() const;
+  bool readIndex();
+  bool build();
+
+  std::string m_source;
+  std::string m_directory;
+  double m_bounds[6];
+  std::vector<Brick> m_bricks;
+};
+
+#endif // GVBRICKSTORE_H
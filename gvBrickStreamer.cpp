@@ -0,0 +1,238 @@
+#include "gvBrickStreamer.h"
+
+#include "gvBrickStore.h"
+#include "gvFrustum.h"
+
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+const std::size_t NoBrick = std::numeric_limits<std::size_t>::max();
+
+// Distance from the eye to the closest point of a box, 0 inside it.
+double eyeDistance(const double eye[3], const double bounds[6])
+{
+  double squared = 0.;
+  for (int i = 0; i < 3; ++i)
+    {
+    double d = std::max(bounds[2 * i] - eye[i],
+                        std::max(0., eye[i] - bounds[2 * i + 1]));
+    squared += d * d;
+    }
+  return std::sqrt(squared);
+}
+
+} // end anon namespace
+
+gvBrickStreamer::gvBrickStreamer(std::shared_ptr<gvBrickStore> store,
+                                 std::size_t budgetBytes,
+                                 const std::function<void()> &loaded)
+  : m_store(store),
+    m_budgetBytes(budgetBytes),
+    m_loaded(loaded),
+    m_resident(store->bricks().size()),
+    m_lastUsed(store->bricks().size(), 0),
+    m_failed(store->bricks().size(), false),
+    m_residentBytes(0),
+    m_residentVersion(1),
+    m_frame(1),
+    m_requests(store->bricks().size(), -1.),
+    m_hasRequests(false),
+    m_inFlight(NoBrick),
+    m_stop(false)
+{
+  m_io = std::thread(&gvBrickStreamer::ioLoop, this);
+}
+
+gvBrickStreamer::~gvBrickStreamer()
+{
+    {
+    std::lock_guard<std::mutex> lock(m_ioMutex);
+    m_stop = true;
+    }
+  m_ioCondition.notify_all();
+  m_io.join();
+}
+
+void gvBrickStreamer::requestVisible(const gvFrustum &frustum)
+{
+  const std::vector<gvBrickStore::Brick> &bricks = m_store->bricks();
+
+  std::lock_guard<std::mutex> lock(m_requestMutex);
+  for (std::size_t i = 0; i < bricks.size(); ++i)
+    {
+    if (bricks[i].numberOfTriangles == 0 ||
+        !frustum.intersects(bricks[i].bounds))
+      {
+      continue;
+      }
+    double distance = eyeDistance(frustum.eye(), bricks[i].bounds);
+    if (m_requests[i] < 0. || distance < m_requests[i])
+      {
+      m_requests[i] = distance;
+      }
+    m_hasRequests = true;
+    }
+}
+
+bool gvBrickStreamer::update()
+{
+  bool changed = false;
+  std::size_t inFlight;
+  std::vector<std::pair<std::size_t, vtkSmartPointer<vtkPolyData> > > arrived;
+    {
+    std::lock_guard<std::mutex> lock(m_ioMutex);
+    arrived.swap(m_arrived);
+    inFlight = m_inFlight;
+    }
+  for (std::size_t i = 0; i < arrived.size(); ++i)
+    {
+    std::size_t id = arrived[i].first;
+    if (!arrived[i].second)
+      {
+      // Don't retry unreadable bricks every frame:
+      m_failed[id] = true;
+      }
+    else if (!m_resident[id])
+      {
+      m_resident[id] = arrived[i].second;
+      m_residentBytes += m_store->brickBytes(id);
+      m_lastUsed[id] = m_frame;
+      changed = true;
+      }
+    }
+
+  // Collect what the windows asked for since the last update:
+  std::vector<std::pair<double, std::size_t> > requested;
+  bool hasRequests;
+    {
+    std::lock_guard<std::mutex> lock(m_requestMutex);
+    hasRequests = m_hasRequests;
+    for (std::size_t i = 0; i < m_requests.size(); ++i)
+      {
+      if (m_requests[i] >= 0.)
+        {
+        requested.push_back(std::make_pair(m_requests[i], i));
+        m_requests[i] = -1.;
+        }
+      }
+    m_hasRequests = false;
+    }
+
+  // Nothing was drawn (e.g. before the first display), keep what we have:
+  if (hasRequests)
+    {
+    // The nearest bricks that fit in the budget make up the working set:
+    std::sort(requested.begin(), requested.end());
+    std::vector<bool> wanted(m_resident.size(), false);
+    std::vector<std::size_t> missing;
+    std::size_t wantedBytes = 0;
+    std::size_t missingBytes = 0;
+    for (std::size_t i = 0; i < requested.size(); ++i)
+      {
+      std::size_t id = requested[i].second;
+      if (m_failed[id])
+        {
+        continue;
+        }
+      std::size_t bytes = m_store->brickBytes(id);
+      if (wantedBytes + bytes > m_budgetBytes && wantedBytes > 0)
+        {
+        break;
+        }
+      wantedBytes += bytes;
+      wanted[id] = true;
+      if (m_resident[id])
+        {
+        m_lastUsed[id] = m_frame;
+        }
+      else
+        {
+        missing.push_back(id);
+        missingBytes += bytes;
+        }
+      }
+
+    // Make room for the missing bricks, least recently used first. Unwanted
+    // bricks otherwise stay cached in case the view comes back to them.
+    std::size_t target =
+      m_budgetBytes > missingBytes ? m_budgetBytes - missingBytes : 0;
+    if (m_residentBytes > target)
+      {
+      std::vector<std::pair<unsigned long, std::size_t> > evictable;
+      for (std::size_t id = 0; id < m_resident.size(); ++id)
+        {
+        if (m_resident[id] && !wanted[id])
+          {
+          evictable.push_back(std::make_pair(m_lastUsed[id], id));
+          }
+        }
+      std::sort(evictable.begin(), evictable.end());
+      for (std::size_t i = 0;
+           i < evictable.size() && m_residentBytes > target; ++i)
+        {
+        std::size_t id = evictable[i].second;
+        m_resident[id] = nullptr;
+        m_residentBytes -= m_store->brickBytes(id);
+        changed = true;
+        }
+      }
+
+    // Replace the load queue, nearest first:
+      {
+      std::lock_guard<std::mutex> lock(m_ioMutex);
+      m_queue.clear();
+      for (std::size_t i = 0; i < missing.size(); ++i)
+        {
+        if (missing[i] != inFlight)
+          {
+          m_queue.push_back(missing[i]);
+          }
+        }
+      }
+    m_ioCondition.notify_one();
+    }
+
+  if (changed)
+    {
+    ++m_residentVersion;
+    }
+  ++m_frame;
+  return changed;
+}
+
+void gvBrickStreamer::ioLoop()
+{
+  std::unique_lock<std::mutex> lock(m_ioMutex);
+  for (;;)
+    {
+    m_ioCondition.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+    if (m_stop)
+      {
+      return;
+      }
+
+    std::size_t id = m_queue.front();
+    m_queue.pop_front();
+    m_inFlight = id;
+    lock.unlock();
+
+    vtkSmartPointer<vtkPolyData> data = m_store->load(id);
+
+    lock.lock();
+    m_arrived.push_back(std::make_pair(id, data));
+    m_inFlight = NoBrick;
+    lock.unlock();
+
+    if (m_loaded)
+      {
+      m_loaded();
+      }
+
+    lock.lock();
+    }
+}
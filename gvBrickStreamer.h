@@ -0,0 +1,86 @@
+#ifndef GVBRICKSTREAMER_H
+#define GVBRICKSTREAMER_H
+
+#include <vtkSmartPointer.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class gvBrickStore;
+class gvFrustum;
+class vtkPolyData;
+
+// Keeps the bricks of a gvBrickStore that the current views need in memory,
+// within a fixed budget. Windows report what they see with requestVisible();
+// update() turns the requests into a nearest-first load queue for a
+// background I/O thread and evicts the least recently used bricks once the
+// budget is reached.
+class gvBrickStreamer
+{
+public:
+  // loaded is invoked from the I/O thread after each brick arrives.
+  gvBrickStreamer(std::shared_ptr<gvBrickStore> store,
+                  std::size_t budgetBytes,
+                  const std::function<void()> &loaded);
+  ~gvBrickStreamer();
+
+  const gvBrickStore& store() const { return *m_store; }
+
+  // Request the bricks inside frustum for the next update(). Safe to call
+  // from any rendering thread.
+  void requestVisible(const gvFrustum &frustum);
+
+  // Take in arrived bricks, evict, and reschedule loading. Call from the main
+  // thread once per frame; returns true if the resident set changed.
+  bool update();
+
+  // The resident data of a brick, or null. Only changes in update().
+  vtkPolyData* brick(std::size_t id) const { return m_resident[id].Get(); }
+
+  // Incremented whenever the resident set changes.
+  unsigned long residentVersion() const { return m_residentVersion; }
+
+  std::size_t residentBytes() const { return m_residentBytes; }
+  std::size_t budgetBytes() const { return m_budgetBytes; }
+
+private:
+  gvBrickStreamer(const gvBrickStreamer&) = delete;
+  gvBrickStreamer& operator=(const gvBrickStreamer&) = delete;
+
+  void ioLoop();
+
+  std::shared_ptr<gvBrickStore> m_store;
+  std::size_t m_budgetBytes;
+  std::function<void()> m_loaded;
+
+  // Main thread only:
+  std::vector<vtkSmartPointer<vtkPolyData> > m_resident;
+  std::vector<unsigned long> m_lastUsed;
+  std::vector<bool> m_failed;
+  std::size_t m_residentBytes;
+  unsigned long m_residentVersion;
+  unsigned long m_frame;
+
+  // Eye distance of each requested brick, or a negative value:
+  std::mutex m_requestMutex;
+  std::vector<double> m_requests;
+  bool m_hasRequests;
+
+  // I/O thread hand-off, guarded by m_ioMutex:
+  std::mutex m_ioMutex;
+  std::condition_variable m_ioCondition;
+  std::deque<std::size_t> m_queue;
+  std::size_t m_inFlight;
+  std::vector<std::pair<std::size_t, vtkSmartPointer<vtkPolyData> > > m_arrived;
+  bool m_stop;
+  std::thread m_io;
+};
+
+#endif // GVBRICKSTREAMER_H
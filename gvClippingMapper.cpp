@@ -0,0 +1,238 @@
+#include "gvClippingMapper.h"
+
+#include <vtkActor.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkOpenGLHelper.h>
+#include <vtkShader.h>
+#include <vtkShaderProgram.h>
+#include <vtkVersion.h>
+#include <vtk_glew.h>
+
+// Vertex buffers are grouped, and may be shifted and scaled, from VTK 8.1:
+#if VTK_MAJOR_VERSION > 8 || (VTK_MAJOR_VERSION == 8 && VTK_MINOR_VERSION >= 1)
+#define GV_VBO_SHIFT_SCALE
+#include <vtkOpenGLVertexBufferObject.h>
+#include <vtkOpenGLVertexBufferObjectGroup.h>
+#endif
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+
+vtkStandardNewMacro(gvClippingMapper)
+
+gvClippingMapper::gvClippingMapper()
+  : m_planes(nullptr),
+    m_maxPlanes(6),
+    m_maxClipDistances(-1),
+    m_enabledDistances(0)
+{
+}
+
+gvClippingMapper::~gvClippingMapper()
+{
+}
+
+void gvClippingMapper::setMaximumNumberOfClipPlanes(int count)
+{
+  m_maxPlanes = std::max(1, count);
+}
+
+void gvClippingMapper::setClipPlanes(const std::vector<float> *planes)
+{
+  m_planes = planes;
+}
+
+const float* gvClippingMapper::dataPlanes(const std::vector<float> &planes,
+                                          int count, vtkActor *act,
+                                          std::vector<float> &scratch,
+                                          const double *shift,
+                                          const double *scale)
+{
+  bool identity = act->GetIsIdentity() != 0;
+  if (identity && !shift)
+    {
+    return planes.data();
+    }
+
+  // Planes move the other way: a world plane p keeps x where p . (M x) >= 0.
+  vtkMatrix4x4 *matrix = identity ? nullptr : act->GetMatrix();
+  scratch.resize(4 * count);
+  for (int i = 0; i < count; ++i)
+    {
+    const float *world = planes.data() + 4 * i;
+    double plane[4];
+    for (int j = 0; j < 4; ++j)
+      {
+      plane[j] = world[j];
+      if (matrix)
+        {
+        plane[j] = 0.;
+        for (int k = 0; k < 4; ++k)
+          {
+          plane[j] += world[k] * matrix->GetElement(k, j);
+          }
+        }
+      }
+    // A stored position v is x = v / scale + shift:
+    if (shift)
+      {
+      for (int j = 0; j < 3; ++j)
+        {
+        plane[3] += plane[j] * shift[j];
+        plane[j] /= scale[j];
+        }
+      }
+    for (int j = 0; j < 4; ++j)
+      {
+      scratch[4 * i + j] = static_cast<float>(plane[j]);
+      }
+    }
+  return scratch.data();
+}
+
+int gvClippingMapper::hardwarePlanes(bool geometryShader)
+{
+  // gl_ClipDistance would have to be forwarded through a geometry shader:
+  if (geometryShader)
+    {
+    return 0;
+    }
+  if (m_maxClipDistances < 0)
+    {
+    GLint maxClipDistances = 0;
+    glGetIntegerv(GL_MAX_CLIP_DISTANCES, &maxClipDistances);
+    m_maxClipDistances = static_cast<int>(maxClipDistances);
+    }
+  return std::min(m_maxPlanes, m_maxClipDistances);
+}
+
+void gvClippingMapper::ReplaceShaderClip(
+    std::map<vtkShader::Type, vtkShader*> shaders, vtkRenderer *ren,
+    vtkActor *act)
+{
+  std::string vs = shaders[vtkShader::Vertex]->GetSource();
+  std::string gs = shaders[vtkShader::Geometry]->GetSource();
+  std::string fs = shaders[vtkShader::Fragment]->GetSource();
+  int hardware = this->hardwarePlanes(!gs.empty());
+  const char *position = gs.empty() ? "gvVertexMCVSOutput"
+                                    : "gvVertexMCGSOutput";
+
+  std::ostringstream uniforms;
+  uniforms << "uniform int gvNumberOfClipPlanes;\n"
+           << "uniform vec4 gvClipPlanes[" << m_maxPlanes << "];\n";
+
+  // The tags stay in place for the superclass' own clipping planes:
+  std::ostringstream vsDec;
+  vsDec << "//VTK::Clip::Dec\n" << uniforms.str()
+        << "out vec4 gvVertexMCVSOutput;\n";
+  std::ostringstream vsImpl;
+  vsImpl << "//VTK::Clip::Impl\n"
+         << "  gvVertexMCVSOutput = vertexMC;\n";
+  if (hardware > 0)
+    {
+    vsDec << "out float gl_ClipDistance[" << hardware << "];\n";
+    vsImpl << "  for (int gvi = 0; gvi < " << hardware << "; ++gvi)\n"
+           << "    {\n"
+           << "    gl_ClipDistance[gvi] = gvi < gvNumberOfClipPlanes ?\n"
+           << "      dot(gvClipPlanes[gvi], vertexMC) : 1.0;\n"
+           << "    }\n";
+    }
+  vtkShaderProgram::Substitute(vs, "//VTK::Clip::Dec", vsDec.str());
+  vtkShaderProgram::Substitute(vs, "//VTK::Clip::Impl", vsImpl.str());
+  shaders[vtkShader::Vertex]->SetSource(vs);
+
+  if (!gs.empty())
+    {
+    vtkShaderProgram::Substitute(gs, "//VTK::Clip::Dec",
+      "//VTK::Clip::Dec\n"
+      "in vec4 gvVertexMCVSOutput[];\n"
+      "out vec4 gvVertexMCGSOutput;\n");
+    vtkShaderProgram::Substitute(gs, "//VTK::Clip::Impl",
+      "//VTK::Clip::Impl\n"
+      "  gvVertexMCGSOutput = gvVertexMCVSOutput[i];\n");
+    shaders[vtkShader::Geometry]->SetSource(gs);
+    }
+
+  std::ostringstream fsDec;
+  fsDec << "//VTK::Clip::Dec\n" << uniforms.str()
+        << "in vec4 " << position << ";\n";
+  std::ostringstream fsImpl;
+  fsImpl << "//VTK::Clip::Impl\n"
+         << "  for (int gvi = " << hardware
+         << "; gvi < gvNumberOfClipPlanes; ++gvi)\n"
+         << "    {\n"
+         << "    if (dot(gvClipPlanes[gvi], " << position << ") < 0.0)\n"
+         << "      {\n"
+         << "      discard;\n"
+         << "      }\n"
+         << "    }\n";
+  vtkShaderProgram::Substitute(fs, "//VTK::Clip::Dec", fsDec.str());
+  vtkShaderProgram::Substitute(fs, "//VTK::Clip::Impl", fsImpl.str());
+  shaders[vtkShader::Fragment]->SetSource(fs);
+
+  this->Superclass::ReplaceShaderClip(shaders, ren, act);
+}
+
+void gvClippingMapper::SetMapperShaderParameters(vtkOpenGLHelper &cellBO,
+                                                 vtkRenderer *ren,
+                                                 vtkActor *act)
+{
+  this->Superclass::SetMapperShaderParameters(cellBO, ren, act);
+
+  vtkShaderProgram *program = cellBO.Program;
+  int count = m_planes ?
+    std::min(m_maxPlanes, static_cast<int>(m_planes->size() / 4)) : 0;
+
+  // VTK shifts and scales the positions of meshes far from the origin as
+  // it uploads them, and vertexMC holds the result:
+  const double *shift = nullptr;
+  const double *scale = nullptr;
+#ifdef GV_VBO_SHIFT_SCALE
+  vtkOpenGLVertexBufferObject *positions = this->VBOs->GetVBO("vertexMC");
+  if (positions && positions->GetCoordShiftAndScaleEnabled())
+    {
+    shift = positions->GetShift().data();
+    scale = positions->GetScale().data();
+    }
+#endif
+
+  const float *planes = count > 0 ?
+    dataPlanes(*m_planes, count, act, m_dataPlanes, shift, scale) : nullptr;
+
+  // One upload for all planes:
+  if (program->IsUniformUsed("gvNumberOfClipPlanes"))
+    {
+    program->SetUniformi("gvNumberOfClipPlanes", count);
+    }
+  if (count > 0 && program->IsUniformUsed("gvClipPlanes"))
+    {
+    program->SetUniform4fv("gvClipPlanes", count,
+      reinterpret_cast<const float (*)[4]>(planes));
+    }
+
+  vtkShader *gs = program->GetGeometryShader();
+  bool geometryShader = gs && !gs->GetSource().empty();
+  int distances = std::min(count, this->hardwarePlanes(geometryShader));
+  for (int i = m_enabledDistances; i < distances; ++i)
+    {
+    glEnable(GL_CLIP_DISTANCE0 + i);
+    }
+  for (int i = distances; i < m_enabledDistances; ++i)
+    {
+    glDisable(GL_CLIP_DISTANCE0 + i);
+    }
+  m_enabledDistances = distances;
+}
+
+void gvClippingMapper::RenderPieceFinish(vtkRenderer *ren, vtkActor *act)
+{
+  for (int i = 0; i < m_enabledDistances; ++i)
+    {
+    glDisable(GL_CLIP_DISTANCE0 + i);
+    }
+  m_enabledDistances = 0;
+
+  this->Superclass::RenderPieceFinish(ren, act);
+}
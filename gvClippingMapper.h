@@ -0,0 +1,63 @@
+#ifndef GVCLIPPINGMAPPER_H
+#define GVCLIPPINGMAPPER_H
+
+#include <vtkOpenGLPolyDataMapper.h>
+
+#include <map>
+#include <vector>
+
+// Poly data mapper for the OpenGL2 backend that clips in its shaders against
+// any number of planes, passed as one uniform array per draw. Planes up to
+// the GL_MAX_CLIP_DISTANCES limit are applied with gl_ClipDistance and the
+// rest by discarding fragments; with a geometry shader (wide lines) all of
+// them are discarded.
+class gvClippingMapper : public vtkOpenGLPolyDataMapper
+{
+public:
+  static gvClippingMapper* New();
+  vtkTypeMacro(gvClippingMapper, vtkOpenGLPolyDataMapper)
+
+  // Size of the plane array compiled into the shaders. Set it before the
+  // first render.
+  void setMaximumNumberOfClipPlanes(int count);
+
+  // Planes as packed (a, b, c, d) floats, keeping a*x + b*y + c*z + d >= 0
+  // in world coordinates like VTK's own clipping planes. The caller owns
+  // them and they are read at every draw; null turns clipping off.
+  void setClipPlanes(const std::vector<float> *planes);
+
+  // The first count of packed planes moved into the coordinates shaders
+  // test positions in: act's data coordinates, before the actor's
+  // transform, then those of a vertex buffer storing (x - shift) * scale if
+  // shift and scale are given. Returns planes' own data if neither applies,
+  // else scratch's.
+  static const float* dataPlanes(const std::vector<float> &planes, int count,
+                                 vtkActor *act, std::vector<float> &scratch,
+                                 const double *shift = nullptr,
+                                 const double *scale = nullptr);
+
+protected:
+  gvClippingMapper();
+  ~gvClippingMapper() override;
+
+  void ReplaceShaderClip(std::map<vtkShader::Type, vtkShader*> shaders,
+                         vtkRenderer *ren, vtkActor *act) override;
+  void SetMapperShaderParameters(vtkOpenGLHelper &cellBO, vtkRenderer *ren,
+                                 vtkActor *act) override;
+  void RenderPieceFinish(vtkRenderer *ren, vtkActor *act) override;
+
+private:
+  gvClippingMapper(const gvClippingMapper&) = delete;
+  void operator=(const gvClippingMapper&) = delete;
+
+  // Planes applied with gl_ClipDistance by a program.
+  int hardwarePlanes(bool geometryShader);
+
+  const std::vector<float> *m_planes;
+  std::vector<float> m_dataPlanes; // m_planes in the actor's data coordinates
+  int m_maxPlanes;
+  int m_maxClipDistances;
+  int m_enabledDistances;
+};
+
+#endif // GVCLIPPINGMAPPER_H
@@ -0,0 +1,607 @@
+#include "gvCompactMapper.h"
+
+#include "gvClippingMapper.h"
+#include "gvCompactMesh.h"
+#include "gvSharedBuffers.h"
+
+#include <vtkActor.h>
+#include <vtkLight.h>
+#include <vtkLightCollection.h>
+#include <vtkMatrix3x3.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkOpenGLActor.h>
+#include <vtkOpenGLBufferObject.h>
+#include <vtkOpenGLCamera.h>
+#include <vtkOpenGLRenderWindow.h>
+#include <vtkOpenGLShaderCache.h>
+#include <vtkOpenGLVertexArrayObject.h>
+#include <vtkProperty.h>
+#include <vtkRenderer.h>
+#include <vtkShaderProgram.h>
+#include <vtk_glew.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+namespace {
+
+const int MaximumNumberOfLights = 8;
+
+std::string vertexShader(int maxPlanes, int hardwarePlanes)
+{
+  std::ostringstream vs;
+  vs << "//VTK::System::Dec\n"
+        "in vec4 gvPosition;\n"
+        "in vec2 gvNormal;\n"
+        "uniform vec3 gvOrigin;\n"
+        "uniform vec3 gvExtent;\n"
+        "uniform mat4 gvModelToClip;\n"
+        "uniform mat4 gvModelToView;\n"
+        "uniform mat3 gvNormalMatrix;\n"
+        "uniform int gvHasNormals;\n"
+        "uniform int gvNumberOfClipPlanes;\n"
+        "uniform vec4 gvClipPlanes[" << maxPlanes << "];\n"
+        "out vec4 gvVertexMC;\n"
+        "out vec4 gvVertexVC;\n"
+        "out vec3 gvNormalVC;\n";
+  if (hardwarePlanes > 0)
+    {
+    vs << "out float gl_ClipDistance[" << hardwarePlanes << "];\n";
+    }
+  vs << "vec3 gvDecodeNormal(vec2 e)\n"
+        "{\n"
+        "  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+        "  if (n.z < 0.0)\n"
+        "    {\n"
+        "    n.xy = (1.0 - abs(n.yx)) *\n"
+        "      vec2(n.x < 0.0 ? -1.0 : 1.0, n.y < 0.0 ? -1.0 : 1.0);\n"
+        "    }\n"
+        "  return normalize(n);\n"
+        "}\n"
+        "void main()\n"
+        "{\n"
+        "  gvVertexMC = vec4(gvOrigin + gvPosition.xyz * gvExtent, 1.0);\n"
+        "  gvVertexVC = gvModelToView * gvVertexMC;\n"
+        "  gvNormalVC = gvHasNormals != 0 ?\n"
+        "    normalize(gvNormalMatrix * gvDecodeNormal(gvNormal)) :\n"
+        "    vec3(0.0);\n";
+  if (hardwarePlanes > 0)
+    {
+    vs << "  for (int gvi = 0; gvi < " << hardwarePlanes << "; ++gvi)\n"
+          "    {\n"
+          "    gl_ClipDistance[gvi] = gvi < gvNumberOfClipPlanes ?\n"
+          "      dot(gvClipPlanes[gvi], gvVertexMC) : 1.0;\n"
+          "    }\n";
+    }
+  vs << "  gl_Position = gvModelToClip * gvVertexMC;\n"
+        "}\n";
+  return vs.str();
+}
+
+// VTK's Blinn-Phong surface shading, lit from both sides.
+std::string fragmentShader(int maxPlanes, int hardwarePlanes)
+{
+  std::ostringstream fs;
+  fs << "//VTK::System::Dec\n"
+        "//VTK::Output::Dec\n"
+        "in vec4 gvVertexMC;\n"
+        "in vec4 gvVertexVC;\n"
+        "in vec3 gvNormalVC;\n"
+        "uniform int gvHasNormals;\n"
+        "uniform int gvNumberOfClipPlanes;\n"
+        "uniform vec4 gvClipPlanes[" << maxPlanes << "];\n"
+        "uniform int gvLighting;\n"
+        "uniform int gvNumberOfLights;\n"
+        "uniform vec3 gvLightColor[" << MaximumNumberOfLights << "];\n"
+        "uniform vec3 gvLightDirectionVC[" << MaximumNumberOfLights << "];\n"
+        "uniform vec3 gvAmbientColor;\n"
+        "uniform vec3 gvDiffuseColor;\n"
+        "uniform vec3 gvSpecularColor;\n"
+        "uniform float gvSpecularPower;\n"
+        "uniform float gvOpacity;\n"
+        "void main()\n"
+        "{\n"
+        "  for (int gvi = " << hardwarePlanes
+     << "; gvi < gvNumberOfClipPlanes; ++gvi)\n"
+        "    {\n"
+        "    if (dot(gvClipPlanes[gvi], gvVertexMC) < 0.0)\n"
+        "      {\n"
+        "      discard;\n"
+        "      }\n"
+        "    }\n"
+        "  if (gvLighting == 0)\n"
+        "    {\n"
+        "    gl_FragData[0] = vec4(gvDiffuseColor, gvOpacity);\n"
+        "    return;\n"
+        "    }\n"
+        "  vec3 normal;\n"
+        "  if (gvHasNormals != 0)\n"
+        "    {\n"
+        "    normal = normalize(gvNormalVC);\n"
+        "    if (!gl_FrontFacing)\n"
+        "      {\n"
+        "      normal = -normal;\n"
+        "      }\n"
+        "    }\n"
+        "  else\n"
+        "    {\n"
+        "    normal = normalize(cross(dFdx(gvVertexVC.xyz),\n"
+        "                             dFdy(gvVertexVC.xyz)));\n"
+        "    if (dot(normal, gvVertexVC.xyz) > 0.0)\n"
+        "      {\n"
+        "      normal = -normal;\n"
+        "      }\n"
+        "    }\n"
+        "  vec3 view = normalize(-gvVertexVC.xyz);\n"
+        "  vec3 diffuse = vec3(0.0);\n"
+        "  vec3 specular = vec3(0.0);\n"
+        "  for (int gvi = 0; gvi < gvNumberOfLights; ++gvi)\n"
+        "    {\n"
+        "    float df = max(0.0, dot(normal, -gvLightDirectionVC[gvi]));\n"
+        "    diffuse += df * gvLightColor[gvi];\n"
+        "    if (df > 0.0)\n"
+        "      {\n"
+        "      vec3 halfway = normalize(view - gvLightDirectionVC[gvi]);\n"
+        "      float sf = pow(max(0.0, dot(halfway, normal)),\n"
+        "                     gvSpecularPower);\n"
+        "      specular += sf * gvLightColor[gvi];\n"
+        "      }\n"
+        "    }\n"
+        "  gl_FragData[0] = vec4(gvAmbientColor + diffuse * gvDiffuseColor +\n"
+        "                        specular * gvSpecularColor, gvOpacity);\n"
+        "}\n";
+  return fs.str();
+}
+
+// The buffers of a chunk, as parts of its mesh in gvSharedBuffers:
+enum BufferPart
+{
+  Positions,
+  Normals,
+  Indices,
+  EdgeIndices,
+  NumberOfBufferParts
+};
+
+int bufferPart(std::size_t chunk, BufferPart part)
+{
+  return static_cast<int>(chunk) * NumberOfBufferParts + part;
+}
+
+// Upload values into buffer, returning their size.
+template <typename T>
+std::size_t upload(vtkOpenGLBufferObject *buffer, const std::vector<T> &values,
+                   vtkOpenGLBufferObject::ObjectType type)
+{
+  buffer->Upload(values, type);
+  return values.size() * sizeof(T);
+}
+
+void setColor(vtkShaderProgram *program, const char *name, double factor,
+              const double color[3])
+{
+  float value[3];
+  for (int i = 0; i < 3; ++i)
+    {
+    value[i] = static_cast<float>(factor * color[i]);
+    }
+  program->SetUniform3f(name, value);
+}
+
+} // end anon namespace
+
+vtkStandardNewMacro(gvCompactMapper)
+
+gvCompactMapper::gvCompactMapper()
+  : m_chunk(0),
+    m_planes(nullptr),
+    m_maxPlanes(6),
+    m_hardwarePlanes(-1),
+    m_program(nullptr),
+    m_positions(nullptr),
+    m_normals(nullptr),
+    m_indices(nullptr),
+    m_edgeIndices(nullptr),
+    m_uploaded(false),
+    m_edgesUploaded(false)
+{
+  for (int i = 0; i < 6; ++i)
+    {
+    m_bounds[i] = 0.;
+    }
+  this->ScalarVisibilityOff();
+}
+
+gvCompactMapper::~gvCompactMapper()
+{
+}
+
+void gvCompactMapper::setChunk(
+    const std::shared_ptr<const gvCompactMesh> &mesh, std::size_t chunk)
+{
+  m_mesh = mesh;
+  m_chunk = chunk;
+  m_positions = nullptr;
+  m_normals = nullptr;
+  m_indices = nullptr;
+  m_edgeIndices = nullptr;
+  m_uploaded = false;
+  m_edgesUploaded = false;
+  if (m_mesh)
+    {
+    const gvCompactMesh::Chunk &data = m_mesh->chunks()[m_chunk];
+    for (int i = 0; i < 3; ++i)
+      {
+      m_bounds[2 * i] = data.origin[i];
+      m_bounds[2 * i + 1] = data.origin[i] + data.extent[i];
+      }
+    }
+  this->Modified();
+}
+
+void gvCompactMapper::setSharedBuffers(
+    const std::shared_ptr<gvSharedBuffers> &buffers)
+{
+  m_buffers = buffers;
+  m_positions = nullptr;
+  m_normals = nullptr;
+  m_indices = nullptr;
+  m_edgeIndices = nullptr;
+  m_uploaded = false;
+  m_edgesUploaded = false;
+}
+
+void gvCompactMapper::setMaximumNumberOfClipPlanes(int count)
+{
+  m_maxPlanes = std::max(1, count);
+  m_hardwarePlanes = -1;
+  m_program = nullptr;
+}
+
+void gvCompactMapper::setClipPlanes(const std::vector<float> *planes)
+{
+  m_planes = planes;
+}
+
+std::size_t gvCompactMapper::bufferBytes() const
+{
+  if (!m_mesh)
+    {
+    return 0;
+    }
+  const gvCompactMesh::Chunk &chunk = m_mesh->chunks()[m_chunk];
+  return gvCompactMesh::bytes(chunk) +
+    (m_edgesUploaded ? gvCompactMesh::edgeBytes(chunk) : 0);
+}
+
+double* gvCompactMapper::GetBounds()
+{
+  return m_bounds;
+}
+
+void gvCompactMapper::GetBounds(double bounds[6])
+{
+  std::copy(m_bounds, m_bounds + 6, bounds);
+}
+
+void gvCompactMapper::ReleaseGraphicsResources(vtkWindow *window)
+{
+  // The buffers stay with the share group for the other contexts:
+  m_vertexArray->ReleaseGraphicsResources();
+  m_positions = nullptr;
+  m_normals = nullptr;
+  m_indices = nullptr;
+  m_edgeIndices = nullptr;
+  m_program = nullptr;
+  m_uploaded = false;
+  m_edgesUploaded = false;
+  this->Superclass::ReleaseGraphicsResources(window);
+}
+
+bool gvCompactMapper::readyProgram(vtkRenderer *ren)
+{
+  vtkOpenGLRenderWindow *window =
+    vtkOpenGLRenderWindow::SafeDownCast(ren->GetRenderWindow());
+  if (!window)
+    {
+    return false;
+    }
+  if (m_program)
+    {
+    return window->GetShaderCache()->ReadyShaderProgram(m_program) != 0;
+    }
+
+  if (m_hardwarePlanes < 0)
+    {
+    GLint maxClipDistances = 0;
+    glGetIntegerv(GL_MAX_CLIP_DISTANCES, &maxClipDistances);
+    m_hardwarePlanes = std::min(m_maxPlanes,
+                                static_cast<int>(maxClipDistances));
+    }
+  std::string vs = vertexShader(m_maxPlanes, m_hardwarePlanes);
+  std::string fs = fragmentShader(m_maxPlanes, m_hardwarePlanes);
+  m_program = window->GetShaderCache()->ReadyShaderProgram(vs.c_str(),
+                                                           fs.c_str(), "");
+  return m_program != nullptr;
+}
+
+void gvCompactMapper::uploadBuffers()
+{
+  if (!m_buffers)
+    {
+    m_buffers = gvSharedBuffers::current();
+    }
+  const gvCompactMesh::Chunk &chunk = m_mesh->chunks()[m_chunk];
+  m_positions = m_buffers->buffer(m_mesh, bufferPart(m_chunk, Positions),
+    [&chunk](vtkOpenGLBufferObject *buffer)
+      {
+      return upload(buffer, chunk.positions,
+                    vtkOpenGLBufferObject::ArrayBuffer);
+      });
+  if (!chunk.normals.empty())
+    {
+    m_normals = m_buffers->buffer(m_mesh, bufferPart(m_chunk, Normals),
+      [&chunk](vtkOpenGLBufferObject *buffer)
+        {
+        return upload(buffer, chunk.normals,
+                      vtkOpenGLBufferObject::ArrayBuffer);
+        });
+    }
+  m_indices = m_buffers->buffer(m_mesh, bufferPart(m_chunk, Indices),
+    [&chunk](vtkOpenGLBufferObject *buffer)
+      {
+      return chunk.shortIndices.empty() ?
+        upload(buffer, chunk.indices,
+               vtkOpenGLBufferObject::ElementArrayBuffer) :
+        upload(buffer, chunk.shortIndices,
+               vtkOpenGLBufferObject::ElementArrayBuffer);
+      });
+  m_uploaded = true;
+}
+
+void gvCompactMapper::drawEdges()
+{
+  const gvCompactMesh::Chunk &chunk = m_mesh->chunks()[m_chunk];
+  if (!m_edgesUploaded)
+    {
+    m_edgeIndices = m_buffers->buffer(m_mesh,
+                                      bufferPart(m_chunk, EdgeIndices),
+      [&chunk](vtkOpenGLBufferObject *buffer)
+        {
+        return chunk.shortEdges.empty() ?
+          upload(buffer, chunk.edges,
+                 vtkOpenGLBufferObject::ElementArrayBuffer) :
+          upload(buffer, chunk.shortEdges,
+                 vtkOpenGLBufferObject::ElementArrayBuffer);
+        });
+    m_edgesUploaded = true;
+    }
+
+  GLenum type = chunk.shortEdges.empty() ? GL_UNSIGNED_INT :
+    GL_UNSIGNED_SHORT;
+  m_edgeIndices->Bind();
+  glDrawRangeElements(GL_LINES, 0,
+                      static_cast<GLuint>(chunk.numberOfPoints - 1),
+                      static_cast<GLsizei>(2 * chunk.numberOfEdges), type,
+                      nullptr);
+  m_edgeIndices->Release();
+}
+
+void gvCompactMapper::setUniforms(vtkRenderer *ren, vtkActor *act)
+{
+  const gvCompactMesh::Chunk &chunk = m_mesh->chunks()[m_chunk];
+  float origin[3];
+  float extent[3];
+  for (int i = 0; i < 3; ++i)
+    {
+    origin[i] = static_cast<float>(chunk.origin[i]);
+    extent[i] = static_cast<float>(chunk.extent[i]);
+    }
+  m_program->SetUniform3f("gvOrigin", origin);
+  m_program->SetUniform3f("gvExtent", extent);
+  m_program->SetUniformi("gvHasNormals", chunk.normals.empty() ? 0 : 1);
+
+  // VTK's key matrices are transposed for GL, hence the order:
+  vtkOpenGLCamera *camera =
+    static_cast<vtkOpenGLCamera*>(ren->GetActiveCamera());
+  vtkMatrix4x4 *worldToView;
+  vtkMatrix3x3 *normalMatrix;
+  vtkMatrix4x4 *viewToClip;
+  vtkMatrix4x4 *worldToClip;
+  camera->GetKeyMatrices(ren, worldToView, normalMatrix, viewToClip,
+                         worldToClip);
+  if (act->GetIsIdentity())
+    {
+    m_program->SetUniformMatrix("gvModelToClip", worldToClip);
+    m_program->SetUniformMatrix("gvModelToView", worldToView);
+    m_program->SetUniformMatrix("gvNormalMatrix", normalMatrix);
+    }
+  else
+    {
+    vtkMatrix4x4 *modelToWorld;
+    vtkMatrix3x3 *actorNormalMatrix;
+    static_cast<vtkOpenGLActor*>(act)->GetKeyMatrices(modelToWorld,
+                                                      actorNormalMatrix);
+    vtkMatrix4x4::Multiply4x4(modelToWorld, worldToClip,
+                              m_modelToClip.Get());
+    vtkMatrix4x4::Multiply4x4(modelToWorld, worldToView,
+                              m_modelToView.Get());
+    vtkMatrix3x3::Multiply3x3(actorNormalMatrix, normalMatrix,
+                              m_normalMatrix.Get());
+    m_program->SetUniformMatrix("gvModelToClip", m_modelToClip.Get());
+    m_program->SetUniformMatrix("gvModelToView", m_modelToView.Get());
+    m_program->SetUniformMatrix("gvNormalMatrix", m_normalMatrix.Get());
+    }
+
+  // Light directions in view coordinates, as VTK's mappers compute them:
+  float colors[MaximumNumberOfLights][3];
+  float directions[MaximumNumberOfLights][3];
+  int numberOfLights = 0;
+  vtkMatrix4x4 *view = camera->GetModelViewTransformMatrix();
+  vtkLightCollection *lights = ren->GetLights();
+  vtkCollectionSimpleIterator it;
+  lights->InitTraversal(it);
+  while (vtkLight *light = lights->GetNextLight(it))
+    {
+    if (!light->GetSwitch() || numberOfLights == MaximumNumberOfLights)
+      {
+      continue;
+      }
+    double direction[3] = {0., 0., -1.};
+    if (!light->LightTypeIsHeadlight())
+      {
+      const double *focalPoint = light->GetTransformedFocalPoint();
+      const double *position = light->GetTransformedPosition();
+      double world[3];
+      for (int i = 0; i < 3; ++i)
+        {
+        world[i] = focalPoint[i] - position[i];
+        }
+      for (int i = 0; i < 3; ++i)
+        {
+        direction[i] = view->GetElement(i, 0) * world[0] +
+          view->GetElement(i, 1) * world[1] +
+          view->GetElement(i, 2) * world[2];
+        }
+      double length = std::sqrt(direction[0] * direction[0] +
+                                direction[1] * direction[1] +
+                                direction[2] * direction[2]);
+      for (int i = 0; i < 3; ++i)
+        {
+        direction[i] = length > 0. ? direction[i] / length : 0.;
+        }
+      }
+    const double *color = light->GetDiffuseColor();
+    for (int i = 0; i < 3; ++i)
+      {
+      colors[numberOfLights][i] =
+        static_cast<float>(light->GetIntensity() * color[i]);
+      directions[numberOfLights][i] = static_cast<float>(direction[i]);
+      }
+    ++numberOfLights;
+    }
+  m_program->SetUniformi("gvNumberOfLights", numberOfLights);
+  if (numberOfLights > 0)
+    {
+    m_program->SetUniform3fv("gvLightColor", numberOfLights, colors);
+    m_program->SetUniform3fv("gvLightDirectionVC", numberOfLights,
+                             directions);
+    }
+
+  vtkProperty *property = act->GetProperty();
+  m_program->SetUniformi("gvLighting", property->GetLighting() ? 1 : 0);
+  setColor(m_program, "gvAmbientColor", property->GetAmbient(),
+           property->GetAmbientColor());
+  setColor(m_program, "gvDiffuseColor", property->GetDiffuse(),
+           property->GetDiffuseColor());
+  setColor(m_program, "gvSpecularColor", property->GetSpecular(),
+           property->GetSpecularColor());
+  m_program->SetUniformf("gvSpecularPower",
+                         static_cast<float>(property->GetSpecularPower()));
+  m_program->SetUniformf("gvOpacity",
+                         static_cast<float>(property->GetOpacity()));
+
+  int count = m_planes ?
+    std::min(m_maxPlanes, static_cast<int>(m_planes->size() / 4)) : 0;
+  m_program->SetUniformi("gvNumberOfClipPlanes", count);
+  if (count > 0)
+    {
+    const float *planes = gvClippingMapper::dataPlanes(*m_planes, count, act,
+                                                       m_dataPlanes);
+    m_program->SetUniform4fv("gvClipPlanes", count,
+      reinterpret_cast<const float (*)[4]>(planes));
+    }
+}
+
+void gvCompactMapper::Render(vtkRenderer *ren, vtkActor *act)
+{
+  if (!m_mesh)
+    {
+    return;
+    }
+  const gvCompactMesh::Chunk &chunk = m_mesh->chunks()[m_chunk];
+  vtkShaderProgram *previous = m_program;
+  if (chunk.numberOfTriangles == 0 || !this->readyProgram(ren))
+    {
+    return;
+    }
+
+  m_vertexArray->Bind();
+  if (!m_uploaded || m_program != previous)
+    {
+    if (!m_uploaded)
+      {
+      this->uploadBuffers();
+      }
+    m_vertexArray->ShaderProgramChanged();
+    m_vertexArray->AddAttributeArray(m_program, m_positions,
+                                     "gvPosition", 0,
+                                     4 * sizeof(std::uint16_t),
+                                     VTK_UNSIGNED_SHORT, 4, true);
+    if (!chunk.normals.empty())
+      {
+      m_vertexArray->AddAttributeArray(m_program, m_normals,
+                                       "gvNormal", 0,
+                                       2 * sizeof(std::int16_t),
+                                       VTK_SHORT, 2, true);
+      }
+    }
+  this->setUniforms(ren, act);
+
+  int count = m_planes ?
+    std::min(m_maxPlanes, static_cast<int>(m_planes->size() / 4)) : 0;
+  int distances = std::min(count, m_hardwarePlanes);
+  for (int i = 0; i < distances; ++i)
+    {
+    glEnable(GL_CLIP_DISTANCE0 + i);
+    }
+
+  // Every point is used by the chunk's triangles, so the vertex buffers
+  // are the unique points:
+  vtkProperty *property = act->GetProperty();
+  int representation = property->GetRepresentation();
+  if (representation == VTK_POINTS)
+    {
+    glPointSize(property->GetPointSize());
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(chunk.numberOfPoints));
+    }
+  else if (representation == VTK_WIREFRAME)
+    {
+    this->drawEdges();
+    }
+  else
+    {
+    bool edges = property->GetEdgeVisibility() != 0;
+    if (edges)
+      {
+      // Push the faces back so the edges drawn over them win:
+      glEnable(GL_POLYGON_OFFSET_FILL);
+      glPolygonOffset(1.f, 1.f);
+      }
+    GLenum type = chunk.shortIndices.empty() ? GL_UNSIGNED_INT :
+      GL_UNSIGNED_SHORT;
+    m_indices->Bind();
+    glDrawRangeElements(GL_TRIANGLES, 0,
+                        static_cast<GLuint>(chunk.numberOfPoints - 1),
+                        static_cast<GLsizei>(3 * chunk.numberOfTriangles),
+                        type, nullptr);
+    m_indices->Release();
+    if (edges)
+      {
+      glDisable(GL_POLYGON_OFFSET_FILL);
+      m_program->SetUniformi("gvLighting", 0);
+      setColor(m_program, "gvDiffuseColor", 1., property->GetEdgeColor());
+      this->drawEdges();
+      }
+    }
+
+  for (int i = 0; i < distances; ++i)
+    {
+    glDisable(GL_CLIP_DISTANCE0 + i);
+    }
+  m_vertexArray->Release();
+}
@@ -0,0 +1,103 @@
+#ifndef GVCOMPACTMAPPER_H
+#define GVCOMPACTMAPPER_H
+
+#include <vtkMapper.h>
+#include <vtkNew.h>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class gvCompactMesh;
+class gvSharedBuffers;
+class vtkMatrix3x3;
+class vtkMatrix4x4;
+class vtkOpenGLBufferObject;
+class vtkOpenGLVertexArrayObject;
+class vtkShaderProgram;
+
+// Draws one chunk of a gvCompactMesh on the OpenGL2 backend. Quantized
+// positions and octahedral normals are uploaded as they are and decoded in
+// the vertex shader, so a point takes 12 bytes of GPU memory instead of 24
+// and an index 2 instead of 4 in most chunks. Shading follows the
+// renderer's lights and the actor's property like VTK's own surface
+// shading, two-sided. The representations gvRenderSettings offers draw
+// each primitive once: points straight from the vertex buffers, and the
+// wireframe and the edges over the surface from the chunk's unique edges,
+// whose index buffer is uploaded the first time either is shown and kept
+// for switching back. Clipping planes work as in gvClippingMapper. Scalar
+// colors, textures and selection aren't supported.
+//
+// The buffers come from the gvSharedBuffers of the context's share group,
+// so the mappers drawing a chunk in every context of a group upload it
+// once; each keeps only its vertex array object and program.
+class gvCompactMapper : public vtkMapper
+{
+public:
+  static gvCompactMapper* New();
+  vtkTypeMacro(gvCompactMapper, vtkMapper)
+
+  // The chunk to draw; mesh is shared by the mappers of all its chunks.
+  void setChunk(const std::shared_ptr<const gvCompactMesh> &mesh,
+                std::size_t chunk);
+
+  // The share group to take buffers from; by default the mapper looks up
+  // the group of the context it first renders in.
+  void setSharedBuffers(const std::shared_ptr<gvSharedBuffers> &buffers);
+
+  // As in gvClippingMapper: the size of the plane array compiled into the
+  // shader, and packed (a, b, c, d) planes read at every draw, or null.
+  void setMaximumNumberOfClipPlanes(int count);
+  void setClipPlanes(const std::vector<float> *planes);
+
+  // Bytes of the chunk's buffers on the GPU, with the edge indices once
+  // this mapper has drawn them, whichever context uploaded them.
+  std::size_t bufferBytes() const;
+
+  void Render(vtkRenderer *ren, vtkActor *act) override;
+  void ReleaseGraphicsResources(vtkWindow *window) override;
+  double* GetBounds() override;
+  void GetBounds(double bounds[6]) override;
+
+protected:
+  gvCompactMapper();
+  ~gvCompactMapper() override;
+
+private:
+  gvCompactMapper(const gvCompactMapper&) = delete;
+  void operator=(const gvCompactMapper&) = delete;
+
+  // Compile the program for the current context, or fetch it from the
+  // window's shader cache, and bind it.
+  bool readyProgram(vtkRenderer *ren);
+  // Take the chunk's buffers from the share group, uploading those no
+  // other context has.
+  void uploadBuffers();
+  void drawEdges();
+  void setUniforms(vtkRenderer *ren, vtkActor *act);
+
+  std::shared_ptr<const gvCompactMesh> m_mesh;
+  std::size_t m_chunk;
+  double m_bounds[6];
+
+  const std::vector<float> *m_planes;
+  std::vector<float> m_dataPlanes;
+  int m_maxPlanes;
+  int m_hardwarePlanes; // -1 until the context is queried
+
+  vtkShaderProgram *m_program; // Owned by the window's shader cache
+  vtkNew<vtkOpenGLVertexArrayObject> m_vertexArray;
+  std::shared_ptr<gvSharedBuffers> m_buffers;
+  // Owned by m_buffers as long as m_mesh lives:
+  vtkOpenGLBufferObject *m_positions;
+  vtkOpenGLBufferObject *m_normals;
+  vtkOpenGLBufferObject *m_indices;
+  vtkOpenGLBufferObject *m_edgeIndices;
+  bool m_uploaded;
+  bool m_edgesUploaded;
+  vtkNew<vtkMatrix4x4> m_modelToClip;
+  vtkNew<vtkMatrix4x4> m_modelToView;
+  vtkNew<vtkMatrix3x3> m_normalMatrix;
+};
+
+#endif // GVCOMPACTMAPPER_H
@@ -0,0 +1,229 @@
+#include "gvCompactMesh.h"
+
+#include "gvMeshChunks.h"
+#include "gvMeshUtilities.h"
+#include "gvParallel.h"
+
+#include <vtkDataArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+const double PositionSteps = 65535.;
+const double NormalSteps = 32767.;
+
+double signNotZero(double value)
+{
+  return value < 0. ? -1. : 1.;
+}
+
+std::int16_t toShort(double value)
+{
+  value = std::min(std::max(value, -1.), 1.);
+  return static_cast<std::int16_t>(std::floor(value * NormalSteps + .5));
+}
+
+// GL maps the most negative short to -1 as well:
+double fromShort(std::int16_t value)
+{
+  return std::max(value / NormalSteps, -1.);
+}
+
+} // end anon namespace
+
+gvCompactMesh::gvCompactMesh()
+  : m_positionError(0.),
+    m_normalError(0.)
+{
+}
+
+void gvCompactMesh::encodeNormal(const double normal[3],
+                                 std::int16_t encoded[2])
+{
+  double length = std::fabs(normal[0]) + std::fabs(normal[1]) +
+    std::fabs(normal[2]);
+  if (length <= 0.)
+    {
+    encoded[0] = encoded[1] = 0;
+    return;
+    }
+  double u = normal[0] / length;
+  double v = normal[1] / length;
+  if (normal[2] < 0.)
+    {
+    double folded = (1. - std::fabs(v)) * signNotZero(u);
+    v = (1. - std::fabs(u)) * signNotZero(v);
+    u = folded;
+    }
+  encoded[0] = toShort(u);
+  encoded[1] = toShort(v);
+}
+
+void gvCompactMesh::decodeNormal(const std::int16_t encoded[2],
+                                 double normal[3])
+{
+  normal[0] = fromShort(encoded[0]);
+  normal[1] = fromShort(encoded[1]);
+  normal[2] = 1. - std::fabs(normal[0]) - std::fabs(normal[1]);
+  if (normal[2] < 0.)
+    {
+    double folded = (1. - std::fabs(normal[1])) * signNotZero(normal[0]);
+    normal[1] = (1. - std::fabs(normal[0])) * signNotZero(normal[1]);
+    normal[0] = folded;
+    }
+  double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] +
+                            normal[2] * normal[2]);
+  for (int i = 0; i < 3; ++i)
+    {
+    normal[i] /= length;
+    }
+}
+
+std::size_t gvCompactMesh::bytes(const Chunk &chunk)
+{
+  return sizeof(std::uint16_t) * chunk.positions.size() +
+    sizeof(std::int16_t) * chunk.normals.size() +
+    sizeof(std::uint16_t) * chunk.shortIndices.size() +
+    sizeof(std::uint32_t) * chunk.indices.size();
+}
+
+std::size_t gvCompactMesh::edgeBytes(const Chunk &chunk)
+{
+  return sizeof(std::uint16_t) * chunk.shortEdges.size() +
+    sizeof(std::uint32_t) * chunk.edges.size();
+}
+
+std::size_t gvCompactMesh::floatBytes(const Chunk &chunk)
+{
+  std::size_t perPoint = 3 * sizeof(float);
+  if (!chunk.normals.empty())
+    {
+    perPoint += 3 * sizeof(float);
+    }
+  return perPoint * chunk.numberOfPoints +
+    3 * sizeof(std::uint32_t) * chunk.numberOfTriangles;
+}
+
+std::shared_ptr<gvCompactMesh> gvCompactMesh::build(
+    const gvMeshChunks &chunks, unsigned int numberOfThreads)
+{
+  const std::vector<gvMeshChunks::Chunk> &source = chunks.chunks();
+  for (std::size_t c = 0; c < source.size(); ++c)
+    {
+    vtkPolyData *data = source[c].data;
+    if (!data || !data->GetPoints())
+      {
+      return nullptr;
+      }
+    if (data->GetPointData()->GetScalars() ||
+        data->GetPointData()->GetTCoords())
+      {
+      std::cout << "Keeping float vertex storage for a mesh with colors or "
+                   "texture coordinates" << std::endl;
+      return nullptr;
+      }
+    }
+
+  std::shared_ptr<gvCompactMesh> result(new gvCompactMesh);
+  result->m_chunks.resize(source.size());
+  std::vector<double> positionErrors(source.size(), 0.);
+  std::vector<double> normalErrors(source.size(), 0.);
+  gvParallel::forEach(source.size(), [&](std::size_t c)
+    {
+    vtkPolyData *data = source[c].data;
+    Chunk &chunk = result->m_chunks[c];
+    vtkPoints *points = data->GetPoints();
+    vtkIdType numberOfPoints = points->GetNumberOfPoints();
+    chunk.numberOfPoints = static_cast<std::size_t>(numberOfPoints);
+
+    // The grid spans the points' own bounds, which can be tighter than the
+    // chunk's:
+    double bounds[6];
+    points->GetBounds(bounds);
+    for (int i = 0; i < 3; ++i)
+      {
+      chunk.origin[i] = bounds[2 * i];
+      chunk.extent[i] = bounds[2 * i + 1] - bounds[2 * i];
+      }
+    chunk.positions.resize(4 * chunk.numberOfPoints, 0);
+    for (vtkIdType p = 0; p < numberOfPoints; ++p)
+      {
+      double x[3];
+      points->GetPoint(p, x);
+      for (int i = 0; i < 3; ++i)
+        {
+        double step = chunk.extent[i] / PositionSteps;
+        double q = step > 0. ?
+          std::floor((x[i] - chunk.origin[i]) / step + .5) : 0.;
+        q = std::min(std::max(q, 0.), PositionSteps);
+        chunk.positions[4 * p + i] = static_cast<std::uint16_t>(q);
+        positionErrors[c] = std::max(positionErrors[c],
+          std::fabs(chunk.origin[i] + q * step - x[i]));
+        }
+      }
+
+    if (vtkDataArray *normals = data->GetPointData()->GetNormals())
+      {
+      chunk.normals.resize(2 * chunk.numberOfPoints);
+      for (vtkIdType p = 0; p < numberOfPoints; ++p)
+        {
+        double n[3];
+        normals->GetTuple(p, n);
+        double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        encodeNormal(n, &chunk.normals[2 * p]);
+        if (length > 0.)
+          {
+          double decoded[3];
+          decodeNormal(&chunk.normals[2 * p], decoded);
+          double cosine = (n[0] * decoded[0] + n[1] * decoded[1] +
+                           n[2] * decoded[2]) / length;
+          normalErrors[c] = std::max(normalErrors[c],
+            std::acos(std::min(std::max(cosine, -1.), 1.)));
+          }
+        }
+      }
+
+    std::vector<vtkIdType> ids;
+    gvMeshUtilities::extractTriangles(data, ids);
+    chunk.numberOfTriangles = ids.size() / 3;
+    std::vector<vtkIdType> edges;
+    gvMeshUtilities::uniqueEdges(ids.data(), chunk.numberOfTriangles, edges);
+    chunk.numberOfEdges = edges.size() / 2;
+    if (chunk.numberOfPoints <= 65536)
+      {
+      chunk.shortIndices.assign(ids.begin(), ids.end());
+      chunk.shortEdges.assign(edges.begin(), edges.end());
+      }
+    else
+      {
+      chunk.indices.assign(ids.begin(), ids.end());
+      chunk.edges.assign(edges.begin(), edges.end());
+      }
+    }, numberOfThreads);
+
+  std::size_t compact = 0;
+  std::size_t uncompressed = 0;
+  for (std::size_t c = 0; c < source.size(); ++c)
+    {
+    compact += bytes(result->m_chunks[c]);
+    uncompressed += floatBytes(result->m_chunks[c]);
+    result->m_positionError =
+      std::max(result->m_positionError, positionErrors[c]);
+    result->m_normalError = std::max(result->m_normalError, normalErrors[c]);
+    }
+  result->m_normalError *= 180. / 3.14159265358979323846;
+
+  const double megabyte = 1024. * 1024.;
+  std::cout << "Compact vertex storage: " << compact / megabyte
+            << " MB instead of " << uncompressed / megabyte
+            << " MB of float buffers; positions within "
+            << result->m_positionError << ", normals within "
+            << result->m_normalError << " degrees" << std::endl;
+  return result;
+}
@@ -0,0 +1,81 @@
+#ifndef GVCOMPACTMESH_H
+#define GVCOMPACTMESH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class gvMeshChunks;
+
+// The chunks of a mesh in the layout gvCompactMapper draws, instead of
+// float positions and normals and vtkIdType cells:
+//
+//  - positions are 16-bit unsigned integers spanning each chunk's bounds,
+//    padded to four components for alignment: 8 bytes instead of 12;
+//  - normals are the two 16-bit components of an octahedral encoding
+//    (Cigolle et al., "A Survey of Efficient Representations for
+//    Independent Unit Vectors", JCGT 2014): 4 bytes instead of 12;
+//  - triangle indices are 16-bit in chunks of at most 65536 points, else
+//    32-bit, and so are the indices of the chunk's unique edges, which the
+//    wireframe and the edges over the surface are drawn from.
+//
+// Quantizing moves a point by at most half a step, 1/131070 of its chunk's
+// extent along each axis, so the error follows the chunk size rather than
+// the model's. Normals are off by at most about 0.004 degrees. build()
+// prints both errors as measured. Point colors and texture coordinates
+// aren't kept.
+class gvCompactMesh
+{
+public:
+  struct Chunk
+  {
+    double origin[3]; // Lower corner of the quantization grid
+    double extent[3]; // Size of the grid; the largest value is 65535
+    std::size_t numberOfPoints;
+    std::size_t numberOfTriangles;
+    std::size_t numberOfEdges;
+    std::vector<std::uint16_t> positions; // x, y, z, 0 per point
+    std::vector<std::int16_t> normals;    // Empty if the mesh has none
+    std::vector<std::uint16_t> shortIndices;
+    std::vector<std::uint32_t> indices;   // Only if shortIndices is empty
+    std::vector<std::uint16_t> shortEdges; // Pairs of indices
+    std::vector<std::uint32_t> edges;     // Only if shortEdges is empty
+  };
+
+  // Quantize the poly data of every chunk on numberOfThreads workers (0
+  // uses all cores). Returns null if a chunk has no data or has point
+  // colors or texture coordinates. Prints the memory saved and the errors.
+  static std::shared_ptr<gvCompactMesh> build(const gvMeshChunks &chunks,
+                                              unsigned int numberOfThreads = 0);
+
+  const std::vector<Chunk>& chunks() const { return m_chunks; }
+
+  // Bytes of a chunk's buffers in this layout, and as float positions and
+  // normals with 32-bit indices like VTK's mappers upload them.
+  static std::size_t bytes(const Chunk &chunk);
+  static std::size_t floatBytes(const Chunk &chunk);
+
+  // Bytes of a chunk's edge indices, uploaded once the edges are drawn.
+  static std::size_t edgeBytes(const Chunk &chunk);
+
+  // Largest distance along an axis between a point and its quantized
+  // position, in model units, and largest angle between a normal and its
+  // encoding, in degrees.
+  double positionError() const { return m_positionError; }
+  double normalError() const { return m_normalError; }
+
+  // Octahedral encoding of a unit vector as GL's normalized shorts, and
+  // its decoding as the vertex shader does it.
+  static void encodeNormal(const double normal[3], std::int16_t encoded[2]);
+  static void decodeNormal(const std::int16_t encoded[2], double normal[3]);
+
+private:
+  gvCompactMesh();
+
+  std::vector<Chunk> m_chunks;
+  double m_positionError;
+  double m_normalError;
+};
+
+#endif // GVCOMPACTMESH_H
@@ -1,14 +1,193 @@
 #include "gvContextState.h"
 
+#include "gvBrickStore.h"
+#include "gvBrickStreamer.h"
+#include "gvCompactMesh.h"
+#include "gvFrustum.h"
+#include "gvLODChain.h"
+#include "gvMeshChunks.h"
+#include "gvRenderSettings.h"
+#include "gvScene.h"
+
+#ifdef GV_OPENGL2
+#include "gvClippingMapper.h"
+#include "gvCompactMapper.h"
+#include "gvSharedBuffers.h"
+#endif
+
 #include <GL/glew.h>
 
 #include <vtkActor.h>
 #include <vtkExternalLight.h>
 #include <vtkExternalOpenGLRenderer.h>
+#include <vtkDataArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkGlyph3DMapper.h>
 #include <vtkLight.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPlane.h>
+#include <vtkPlaneCollection.h>
+#include <vtkPoints.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkProperty.h>
+#include <vtkRenderWindow.h>
+#include <vtkVersion.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+
+namespace {
+
+// Serializes uploads of shared data on VTK before 9; see uploadLock().
+std::mutex uploadMutex;
+
+// Bytes the mappers upload for data: float positions and normals, texture
+// coordinates, 8-bit colors and 32-bit triangle indices.
+std::size_t bufferBytes(vtkPolyData *data)
+{
+  if (!data)
+    {
+    return 0;
+    }
+  std::size_t perPoint = 3 * sizeof(float);
+  vtkPointData *pointData = data->GetPointData();
+  if (pointData->GetNormals())
+    {
+    perPoint += 3 * sizeof(float);
+    }
+  if (vtkDataArray *tcoords = pointData->GetTCoords())
+    {
+    perPoint += tcoords->GetNumberOfComponents() * sizeof(float);
+    }
+  if (pointData->GetScalars())
+    {
+    perPoint += 4;
+    }
+  return perPoint * static_cast<std::size_t>(data->GetNumberOfPoints()) +
+    3 * sizeof(std::uint32_t) *
+    static_cast<std::size_t>(data->GetNumberOfPolys());
+}
 
-gvContextState::gvContextState()
+std::size_t mapperBytes(vtkMapper *mapper)
 {
+#ifdef GV_OPENGL2
+  if (gvCompactMapper *compact = gvCompactMapper::SafeDownCast(mapper))
+    {
+    return compact->bufferBytes();
+    }
+#endif
+  return mapper ?
+    bufferBytes(static_cast<vtkPolyDataMapper*>(mapper)->GetInput()) : 0;
+}
+
+// Bytes of the indices a chunk's edges and points add once they have been
+// shown. VTK 8.1 and later upload the point arrays their mappers share with
+// the surface's only once.
+std::size_t representationBytes(const gvMeshChunks::Chunk &chunk,
+                                bool edges, bool vertices)
+{
+  std::size_t bytes = 0;
+  if (edges)
+    {
+    bytes += 2 * sizeof(std::uint32_t) * chunk.numberOfEdges;
+    }
+  if (vertices && chunk.vertices)
+    {
+    bytes += sizeof(std::uint32_t) *
+      static_cast<std::size_t>(chunk.vertices->GetNumberOfPoints());
+    }
+  return bytes;
+}
+
+#if VTK_MAJOR_VERSION >= 9
+// Split a row-major transform into the position, rotation quaternion
+// (w, x, y, z) and per-axis scale the glyph mapper composes. Shear is lost.
+void decompose(const std::array<double, 16> &m, double position[3],
+               double quaternion[4], double scale[3])
+{
+  double rotation[3][3];
+  for (int j = 0; j < 3; ++j)
+    {
+    position[j] = m[4 * j + 3];
+    scale[j] = std::sqrt(m[j] * m[j] + m[4 + j] * m[4 + j] +
+                         m[8 + j] * m[8 + j]);
+    for (int i = 0; i < 3; ++i)
+      {
+      rotation[i][j] = scale[j] > 0. ? m[4 * i + j] / scale[j] :
+        (i == j ? 1. : 0.);
+      }
+    }
+  // A mirror goes into the scale so the rotation stays proper:
+  if (vtkMath::Determinant3x3(rotation) < 0.)
+    {
+    scale[0] = -scale[0];
+    for (int i = 0; i < 3; ++i)
+      {
+      rotation[i][0] = -rotation[i][0];
+      }
+    }
+  vtkMath::Matrix3x3ToQuaternion(rotation, quaternion);
+}
+
+// One point per instance with the orientation and scale arrays the glyph
+// mapper reads.
+vtkSmartPointer<vtkPolyData> instancePoints(
+    const std::vector<std::array<double, 16> > &instances)
+{
+  vtkIdType count = static_cast<vtkIdType>(instances.size());
+  vtkNew<vtkPoints> points;
+  points->SetDataTypeToDouble();
+  points->SetNumberOfPoints(count);
+  vtkNew<vtkDoubleArray> orientations;
+  orientations->SetName("Orientation");
+  orientations->SetNumberOfComponents(4);
+  orientations->SetNumberOfTuples(count);
+  vtkNew<vtkDoubleArray> scales;
+  scales->SetName("Scale");
+  scales->SetNumberOfComponents(3);
+  scales->SetNumberOfTuples(count);
+  for (vtkIdType i = 0; i < count; ++i)
+    {
+    double position[3];
+    double quaternion[4];
+    double scale[3];
+    decompose(instances[i], position, quaternion, scale);
+    points->SetPoint(i, position);
+    orientations->SetTypedTuple(i, quaternion);
+    scales->SetTypedTuple(i, scale);
+    }
+
+  vtkSmartPointer<vtkPolyData> data = vtkSmartPointer<vtkPolyData>::New();
+  data->SetPoints(points.Get());
+  data->GetPointData()->AddArray(orientations.Get());
+  data->GetPointData()->AddArray(scales.Get());
+  return data;
+}
+#endif
+
+} // end anon namespace
+
+gvContextState::gvContextState(int maxClipPlanes)
+  : m_representation(VTK_SURFACE),
+    m_edgesShown(false),
+    m_verticesShown(false),
+    m_transparency(&this->renderer()),
+    m_geometryVersion(0),
+    m_renderSettingsVersion(0),
+    m_uploadPending(true),
+    m_maxClipPlanes(maxClipPlanes),
+    m_brickVersion(0),
+    m_reportTime(-1.),
+    m_memoryReportTime(-1.)
+{
+  m_mapper = this->newMapper();
+  this->setMapperClipping(m_mapper.Get(), true);
+  m_actor->SetMapper(m_mapper.Get());
   this->renderer().AddActor(m_actor.Get());
 
   // This external light models the VRUI-default headlight at GL_LIGHT0:
@@ -16,4 +195,746 @@ gvContextState::gvContextState()
   m_headlight->SetIntensity(1.);
   m_headlight->SetDiffuseColor(1., 1., 1.);
   this->renderer().AddExternalLight(m_headlight.Get());
+
+  // Chunk edges are drawn unlit in the edge color, like VTK's own, over
+  // surfaces pushed back by the polygon offset GeometryViewer::initialize()
+  // turns on:
+  m_edgeProperty->LightingOff();
+  m_edgeProperty->SetColor(m_actor->GetProperty()->GetEdgeColor());
+
+#ifdef GV_OPENGL2
+  m_sharedBuffers = gvSharedBuffers::join();
+#endif
+}
+
+gvContextState::~gvContextState()
+{
+#ifdef GV_OPENGL2
+  m_sharedBuffers->leave();
+#endif
+}
+
+bool gvContextState::updateGeometry(
+    const std::shared_ptr<const gvScene> &scene, unsigned long version)
+{
+  if (version == m_geometryVersion)
+    {
+    return false;
+    }
+  m_geometryVersion = version;
+  m_uploadPending = true;
+
+  for (std::size_t i = 0; i < m_models.size(); ++i)
+    {
+    ModelActors &model = m_models[i];
+    for (std::size_t j = 0; j < model.chunkMappers.size(); ++j)
+      {
+      ChunkMappers &mappers = model.chunkMappers[j];
+      this->removeActor(mappers.edgeActor);
+      mappers.surface->ReleaseGraphicsResources(
+        this->renderer().GetRenderWindow());
+      mappers.edges->ReleaseGraphicsResources(
+        this->renderer().GetRenderWindow());
+      mappers.vertices->ReleaseGraphicsResources(
+        this->renderer().GetRenderWindow());
+      }
+    for (std::size_t j = 0; j < model.chunkActors.size(); ++j)
+      {
+      this->removeActor(model.chunkActors[j]);
+      }
+    for (std::size_t j = 0; j < model.instanceActors.size(); ++j)
+      {
+      this->removeActor(model.instanceActors[j]);
+      }
+    if (model.actor != m_actor.Get())
+      {
+      this->removeActor(model.actor);
+      }
+    }
+  m_models.clear();
+  m_mapper->SetInputData(nullptr);
+  m_actor->SetVisibility(false);
+  m_edgesShown = m_representation == VTK_WIREFRAME || m_representation == 3;
+  m_verticesShown = m_representation == VTK_POINTS;
+
+  m_scene = scene;
+  const std::vector<gvScene::Model> &models = scene->models();
+  m_models.resize(models.size());
+  for (std::size_t i = 0; i < models.size(); ++i)
+    {
+    const gvScene::Model &model = models[i];
+    ModelActors &actors = m_models[i];
+    if (!model.instances.empty())
+      {
+      this->addInstances(i);
+      continue;
+      }
+    if (i == 0)
+      {
+      m_mapper->SetInputData(model.geometry);
+      actors.actor = m_actor.Get();
+      actors.mapper = m_mapper;
+      }
+    else
+      {
+      actors.actor = this->addActor(model.geometry);
+      actors.mapper =
+        static_cast<vtkPolyDataMapper*>(actors.actor->GetMapper());
+      this->setMapperClipping(actors.mapper.Get(), true);
+      }
+    actors.actor->SetUserMatrix(model.transform);
+
+    if (model.chunks)
+      {
+      const std::vector<gvMeshChunks::Chunk> &chunks = model.chunks->chunks();
+      for (std::size_t j = 0; j < chunks.size(); ++j)
+        {
+        this->addChunkActors(i, j);
+        }
+      this->setChunkRepresentation(i);
+      }
+    }
+
+  // Levels of the previous geometry are stale:
+  for (std::size_t i = 0; i < m_levelMappers.size(); ++i)
+    {
+    if (m_levelMappers[i])
+      {
+      m_levelMappers[i]->ReleaseGraphicsResources(
+        this->renderer().GetRenderWindow());
+      }
+    }
+  m_levelMappers.clear();
+  m_actor->SetMapper(m_mapper.Get());
+  return true;
+}
+
+void gvContextState::addInstances(std::size_t i)
+{
+  const gvScene::Model &model = m_scene->models()[i];
+  ModelActors &actors = m_models[i];
+#if VTK_MAJOR_VERSION >= 9
+  // One copy of the geometry, drawn for all instances at once where the
+  // OpenGL2 backend supports instanced draws:
+  vtkNew<vtkGlyph3DMapper> mapper;
+  mapper->SetInputData(instancePoints(model.instances));
+  mapper->SetSourceData(model.geometry);
+  mapper->SetOrientationModeToQuaternion();
+  mapper->SetOrientationArray("Orientation");
+  mapper->OrientOn();
+  mapper->SetScaleModeToScaleByVectorComponents();
+  mapper->SetScaleArray("Scale");
+  mapper->ScalingOn();
+  mapper->SetClippingPlanes(m_clipPlanes.Get());
+  actors.actor = vtkSmartPointer<vtkActor>::New();
+  actors.actor->SetMapper(mapper.Get());
+  actors.actor->SetProperty(m_actor->GetProperty());
+  this->renderer().AddActor(actors.actor.Get());
+#else
+  // One copy of the geometry, but a draw per instance:
+  actors.mapper = this->newMapper();
+  actors.mapper->SetInputData(model.geometry);
+  this->setMapperClipping(actors.mapper.Get(), true);
+  for (std::size_t j = 0; j < model.instances.size(); ++j)
+    {
+    vtkNew<vtkMatrix4x4> transform;
+    transform->DeepCopy(model.instances[j].data());
+    vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+    actor->SetMapper(actors.mapper.Get());
+    actor->SetProperty(m_actor->GetProperty());
+    actor->SetUserMatrix(transform.Get());
+    this->renderer().AddActor(actor.Get());
+    actors.instanceActors.push_back(actor);
+    }
+#endif
+}
+
+void gvContextState::applyRenderSettings(const gvRenderSettings &settings,
+                                         unsigned long version)
+{
+  if (version == m_renderSettingsVersion)
+    {
+    return;
+    }
+
+  m_headlight->SetIntensity(settings.intensity);
+  m_headlight->SetAmbientColor(settings.ambient[0], settings.ambient[1],
+                               settings.ambient[2]);
+  m_headlight->SetDiffuseColor(settings.diffuse[0], settings.diffuse[1],
+                               settings.diffuse[2]);
+  m_headlight->SetSpecularColor(settings.specular[0], settings.specular[1],
+                                settings.specular[2]);
+
+  // Compact chunk and brick actors share this property:
+  vtkProperty *property = m_actor->GetProperty();
+  property->SetOpacity(settings.opacity);
+  m_chunkProperty->SetOpacity(settings.opacity);
+  m_edgeProperty->SetOpacity(settings.opacity);
+  if (settings.representation < 3)
+    {
+    property->SetRepresentation(settings.representation);
+    property->EdgeVisibilityOff();
+    }
+  else
+    {
+    property->SetRepresentationToSurface();
+    property->EdgeVisibilityOn();
+    }
+
+  if (settings.representation != m_representation)
+    {
+    m_representation = settings.representation;
+    m_edgesShown = m_edgesShown || m_representation == VTK_WIREFRAME ||
+      m_representation == 3;
+    m_verticesShown = m_verticesShown || m_representation == VTK_POINTS;
+    // Chunk mappers shown for the first time upload shared data:
+    m_uploadPending = true;
+    for (std::size_t i = 0; i < m_models.size(); ++i)
+      {
+      this->setChunkRepresentation(i);
+      }
+    }
+
+  m_transparency.apply(settings);
+
+  m_renderSettingsVersion = version;
+}
+
+void gvContextState::updateTransparency()
+{
+  m_transparency.update();
+}
+
+std::unique_lock<std::mutex> gvContextState::uploadLock()
+{
+  std::unique_lock<std::mutex> lock;
+#if VTK_MAJOR_VERSION < 9
+  if (m_uploadPending)
+    {
+    lock = std::unique_lock<std::mutex>(uploadMutex);
+    }
+#endif
+  m_uploadPending = false;
+  return lock;
+}
+
+void gvContextState::setLevel(const gvLODChain *levels, int level)
+{
+  vtkMapper *mapper = m_mapper.Get();
+  if (levels && level > 0)
+    {
+    m_levelMappers.resize(gvLODChain::NumberOfLevels);
+    vtkSmartPointer<vtkPolyDataMapper> &levelMapper = m_levelMappers[level];
+    if (!levelMapper)
+      {
+      levelMapper = this->newMapper();
+      this->setMapperClipping(levelMapper.Get(), true);
+      }
+    if (levelMapper->GetInput() != levels->level(level))
+      {
+      levelMapper->SetInputData(levels->level(level));
+      m_uploadPending = true;
+      }
+    mapper = levelMapper.Get();
+    }
+
+  if (m_actor->GetMapper() != mapper)
+    {
+    m_actor->SetMapper(mapper);
+    }
+}
+
+int gvContextState::maxClipPlanes() const
+{
+#ifdef GV_OPENGL2
+  return m_maxClipPlanes;
+#else
+  // The legacy mapper applies at most the six planes OpenGL guarantees:
+  return std::min(m_maxClipPlanes, 6);
+#endif
+}
+
+void gvContextState::setClipPlanes(const ClipPlanes &clipPlanes)
+{
+  std::size_t count = std::min(clipPlanes.size(),
+                               static_cast<std::size_t>(this->maxClipPlanes()));
+  if (count == m_clipPlaneEquations.size() &&
+      std::equal(m_clipPlaneEquations.begin(), m_clipPlaneEquations.end(),
+                 clipPlanes.begin()))
+    {
+    return;
+    }
+  m_clipPlaneEquations.assign(clipPlanes.begin(), clipPlanes.begin() + count);
+
+#ifdef GV_OPENGL2
+  // Packed for a single uniform upload per draw:
+  m_clipPlaneUniforms.resize(4 * count);
+  for (std::size_t i = 0; i < count; ++i)
+    {
+    for (int j = 0; j < 4; ++j)
+      {
+      m_clipPlaneUniforms[4 * i + j] =
+        static_cast<float>(m_clipPlaneEquations[i][j]);
+      }
+    }
+#endif
+
+  m_clipPlanes->RemoveAllItems();
+  for (std::size_t i = 0; i < count && m_clipPlanes->GetNumberOfItems() < 6;
+       ++i)
+    {
+    const std::array<double, 4> &equation = m_clipPlaneEquations[i];
+    double lengthSquared = equation[0] * equation[0] +
+      equation[1] * equation[1] + equation[2] * equation[2];
+    if (lengthSquared <= 0.)
+      {
+      continue;
+      }
+    vtkNew<vtkPlane> plane;
+    plane->SetNormal(equation[0], equation[1], equation[2]);
+    double scale = -equation[3] / lengthSquared;
+    plane->SetOrigin(scale * equation[0], scale * equation[1],
+                     scale * equation[2]);
+    m_clipPlanes->AddItem(plane.Get());
+    }
+}
+
+void gvContextState::updateBricks(const gvBrickStreamer &streamer,
+                                  const gvFrustum &frustum)
+{
+  const std::vector<gvBrickStore::Brick> &bricks = streamer.store().bricks();
+  if (m_brickActors.size() != bricks.size())
+    {
+    m_brickActors.resize(bricks.size());
+    m_brickVersion = 0;
+    }
+
+  if (streamer.residentVersion() != m_brickVersion)
+    {
+    for (std::size_t i = 0; i < bricks.size(); ++i)
+      {
+      vtkPolyData *data = streamer.brick(i);
+      vtkSmartPointer<vtkActor> &actor = m_brickActors[i];
+      if (data && !actor)
+        {
+        actor = this->addActor(data);
+        m_uploadPending = true;
+        }
+      else if (data && actor)
+        {
+        // Evicted and reloaded since this context last looked:
+        vtkPolyDataMapper *mapper =
+          static_cast<vtkPolyDataMapper*>(actor->GetMapper());
+        if (mapper->GetInput() != data)
+          {
+          mapper->SetInputData(data);
+          m_uploadPending = true;
+          }
+        }
+      else if (!data && actor)
+        {
+        this->removeActor(actor);
+        }
+      }
+    m_brickVersion = streamer.residentVersion();
+    }
+
+  for (std::size_t i = 0; i < bricks.size(); ++i)
+    {
+    if (m_brickActors[i])
+      {
+      gvFrustum::ClipState clip =
+        gvFrustum::classifyClipping(m_clipPlaneEquations, bricks[i].bounds);
+      bool visible = clip != gvFrustum::Clipped &&
+        frustum.intersects(bricks[i].bounds);
+      m_brickActors[i]->SetVisibility(visible);
+      if (visible)
+        {
+        this->setMapperClipping(
+          static_cast<vtkPolyDataMapper*>(m_brickActors[i]->GetMapper()),
+          clip == gvFrustum::Straddling);
+        }
+      }
+    }
+}
+
+void gvContextState::cullScene(const gvFrustum &frustum,
+                               const std::vector<bool> &modelVisibility,
+                               std::size_t &submitted, std::size_t &culled)
+{
+  submitted = 0;
+  culled = 0;
+  if (!m_scene)
+    {
+    return;
+    }
+
+  // Models under a node that is out of view or clipped away are skipped
+  // without looking at them:
+  const std::vector<gvScene::Node> &nodes = m_scene->nodes();
+  m_modelsInView.assign(m_models.size(), false);
+  m_nodeStack.clear();
+  if (!nodes.empty())
+    {
+    m_nodeStack.push_back(0);
+    }
+  while (!m_nodeStack.empty())
+    {
+    const gvScene::Node &node = nodes[m_nodeStack.back()];
+    m_nodeStack.pop_back();
+    if (!frustum.intersects(node.bounds) ||
+        gvFrustum::classifyClipping(m_clipPlaneEquations, node.bounds) ==
+          gvFrustum::Clipped)
+      {
+      continue;
+      }
+    if (node.model >= 0)
+      {
+      m_modelsInView[node.model] = true;
+      }
+    else
+      {
+      m_nodeStack.push_back(node.children[0]);
+      m_nodeStack.push_back(node.children[1]);
+      }
+    }
+
+  // Models that failed to load left no model behind, so visibility goes by
+  // the entry each model came from:
+  const std::vector<gvScene::Model> &models = m_scene->models();
+  bool useVisibility = true;
+  for (std::size_t i = 0; i < models.size(); ++i)
+    {
+    useVisibility = useVisibility && models[i].entry < modelVisibility.size();
+    }
+  for (std::size_t i = 0; i < m_models.size(); ++i)
+    {
+    bool shown = m_modelsInView[i] &&
+      (!useVisibility || modelVisibility[models[i].entry]);
+    this->cullModel(i, shown, frustum, submitted, culled);
+    }
+}
+
+void gvContextState::cullModel(std::size_t i, bool shown,
+                               const gvFrustum &frustum,
+                               std::size_t &submitted, std::size_t &culled)
+{
+  ModelActors &actors = m_models[i];
+  const gvScene::Model &model = m_scene->models()[i];
+
+  if (!model.instances.empty())
+    {
+    if (actors.actor)
+      {
+      actors.actor->SetVisibility(shown);
+      }
+    for (std::size_t j = 0; j < actors.instanceActors.size(); ++j)
+      {
+      actors.instanceActors[j]->SetVisibility(shown);
+      }
+    (shown ? submitted : culled) += model.instances.size() *
+      static_cast<std::size_t>(model.geometry->GetNumberOfPolys());
+    return;
+    }
+
+  // Coarser levels are small enough to draw whole:
+  bool useChunks = shown && !actors.chunkActors.empty() &&
+    actors.actor->GetMapper() == actors.mapper.Get();
+
+  actors.actor->SetVisibility(shown && !useChunks);
+  if (!useChunks)
+    {
+    vtkPolyData *input =
+      static_cast<vtkPolyDataMapper*>(actors.actor->GetMapper())->GetInput();
+    (shown ? submitted : culled) += input ?
+      static_cast<std::size_t>(input->GetNumberOfPolys()) : 0;
+    for (std::size_t j = 0; j < actors.chunkActors.size(); ++j)
+      {
+      actors.chunkActors[j]->SetVisibility(false);
+      }
+    for (std::size_t j = 0; j < actors.chunkMappers.size(); ++j)
+      {
+      actors.chunkMappers[j].edgeActor->SetVisibility(false);
+      }
+    return;
+    }
+
+  for (std::size_t j = 0; j < actors.chunkActors.size(); ++j)
+    {
+    const double *bounds = model.chunkBounds[j].data();
+    gvFrustum::ClipState clip =
+      gvFrustum::classifyClipping(m_clipPlaneEquations, bounds);
+    bool visible = clip != gvFrustum::Clipped && frustum.intersects(bounds);
+    actors.chunkActors[j]->SetVisibility(visible);
+    (visible ? submitted : culled) +=
+      model.chunks->chunks()[j].numberOfTriangles;
+    if (visible)
+      {
+      this->setActorClipping(actors.chunkActors[j].Get(),
+                             clip == gvFrustum::Straddling);
+      }
+
+    // The surface with edges, for chunks drawn by VTK's mappers:
+    if (!actors.chunkMappers.empty())
+      {
+      vtkActor *edges = actors.chunkMappers[j].edgeActor.Get();
+      edges->SetVisibility(visible && m_representation == 3);
+      if (edges->GetVisibility())
+        {
+        this->setActorClipping(edges, clip == gvFrustum::Straddling);
+        }
+      }
+    }
+}
+
+void gvContextState::reportTriangles(int window, std::size_t submitted,
+                                     std::size_t culled, double time,
+                                     double interval)
+{
+  TriangleCounts &counts = m_triangleCounts[window];
+  counts.submitted += submitted;
+  counts.culled += culled;
+  ++counts.frames;
+
+  if (m_reportTime < 0.)
+    {
+    m_reportTime = time;
+    }
+  if (time - m_reportTime < interval)
+    {
+    return;
+    }
+
+  for (std::map<int, TriangleCounts>::iterator it = m_triangleCounts.begin();
+       it != m_triangleCounts.end(); ++it)
+    {
+    const TriangleCounts &c = it->second;
+    std::size_t total = c.submitted + c.culled;
+    std::cout << "Window " << it->first << ": "
+              << c.submitted / c.frames << " triangles submitted, "
+              << c.culled / c.frames << " culled per draw ("
+              << (total ? 100. * c.culled / total : 0.) << "% culled)"
+              << std::endl;
+    }
+  m_triangleCounts.clear();
+  m_reportTime = time;
+}
+
+void gvContextState::reportMemory(int window, double time, double interval)
+{
+  if (m_memoryReportTime < 0.)
+    {
+    m_memoryReportTime = time;
+    }
+  if (time - m_memoryReportTime < interval)
+    {
+    return;
+    }
+  m_memoryReportTime = time;
+
+  // The full-detail mappers are never drawn once a model is chunked, and
+  // instances share one copy. Compact chunks come from the share group's
+  // buffers and are also counted as the float buffers VTK's mappers would
+  // upload for them:
+  std::size_t geometry = 0;
+  std::size_t shared = 0;
+  std::size_t compact = 0;
+  std::size_t uncompressed = 0;
+  for (std::size_t i = 0; i < m_models.size(); ++i)
+    {
+    const ModelActors &model = m_models[i];
+    if (!m_scene->models()[i].instances.empty())
+      {
+      geometry += bufferBytes(m_scene->models()[i].geometry);
+      }
+    else if (model.chunkActors.empty())
+      {
+      geometry += mapperBytes(model.mapper.Get());
+      }
+    for (std::size_t j = 0; j < model.chunkMappers.size(); ++j)
+      {
+      geometry += mapperBytes(model.chunkMappers[j].surface.Get()) +
+        representationBytes(m_scene->models()[i].chunks->chunks()[j],
+                            m_edgesShown, m_verticesShown);
+      }
+    if (model.chunkMappers.empty())
+      {
+      for (std::size_t j = 0; j < model.chunkActors.size(); ++j)
+        {
+        shared += mapperBytes(model.chunkActors[j]->GetMapper());
+        }
+      }
+    if (const gvCompactMesh *mesh = m_scene->models()[i].compact.get())
+      {
+      for (std::size_t j = 0; j < mesh->chunks().size(); ++j)
+        {
+        compact += gvCompactMesh::bytes(mesh->chunks()[j]);
+        uncompressed += gvCompactMesh::floatBytes(mesh->chunks()[j]);
+        }
+      }
+    }
+  std::size_t levels = 0;
+  for (std::size_t i = 0; i < m_levelMappers.size(); ++i)
+    {
+    levels += mapperBytes(m_levelMappers[i].Get());
+    }
+  std::size_t bricks = 0;
+  for (std::size_t i = 0; i < m_brickActors.size(); ++i)
+    {
+    if (m_brickActors[i])
+      {
+      bricks += mapperBytes(m_brickActors[i]->GetMapper());
+      }
+    }
+
+  const double megabyte = 1024. * 1024.;
+  std::cout << "Window " << window << " context: "
+            << (geometry + levels + bricks) / megabyte
+            << " MB in its own GPU buffers (geometry " << geometry / megabyte
+            << " MB, levels " << levels / megabyte << " MB, bricks "
+            << bricks / megabyte << " MB)";
+#ifdef GV_OPENGL2
+  // Uploaded once for the whole share group; without sharing every context
+  // drawing them would hold its own copy:
+  if (shared > 0)
+    {
+    int contexts = m_sharedBuffers->numberOfContexts();
+    std::size_t group = m_sharedBuffers->bytes();
+    std::cout << "; draws " << shared / megabyte << " MB from the "
+              << group / megabyte << " MB of buffers shared by " << contexts
+              << " contexts, saving up to "
+              << (contexts - 1) * group / megabyte << " MB";
+    }
+#endif
+  if (compact > 0)
+    {
+    std::cout << "; compact chunks take " << compact / megabyte
+              << " MB instead of " << uncompressed / megabyte << " MB";
+    }
+  std::cout << std::endl;
+}
+
+vtkSmartPointer<vtkPolyDataMapper> gvContextState::newMapper() const
+{
+#ifdef GV_OPENGL2
+  vtkSmartPointer<gvClippingMapper> mapper =
+    vtkSmartPointer<gvClippingMapper>::New();
+  mapper->setMaximumNumberOfClipPlanes(m_maxClipPlanes);
+  return mapper;
+#else
+  return vtkSmartPointer<vtkPolyDataMapper>::New();
+#endif
+}
+
+void gvContextState::setMapperClipping(vtkPolyDataMapper *mapper, bool clip)
+{
+#ifdef GV_OPENGL2
+  static_cast<gvClippingMapper*>(mapper)->setClipPlanes(
+    clip ? &m_clipPlaneUniforms : nullptr);
+#else
+  mapper->SetClippingPlanes(clip ? m_clipPlanes.Get() : nullptr);
+#endif
+}
+
+vtkSmartPointer<vtkActor> gvContextState::addActor(vtkPolyData *data)
+{
+  vtkSmartPointer<vtkPolyDataMapper> mapper = this->newMapper();
+  mapper->SetInputData(data);
+  vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+  actor->SetMapper(mapper.Get());
+  actor->SetProperty(m_actor->GetProperty());
+  this->renderer().AddActor(actor.Get());
+  return actor;
+}
+
+void gvContextState::addChunkActors(std::size_t i, std::size_t chunk)
+{
+  const gvScene::Model &model = m_scene->models()[i];
+  ModelActors &actors = m_models[i];
+  vtkSmartPointer<vtkActor> actor = vtkSmartPointer<vtkActor>::New();
+  actor->SetUserMatrix(model.transform);
+#ifdef GV_OPENGL2
+  if (model.compact)
+    {
+    // gvCompactMapper draws the representations from its own buffers:
+    vtkNew<gvCompactMapper> mapper;
+    mapper->setChunk(model.compact, chunk);
+    mapper->setSharedBuffers(m_sharedBuffers);
+    mapper->setMaximumNumberOfClipPlanes(m_maxClipPlanes);
+    actor->SetMapper(mapper.Get());
+    actor->SetProperty(m_actor->GetProperty());
+    this->renderer().AddActor(actor.Get());
+    actors.chunkActors.push_back(actor);
+    return;
+    }
+#endif
+
+  const gvMeshChunks::Chunk &source = model.chunks->chunks()[chunk];
+  ChunkMappers mappers;
+  mappers.surface = this->newMapper();
+  mappers.surface->SetInputData(source.data);
+  mappers.edges = this->newMapper();
+  mappers.edges->SetInputData(source.edges);
+  mappers.vertices = this->newMapper();
+  mappers.vertices->SetInputData(source.vertices);
+  actor->SetMapper(mappers.surface.Get());
+  actor->SetProperty(m_chunkProperty.Get());
+  this->renderer().AddActor(actor.Get());
+
+  // Added after the surface so the edges are drawn over it:
+  mappers.edgeActor = vtkSmartPointer<vtkActor>::New();
+  mappers.edgeActor->SetMapper(mappers.edges.Get());
+  mappers.edgeActor->SetProperty(m_edgeProperty.Get());
+  mappers.edgeActor->SetUserMatrix(model.transform);
+  mappers.edgeActor->SetVisibility(false);
+  this->renderer().AddActor(mappers.edgeActor.Get());
+
+  actors.chunkActors.push_back(actor);
+  actors.chunkMappers.push_back(mappers);
+}
+
+void gvContextState::setChunkRepresentation(std::size_t i)
+{
+  ModelActors &actors = m_models[i];
+  for (std::size_t j = 0; j < actors.chunkMappers.size(); ++j)
+    {
+    const ChunkMappers &mappers = actors.chunkMappers[j];
+    vtkPolyDataMapper *mapper = mappers.surface.Get();
+    if (m_representation == VTK_POINTS)
+      {
+      mapper = mappers.vertices.Get();
+      }
+    else if (m_representation == VTK_WIREFRAME)
+      {
+      mapper = mappers.edges.Get();
+      }
+    if (actors.chunkActors[j]->GetMapper() != mapper)
+      {
+      actors.chunkActors[j]->SetMapper(mapper);
+      }
+    }
+}
+
+void gvContextState::setActorClipping(vtkActor *actor, bool clip)
+{
+#ifdef GV_OPENGL2
+  gvCompactMapper *compact = gvCompactMapper::SafeDownCast(actor->GetMapper());
+  if (compact)
+    {
+    compact->setClipPlanes(clip ? &m_clipPlaneUniforms : nullptr);
+    return;
+    }
+#endif
+  this->setMapperClipping(
+    static_cast<vtkPolyDataMapper*>(actor->GetMapper()), clip);
+}
+
+void gvContextState::removeActor(vtkSmartPointer<vtkActor> &actor)
+{
+  if (actor)
+    {
+    actor->ReleaseGraphicsResources(this->renderer().GetRenderWindow());
+    this->renderer().RemoveActor(actor.Get());
+    actor = nullptr;
+    }
 }
@@ -3,26 +3,214 @@
 
 #include <vvContextState.h>
 
+#include "gvTransparency.h"
+
 #include <vtkNew.h>
+#include <vtkSmartPointer.h>
+
+#include <array>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 
+class gvBrickStreamer;
+class gvFrustum;
+class gvLODChain;
+class gvScene;
+class gvSharedBuffers;
+struct gvRenderSettings;
 class vtkActor;
 class vtkExternalLight;
 class vtkLight;
+class vtkPlaneCollection;
+class vtkPolyData;
+class vtkPolyDataMapper;
+class vtkProperty;
 
 class gvContextState : public vvContextState
 {
 public:
-  gvContextState();
+  // Clipping planes (a, b, c, d); points with a*x + b*y + c*z + d >= 0 are
+  // kept.
+  typedef std::vector<std::array<double, 4> > ClipPlanes;
+
+  // Construct and destroy with the context current; on the OpenGL2 backend
+  // the context joins its share group's gvSharedBuffers.
+  explicit gvContextState(int maxClipPlanes);
+  ~gvContextState() override;
 
   // These aren't const-correct bc VTK is not const-correct.
   vtkActor& actor() const { return *m_actor.Get(); }
+  vtkPolyDataMapper& mapper() const { return *m_mapper.Get(); }
   vtkExternalLight& headlight() const { return *m_headlight.Get(); }
   vtkLight& flashlight() const { return *m_flashlight.Get(); }
 
+  // Map the models of the shared scene and their chunks if its version
+  // differs from the one this context last mapped. The first model is drawn
+  // by actor() unless it is instanced. Chunks of a model with a compact copy
+  // are drawn by gvCompactMapper on the OpenGL2 backend, from buffers shared
+  // with the other contexts of the share group. Instanced models upload their
+  // geometry once and draw every instance through a glyph mapper on VTK 9,
+  // or through one actor per instance sharing a mapper before that. Returns
+  // true if the mapper inputs changed. The context keeps scene alive until
+  // it maps another one.
+  bool updateGeometry(const std::shared_ptr<const gvScene> &scene,
+                      unsigned long version);
+
+  // Number of clipping planes this context can apply. The OpenGL2 backend
+  // clips in the mappers' shaders and takes as many as it was created for;
+  // the legacy backend's mappers are limited to six.
+  int maxClipPlanes() const;
+
+  // Clipping planes for this frame's draws in scene coordinates, up to
+  // maxClipPlanes(). Whole models and levels are clipped by their mappers;
+  // chunks and bricks only if they cross a plane.
+  void setClipPlanes(const ClipPlanes &clipPlanes);
+
+  // Walk the scene's model hierarchy and skip the models outside frustum,
+  // clipped away entirely, or hidden by modelVisibility, which has an entry
+  // per model loaded and is indexed by gvScene::Model::entry (used only if
+  // it covers every model). Of the rest, draw only the chunks in view at
+  // full detail, otherwise the whole model, and all instances of an
+  // instanced model. Reports the triangles submitted and culled.
+  void cullScene(const gvFrustum &frustum,
+                 const std::vector<bool> &modelVisibility,
+                 std::size_t &submitted, std::size_t &culled);
+
+  // Accumulate per-window triangle counts and print the averages every
+  // interval seconds.
+  void reportTriangles(int window, std::size_t submitted, std::size_t culled,
+                       double time, double interval);
+
+  // Print the estimated size of the vertex and index buffers this context
+  // has uploaded every interval seconds, and of those it draws from its
+  // share group's gvSharedBuffers with what sharing them saves. Windows
+  // that Vrui opens on one GL context share a context state and thus all
+  // of these buffers.
+  void reportMemory(int window, double time, double interval);
+
+  // Keep one actor per resident brick of a streamed model, sharing the main
+  // actor's property, and show only those inside frustum and not clipped
+  // away. Actors of evicted bricks release their GPU buffers.
+  void updateBricks(const gvBrickStreamer &streamer, const gvFrustum &frustum);
+
+  // Apply settings to the headlight and the actor's property if version
+  // differs from the one this context last applied, so unchanged settings
+  // don't bump any VTK modification times. Chunks drawn by VTK's mappers
+  // switch representations by switching mappers instead: each has one for
+  // its triangles, unique edges and unique points, and draws the edges over
+  // the surface with a second actor, so every edge and point is drawn once
+  // and nothing is uploaded again after a representation was first shown.
+  //
+  // Translucent surfaces blend as the settings' transparency mode says; see
+  // gvTransparency.
+  void applyRenderSettings(const gvRenderSettings &settings,
+                           unsigned long version);
+
+  // Call after each render of this context to keep depth peeling within the
+  // settings' budget.
+  void updateTransparency();
+
+  // VTK before 9 walks cell arrays with a cursor stored in the array, so
+  // contexts rendering on different threads must not upload the same shared
+  // data at once. Returns a lock on a mutex shared by all contexts, held
+  // only if this context has new data to upload; steady frames render
+  // without it.
+  std::unique_lock<std::mutex> uploadLock();
+
+  // Render the given level of detail, which must be one levels had built
+  // when the frame state was published. Each level keeps its own mapper so
+  // switching doesn't re-upload geometry.
+  void setLevel(const gvLODChain *levels, int level);
+
 private:
+  // A mapper that can clip against this context's planes.
+  vtkSmartPointer<vtkPolyDataMapper> newMapper() const;
+  void setMapperClipping(vtkPolyDataMapper *mapper, bool clip);
+
+  // Add an actor that draws data with the main actor's property.
+  vtkSmartPointer<vtkActor> addActor(vtkPolyData *data);
+
+  // Add the actors for a chunk of model i, from its compact copy if it has
+  // one.
+  void addChunkActors(std::size_t i, std::size_t chunk);
+  void setActorClipping(vtkActor *actor, bool clip);
+  void removeActor(vtkSmartPointer<vtkActor> &actor);
+
+  // Point the chunk actors of model i at the mappers of the current
+  // representation.
+  void setChunkRepresentation(std::size_t i);
+
+  // Add the actors drawing every instance of model i.
+  void addInstances(std::size_t i);
+
+  // Show model i whole or by its chunks in frustum, or hide it.
+  void cullModel(std::size_t i, bool shown, const gvFrustum &frustum,
+                 std::size_t &submitted, std::size_t &culled);
+
+  // The mappers of a chunk drawn by VTK's mappers, one per representation,
+  // and the actor drawing its edges over the surface.
+  struct ChunkMappers
+  {
+    vtkSmartPointer<vtkPolyDataMapper> surface;
+    vtkSmartPointer<vtkPolyDataMapper> edges;
+    vtkSmartPointer<vtkPolyDataMapper> vertices;
+    vtkSmartPointer<vtkActor> edgeActor;
+  };
+
+  // The actors drawing one model of the scene. The first model's are
+  // m_actor and m_mapper unless it is instanced.
+  struct ModelActors
+  {
+    vtkSmartPointer<vtkActor> actor; // Glyph mapper of an instanced model
+    vtkSmartPointer<vtkPolyDataMapper> mapper; // Full detail
+    std::vector<vtkSmartPointer<vtkActor> > chunkActors;
+    std::vector<ChunkMappers> chunkMappers; // Empty for compact chunks
+    std::vector<vtkSmartPointer<vtkActor> > instanceActors; // Before VTK 9
+  };
+
+  struct TriangleCounts
+  {
+    std::size_t submitted;
+    std::size_t culled;
+    std::size_t frames;
+  };
+
   vtkNew<vtkActor> m_actor;
+  vtkSmartPointer<vtkPolyDataMapper> m_mapper;
   vtkNew<vtkExternalLight> m_headlight;
   vtkNew<vtkLight> m_flashlight;
+  // Chunks drawn by VTK's mappers always draw their input as it is; the
+  // representation picks the input:
+  vtkNew<vtkProperty> m_chunkProperty;
+  vtkNew<vtkProperty> m_edgeProperty;
+  int m_representation;
+  bool m_edgesShown;
+  bool m_verticesShown;
+  gvTransparency m_transparency;
+  unsigned long m_geometryVersion;
+  unsigned long m_renderSettingsVersion;
+  bool m_uploadPending;
+  std::vector<vtkSmartPointer<vtkPolyDataMapper> > m_levelMappers;
+  std::shared_ptr<const gvScene> m_scene;
+  std::vector<ModelActors> m_models;
+  std::vector<bool> m_modelsInView;
+  std::vector<int> m_nodeStack;
+  int m_maxClipPlanes;
+  ClipPlanes m_clipPlaneEquations;
+#ifdef GV_OPENGL2
+  std::vector<float> m_clipPlaneUniforms;
+  std::shared_ptr<gvSharedBuffers> m_sharedBuffers;
+#endif
+  // For VTK's own mappers, which take at most six:
+  vtkNew<vtkPlaneCollection> m_clipPlanes;
+  std::vector<vtkSmartPointer<vtkActor> > m_brickActors;
+  unsigned long m_brickVersion;
+  std::map<int, TriangleCounts> m_triangleCounts;
+  double m_reportTime;
+  double m_memoryReportTime;
 };
 
 #endif // GVCONTEXTSTATE_H
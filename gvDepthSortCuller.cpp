@@ -0,0 +1,77 @@
+#include "gvDepthSortCuller.h"
+
+#include <vtkCamera.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkProp.h>
+#include <vtkRenderer.h>
+
+#include <algorithm>
+#include <limits>
+
+vtkStandardNewMacro(gvDepthSortCuller)
+
+gvDepthSortCuller::gvDepthSortCuller()
+  : m_enabled(false)
+{
+}
+
+gvDepthSortCuller::~gvDepthSortCuller()
+{
+}
+
+double gvDepthSortCuller::Cull(vtkRenderer *ren, vtkProp **propList,
+                               int &listLength, int &initialized)
+{
+  // The renderer budgets time by the props' multipliers once a culler
+  // initialized them, and by one per prop otherwise:
+  double total = 0.;
+  for (int i = 0; i < listLength; ++i)
+    {
+    total += initialized ? propList[i]->GetRenderTimeMultiplier() : 1.;
+    }
+  if (!m_enabled || listLength < 2)
+    {
+    return total;
+    }
+
+  // The external renderer takes the camera's view transform from the GL
+  // modelview of the current render, so each eye of a stereo pair and each
+  // window sorts by its own eye position:
+  vtkMatrix4x4 *view = ren->GetActiveCamera()->GetModelViewTransformMatrix();
+  m_order.resize(listLength);
+  for (int i = 0; i < listLength; ++i)
+    {
+    const double *bounds = propList[i]->GetBounds();
+    double distance = std::numeric_limits<double>::max();
+    if (bounds && bounds[0] <= bounds[1])
+      {
+      double center[3] = { 0.5 * (bounds[0] + bounds[1]),
+                           0.5 * (bounds[2] + bounds[3]),
+                           0.5 * (bounds[4] + bounds[5]) };
+      distance = 0.;
+      for (int row = 0; row < 3; ++row)
+        {
+        double eye = view->GetElement(row, 3);
+        for (int col = 0; col < 3; ++col)
+          {
+          eye += view->GetElement(row, col) * center[col];
+          }
+        distance += eye * eye;
+        }
+      }
+    m_order[i] = std::make_pair(distance, i);
+    }
+
+  std::stable_sort(m_order.begin(), m_order.end(),
+                   [](const std::pair<double, int> &a,
+                      const std::pair<double, int> &b)
+                     { return a.first > b.first; });
+
+  m_props.assign(propList, propList + listLength);
+  for (int i = 0; i < listLength; ++i)
+    {
+    propList[i] = m_props[m_order[i].second];
+    }
+  return total;
+}
@@ -0,0 +1,39 @@
+#ifndef GVDEPTHSORTCULLER_H
+#define GVDEPTHSORTCULLER_H
+
+#include <vtkCuller.h>
+
+#include <utility>
+#include <vector>
+
+// Orders the props a renderer draws back to front by the eye distance of
+// their bounds' centers, so translucent chunks blend in about the right
+// order without sorting triangles. Culls nothing. Props without bounds go
+// first, and ties keep the renderer's order, so an edge actor added after
+// its chunk's surface is still drawn after it. Does nothing while disabled.
+class gvDepthSortCuller : public vtkCuller
+{
+public:
+  static gvDepthSortCuller* New();
+  vtkTypeMacro(gvDepthSortCuller, vtkCuller)
+
+  void setEnabled(bool enabled) { m_enabled = enabled; }
+  bool enabled() const { return m_enabled; }
+
+  double Cull(vtkRenderer *ren, vtkProp **propList, int &listLength,
+              int &initialized) override;
+
+protected:
+  gvDepthSortCuller();
+  ~gvDepthSortCuller() override;
+
+private:
+  gvDepthSortCuller(const gvDepthSortCuller&) = delete;
+  void operator=(const gvDepthSortCuller&) = delete;
+
+  bool m_enabled;
+  std::vector<std::pair<double, int> > m_order; // (distance², index)
+  std::vector<vtkProp*> m_props;
+};
+
+#endif // GVDEPTHSORTCULLER_H
@@ -0,0 +1,321 @@
+// Load time and peak memory of one mesh in each format gvGeometryReader
+// reads, through its fast path and through VTK's reader.
+//
+// The mesh is converted to OBJ, binary PLY, binary STL, VTP with raw
+// appended data and binary legacy VTK in a scratch directory. Every read
+// then runs in a child process of its own, so that its peak resident memory
+// is measured alone, and the results are printed as a Markdown table.
+
+#include "gvGeometryReader.h"
+#include "gvMappedFile.h"
+#include "gvMeshUtilities.h"
+#include "gvSyntheticMesh.h"
+
+#include <vtkNew.h>
+#include <vtkPLYWriter.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataWriter.h>
+#include <vtkSTLWriter.h>
+#include <vtkXMLPolyDataWriter.h>
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+void printUsage()
+{
+  std::cout << "USAGE: gvFormatBenchmark [-threads <int>] [-o <directory>] "
+               "[-keep] <mesh>\n\n"
+               "mesh is any file gvGeometryReader reads or a synthetic mesh "
+               "name such as\nsynthetic:sphere:10M. Converted files go to "
+               "directory (default: a new\ndirectory under /tmp) and are "
+               "removed afterwards unless -keep is given." << std::endl;
+}
+
+// Points and triangles only, so every format holds the same data.
+vtkSmartPointer<vtkPolyData> readMesh(const std::string &fileName,
+                                      unsigned int threads)
+{
+  vtkSmartPointer<vtkPolyData> input;
+  gvSyntheticMesh::Specification synthetic;
+  if (gvSyntheticMesh::parse(fileName, synthetic))
+    {
+    input = gvSyntheticMesh::generate(synthetic, threads);
+    }
+  else
+    {
+    input = gvGeometryReader::read(fileName, threads);
+    }
+  if (!input || input->GetNumberOfPoints() == 0)
+    {
+    return nullptr;
+    }
+  std::vector<vtkIdType> ids;
+  gvMeshUtilities::extractTriangles(input, ids);
+  vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+  mesh->SetPoints(input->GetPoints());
+  mesh->SetPolys(gvMeshUtilities::newTriangles(ids.data(), ids.size() / 3));
+  return mesh;
+}
+
+bool writeOBJ(vtkPolyData *mesh, const std::string &fileName)
+{
+  std::ofstream out(fileName.c_str());
+  out << std::setprecision(9);
+  vtkPoints *points = mesh->GetPoints();
+  for (vtkIdType i = 0; i < points->GetNumberOfPoints(); ++i)
+    {
+    double p[3];
+    points->GetPoint(i, p);
+    out << "v " << p[0] << ' ' << p[1] << ' ' << p[2] << '\n';
+    }
+  std::vector<vtkIdType> ids;
+  gvMeshUtilities::extractTriangles(mesh, ids);
+  for (std::size_t i = 0; i < ids.size(); i += 3)
+    {
+    out << "f " << ids[i] + 1 << ' ' << ids[i + 1] + 1 << ' '
+        << ids[i + 2] + 1 << '\n';
+    }
+  return static_cast<bool>(out);
+}
+
+template <typename Writer>
+bool writeWithVTK(vtkPolyData *mesh, Writer *writer,
+                  const std::string &fileName)
+{
+  writer->SetInputData(mesh);
+  writer->SetFileName(fileName.c_str());
+  return writer->Write() != 0;
+}
+
+bool writeFormats(const std::string &input, const std::string &directory,
+                  unsigned int threads)
+{
+  vtkSmartPointer<vtkPolyData> mesh = readMesh(input, threads);
+  if (!mesh)
+    {
+    std::cerr << "ERROR: Could not read " << input << std::endl;
+    return false;
+    }
+  std::cerr << "Converting " << mesh->GetNumberOfPolys() << " triangles"
+            << std::endl;
+
+  vtkNew<vtkPLYWriter> ply;
+  ply->SetFileTypeToBinary();
+  vtkNew<vtkSTLWriter> stl;
+  stl->SetFileTypeToBinary();
+  vtkNew<vtkXMLPolyDataWriter> vtp;
+  vtp->SetDataModeToAppended();
+  vtp->EncodeAppendedDataOff();
+  vtp->SetCompressor(nullptr);
+  vtkNew<vtkPolyDataWriter> legacy;
+  legacy->SetFileTypeToBinary();
+
+  const std::string base = directory + "/mesh.";
+  return writeOBJ(mesh, base + "obj") &&
+    writeWithVTK(mesh.Get(), ply.Get(), base + "ply") &&
+    writeWithVTK(mesh.Get(), stl.Get(), base + "stl") &&
+    writeWithVTK(mesh.Get(), vtp.Get(), base + "vtp") &&
+    writeWithVTK(mesh.Get(), legacy.Get(), base + "vtk");
+}
+
+// Run functor in a child process and wait for it. Returns false if the
+// child failed.
+template <typename Functor>
+bool runChild(Functor functor, struct rusage &usage)
+{
+  pid_t pid = fork();
+  if (pid < 0)
+    {
+    return false;
+    }
+  if (pid == 0)
+    {
+    _exit(functor() ? 0 : 1);
+    }
+  int status = 0;
+  return wait4(pid, &status, 0, &usage) == pid && WIFEXITED(status) &&
+    WEXITSTATUS(status) == 0;
+}
+
+struct Result
+{
+  double seconds;
+  long long points;
+  long long triangles;
+};
+
+// Time one read in a child; its stdout is silenced and the result comes
+// back through a pipe.
+bool measureRead(const std::string &fileName, unsigned int threads, bool fast,
+                 Result &result, double &peakMegabytes)
+{
+  int channel[2];
+  if (pipe(channel) != 0)
+    {
+    return false;
+    }
+  struct rusage usage;
+  bool ran = runChild([&]()
+    {
+    close(channel[0]);
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    Clock::time_point start = Clock::now();
+    vtkSmartPointer<vtkPolyData> mesh =
+      gvGeometryReader::read(fileName, threads, fast);
+    Result child;
+    child.seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+    child.points = mesh ? mesh->GetNumberOfPoints() : 0;
+    child.triangles = mesh ? mesh->GetNumberOfPolys() : 0;
+    return write(channel[1], &child, sizeof(child)) == sizeof(child);
+    }, usage);
+  close(channel[1]);
+  bool received = read(channel[0], &result, sizeof(result)) == sizeof(result);
+  close(channel[0]);
+
+  // Kilobytes on Linux, bytes on macOS:
+#ifdef __APPLE__
+  peakMegabytes = usage.ru_maxrss / (1024. * 1024.);
+#else
+  peakMegabytes = usage.ru_maxrss / 1024.;
+#endif
+  return ran && received;
+}
+
+} // end anon namespace
+
+int main(int argc, char *argv[])
+{
+  unsigned int threads = 0;
+  std::string directory;
+  std::string input;
+  bool keep = false;
+  for (int i = 1; i < argc; ++i)
+    {
+    if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+      {
+      threads = static_cast<unsigned int>(atoi(argv[++i]));
+      }
+    else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+      {
+      directory = argv[++i];
+      }
+    else if (strcmp(argv[i], "-keep") == 0)
+      {
+      keep = true;
+      }
+    else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "-help") == 0)
+      {
+      printUsage();
+      return 0;
+      }
+    else
+      {
+      input = argv[i];
+      }
+    }
+  if (input.empty())
+    {
+    printUsage();
+    return 1;
+    }
+  bool scratch = directory.empty();
+  if (scratch)
+    {
+    char name[] = "/tmp/gvFormatBenchmarkXXXXXX";
+    if (!mkdtemp(name))
+      {
+      std::cerr << "ERROR: Could not create a scratch directory."
+                << std::endl;
+      return 1;
+      }
+    directory = name;
+    }
+
+  // The conversion runs in a child too, so the reads start from this
+  // process's small footprint:
+  struct rusage usage;
+  if (!runChild([&]() { return writeFormats(input, directory, threads); },
+                usage))
+    {
+    std::cerr << "ERROR: Could not convert " << input << " into "
+              << directory << std::endl;
+    return 1;
+    }
+
+  struct Run
+  {
+    const char *extension;
+    const char *reader;
+    bool fast;
+  };
+  const Run runs[] = {
+    {"obj", "gvOBJReader", true},
+    {"obj", "vtkOBJReader", false},
+    {"ply", "gvGeometryReader", true},
+    {"ply", "vtkPLYReader", false},
+    {"stl", "gvGeometryReader", true},
+    {"stl", "vtkSTLReader", false},
+    {"vtp", "vtkXMLPolyDataReader", true},
+    {"vtk", "vtkPolyDataReader", true}};
+
+  std::cout << "| Format | Reader | File MB | Load s | Peak MB | Points | "
+               "Triangles |\n"
+               "|---|---|---:|---:|---:|---:|---:|" << std::endl;
+  std::cout << std::fixed;
+  int failures = 0;
+  for (std::size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); ++i)
+    {
+    std::string fileName = directory + "/mesh." + runs[i].extension;
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;
+    gvMappedFile::statFile(fileName, size, mtime);
+    Result result;
+    double peak = 0.;
+    if (!measureRead(fileName, threads, runs[i].fast, result, peak))
+      {
+      std::cerr << "ERROR: Reading " << fileName << " with "
+                << runs[i].reader << " failed." << std::endl;
+      ++failures;
+      continue;
+      }
+    std::cout << "| " << runs[i].extension << " | " << runs[i].reader
+              << " | " << std::setprecision(1) << size / (1024. * 1024.)
+              << " | " << std::setprecision(3) << result.seconds << " | "
+              << std::setprecision(1) << peak << " | " << result.points
+              << " | " << result.triangles << " |" << std::endl;
+    }
+
+  if (!keep)
+    {
+    const char *extensions[] = {"obj", "ply", "stl", "vtp", "vtk"};
+    for (int i = 0; i < 5; ++i)
+      {
+      std::remove((directory + "/mesh." + extensions[i]).c_str());
+      }
+    if (scratch)
+      {
+      rmdir(directory.c_str());
+      }
+    }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+#ifndef GVFRAMESTATE_H
+#define GVFRAMESTATE_H
+
+#include "gvRenderSettings.h"
+
+#include <array>
+#include <memory>
+#include <vector>
+
+class gvBrickStreamer;
+class gvLODChain;
+class gvScene;
+
+// What frame() decided for a frame, handed to display() on the rendering
+// threads. The application state publishes these as immutable snapshots,
+// so display() never reads settings that the UI callbacks are writing. A
+// snapshot holds the geometry it refers to, so a scene replaced by frame()
+// stays alive until every context drawing the older snapshot is done.
+struct gvFrameState
+{
+  gvFrameState()
+    : renderSettingsVersion(0),
+      geometryVersion(0),
+      level(0)
+  {
+  }
+
+  // Active clipping planes (a, b, c, d); points with
+  // a*x + b*y + c*z + d >= 0 are kept.
+  std::vector<std::array<double, 4> > clipPlanes;
+
+  gvRenderSettings renderSettings;
+  unsigned long renderSettingsVersion;
+
+  // The scene to draw and the version it was published as.
+  std::shared_ptr<const gvScene> scene;
+  unsigned long geometryVersion;
+
+  // Coarser levels of the scene, or null. level is one of the levels built
+  // when the snapshot was published, so contexts can use it without
+  // looking at the levels the chain adds later.
+  std::shared_ptr<gvLODChain> levels;
+  int level;
+
+  // Brick streamer of a streamed scene, or null.
+  std::shared_ptr<gvBrickStreamer> streamer;
+
+  // Which models are shown, by the index of the entry they were loaded
+  // from (gvScene::Model::entry).
+  std::vector<bool> modelVisibility;
+};
+
+#endif // GVFRAMESTATE_H
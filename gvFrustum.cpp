@@ -0,0 +1,135 @@
+#include "gvFrustum.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+
+gvFrustum::gvFrustum()
+{
+  for (int i = 0; i < 6; ++i)
+    {
+    m_planes[i][0] = m_planes[i][1] = m_planes[i][2] = 0.;
+    m_planes[i][3] = 1.;
+    }
+  m_eye[0] = m_eye[1] = m_eye[2] = 0.;
+}
+
+void gvFrustum::setFromGL()
+{
+  GLdouble projection[16];
+  GLdouble modelview[16];
+  glGetDoublev(GL_PROJECTION_MATRIX, projection);
+  glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+  this->setFromMatrices(projection, modelview);
+}
+
+void gvFrustum::setFromMatrices(const double projection[16],
+                                const double modelview[16])
+{
+  // Combined clip matrix, column-major: clip = projection * modelview
+  double m[16];
+  for (int col = 0; col < 4; ++col)
+    {
+    for (int row = 0; row < 4; ++row)
+      {
+      double sum = 0.;
+      for (int k = 0; k < 4; ++k)
+        {
+        sum += projection[k * 4 + row] * modelview[col * 4 + k];
+        }
+      m[col * 4 + row] = sum;
+      }
+    }
+
+  // Gribb/Hartmann: each plane is row 3 plus or minus one of rows 0..2.
+  for (int axis = 0; axis < 3; ++axis)
+    {
+    for (int side = 0; side < 2; ++side)
+      {
+      double *plane = m_planes[axis * 2 + side];
+      double sign = side == 0 ? 1. : -1.;
+      for (int col = 0; col < 4; ++col)
+        {
+        plane[col] = m[col * 4 + 3] + sign * m[col * 4 + axis];
+        }
+      double length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] +
+                                plane[2] * plane[2]);
+      if (length > 0.)
+        {
+        for (int col = 0; col < 4; ++col)
+          {
+          plane[col] /= length;
+          }
+        }
+      }
+    }
+
+  // The eye sits at the eye-space origin: eye = -A^-1 * t, where A is the
+  // upper 3x3 of the modelview (rotation and navigation scale).
+  const double *a = modelview;
+  double cofactor[9] = {
+    a[5] * a[10] - a[9] * a[6], a[9] * a[2] - a[1] * a[10],
+    a[1] * a[6] - a[5] * a[2],
+    a[8] * a[6] - a[4] * a[10], a[0] * a[10] - a[8] * a[2],
+    a[4] * a[2] - a[0] * a[6],
+    a[4] * a[9] - a[8] * a[5], a[8] * a[1] - a[0] * a[9],
+    a[0] * a[5] - a[4] * a[1] };
+  double determinant = a[0] * cofactor[0] + a[4] * cofactor[1] +
+                       a[8] * cofactor[2];
+  if (determinant == 0.)
+    {
+    return;
+    }
+  for (int i = 0; i < 3; ++i)
+    {
+    // Row i of the inverse (column-major cofactor layout) times t:
+    m_eye[i] = -(cofactor[i] * a[12] + cofactor[3 + i] * a[13] +
+                 cofactor[6 + i] * a[14]) / determinant;
+    }
+}
+
+bool gvFrustum::intersects(const double bounds[6]) const
+{
+  for (int i = 0; i < 6; ++i)
+    {
+    const double *plane = m_planes[i];
+    // Test the box corner farthest along the plane normal:
+    double x = plane[0] >= 0. ? bounds[1] : bounds[0];
+    double y = plane[1] >= 0. ? bounds[3] : bounds[2];
+    double z = plane[2] >= 0. ? bounds[5] : bounds[4];
+    if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0.)
+      {
+      return false;
+      }
+    }
+  return true;
+}
+
+gvFrustum::ClipState gvFrustum::classifyClipping(
+    const std::vector<std::array<double, 4> > &planes, const double bounds[6])
+{
+  ClipState state = Kept;
+  for (std::size_t i = 0; i < planes.size(); ++i)
+    {
+    const std::array<double, 4> &plane = planes[i];
+    double minimum = plane[3];
+    double maximum = plane[3];
+    for (int j = 0; j < 3; ++j)
+      {
+      double a = plane[j] * bounds[2 * j];
+      double b = plane[j] * bounds[2 * j + 1];
+      minimum += std::min(a, b);
+      maximum += std::max(a, b);
+      }
+    if (maximum < 0.)
+      {
+      return Clipped;
+      }
+    if (minimum < 0.)
+      {
+      state = Straddling;
+      }
+    }
+  return state;
+}
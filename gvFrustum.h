@@ -0,0 +1,49 @@
+#ifndef GVFRUSTUM_H
+#define GVFRUSTUM_H
+
+#include <array>
+#include <vector>
+
+// View frustum of one window and eye in model coordinates, taken from the
+// OpenGL matrices Vrui sets up before calling display().
+class gvFrustum
+{
+public:
+  // Where a box lies relative to a set of clipping planes.
+  enum ClipState
+  {
+    Kept,
+    Straddling,
+    Clipped
+  };
+
+  gvFrustum();
+
+  // Extract the frustum from the current projection and modelview matrices.
+  void setFromGL();
+
+  // Extract the frustum from column-major projection and modelview matrices.
+  void setFromMatrices(const double projection[16],
+                       const double modelview[16]);
+
+  // Conservative test: false only if the box lies fully outside one plane.
+  bool intersects(const double bounds[6]) const;
+
+  // Classify a box against clipping planes (a, b, c, d) that keep
+  // a*x + b*y + c*z + d >= 0.
+  static ClipState classifyClipping(
+    const std::vector<std::array<double, 4> > &planes,
+    const double bounds[6]);
+
+  // Plane i as (a, b, c, d) with a*x + b*y + c*z + d >= 0 on the inside.
+  const double* plane(int i) const { return m_planes[i]; }
+
+  // Eye position in model coordinates.
+  const double* eye() const { return m_eye; }
+
+private:
+  double m_planes[6][4];
+  double m_eye[3];
+};
+
+#endif // GVFRUSTUM_H
@@ -0,0 +1,728 @@
+#include "gvGeometryReader.h"
+
+#include "gvMappedFile.h"
+#include "gvMeshUtilities.h"
+#include "gvOBJReader.h"
+#include "gvParallel.h"
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkNew.h>
+#include <vtkOBJReader.h>
+#include <vtkPLYReader.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataReader.h>
+#include <vtkSTLReader.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkXMLPolyDataReader.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+template <typename Reader>
+vtkSmartPointer<vtkPolyData> readWithVTK(const std::string &fileName)
+{
+  vtkNew<Reader> reader;
+  reader->SetFileName(fileName.c_str());
+  reader->Update();
+  vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+  output->ShallowCopy(reader->GetOutput());
+  return output;
+}
+
+void reportParse(const char *format, const gvMappedFile &file,
+                 Clock::time_point start, unsigned int threads)
+{
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  double megabytes = static_cast<double>(file.size()) / (1024. * 1024.);
+  std::cout << "Parsed " << megabytes << " MB of " << format << " in "
+            << elapsed.count() << " s (" << megabytes / elapsed.count()
+            << " MB/s, " << threads << " threads)" << std::endl;
+}
+
+bool isLittleEndian()
+{
+  const std::uint16_t one = 1;
+  return *reinterpret_cast<const unsigned char*>(&one) == 1;
+}
+
+// A value of type T stored at p, byte-swapped if swap is set.
+template <typename T>
+T load(const char *p, bool swap)
+{
+  char bytes[sizeof(T)];
+  if (swap)
+    {
+    std::reverse_copy(p, p + sizeof(T), bytes);
+    }
+  else
+    {
+    std::memcpy(bytes, p, sizeof(T));
+    }
+  T value;
+  std::memcpy(&value, bytes, sizeof(T));
+  return value;
+}
+
+//------------------------------------------------------------------------------
+// Binary PLY
+
+enum PLYType
+{
+  Int8,
+  UInt8,
+  Int16,
+  UInt16,
+  Int32,
+  UInt32,
+  Float32,
+  Float64,
+  NoType
+};
+
+PLYType plyType(const std::string &name)
+{
+  static const char *names[][2] = {
+    {"char", "int8"}, {"uchar", "uint8"}, {"short", "int16"},
+    {"ushort", "uint16"}, {"int", "int32"}, {"uint", "uint32"},
+    {"float", "float32"}, {"double", "float64"}};
+  for (int i = 0; i < NoType; ++i)
+    {
+    if (name == names[i][0] || name == names[i][1])
+      {
+      return static_cast<PLYType>(i);
+      }
+    }
+  return NoType;
+}
+
+std::size_t plySize(PLYType type)
+{
+  static const std::size_t sizes[] = {1, 1, 2, 2, 4, 4, 4, 8, 0};
+  return sizes[type];
+}
+
+double plyValue(const char *p, PLYType type, bool swap)
+{
+  switch (type)
+    {
+    case Int8:
+      return load<std::int8_t>(p, swap);
+    case UInt8:
+      return load<std::uint8_t>(p, swap);
+    case Int16:
+      return load<std::int16_t>(p, swap);
+    case UInt16:
+      return load<std::uint16_t>(p, swap);
+    case Int32:
+      return load<std::int32_t>(p, swap);
+    case UInt32:
+      return load<std::uint32_t>(p, swap);
+    case Float32:
+      return load<float>(p, swap);
+    case Float64:
+      return load<double>(p, swap);
+    default:
+      return 0.;
+    }
+}
+
+struct PLYProperty
+{
+  std::string name;
+  PLYType type;      // Of the items of a list
+  PLYType countType; // NoType unless this is a list
+  std::size_t offset; // In the record, if no list comes before
+};
+
+struct PLYElement
+{
+  std::string name;
+  std::size_t count;
+  std::vector<PLYProperty> properties;
+
+  // Size of every record, or 0 if the element has lists.
+  std::size_t recordSize() const
+  {
+    std::size_t size = 0;
+    for (std::size_t i = 0; i < properties.size(); ++i)
+      {
+      if (properties[i].countType != NoType)
+        {
+        return 0;
+        }
+      size += plySize(properties[i].type);
+      }
+    return size;
+  }
+
+  const PLYProperty* property(const char *name) const
+  {
+    for (std::size_t i = 0; i < properties.size(); ++i)
+      {
+      if (properties[i].name == name && properties[i].countType == NoType)
+        {
+        return &properties[i];
+        }
+      }
+    return nullptr;
+  }
+};
+
+struct PLYHeader
+{
+  bool binary;
+  bool swap;
+  std::vector<PLYElement> elements;
+  std::size_t dataOffset;
+};
+
+// Returns false if file doesn't start with a PLY header this reader
+// understands.
+bool readPLYHeader(const gvMappedFile &file, PLYHeader &header)
+{
+  static const char endHeader[] = "end_header";
+  const char *begin = file.data();
+  const char *limit = begin + std::min<std::size_t>(file.size(), 1 << 20);
+  const char *end = std::search(begin, limit, endHeader,
+                                endHeader + sizeof(endHeader) - 1);
+  end = std::find(end, limit, '\n');
+  if (end == limit)
+    {
+    return false;
+    }
+  header.dataOffset = static_cast<std::size_t>(end + 1 - begin);
+
+  std::istringstream in(std::string(begin, end));
+  std::string line;
+  bool valid = std::getline(in, line) && line.compare(0, 3, "ply") == 0;
+  bool haveFormat = false;
+  while (valid && std::getline(in, line))
+    {
+    std::istringstream fields(line);
+    std::string keyword;
+    fields >> keyword;
+    if (keyword == "format")
+      {
+      std::string format;
+      fields >> format;
+      header.binary = format != "ascii";
+      header.swap = (format == "binary_big_endian") == isLittleEndian();
+      valid = format == "ascii" || format == "binary_little_endian" ||
+        format == "binary_big_endian";
+      haveFormat = true;
+      }
+    else if (keyword == "element")
+      {
+      PLYElement element;
+      valid = static_cast<bool>(fields >> element.name >> element.count);
+      header.elements.push_back(element);
+      }
+    else if (keyword == "property")
+      {
+      std::string type;
+      PLYProperty property;
+      property.countType = NoType;
+      property.offset = 0;
+      fields >> type;
+      if (type == "list")
+        {
+        std::string countType;
+        fields >> countType >> type;
+        property.countType = plyType(countType);
+        valid = property.countType != NoType;
+        }
+      property.type = plyType(type);
+      valid = valid && property.type != NoType &&
+        (fields >> property.name) && !header.elements.empty();
+      if (valid)
+        {
+        PLYElement &element = header.elements.back();
+        if (!element.properties.empty())
+          {
+          const PLYProperty &last = element.properties.back();
+          property.offset = last.offset + plySize(last.type);
+          }
+        element.properties.push_back(property);
+        }
+      }
+    }
+  return valid && haveFormat;
+}
+
+// 0..255 from an integer channel, or from a floating point one in 0..1.
+unsigned char plyColor(const char *record, const PLYProperty &channel,
+                       bool swap)
+{
+  double value = plyValue(record + channel.offset, channel.type, swap);
+  if (channel.type == Float32 || channel.type == Float64)
+    {
+    value *= 255.;
+    }
+  return static_cast<unsigned char>(std::min(std::max(value, 0.), 255.));
+}
+
+// Null if file isn't binary PLY with vertex and face elements this reader
+// handles; vtkPLYReader takes over then.
+vtkSmartPointer<vtkPolyData> readBinaryPLY(const std::string &fileName,
+                                           unsigned int threads)
+{
+  Clock::time_point start = Clock::now();
+  gvMappedFile file;
+  PLYHeader header;
+  if (!file.open(fileName) || !readPLYHeader(file, header) || !header.binary)
+    {
+    return nullptr;
+    }
+  file.adviseSequential();
+
+  // Elements up to the faces must have fixed-size records to be skipped;
+  // anything after the faces isn't needed.
+  const char *p = file.data() + header.dataOffset;
+  const char *end = file.data() + file.size();
+  const PLYElement *vertices = nullptr;
+  const PLYElement *faces = nullptr;
+  const char *vertexData = nullptr;
+  const char *faceData = nullptr;
+  for (std::size_t i = 0; i < header.elements.size() && !faces; ++i)
+    {
+    const PLYElement &element = header.elements[i];
+    if (element.name == "face")
+      {
+      faces = &element;
+      faceData = p;
+      continue;
+      }
+    std::size_t recordSize = element.recordSize();
+    if (element.count > 0 && recordSize == 0)
+      {
+      return nullptr;
+      }
+    if (element.name == "vertex")
+      {
+      vertices = &element;
+      vertexData = p;
+      }
+    if (recordSize > 0 &&
+        element.count > static_cast<std::size_t>(end - p) / recordSize)
+      {
+      return nullptr;
+      }
+    p += recordSize * element.count;
+    }
+  if (!vertices || !faces)
+    {
+    return nullptr;
+    }
+
+  const PLYProperty *x = vertices->property("x");
+  const PLYProperty *y = vertices->property("y");
+  const PLYProperty *z = vertices->property("z");
+  const PLYProperty *nx = vertices->property("nx");
+  const PLYProperty *ny = vertices->property("ny");
+  const PLYProperty *nz = vertices->property("nz");
+  const PLYProperty *u = vertices->property("u");
+  const PLYProperty *v = vertices->property("v");
+  const PLYProperty *color[4] = {
+    vertices->property("red"), vertices->property("green"),
+    vertices->property("blue"), vertices->property("alpha")};
+  if (!x || !y || !z)
+    {
+    return nullptr;
+    }
+  if (!u || !v)
+    {
+    u = vertices->property("s");
+    v = vertices->property("t");
+    }
+
+  // The face's vertex list may sit between other fixed-size properties:
+  const PLYProperty *list = nullptr;
+  std::size_t before = 0;
+  std::size_t after = 0;
+  for (std::size_t i = 0; i < faces->properties.size(); ++i)
+    {
+    const PLYProperty &property = faces->properties[i];
+    if (property.countType != NoType)
+      {
+      if (list || (property.name != "vertex_indices" &&
+                   property.name != "vertex_index") ||
+          property.type == Float32 || property.type == Float64)
+        {
+        return nullptr;
+        }
+      list = &property;
+      }
+    else
+      {
+      (list ? after : before) += plySize(property.type);
+      }
+    }
+  if (!list)
+    {
+    return nullptr;
+    }
+
+  bool swap = header.swap;
+  std::size_t numberOfPoints = vertices->count;
+  std::size_t vertexSize = vertices->recordSize();
+  vtkNew<vtkFloatArray> positions;
+  positions->SetNumberOfComponents(3);
+  positions->SetNumberOfTuples(static_cast<vtkIdType>(numberOfPoints));
+  vtkSmartPointer<vtkFloatArray> normals;
+  if (nx && ny && nz)
+    {
+    normals = vtkSmartPointer<vtkFloatArray>::New();
+    normals->SetName("Normals");
+    normals->SetNumberOfComponents(3);
+    normals->SetNumberOfTuples(static_cast<vtkIdType>(numberOfPoints));
+    }
+  vtkSmartPointer<vtkFloatArray> tcoords;
+  if (u && v)
+    {
+    tcoords = vtkSmartPointer<vtkFloatArray>::New();
+    tcoords->SetName("TCoords");
+    tcoords->SetNumberOfComponents(2);
+    tcoords->SetNumberOfTuples(static_cast<vtkIdType>(numberOfPoints));
+    }
+  int colorComponents = !color[0] || !color[1] || !color[2] ? 0 :
+    color[3] ? 4 : 3;
+  vtkSmartPointer<vtkUnsignedCharArray> colors;
+  if (colorComponents > 0)
+    {
+    colors = vtkSmartPointer<vtkUnsignedCharArray>::New();
+    colors->SetName(colorComponents == 4 ? "RGBA" : "RGB");
+    colors->SetNumberOfComponents(colorComponents);
+    colors->SetNumberOfTuples(static_cast<vtkIdType>(numberOfPoints));
+    }
+
+  gvParallel::forRange(numberOfPoints, [&](std::size_t first,
+                                           std::size_t last)
+    {
+    float *outPositions = positions->GetPointer(0);
+    for (std::size_t i = first; i < last; ++i)
+      {
+      const char *record = vertexData + i * vertexSize;
+      outPositions[3 * i] = static_cast<float>(
+        plyValue(record + x->offset, x->type, swap));
+      outPositions[3 * i + 1] = static_cast<float>(
+        plyValue(record + y->offset, y->type, swap));
+      outPositions[3 * i + 2] = static_cast<float>(
+        plyValue(record + z->offset, z->type, swap));
+      if (normals)
+        {
+        float *n = normals->GetPointer(3 * i);
+        n[0] = static_cast<float>(
+          plyValue(record + nx->offset, nx->type, swap));
+        n[1] = static_cast<float>(
+          plyValue(record + ny->offset, ny->type, swap));
+        n[2] = static_cast<float>(
+          plyValue(record + nz->offset, nz->type, swap));
+        }
+      if (tcoords)
+        {
+        float *t = tcoords->GetPointer(2 * i);
+        t[0] = static_cast<float>(plyValue(record + u->offset, u->type, swap));
+        t[1] = static_cast<float>(plyValue(record + v->offset, v->type, swap));
+        }
+      if (colors)
+        {
+        unsigned char *c = colors->GetPointer(colorComponents * i);
+        for (int j = 0; j < colorComponents; ++j)
+          {
+          c[j] = plyColor(record, *color[j], swap);
+          }
+        }
+      }
+    }, threads);
+
+  // Triangulated files have fixed-size face records whose corners decode in
+  // parallel; others are walked once and fanned into triangles.
+  std::size_t numberOfFaces = faces->count;
+  std::size_t countSize = plySize(list->countType);
+  std::size_t indexSize = plySize(list->type);
+  std::size_t triangleSize = before + countSize + 3 * indexSize + after;
+  bool triangles = numberOfFaces <=
+    static_cast<std::size_t>(end - faceData) / triangleSize;
+  if (triangles)
+    {
+    std::atomic<bool> allTriangles(true);
+    gvParallel::forRange(numberOfFaces, [&](std::size_t first,
+                                            std::size_t last)
+      {
+      for (std::size_t i = first; i < last && allTriangles; ++i)
+        {
+        const char *count = faceData + i * triangleSize + before;
+        if (plyValue(count, list->countType, swap) != 3.)
+          {
+          allTriangles = false;
+          }
+        }
+      }, threads);
+    triangles = allTriangles;
+    }
+
+  std::vector<vtkIdType> ids;
+  std::atomic<bool> valid(true);
+  double maximumId = static_cast<double>(numberOfPoints);
+  if (triangles)
+    {
+    ids.resize(3 * numberOfFaces);
+    gvParallel::forRange(numberOfFaces, [&](std::size_t first,
+                                            std::size_t last)
+      {
+      for (std::size_t i = first; i < last; ++i)
+        {
+        const char *corner = faceData + i * triangleSize + before + countSize;
+        for (int j = 0; j < 3; ++j, corner += indexSize)
+          {
+          double id = plyValue(corner, list->type, swap);
+          if (id < 0. || id >= maximumId)
+            {
+            valid = false;
+            }
+          ids[3 * i + j] = static_cast<vtkIdType>(id);
+          }
+        }
+      }, threads);
+    }
+  else
+    {
+    const char *record = faceData;
+    for (std::size_t i = 0; i < numberOfFaces && valid; ++i)
+      {
+      if (static_cast<std::size_t>(end - record) < before + countSize)
+        {
+        valid = false;
+        break;
+        }
+      record += before;
+      std::size_t count = static_cast<std::size_t>(
+        plyValue(record, list->countType, swap));
+      record += countSize;
+      if (static_cast<std::size_t>(end - record) < count * indexSize + after)
+        {
+        valid = false;
+        break;
+        }
+      vtkIdType fan[2] = {0, 0};
+      for (std::size_t j = 0; j < count; ++j, record += indexSize)
+        {
+        double id = plyValue(record, list->type, swap);
+        valid = valid && id >= 0. && id < maximumId;
+        vtkIdType corner = static_cast<vtkIdType>(id);
+        if (j >= 2)
+          {
+          ids.push_back(fan[0]);
+          ids.push_back(fan[1]);
+          ids.push_back(corner);
+          }
+        fan[j == 0 ? 0 : 1] = corner;
+        }
+      record += after;
+      }
+    }
+  if (!valid)
+    {
+    std::cerr << "ERROR: " << fileName << " has corrupt faces." << std::endl;
+    return nullptr;
+    }
+
+  vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+  vtkNew<vtkPoints> points;
+  points->SetData(positions.Get());
+  output->SetPoints(points.Get());
+  output->GetPointData()->SetNormals(normals);
+  output->GetPointData()->SetTCoords(tcoords);
+  output->GetPointData()->SetScalars(colors);
+  output->SetPolys(gvMeshUtilities::newTriangles(ids.data(), ids.size() / 3));
+
+  reportParse("PLY", file, start, threads);
+  return output;
+}
+
+//------------------------------------------------------------------------------
+// Binary STL
+
+// A triangle corner of a binary STL file. Corners at the same position are
+// welded into one point, so positions compare by their bits.
+struct STLCorner
+{
+  std::uint32_t position[3];
+  std::uint32_t corner;
+
+  bool samePosition(const STLCorner &other) const
+  {
+    return position[0] == other.position[0] &&
+      position[1] == other.position[1] && position[2] == other.position[2];
+  }
+
+  bool operator<(const STLCorner &other) const
+  {
+    if (!this->samePosition(other))
+      {
+      return std::lexicographical_compare(position, position + 3,
+                                          other.position, other.position + 3);
+      }
+    return corner < other.corner;
+  }
+};
+
+// Null if file isn't binary STL; vtkSTLReader takes over then.
+vtkSmartPointer<vtkPolyData> readBinarySTL(const std::string &fileName,
+                                           unsigned int threads)
+{
+  Clock::time_point start = Clock::now();
+  gvMappedFile file;
+  if (!file.open(fileName) || file.size() < 84)
+    {
+    return nullptr;
+    }
+  file.adviseSequential();
+
+  // ASCII files start with "solid", but so do some binary ones, whose size
+  // then gives them away:
+  const char *data = file.data();
+  bool swap = !isLittleEndian();
+  std::uint64_t numberOfTriangles = load<std::uint32_t>(data + 80, swap);
+  std::uint64_t expectedSize = 84 + 50 * numberOfTriangles;
+  bool solid = std::strncmp(data, "solid", 5) == 0;
+  if (expectedSize > file.size() || (solid && expectedSize != file.size()) ||
+      3 * numberOfTriangles > std::numeric_limits<std::uint32_t>::max())
+    {
+    return nullptr;
+    }
+
+  // Each record is a facet normal, three corners and two attribute bytes:
+  std::size_t numberOfCorners = static_cast<std::size_t>(3 * numberOfTriangles);
+  std::vector<STLCorner> corners(numberOfCorners);
+  gvParallel::forRange(static_cast<std::size_t>(numberOfTriangles),
+                       [&](std::size_t first, std::size_t last)
+    {
+    for (std::size_t i = first; i < last; ++i)
+      {
+      const char *record = data + 84 + 50 * i + 12;
+      for (std::size_t j = 0; j < 3; ++j)
+        {
+        STLCorner &corner = corners[3 * i + j];
+        for (std::size_t k = 0; k < 3; ++k)
+          {
+          corner.position[k] =
+            load<std::uint32_t>(record + 12 * j + 4 * k, swap);
+          }
+        corner.corner = static_cast<std::uint32_t>(3 * i + j);
+        }
+      }
+    }, threads);
+
+  gvParallel::sort(corners.begin(), corners.end(), std::less<STLCorner>(),
+                   threads);
+
+  std::size_t numberOfPoints = 0;
+  for (std::size_t i = 0; i < numberOfCorners; ++i)
+    {
+    if (i == 0 || !corners[i].samePosition(corners[i - 1]))
+      {
+      ++numberOfPoints;
+      }
+    }
+
+  vtkNew<vtkFloatArray> positions;
+  positions->SetNumberOfComponents(3);
+  positions->SetNumberOfTuples(static_cast<vtkIdType>(numberOfPoints));
+  float *outPositions = positions->GetPointer(0);
+  std::vector<vtkIdType> ids(numberOfCorners);
+  vtkIdType point = -1;
+  for (std::size_t i = 0; i < numberOfCorners; ++i)
+    {
+    if (i == 0 || !corners[i].samePosition(corners[i - 1]))
+      {
+      ++point;
+      std::memcpy(outPositions + 3 * point, corners[i].position,
+                  3 * sizeof(float));
+      }
+    ids[corners[i].corner] = point;
+    }
+  std::vector<STLCorner>().swap(corners);
+
+  vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+  vtkNew<vtkPoints> points;
+  points->SetData(positions.Get());
+  output->SetPoints(points.Get());
+  output->SetPolys(gvMeshUtilities::newTriangles(
+    ids.data(), static_cast<std::size_t>(numberOfTriangles)));
+
+  reportParse("STL", file, start, threads);
+  return output;
+}
+
+} // end anon namespace
+
+gvGeometryReader::Format gvGeometryReader::format(const std::string &fileName)
+{
+  std::string::size_type dot = fileName.rfind('.');
+  if (dot == std::string::npos || fileName.find('/', dot) != std::string::npos)
+    {
+    return Unknown;
+    }
+  std::string extension = fileName.substr(dot + 1);
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  for (int i = 0; i < Unknown; ++i)
+    {
+    Format format = static_cast<Format>(i);
+    if (extension == formatName(format))
+      {
+      return format;
+      }
+    }
+  return Unknown;
+}
+
+const char* gvGeometryReader::formatName(Format format)
+{
+  static const char *names[] = {"obj", "ply", "stl", "vtp", "vtk", ""};
+  return names[format];
+}
+
+vtkSmartPointer<vtkPolyData> gvGeometryReader::read(
+    const std::string &fileName, unsigned int numberOfThreads, bool fast)
+{
+  unsigned int threads = gvParallel::resolveThreads(numberOfThreads);
+  vtkSmartPointer<vtkPolyData> output;
+  switch (format(fileName))
+    {
+    case OBJ:
+      return fast ? gvOBJReader::read(fileName, threads) :
+        readWithVTK<vtkOBJReader>(fileName);
+    case PLY:
+      output = fast ? readBinaryPLY(fileName, threads) : nullptr;
+      return output ? output : readWithVTK<vtkPLYReader>(fileName);
+    case STL:
+      output = fast ? readBinarySTL(fileName, threads) : nullptr;
+      return output ? output : readWithVTK<vtkSTLReader>(fileName);
+    case VTP:
+      return readWithVTK<vtkXMLPolyDataReader>(fileName);
+    case LegacyVTK:
+      return readWithVTK<vtkPolyDataReader>(fileName);
+    default:
+      std::cerr << "ERROR: Unknown mesh format of " << fileName
+                << "; expected .obj, .ply, .stl, .vtp or .vtk." << std::endl;
+      return nullptr;
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef GVGEOMETRYREADER_H
+#define GVGEOMETRYREADER_H
+
+#include <vtkSmartPointer.h>
+
+#include <string>
+
+class vtkPolyData;
+
+// Reads a mesh with the fastest reader its file extension allows:
+//
+//   .obj  gvOBJReader
+//   .ply  binary PLY is memory-mapped and decoded in parallel; ASCII PLY
+//         and unusual layouts go to vtkPLYReader
+//   .stl  binary STL is memory-mapped, decoded in parallel and its
+//         duplicate corners welded by a parallel sort; ASCII STL goes to
+//         vtkSTLReader
+//   .vtp  vtkXMLPolyDataReader, which reads appended raw arrays directly
+//   .vtk  vtkPolyDataReader
+//
+// Extensions are matched regardless of case. The output is laid out like
+// the VTK readers': float points, "Normals" and "TCoords" point arrays,
+// colors as point scalars, and polygons.
+class gvGeometryReader
+{
+public:
+  enum Format
+  {
+    OBJ,
+    PLY,
+    STL,
+    VTP,
+    LegacyVTK,
+    Unknown
+  };
+
+  static Format format(const std::string &fileName);
+  static const char* formatName(Format format);
+
+  // Read fileName using numberOfThreads workers; 0 uses all cores. With
+  // fast false, every format is read by its VTK reader. Returns null if the
+  // format is unknown or the file can't be read.
+  static vtkSmartPointer<vtkPolyData> read(const std::string &fileName,
+                                           unsigned int numberOfThreads = 0,
+                                           bool fast = true);
+};
+
+#endif // GVGEOMETRYREADER_H
@@ -0,0 +1,175 @@
+#include "gvLODChain.h"
+
+#include "gvMeshUtilities.h"
+
+#include <vtkCallbackCommand.h>
+#include <vtkCellArray.h>
+#include <vtkCommand.h>
+#include <vtkIdTypeArray.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataNormals.h>
+#include <vtkQuadricDecimation.h>
+#include <vtkTriangleFilter.h>
+#include <vtkVersion.h>
+
+#include <chrono>
+#include <iostream>
+
+namespace {
+
+// Meshes this small render fast enough at full resolution:
+const vtkIdType MinimumTriangles = 4096;
+
+#if VTK_MAJOR_VERSION < 9
+// A copy of cells with its own traversal cursor. Only the ids are read, so
+// the shared cursor the contexts move while uploading is left alone.
+vtkSmartPointer<vtkCellArray> privateCells(vtkCellArray *cells)
+{
+  vtkNew<vtkIdTypeArray> ids;
+  ids->DeepCopy(cells->GetData());
+  vtkSmartPointer<vtkCellArray> copy = vtkSmartPointer<vtkCellArray>::New();
+  copy->SetCells(cells->GetNumberOfCells(), ids.Get());
+  return copy;
+}
+#endif
+
+// Stop a filter at its next progress report once the chain is cancelled.
+// The filters check their abort flag right after reporting progress, and
+// the flag is only set from the thread running them, after the pipeline
+// has cleared it for the run.
+void abortIfCancelled(vtkObject *caller, unsigned long, void *clientData,
+                      void*)
+{
+  if (*static_cast<std::atomic<bool>*>(clientData))
+    {
+    static_cast<vtkAlgorithm*>(caller)->AbortExecuteOn();
+    }
+}
+
+} // end anon namespace
+
+gvLODChain::gvLODChain(vtkPolyData *geometry,
+                       const std::function<void()> &levelReady)
+  : m_levelReady(levelReady),
+    m_cancel(false)
+{
+  m_levels.reserve(NumberOfLevels);
+  m_levels.push_back(geometry);
+
+  // Filters register themselves as consumers of their input, so decimate a
+  // private copy rather than the dataset the contexts are mapping. Its cells
+  // are copied on the builder thread.
+  vtkSmartPointer<vtkPolyData> input = vtkSmartPointer<vtkPolyData>::New();
+  input->ShallowCopy(geometry);
+  m_builder = std::thread(&gvLODChain::build, this, input);
+}
+
+gvLODChain::~gvLODChain()
+{
+  // The filters building a level abort at their next progress report, so
+  // this doesn't wait for a whole level of a large mesh to finish:
+  m_cancel = true;
+  m_builder.join();
+}
+
+double gvLODChain::levelFraction(int level)
+{
+  static const double fractions[NumberOfLevels] = { 1., .5, .25, .1, .02 };
+  return fractions[level];
+}
+
+bool gvLODChain::update()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  if (m_built.empty())
+    {
+    return false;
+    }
+  m_levels.insert(m_levels.end(), m_built.begin(), m_built.end());
+  m_built.clear();
+  return true;
+}
+
+void gvLODChain::build(vtkSmartPointer<vtkPolyData> input)
+{
+  if (input->GetNumberOfPolys() < MinimumTriangles)
+    {
+    return;
+    }
+
+#if VTK_MAJOR_VERSION < 9
+  // The triangle filter walks the cells with VTK's traversal cursor, which
+  // is stored in the cell arrays shared with the contexts; uploadLock() only
+  // keeps contexts from moving it at once, so walk copies instead:
+  input->SetVerts(privateCells(input->GetVerts()));
+  input->SetLines(privateCells(input->GetLines()));
+  input->SetPolys(privateCells(input->GetPolys()));
+  input->SetStrips(privateCells(input->GetStrips()));
+#endif
+
+  typedef std::chrono::steady_clock Clock;
+  bool normals = input->GetPointData()->GetNormals() != nullptr;
+
+  vtkNew<vtkCallbackCommand> cancel;
+  cancel->SetCallback(abortIfCancelled);
+  cancel->SetClientData(&m_cancel);
+
+  // Quadric decimation only takes triangles:
+  vtkNew<vtkTriangleFilter> triangles;
+  triangles->AddObserver(vtkCommand::ProgressEvent, cancel.Get());
+  triangles->SetInputData(input);
+  triangles->Update();
+  vtkSmartPointer<vtkPolyData> previous = triangles->GetOutput();
+
+  for (int level = 1; level < NumberOfLevels && !m_cancel; ++level)
+    {
+    Clock::time_point start = Clock::now();
+
+    // Each level is decimated from the one before, which is much cheaper
+    // than starting from the full mesh every time:
+    vtkNew<vtkQuadricDecimation> decimate;
+    decimate->AddObserver(vtkCommand::ProgressEvent, cancel.Get());
+    decimate->SetInputData(previous);
+    decimate->SetTargetReduction(
+      1. - levelFraction(level) / levelFraction(level - 1));
+
+    vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+    if (normals)
+      {
+      vtkNew<vtkPolyDataNormals> recompute;
+      recompute->AddObserver(vtkCommand::ProgressEvent, cancel.Get());
+      recompute->SetInputConnection(decimate->GetOutputPort());
+      recompute->SplittingOff();
+      recompute->Update();
+      output->ShallowCopy(recompute->GetOutput());
+      }
+    else
+      {
+      decimate->Update();
+      output->ShallowCopy(decimate->GetOutput());
+      }
+    // An aborted filter leaves a partial mesh:
+    if (m_cancel)
+      {
+      break;
+      }
+    gvMeshUtilities::prepareForSharing(output);
+
+    std::chrono::duration<double> elapsed = Clock::now() - start;
+    std::cout << "Built LOD level " << level << " ("
+              << output->GetNumberOfPolys() << " triangles) in "
+              << elapsed.count() << " s" << std::endl;
+
+      {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_built.push_back(output);
+      }
+    if (m_levelReady)
+      {
+      m_levelReady();
+      }
+    previous = output;
+    }
+}
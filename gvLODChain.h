@@ -0,0 +1,60 @@
+#ifndef GVLODCHAIN_H
+#define GVLODCHAIN_H
+
+#include <vtkSmartPointer.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class vtkPolyData;
+
+// Progressively coarser versions of a mesh for level-of-detail rendering.
+// Level 0 is the mesh itself; the coarser levels keep about 50%, 25%, 10%
+// and 2% of its triangles and are decimated one after another on a
+// background thread.
+class gvLODChain
+{
+public:
+  enum { NumberOfLevels = 5 };
+
+  // Start decimating geometry. It is shallow-copied, so the caller keeps
+  // ownership of the original. levelReady is invoked from the build thread
+  // each time a level is finished.
+  gvLODChain(vtkPolyData *geometry, const std::function<void()> &levelReady);
+  ~gvLODChain();
+
+  // Fraction of the full mesh's triangles kept at a level.
+  static double levelFraction(int level);
+
+  // Publish the levels finished since the last call. Call from the main
+  // thread; returns true if new levels became available.
+  bool update();
+
+  // Number of levels usable so far, counting level 0. Main thread only.
+  int availableLevels() const { return static_cast<int>(m_levels.size()); }
+
+  // A level below a count availableLevels() returned. Levels never move
+  // once published, so rendering threads can read those they were handed.
+  vtkPolyData* level(int level) const { return m_levels[level].Get(); }
+
+private:
+  gvLODChain(const gvLODChain&) = delete;
+  gvLODChain& operator=(const gvLODChain&) = delete;
+
+  void build(vtkSmartPointer<vtkPolyData> input);
+
+  std::function<void()> m_levelReady;
+
+  // Grown on the main thread only, within its reserved size:
+  std::vector<vtkSmartPointer<vtkPolyData> > m_levels;
+
+  std::mutex m_mutex;
+  std::vector<vtkSmartPointer<vtkPolyData> > m_built; // Guarded by m_mutex
+  std::atomic<bool> m_cancel;
+  std::thread m_builder;
+};
+
+#endif // GVLODCHAIN_H
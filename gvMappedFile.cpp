@@ -0,0 +1,80 @@
+#include "gvMappedFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+gvMappedFile::gvMappedFile()
+  : m_data(nullptr),
+    m_size(0)
+{
+}
+
+gvMappedFile::~gvMappedFile()
+{
+  this->close();
+}
+
+bool gvMappedFile::open(const std::string &fileName)
+{
+  this->close();
+
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0)
+    {
+    return false;
+    }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size <= 0)
+    {
+    ::close(fd);
+    return false;
+    }
+
+  void *data = mmap(nullptr, static_cast<std::size_t>(info.st_size),
+                    PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file:
+  ::close(fd);
+
+  if (data == MAP_FAILED)
+    {
+    return false;
+    }
+
+  m_data = data;
+  m_size = static_cast<std::size_t>(info.st_size);
+  return true;
+}
+
+void gvMappedFile::close()
+{
+  if (m_data)
+    {
+    munmap(m_data, m_size);
+    m_data = nullptr;
+    m_size = 0;
+    }
+}
+
+void gvMappedFile::adviseSequential() const
+{
+  if (m_data)
+    {
+    madvise(m_data, m_size, MADV_SEQUENTIAL);
+    }
+}
+
+bool gvMappedFile::statFile(const std::string &fileName, std::uint64_t &size,
+                            std::int64_t &mtime)
+{
+  struct stat info;
+  if (stat(fileName.c_str(), &info) != 0)
+    {
+    return false;
+    }
+  size = static_cast<std::uint64_t>(info.st_size);
+  mtime = static_cast<std::int64_t>(info.st_mtime);
+  return true;
+}
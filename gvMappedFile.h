@@ -0,0 +1,39 @@
+#ifndef GVMAPPEDFILE_H
+#define GVMAPPEDFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A read-only view of a whole file mapped into memory. The mapping is private,
+// so accidental writes through data() never reach the file.
+class gvMappedFile
+{
+public:
+  gvMappedFile();
+  ~gvMappedFile();
+
+  bool open(const std::string &fileName);
+  void close();
+
+  bool isOpen() const { return m_data != nullptr; }
+  char* data() const { return static_cast<char*>(m_data); }
+  std::size_t size() const { return m_size; }
+
+  // Tell the kernel the file will be read front to back.
+  void adviseSequential() const;
+
+  // Size and modification time (seconds) of a file, used to detect stale
+  // derived files. Returns false if the file doesn't exist.
+  static bool statFile(const std::string &fileName, std::uint64_t &size,
+                       std::int64_t &mtime);
+
+private:
+  gvMappedFile(const gvMappedFile&) = delete;
+  gvMappedFile& operator=(const gvMappedFile&) = delete;
+
+  void *m_data;
+  std::size_t m_size;
+};
+
+#endif // GVMAPPEDFILE_H
@@ -0,0 +1,498 @@
+#include "gvMeshCache.h"
+
+#include "gvMappedFile.h"
+#include "gvMeshUtilities.h"
+
+#include <vtkCallbackCommand.h>
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkCommand.h>
+#include <vtkDataArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkVersion.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace {
+
+const char CacheMagic[8] = { 'G', 'V', 'M', 'E', 'S', 'H', '\0', '\0' };
+const std::uint32_t CacheVersion = 6;
+const std::uint64_t SectionAlignment = 64;
+
+// How the polygon index buffer is laid out. It must match the VTK build
+// reading the cache so the mapped indices can be handed over without copies.
+enum CellLayout
+{
+  LegacyCellLayout = 0,  // (npts, id0, id1, ...) per cell
+  OffsetsCellLayout = 1  // Separate offsets and connectivity arrays
+};
+
+#if VTK_MAJOR_VERSION >= 9
+const std::uint32_t NativeCellLayout = OffsetsCellLayout;
+#else
+const std::uint32_t NativeCellLayout = LegacyCellLayout;
+#endif
+
+struct CacheHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t idTypeSize;
+  std::uint32_t cellLayout;
+  std::int32_t pointsType; // VTK data type of the positions, as in the source
+  std::uint32_t optimized; // Written after gvMeshOptimizer
+  float featureAngle;      // Of gvMeshNormals, or -1 for the source's normals
+  double weldTolerance;    // Of gvMeshOptimizer, if optimized
+  std::uint64_t sourceSize;
+  std::int64_t sourceMTime;
+  std::uint64_t numberOfPoints;
+  std::uint64_t numberOfPolys;
+  std::uint64_t numberOfArrays; // Point data, described after the header
+  // Number of vtkIdType entries in each cell section. The legacy layout only
+  // uses the first one; the offsets layout stores offsets, then connectivity.
+  std::uint64_t cellsLength[2];
+  std::uint64_t pointsOffset;
+  std::uint64_t cellsOffset[2];
+};
+
+// One per point data array, stored with its source type and components.
+struct ArrayHeader
+{
+  char name[64];
+  std::int32_t dataType;
+  std::int32_t numberOfComponents;
+  std::int32_t attribute; // vtkDataSetAttributes::AttributeTypes, or -1
+  std::uint32_t padding;
+  std::uint64_t offset;
+};
+
+std::uint64_t align(std::uint64_t offset)
+{
+  return (offset + SectionAlignment - 1) / SectionAlignment * SectionAlignment;
+}
+
+void pad(std::ofstream &out, std::uint64_t offset)
+{
+  static const char zeros[SectionAlignment] = { 0 };
+  std::uint64_t position = static_cast<std::uint64_t>(out.tellp());
+  if (offset > position)
+    {
+    out.write(zeros, static_cast<std::streamsize>(offset - position));
+    }
+}
+
+template <typename T>
+void writeValues(std::ofstream &out, const std::vector<T> &values)
+{
+  out.write(reinterpret_cast<const char*>(values.data()),
+            static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+std::uint64_t arrayBytes(vtkDataArray *array)
+{
+  return static_cast<std::uint64_t>(array->GetNumberOfTuples()) *
+    static_cast<std::uint64_t>(array->GetNumberOfComponents()) *
+    static_cast<std::uint64_t>(array->GetDataTypeSize());
+}
+
+// Whether the cache can hold data without losing anything the source had;
+// otherwise reason says what it would drop.
+bool isCacheable(vtkPolyData *data, std::string &reason)
+{
+  if (data->GetPoints()->GetDataType() == VTK_BIT)
+    {
+    reason = "bit positions";
+    return false;
+    }
+  if (data->GetCellData()->GetNumberOfArrays() > 0)
+    {
+    reason = "cell data";
+    return false;
+    }
+  vtkPointData *pointData = data->GetPointData();
+  for (int i = 0; i < pointData->GetNumberOfArrays(); ++i)
+    {
+    vtkDataArray *array = pointData->GetArray(i);
+    if (!array || array->GetDataType() == VTK_BIT)
+      {
+      reason = "non-numeric point data";
+      return false;
+      }
+    const char *name = array->GetName();
+    if (name && std::strlen(name) >= sizeof(ArrayHeader().name))
+      {
+      reason = std::string("a point array named ") + name;
+      return false;
+      }
+    }
+  return true;
+}
+
+// The mapping must outlive every VTK array wrapping it. Each array holds a
+// reference that is dropped when VTK deletes the array.
+void releaseMapping(vtkObject*, unsigned long, void *clientData, void*)
+{
+  delete static_cast<std::shared_ptr<gvMappedFile>*>(clientData);
+}
+
+void keepMappingAlive(vtkObject *array,
+                      const std::shared_ptr<gvMappedFile> &file)
+{
+  vtkNew<vtkCallbackCommand> release;
+  release->SetCallback(releaseMapping);
+  release->SetClientData(new std::shared_ptr<gvMappedFile>(file));
+  array->AddObserver(vtkCommand::DeleteEvent, release.Get());
+}
+
+// The array of the given type stored at offset, or null if the type is
+// unknown or the array would run past the end of the file.
+vtkSmartPointer<vtkDataArray> mapArray(
+    const std::shared_ptr<gvMappedFile> &file, int dataType,
+    int numberOfComponents, std::uint64_t offset, std::uint64_t tuples)
+{
+  vtkSmartPointer<vtkDataArray> array;
+  if (dataType == VTK_BIT || numberOfComponents < 1)
+    {
+    return nullptr;
+    }
+  array.TakeReference(vtkDataArray::CreateDataArray(dataType));
+  if (!array)
+    {
+    return nullptr;
+    }
+  array->SetNumberOfComponents(numberOfComponents);
+  std::uint64_t values =
+    tuples * static_cast<std::uint64_t>(numberOfComponents);
+  if (offset + values * static_cast<std::uint64_t>(array->GetDataTypeSize())
+        > file->size())
+    {
+    return nullptr;
+    }
+  array->SetVoidArray(file->data() + offset, static_cast<vtkIdType>(values),
+                      1);
+  keepMappingAlive(array.Get(), file);
+  return array;
+}
+
+vtkSmartPointer<vtkIdTypeArray> mapIds(
+    const std::shared_ptr<gvMappedFile> &file, std::uint64_t offset,
+    std::uint64_t length)
+{
+  vtkSmartPointer<vtkIdTypeArray> array =
+    vtkSmartPointer<vtkIdTypeArray>::New();
+  array->SetArray(reinterpret_cast<vtkIdType*>(file->data() + offset),
+                  static_cast<vtkIdType>(length), 1);
+  keepMappingAlive(array.Get(), file);
+  return array;
+}
+
+} // end anon namespace
+
+std::string gvMeshCache::cacheFileName(const std::string &sourceFileName)
+{
+  return sourceFileName + ".gvcache";
+}
+
+vtkSmartPointer<vtkPolyData> gvMeshCache::read(
+    const std::string &sourceFileName, bool optimized, double weldTolerance,
+    double featureAngle)
+{
+  std::uint64_t sourceSize;
+  std::int64_t sourceMTime;
+  if (!gvMappedFile::statFile(sourceFileName, sourceSize, sourceMTime))
+    {
+    return nullptr;
+    }
+
+  std::shared_ptr<gvMappedFile> file = std::make_shared<gvMappedFile>();
+  if (!file->open(cacheFileName(sourceFileName)) ||
+      file->size() < sizeof(CacheHeader))
+    {
+    return nullptr;
+    }
+
+  CacheHeader header;
+  std::memcpy(&header, file->data(), sizeof(header));
+  if (std::memcmp(header.magic, CacheMagic, sizeof(CacheMagic)) != 0 ||
+      header.version != CacheVersion ||
+      header.idTypeSize != sizeof(vtkIdType) ||
+      header.cellLayout != NativeCellLayout)
+    {
+    std::cout << "Ignoring incompatible mesh cache for " << sourceFileName
+              << std::endl;
+    return nullptr;
+    }
+
+  if (header.sourceSize != sourceSize || header.sourceMTime != sourceMTime)
+    {
+    std::cout << "Ignoring stale mesh cache for " << sourceFileName
+              << std::endl;
+    return nullptr;
+    }
+
+  if (header.optimized != (optimized ? 1u : 0u))
+    {
+    std::cout << "Ignoring mesh cache for " << sourceFileName
+              << (header.optimized ? " (optimized)" : " (not optimized)")
+              << std::endl;
+    return nullptr;
+    }
+
+  if (optimized && header.weldTolerance != weldTolerance)
+    {
+    std::cout << "Ignoring mesh cache for " << sourceFileName
+              << " (welded with a tolerance of " << header.weldTolerance
+              << ")" << std::endl;
+    return nullptr;
+    }
+
+  if (header.featureAngle >= 0.f &&
+      header.featureAngle != static_cast<float>(featureAngle))
+    {
+    std::cout << "Ignoring mesh cache for " << sourceFileName
+              << " (normals for a feature angle of " << header.featureAngle
+              << " degrees)" << std::endl;
+    return nullptr;
+    }
+
+  // Make sure every section lies within the file before mapping it; the
+  // arrays are checked as they are mapped:
+  std::uint64_t end = align(sizeof(CacheHeader)) +
+    header.numberOfArrays * sizeof(ArrayHeader);
+  for (int i = 0; i < 2; ++i)
+    {
+    end = std::max(end, header.cellsOffset[i] +
+                   header.cellsLength[i] * sizeof(vtkIdType));
+    }
+  if (end > file->size())
+    {
+    std::cerr << "ERROR: Truncated mesh cache for " << sourceFileName
+              << std::endl;
+    return nullptr;
+    }
+
+  vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+
+  vtkSmartPointer<vtkDataArray> positions = mapArray(
+    file, header.pointsType, 3, header.pointsOffset, header.numberOfPoints);
+  if (!positions)
+    {
+    std::cerr << "ERROR: Truncated mesh cache for " << sourceFileName
+              << std::endl;
+    return nullptr;
+    }
+  vtkNew<vtkPoints> points;
+  points->SetData(positions);
+  output->SetPoints(points.Get());
+
+  vtkPointData *pointData = output->GetPointData();
+  for (std::uint64_t i = 0; i < header.numberOfArrays; ++i)
+    {
+    ArrayHeader arrayHeader;
+    std::memcpy(&arrayHeader, file->data() + align(sizeof(CacheHeader)) +
+                i * sizeof(ArrayHeader), sizeof(arrayHeader));
+    arrayHeader.name[sizeof(arrayHeader.name) - 1] = '\0';
+    vtkSmartPointer<vtkDataArray> array = mapArray(
+      file, arrayHeader.dataType, arrayHeader.numberOfComponents,
+      arrayHeader.offset, header.numberOfPoints);
+    if (!array)
+      {
+      std::cerr << "ERROR: Truncated mesh cache for " << sourceFileName
+                << std::endl;
+      return nullptr;
+      }
+    if (arrayHeader.name[0])
+      {
+      array->SetName(arrayHeader.name);
+      }
+    int index = pointData->AddArray(array);
+    if (arrayHeader.attribute >= 0)
+      {
+      pointData->SetActiveAttribute(index, arrayHeader.attribute);
+      }
+    }
+
+  vtkNew<vtkCellArray> polys;
+#if VTK_MAJOR_VERSION >= 9
+  polys->SetData(mapIds(file, header.cellsOffset[0], header.cellsLength[0]),
+                 mapIds(file, header.cellsOffset[1], header.cellsLength[1]));
+#else
+  polys->SetCells(static_cast<vtkIdType>(header.numberOfPolys),
+                  mapIds(file, header.cellsOffset[0], header.cellsLength[0]));
+#endif
+  output->SetPolys(polys.Get());
+
+  return output;
+}
+
+bool gvMeshCache::write(const std::string &sourceFileName, vtkPolyData *data,
+                        bool optimized, double weldTolerance,
+                        double featureAngle)
+{
+  if (!data || !data->GetPoints() || data->GetNumberOfPolys() == 0 ||
+      data->GetNumberOfVerts() > 0 || data->GetNumberOfLines() > 0 ||
+      data->GetNumberOfStrips() > 0)
+    {
+    return false;
+    }
+
+  std::string reason;
+  if (!isCacheable(data, reason))
+    {
+    std::cout << "Not caching " << sourceFileName << ": the mesh cache "
+              << "can't hold its " << reason << std::endl;
+    return false;
+    }
+
+  CacheHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, CacheMagic, sizeof(CacheMagic));
+  header.version = CacheVersion;
+  header.idTypeSize = sizeof(vtkIdType);
+  header.cellLayout = NativeCellLayout;
+  header.optimized = optimized ? 1 : 0;
+  header.weldTolerance = optimized ? weldTolerance : 0.;
+  header.featureAngle = featureAngle >= 0. ?
+    static_cast<float>(featureAngle) : -1.f;
+
+  if (!gvMappedFile::statFile(sourceFileName, header.sourceSize,
+                              header.sourceMTime))
+    {
+    return false;
+    }
+
+  vtkDataArray *positions = data->GetPoints()->GetData();
+  vtkPointData *pointData = data->GetPointData();
+  vtkCellArray *polys = data->GetPolys();
+  header.pointsType = positions->GetDataType();
+  header.numberOfPoints = static_cast<std::uint64_t>(data->GetNumberOfPoints());
+  header.numberOfPolys = static_cast<std::uint64_t>(polys->GetNumberOfCells());
+  header.numberOfArrays =
+    static_cast<std::uint64_t>(pointData->GetNumberOfArrays());
+
+  std::uint64_t connectivity = 0;
+  vtkIdType npts;
+  gvCellPointIds pts;
+  for (polys->InitTraversal(); polys->GetNextCell(npts, pts);)
+    {
+    connectivity += static_cast<std::uint64_t>(npts);
+    }
+#if VTK_MAJOR_VERSION >= 9
+  header.cellsLength[0] = header.numberOfPolys + 1;
+  header.cellsLength[1] = connectivity;
+#else
+  header.cellsLength[0] = header.numberOfPolys + connectivity;
+  header.cellsLength[1] = 0;
+#endif
+
+  // Positions, then each point array, each section aligned:
+  header.pointsOffset = align(align(sizeof(CacheHeader)) +
+                              header.numberOfArrays * sizeof(ArrayHeader));
+  std::uint64_t section = align(header.pointsOffset + arrayBytes(positions));
+  std::vector<ArrayHeader> arrays(header.numberOfArrays);
+  for (std::size_t i = 0; i < arrays.size(); ++i)
+    {
+    vtkDataArray *array = pointData->GetArray(static_cast<int>(i));
+    std::memset(&arrays[i], 0, sizeof(ArrayHeader));
+    if (array->GetName())
+      {
+      std::strcpy(arrays[i].name, array->GetName());
+      }
+    arrays[i].dataType = array->GetDataType();
+    arrays[i].numberOfComponents = array->GetNumberOfComponents();
+    arrays[i].attribute = pointData->IsArrayAnAttribute(static_cast<int>(i));
+    arrays[i].offset = section;
+    section = align(section + arrayBytes(array));
+    }
+  header.cellsOffset[0] = section;
+  header.cellsOffset[1] = align(header.cellsOffset[0] +
+                                header.cellsLength[0] * sizeof(vtkIdType));
+
+  std::string cacheName = cacheFileName(sourceFileName);
+  std::string tempName = cacheName + ".tmp";
+  std::ofstream out(tempName.c_str(), std::ios::binary | std::ios::trunc);
+  if (!out)
+    {
+    return false;
+    }
+
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  pad(out, align(sizeof(CacheHeader)));
+  writeValues(out, arrays);
+
+  // Positions and point arrays are stored as they are, so nothing loses
+  // precision:
+  pad(out, header.pointsOffset);
+  out.write(static_cast<const char*>(positions->GetVoidPointer(0)),
+            static_cast<std::streamsize>(arrayBytes(positions)));
+  for (std::size_t i = 0; i < arrays.size(); ++i)
+    {
+    vtkDataArray *array = pointData->GetArray(static_cast<int>(i));
+    pad(out, arrays[i].offset);
+    out.write(static_cast<const char*>(array->GetVoidPointer(0)),
+              static_cast<std::streamsize>(arrayBytes(array)));
+    }
+
+  // Polygon index buffer in the native layout, written in blocks:
+  const vtkIdType blockSize = 1 << 16;
+  std::vector<vtkIdType> ids;
+  pad(out, header.cellsOffset[0]);
+#if VTK_MAJOR_VERSION >= 9
+  vtkIdType offset = 0;
+  ids.push_back(offset);
+  for (polys->InitTraversal(); polys->GetNextCell(npts, pts);)
+    {
+    offset += npts;
+    ids.push_back(offset);
+    if (ids.size() >= static_cast<std::size_t>(blockSize))
+      {
+      writeValues(out, ids);
+      ids.clear();
+      }
+    }
+  writeValues(out, ids);
+  ids.clear();
+  pad(out, header.cellsOffset[1]);
+  for (polys->InitTraversal(); polys->GetNextCell(npts, pts);)
+    {
+    ids.insert(ids.end(), pts, pts + npts);
+    if (ids.size() >= static_cast<std::size_t>(blockSize))
+      {
+      writeValues(out, ids);
+      ids.clear();
+      }
+    }
+#else
+  for (polys->InitTraversal(); polys->GetNextCell(npts, pts);)
+    {
+    ids.push_back(npts);
+    ids.insert(ids.end(), pts, pts + npts);
+    if (ids.size() >= static_cast<std::size_t>(blockSize))
+      {
+      writeValues(out, ids);
+      ids.clear();
+      }
+    }
+#endif
+  writeValues(out, ids);
+
+  out.close();
+  if (!out || std::rename(tempName.c_str(), cacheName.c_str()) != 0)
+    {
+    std::remove(tempName.c_str());
+    return false;
+    }
+
+  return true;
+}
@@ -0,0 +1,43 @@
+#ifndef GVMESHCACHE_H
+#define GVMESHCACHE_H
+
+#include <vtkSmartPointer.h>
+
+#include <string>
+
+class vtkPolyData;
+
+// Versioned binary cache of a parsed mesh, stored next to its source file as
+// "<source>.gvcache". The cache holds the positions and every point data
+// array in their source types, with their names and attribute roles, the
+// polygon index buffer in VTK's native cell array layout, and the size and
+// modification time of the source file, which tell when it is stale.
+// Reading maps the cache into memory and wraps the mapped sections in VTK
+// arrays without copying.
+class gvMeshCache
+{
+public:
+  static std::string cacheFileName(const std::string &sourceFileName);
+
+  // Map the cache for sourceFileName. Returns null if there is no cache, it
+  // was written by an incompatible build, the source file's size or
+  // modification time no longer match, whether it holds a mesh run
+  // through gvMeshOptimizer differs from optimized, an optimized mesh was
+  // welded with another tolerance, or its normals were computed by
+  // gvMeshNormals for another feature angle.
+  static vtkSmartPointer<vtkPolyData> read(const std::string &sourceFileName,
+                                           bool optimized = false,
+                                           double weldTolerance = 0.,
+                                           double featureAngle = -1.);
+
+  // Write the cache for sourceFileName, recording whether data was
+  // optimized and with which weld tolerance, and the feature angle its
+  // normals were computed for, negative if they came with the source. Only polygonal meshes are cached; returns
+  // false if data has other cell types, cell data or non-numeric point data,
+  // which a cache read would drop, or if the file can't be written.
+  static bool write(const std::string &sourceFileName, vtkPolyData *data,
+                    bool optimized = false, double weldTolerance = 0.,
+                    double featureAngle = -1.);
+};
+
+#endif // GVMESHCACHE_H
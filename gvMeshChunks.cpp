@@ -0,0 +1,162 @@
+#include "gvMeshChunks.h"
+
+#include "gvBVH.h"
+#include "gvMeshUtilities.h"
+#include "gvParallel.h"
+
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkIdList.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+
+gvMeshChunks::gvMeshChunks()
+  : m_numberOfTriangles(0)
+{
+}
+
+std::shared_ptr<gvMeshChunks> gvMeshChunks::build(
+    vtkPolyData *geometry, const gvBVH &index, std::size_t targetTriangles,
+    unsigned int numberOfThreads)
+{
+  const std::vector<gvBVH::Node> &nodes = index.nodes();
+  if (nodes.empty() || index.numberOfTriangles() <= targetTriangles)
+    {
+    return nullptr;
+    }
+
+  std::shared_ptr<gvMeshChunks> result(new gvMeshChunks);
+  result->m_numberOfTriangles = index.numberOfTriangles();
+
+  // The largest subtrees under the target size become chunks. Walking left
+  // first keeps chunks in triangle order.
+  std::vector<std::uint32_t> stack(1, 0);
+  while (!stack.empty())
+    {
+    const gvBVH::Node &node = nodes[stack.back()];
+    stack.pop_back();
+    if (!node.isLeaf() && node.numberOfTriangles() > targetTriangles)
+      {
+      stack.push_back(node.offset + 1);
+      stack.push_back(node.offset);
+      continue;
+      }
+
+    const gvBVH::Node *leftmost = &node;
+    while (!leftmost->isLeaf())
+      {
+      leftmost = &nodes[leftmost->offset];
+      }
+    Chunk chunk;
+    for (int i = 0; i < 3; ++i)
+      {
+      chunk.bounds[2 * i] = node.lower[i];
+      chunk.bounds[2 * i + 1] = node.upper[i];
+      }
+    chunk.first = leftmost->offset;
+    chunk.numberOfTriangles = node.numberOfTriangles();
+    chunk.numberOfEdges = 0;
+    result->m_chunks.push_back(chunk);
+    }
+
+  // Give each chunk its own compact copy of the points it uses:
+  vtkDataArray *positions = geometry->GetPoints()->GetData();
+  gvParallel::forEach(result->m_chunks.size(), [&](std::size_t c)
+    {
+    Chunk &chunk = result->m_chunks[c];
+    std::size_t count = chunk.numberOfTriangles;
+
+    // Draw in the mesh's own triangle order, which gvMeshOptimizer may have
+    // arranged for the vertex cache:
+    std::vector<std::size_t> order(count);
+    for (std::size_t t = 0; t < count; ++t)
+      {
+      order[t] = chunk.first + t;
+      }
+    std::sort(order.begin(), order.end(),
+              [&index](std::size_t a, std::size_t b)
+      {
+      return index.sourceTriangle(a) < index.sourceTriangle(b);
+      });
+
+    std::vector<vtkIdType> used;
+    used.reserve(3 * count);
+    for (std::size_t t = 0; t < count; ++t)
+      {
+      const std::uint32_t *ids = index.triangle(order[t]);
+      used.insert(used.end(), ids, ids + 3);
+      }
+    std::sort(used.begin(), used.end());
+    used.erase(std::unique(used.begin(), used.end()), used.end());
+
+    vtkNew<vtkIdList> pointIds;
+    pointIds->SetNumberOfIds(static_cast<vtkIdType>(used.size()));
+    std::copy(used.begin(), used.end(), pointIds->GetPointer(0));
+
+    std::vector<vtkIdType> local(3 * count);
+    for (std::size_t t = 0; t < count; ++t)
+      {
+      const std::uint32_t *ids = index.triangle(order[t]);
+      for (int v = 0; v < 3; ++v)
+        {
+        local[3 * t + v] = static_cast<vtkIdType>(
+          std::lower_bound(used.begin(), used.end(),
+                           static_cast<vtkIdType>(ids[v])) - used.begin());
+        }
+      }
+
+    vtkDataArray *chunkPositions = positions->NewInstance();
+    chunkPositions->SetNumberOfComponents(3);
+    chunkPositions->SetNumberOfTuples(pointIds->GetNumberOfIds());
+    positions->GetTuples(pointIds.Get(), chunkPositions);
+    vtkNew<vtkPoints> points;
+    points->SetData(chunkPositions);
+    chunkPositions->Delete();
+
+    chunk.data = vtkSmartPointer<vtkPolyData>::New();
+    chunk.data->SetPoints(points.Get());
+    chunk.data->SetPolys(gvMeshUtilities::newTriangles(local.data(), count));
+    gvMeshUtilities::copyPointData(geometry->GetPointData(), pointIds.Get(),
+                                   chunk.data->GetPointData());
+    gvMeshUtilities::prepareForSharing(chunk.data);
+
+    // The other representations share the points and their attributes:
+    std::vector<vtkIdType> edges;
+    gvMeshUtilities::uniqueEdges(local.data(), count, edges);
+    chunk.numberOfEdges = edges.size() / 2;
+    chunk.edges = vtkSmartPointer<vtkPolyData>::New();
+    chunk.edges->SetPoints(points.Get());
+    chunk.edges->GetPointData()->ShallowCopy(chunk.data->GetPointData());
+    chunk.edges->SetLines(
+      gvMeshUtilities::newCells(edges.data(), 2, chunk.numberOfEdges));
+    gvMeshUtilities::prepareForSharing(chunk.edges);
+
+    std::vector<vtkIdType> all(used.size());
+    for (std::size_t p = 0; p < all.size(); ++p)
+      {
+      all[p] = static_cast<vtkIdType>(p);
+      }
+    chunk.vertices = vtkSmartPointer<vtkPolyData>::New();
+    chunk.vertices->SetPoints(points.Get());
+    chunk.vertices->GetPointData()->ShallowCopy(chunk.data->GetPointData());
+    chunk.vertices->SetVerts(
+      gvMeshUtilities::newCells(all.data(), all.size(), 1));
+    gvMeshUtilities::prepareForSharing(chunk.vertices);
+    }, numberOfThreads);
+
+  return result;
+}
+
+void gvMeshChunks::releaseData()
+{
+  for (std::size_t i = 0; i < m_chunks.size(); ++i)
+    {
+    m_chunks[i].data = nullptr;
+    m_chunks[i].edges = nullptr;
+    m_chunks[i].vertices = nullptr;
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef GVMESHCHUNKS_H
+#define GVMESHCHUNKS_H
+
+#include <vtkSmartPointer.h>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class gvBVH;
+class vtkPolyData;
+
+// The loaded mesh split into spatially compact chunks that can be culled
+// independently. Chunks are subtrees of the spatial index, so each one is a
+// contiguous draw range of the index's triangle order; its data holds just
+// those triangles and the points they use, with all point attributes.
+// Each chunk also has the cells its other representations draw over the
+// same points and attributes: every edge once as a line, and every point
+// once as a vertex. A mapper per representation then shows each shared
+// edge and point once, instead of once per triangle using it.
+class gvMeshChunks
+{
+public:
+  struct Chunk
+  {
+    double bounds[6];
+    std::size_t first;             // Draw range in the index's triangle order
+    std::size_t numberOfTriangles;
+    vtkSmartPointer<vtkPolyData> data;
+    vtkSmartPointer<vtkPolyData> edges;    // Lines over data's points
+    vtkSmartPointer<vtkPolyData> vertices; // One poly-vertex of all points
+    std::size_t numberOfEdges;
+  };
+
+  // Split geometry into chunks of at most about targetTriangles along the
+  // subtrees of index. Returns null if the mesh fits in a single chunk.
+  static std::shared_ptr<gvMeshChunks> build(vtkPolyData *geometry,
+                                             const gvBVH &index,
+                                             std::size_t targetTriangles,
+                                             unsigned int numberOfThreads = 0);
+
+  const std::vector<Chunk>& chunks() const { return m_chunks; }
+  std::size_t numberOfTriangles() const { return m_numberOfTriangles; }
+
+  // Drop the chunks' poly data, edges and vertices once they are drawn from
+  // another copy, such as a gvCompactMesh built from them. Bounds, ranges
+  // and counts stay.
+  void releaseData();
+
+private:
+  gvMeshChunks();
+
+  std::vector<Chunk> m_chunks;
+  std::size_t m_numberOfTriangles;
+};
+
+#endif // GVMESHCHUNKS_H
@@ -0,0 +1,722 @@
+#include "gvMeshNormals.h"
+
+#include "gvMeshUtilities.h"
+#include "gvParallel.h"
+
+#include <vtkDataArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdList.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Points with up to this many triangles compare the triangles' edges pairwise
+// instead of sorting them.
+const std::uint32_t SmallFan = 16;
+
+// Replace values by their exclusive prefix sums and return the total.
+template <typename T>
+T exclusiveScan(std::vector<T> &values, unsigned int threads)
+{
+  std::size_t count = values.size();
+  std::size_t blocks = std::max<std::size_t>(
+    1, std::min<std::size_t>(count, threads));
+  std::vector<T> sums(blocks + 1, 0);
+  gvParallel::forEach(blocks, [&](std::size_t b)
+    {
+    T sum = 0;
+    for (std::size_t i = count * b / blocks; i < count * (b + 1) / blocks; ++i)
+      {
+      sum += values[i];
+      }
+    sums[b + 1] = sum;
+    }, threads);
+  for (std::size_t b = 0; b < blocks; ++b)
+    {
+    sums[b + 1] += sums[b];
+    }
+  gvParallel::forEach(blocks, [&](std::size_t b)
+    {
+    T sum = sums[b];
+    for (std::size_t i = count * b / blocks; i < count * (b + 1) / blocks; ++i)
+      {
+      T value = values[i];
+      values[i] = sum;
+      sum += value;
+      }
+    }, threads);
+  return sums[blocks];
+}
+
+// atan2(y, x) for y >= 0 within 1e-5 radians, without the branches and
+// range reduction of the library's, which dominate the triangle loop
+// otherwise. Angles only weight the normals, so this is plenty.
+inline float cornerAngle(float y, float x)
+{
+  const float pi = 3.14159265f;
+  float ax = std::fabs(x);
+  float a = std::min(ax, y) / std::max(std::max(ax, y), 1e-30f);
+  float s = a * a;
+  float r = ((-0.0464964749f * s + 0.15931422f) * s - 0.327622764f) * s * a +
+    a;
+  r = y > ax ? 0.5f * pi - r : r;
+  return x < 0.f ? pi - r : r;
+}
+
+// Unit normal and corner angles of every triangle; degenerate triangles get
+// zeros. Straight-line arithmetic on flat arrays between the gathers, so the
+// compiler can vectorize it.
+template <typename Real>
+void triangleNormals(const Real *xyz, const std::vector<vtkIdType> &ids,
+                     std::vector<float> &normals, std::vector<float> &angles,
+                     unsigned int threads)
+{
+  std::size_t numberOfTriangles = ids.size() / 3;
+  normals.resize(3 * numberOfTriangles);
+  angles.resize(3 * numberOfTriangles);
+  gvParallel::forRange(numberOfTriangles,
+                       [&](std::size_t begin, std::size_t end)
+    {
+    for (std::size_t t = begin; t < end; ++t)
+      {
+      const Real *p[3];
+      for (int k = 0; k < 3; ++k)
+        {
+        p[k] = xyz + 3 * ids[3 * t + k];
+        }
+      double edge[3][3];
+      for (int k = 0; k < 3; ++k)
+        {
+        for (int j = 0; j < 3; ++j)
+          {
+          edge[k][j] = static_cast<double>(p[(k + 1) % 3][j]) - p[k][j];
+          }
+        }
+      double cross[3] = {
+        edge[0][1] * edge[1][2] - edge[0][2] * edge[1][1],
+        edge[0][2] * edge[1][0] - edge[0][0] * edge[1][2],
+        edge[0][0] * edge[1][1] - edge[0][1] * edge[1][0] };
+      double length = std::sqrt(cross[0] * cross[0] + cross[1] * cross[1] +
+                                cross[2] * cross[2]);
+      float *normal = &normals[3 * t];
+      float *angle = &angles[3 * t];
+      if (!(length > 0.))
+        {
+        std::fill(normal, normal + 3, 0.f);
+        std::fill(angle, angle + 3, 0.f);
+        continue;
+        }
+      for (int j = 0; j < 3; ++j)
+        {
+        normal[j] = static_cast<float>(cross[j] / length);
+        }
+      // Twice the area is the sine term at every corner:
+      for (int k = 0; k < 3; ++k)
+        {
+        const double *next = edge[k];
+        const double *previous = edge[(k + 2) % 3];
+        double cosine = -(next[0] * previous[0] + next[1] * previous[1] +
+                          next[2] * previous[2]);
+        angle[k] = cornerAngle(static_cast<float>(length),
+                               static_cast<float>(cosine));
+        }
+      }
+    }, threads);
+}
+
+// A 32-bit hash of a position's bit pattern, the same for 0 and -0.
+template <typename Real>
+std::uint32_t hashPosition(const Real *position)
+{
+  static const std::uint64_t primes[3] = {
+    0x9e3779b97f4a7c15ULL, 0xc2b2ae3d27d4eb4fULL, 0x165667b19e3779f9ULL };
+  std::uint64_t hash = 0;
+  for (int j = 0; j < 3; ++j)
+    {
+    double value = static_cast<double>(position[j]) + 0.;
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    hash ^= bits * primes[j];
+    }
+  hash ^= hash >> 29;
+  return static_cast<std::uint32_t>(hash ^ (hash >> 32));
+}
+
+// Number the distinct positions: points at the same position share a group.
+// Groups are numbered in the order of their first point, so that walking
+// them follows the mesh's own order through memory. Returns the number of
+// groups.
+template <typename Real>
+std::size_t groupPoints(const Real *xyz, std::size_t numberOfPoints,
+                        unsigned int threads,
+                        std::vector<std::uint32_t> &group)
+{
+  // Sorting hashes with the ids in the low bits brings equal positions
+  // together, each run in id order, without indirect comparisons:
+  std::vector<std::uint64_t> keys(numberOfPoints);
+  gvParallel::forRange(numberOfPoints,
+                       [&](std::size_t begin, std::size_t end)
+    {
+    for (std::size_t i = begin; i < end; ++i)
+      {
+      keys[i] = static_cast<std::uint64_t>(hashPosition(xyz + 3 * i)) << 32 |
+        i;
+      }
+    }, threads);
+  gvParallel::sort(keys.begin(), keys.end(), std::less<std::uint64_t>(),
+                   threads);
+
+  // Every point points at the first point with its position. A run of one
+  // hash rarely holds more than one position.
+  auto starts = [&](std::size_t i)
+    {
+    return i == 0 || keys[i] >> 32 != keys[i - 1] >> 32;
+    };
+  std::vector<std::uint32_t> first(numberOfPoints);
+  gvParallel::forRange(numberOfPoints,
+                       [&](std::size_t begin, std::size_t end)
+    {
+    std::vector<std::uint32_t> positions;
+    for (std::size_t i = begin; i < end; ++i)
+      {
+      if (!starts(i))
+        {
+        continue;
+        }
+      positions.clear();
+      std::size_t j = i;
+      do
+        {
+        std::uint32_t point = static_cast<std::uint32_t>(keys[j]);
+        const Real *p = xyz + 3 * static_cast<std::size_t>(point);
+        first[point] = point;
+        for (std::size_t k = 0; k < positions.size(); ++k)
+          {
+          const Real *q = xyz + 3 * static_cast<std::size_t>(positions[k]);
+          if (p[0] == q[0] && p[1] == q[1] && p[2] == q[2])
+            {
+            first[point] = positions[k];
+            break;
+            }
+          }
+        if (first[point] == point)
+          {
+          positions.push_back(point);
+          }
+        ++j;
+        }
+      while (j < numberOfPoints && !starts(j));
+      }
+    }, threads);
+  std::vector<std::uint64_t>().swap(keys);
+
+  group.resize(numberOfPoints);
+  gvParallel::forRange(numberOfPoints,
+                       [&](std::size_t begin, std::size_t end)
+    {
+    for (std::size_t i = begin; i < end; ++i)
+      {
+      group[i] = first[i] == i ? 1 : 0;
+      }
+    }, threads);
+  std::size_t numberOfGroups = exclusiveScan(group, threads);
+  gvParallel::forRange(numberOfPoints,
+                       [&](std::size_t begin, std::size_t end)
+    {
+    for (std::size_t i = begin; i < end; ++i)
+      {
+      if (first[i] != i)
+        {
+        group[i] = group[first[i]];
+        }
+      }
+    }, threads);
+  return numberOfGroups;
+}
+
+// The triangles around every group, at incident[offsets[g]] up to
+// incident[offsets[g + 1]], once per corner in the group.
+void gatherTriangles(const std::vector<vtkIdType> &ids,
+                     const std::vector<std::uint32_t> &group,
+                     std::size_t numberOfGroups, unsigned int threads,
+                     std::vector<std::uint64_t> &offsets,
+                     std::vector<std::uint32_t> &incident)
+{
+  std::size_t numberOfCorners = ids.size();
+  std::unique_ptr<std::atomic<std::uint32_t>[]> counts(
+    new std::atomic<std::uint32_t>[numberOfGroups]);
+  auto clear = [&](std::size_t begin, std::size_t end)
+    {
+    for (std::size_t g = begin; g < end; ++g)
+      {
+      counts[g].store(0, std::memory_order_relaxed);
+      }
+    };
+  gvParallel::forRange(numberOfGroups, clear, threads);
+  gvParallel::forRange(numberOfCorners,
+                       [&](std::size_t begin, std::size_t end)
+    {
+    for (std::size_t c = begin; c < end; ++c)
+      {
+      counts[group[ids[c]]].fetch_add(1, std::memory_order_relaxed);
+      }
+    }, threads);
+
+  offsets.assign(numberOfGroups + 1, 0);
+  gvParallel::forRange(numberOfGroups,
+                       [&](std::size_t begin, std::size_t end)
+    {
+    for (std::size_t g = begin; g < end; ++g)
+      {
+      offsets[g] = counts[g].load(std::memory_order_relaxed);
+      }
+    }, threads);
+  exclusiveScan(offsets, threads);
+
+  gvParallel::forRange(numberOfGroups, clear, threads);
+  incident.resize(numberOfCorners);
+  gvParallel::forRange(numberOfCorners,
+                       [&](std::size_t begin, std::size_t end)
+    {
+    for (std::size_t c = begin; c < end; ++c)
+      {
+      std::uint32_t g = group[ids[c]];
+      std::uint64_t slot = offsets[g] +
+        counts[g].fetch_add(1, std::memory_order_relaxed);
+      incident[slot] = static_cast<std::uint32_t>(c / 3);
+      }
+    }, threads);
+}
+
+// Points split off in one block of groups, numbered from 0 within the block
+// until the blocks' totals are known.
+struct SplitPoints
+{
+  std::vector<vtkIdType> sources;
+  std::vector<float> normals;
+};
+
+struct Corner
+{
+  vtkIdType point;
+  std::uint32_t cluster;
+  std::size_t corner;
+
+  bool operator<(const Corner &other) const
+  {
+    return point != other.point ? point < other.point :
+      cluster < other.cluster;
+  }
+};
+
+std::uint32_t findRoot(std::vector<std::uint32_t> &parent, std::uint32_t i)
+{
+  while (parent[i] != i)
+    {
+    parent[i] = parent[parent[i]];
+    i = parent[i];
+    }
+  return i;
+}
+
+template <typename Real>
+vtkSmartPointer<vtkPolyData> computeNormals(vtkPolyData *data,
+                                            const Real *xyz,
+                                            double featureAngle,
+                                            unsigned int threads,
+                                            std::size_t &numberOfSplits)
+{
+  std::size_t numberOfPoints =
+    static_cast<std::size_t>(data->GetNumberOfPoints());
+  std::vector<vtkIdType> ids;
+  gvMeshUtilities::extractTriangles(data, ids);
+
+  std::vector<float> triangleNormal;
+  std::vector<float> cornerAngle;
+  triangleNormals(xyz, ids, triangleNormal, cornerAngle, threads);
+
+  std::vector<std::uint32_t> group;
+  std::size_t numberOfGroups =
+    groupPoints(xyz, numberOfPoints, threads, group);
+
+  std::vector<std::uint64_t> offsets;
+  std::vector<std::uint32_t> incident;
+  gatherTriangles(ids, group, numberOfGroups, threads, offsets, incident);
+
+  bool split = featureAngle < 180.;
+  double cosine = std::cos(featureAngle * std::acos(-1.) / 180.);
+  std::vector<float> pointNormals(3 * numberOfPoints, 0.f);
+  std::vector<float> groupNormals(split ? 0 : 3 * numberOfGroups, 0.f);
+  std::vector<vtkIdType> corners;
+  if (split)
+    {
+    corners = ids;
+    }
+
+  // Fixed blocks of groups, so split points are numbered the same on any
+  // number of threads:
+  std::size_t blocks = std::max<std::size_t>(
+    1, std::min<std::size_t>(numberOfGroups, 4 * threads));
+  std::vector<SplitPoints> splits(blocks);
+  gvParallel::forEach(blocks, [&](std::size_t b)
+    {
+    std::vector<std::uint32_t> faces;
+    std::vector<std::uint32_t> parent;
+    std::vector<std::pair<std::uint32_t, std::uint32_t> > edges;
+    std::vector<double> sums;
+    std::vector<Corner> keys;
+    SplitPoints &blockSplits = splits[b];
+    for (std::size_t g = numberOfGroups * b / blocks;
+         g < numberOfGroups * (b + 1) / blocks; ++g)
+      {
+      faces.assign(incident.begin() + offsets[g],
+                   incident.begin() + offsets[g + 1]);
+      std::sort(faces.begin(), faces.end());
+      faces.erase(std::unique(faces.begin(), faces.end()), faces.end());
+      std::uint32_t count = static_cast<std::uint32_t>(faces.size());
+      if (count == 0)
+        {
+        continue;
+        }
+
+      // Triangles sharing an edge around the point join the same cluster
+      // unless they meet at more than the feature angle. Degenerate ones
+      // join whatever they touch.
+      parent.resize(count);
+      for (std::uint32_t i = 0; i < count; ++i)
+        {
+        parent[i] = split ? i : 0;
+        }
+      if (split)
+        {
+        edges.clear();
+        for (std::uint32_t i = 0; i < count; ++i)
+          {
+          const vtkIdType *triangle = &ids[3 * faces[i]];
+          for (int k = 0; k < 3; ++k)
+            {
+            std::uint32_t other = group[triangle[k]];
+            if (other != g)
+              {
+              edges.push_back(std::make_pair(other, i));
+              }
+            }
+          }
+        auto join = [&](std::uint32_t first, std::uint32_t second)
+          {
+          const float *na = &triangleNormal[3 * faces[first]];
+          const float *nb = &triangleNormal[3 * faces[second]];
+          double dot = na[0] * nb[0] + na[1] * nb[1] + na[2] * nb[2];
+          bool degenerate = (na[0] == 0.f && na[1] == 0.f && na[2] == 0.f) ||
+            (nb[0] == 0.f && nb[1] == 0.f && nb[2] == 0.f);
+          if (degenerate || dot >= cosine)
+            {
+            parent[findRoot(parent, first)] = findRoot(parent, second);
+            }
+          };
+        // Most points have a handful of triangles, for which comparing all
+        // pairs beats sorting:
+        if (count <= SmallFan)
+          {
+          for (std::size_t e = 0; e < edges.size(); ++e)
+            {
+            for (std::size_t f = e + 1; f < edges.size(); ++f)
+              {
+              if (edges[e].first == edges[f].first &&
+                  edges[e].second != edges[f].second)
+                {
+                join(edges[e].second, edges[f].second);
+                }
+              }
+            }
+          }
+        else
+          {
+          std::sort(edges.begin(), edges.end());
+          for (std::size_t e = 1; e < edges.size(); ++e)
+            {
+            if (edges[e].first == edges[e - 1].first)
+              {
+              join(edges[e - 1].second, edges[e].second);
+              }
+            }
+          }
+        }
+
+      // Angle-weighted sums per cluster, kept at the cluster's root:
+      sums.assign(3 * count, 0.);
+      for (std::uint32_t i = 0; i < count; ++i)
+        {
+        std::uint32_t t = faces[i];
+        double *sum = &sums[3 * findRoot(parent, i)];
+        for (int k = 0; k < 3; ++k)
+          {
+          if (group[ids[3 * t + k]] != g)
+            {
+            continue;
+            }
+          for (int j = 0; j < 3; ++j)
+            {
+            sum[j] += cornerAngle[3 * t + k] * triangleNormal[3 * t + j];
+            }
+          }
+        }
+      for (std::uint32_t i = 0; i < count; ++i)
+        {
+        double *sum = &sums[3 * i];
+        double length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] +
+                                  sum[2] * sum[2]);
+        for (int j = 0; length > 0. && j < 3; ++j)
+          {
+          sum[j] /= length;
+          }
+        }
+
+      if (!split)
+        {
+        for (int j = 0; j < 3; ++j)
+          {
+          groupNormals[3 * g + j] = static_cast<float>(sums[j]);
+          }
+        continue;
+        }
+
+      // Usually all triangles form one cluster and the point keeps its id:
+      std::uint32_t root = findRoot(parent, 0);
+      std::uint32_t same = 1;
+      while (same < count && findRoot(parent, same) == root)
+        {
+        ++same;
+        }
+      if (same == count)
+        {
+        for (std::uint32_t i = 0; i < count; ++i)
+          {
+          for (std::size_t c = 3 * faces[i]; c < 3 * faces[i] + 3; ++c)
+            {
+            for (int j = 0; group[ids[c]] == g && j < 3; ++j)
+              {
+              pointNormals[3 * ids[c] + j] =
+                static_cast<float>(sums[3 * root + j]);
+              }
+            }
+          }
+        continue;
+        }
+
+      // Otherwise a point keeps its id for its first cluster and is copied
+      // for each further one. Copies get negative ids local to the block for
+      // now.
+      keys.clear();
+      for (std::uint32_t i = 0; i < count; ++i)
+        {
+        std::uint32_t cluster = findRoot(parent, i);
+        std::size_t t = faces[i];
+        for (std::size_t c = 3 * t; c < 3 * t + 3; ++c)
+          {
+          if (group[ids[c]] == g)
+            {
+            Corner key = { ids[c], cluster, c };
+            keys.push_back(key);
+            }
+          }
+        }
+      std::sort(keys.begin(), keys.end());
+      vtkIdType id = 0;
+      for (std::size_t k = 0; k < keys.size(); ++k)
+        {
+        const Corner &key = keys[k];
+        const double *normal = &sums[3 * key.cluster];
+        if (k == 0 || key.point != keys[k - 1].point)
+          {
+          id = key.point;
+          for (int j = 0; j < 3; ++j)
+            {
+            pointNormals[3 * key.point + j] = static_cast<float>(normal[j]);
+            }
+          }
+        else if (key.cluster != keys[k - 1].cluster)
+          {
+          id = -1 - static_cast<vtkIdType>(blockSplits.sources.size());
+          blockSplits.sources.push_back(key.point);
+          for (int j = 0; j < 3; ++j)
+            {
+            blockSplits.normals.push_back(static_cast<float>(normal[j]));
+            }
+          }
+        corners[key.corner] = id;
+        }
+      }
+    }, threads);
+
+  if (!split)
+    {
+    gvParallel::forRange(numberOfPoints,
+                         [&](std::size_t begin, std::size_t end)
+      {
+      for (std::size_t i = begin; i < end; ++i)
+        {
+        std::copy(&groupNormals[3 * group[i]], &groupNormals[3 * group[i]] + 3,
+                  &pointNormals[3 * i]);
+        }
+      }, threads);
+    }
+
+  std::vector<std::size_t> splitOffsets(blocks + 1, 0);
+  for (std::size_t b = 0; b < blocks; ++b)
+    {
+    splitOffsets[b + 1] = splitOffsets[b] + splits[b].sources.size();
+    }
+  numberOfSplits = splitOffsets[blocks];
+
+  vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+  vtkSmartPointer<vtkFloatArray> normals =
+    vtkSmartPointer<vtkFloatArray>::New();
+  normals->SetName("Normals");
+  normals->SetNumberOfComponents(3);
+  normals->SetNumberOfTuples(
+    static_cast<vtkIdType>(numberOfPoints + numberOfSplits));
+  std::copy(pointNormals.begin(), pointNormals.end(), normals->GetPointer(0));
+  if (numberOfSplits == 0)
+    {
+    output->ShallowCopy(data);
+    output->GetPointData()->SetNormals(normals);
+    return output;
+    }
+
+  // Resolve the copies' ids now that every block's count is known:
+  std::vector<std::size_t> blockFirst(blocks);
+  for (std::size_t b = 0; b < blocks; ++b)
+    {
+    blockFirst[b] = numberOfGroups * b / blocks;
+    }
+  gvParallel::forRange(corners.size(), [&](std::size_t begin, std::size_t end)
+    {
+    for (std::size_t c = begin; c < end; ++c)
+      {
+      if (corners[c] >= 0)
+        {
+        continue;
+        }
+      std::size_t g = group[ids[c]];
+      std::size_t b = static_cast<std::size_t>(
+        std::upper_bound(blockFirst.begin(), blockFirst.end(), g) -
+        blockFirst.begin()) - 1;
+      corners[c] = static_cast<vtkIdType>(numberOfPoints + splitOffsets[b]) -
+        1 - corners[c];
+      }
+    }, threads);
+
+  vtkNew<vtkIdList> pointIds;
+  pointIds->SetNumberOfIds(
+    static_cast<vtkIdType>(numberOfPoints + numberOfSplits));
+  vtkIdType *source = pointIds->GetPointer(0);
+  for (std::size_t i = 0; i < numberOfPoints; ++i)
+    {
+    source[i] = static_cast<vtkIdType>(i);
+    }
+  gvParallel::forEach(blocks, [&](std::size_t b)
+    {
+    std::copy(splits[b].sources.begin(), splits[b].sources.end(),
+              source + numberOfPoints + splitOffsets[b]);
+    std::copy(splits[b].normals.begin(), splits[b].normals.end(),
+              normals->GetPointer(
+                3 * static_cast<vtkIdType>(numberOfPoints + splitOffsets[b])));
+    }, threads);
+
+  vtkDataArray *positions = data->GetPoints()->GetData();
+  vtkDataArray *outPositions = positions->NewInstance();
+  outPositions->SetNumberOfComponents(3);
+  outPositions->SetNumberOfTuples(pointIds->GetNumberOfIds());
+  positions->GetTuples(pointIds.Get(), outPositions);
+  vtkNew<vtkPoints> points;
+  points->SetData(outPositions);
+  outPositions->Delete();
+
+  output->SetPoints(points.Get());
+  output->SetPolys(gvMeshUtilities::newTriangles(corners.data(),
+                                                 ids.size() / 3));
+  gvMeshUtilities::copyPointData(data->GetPointData(), pointIds.Get(),
+                                 output->GetPointData());
+  output->GetPointData()->SetNormals(normals);
+  return output;
+}
+
+} // end anon namespace
+
+vtkSmartPointer<vtkPolyData> gvMeshNormals::compute(
+    vtkPolyData *data, double featureAngle, unsigned int numberOfThreads)
+{
+  if (!data || data->GetPointData()->GetNormals() ||
+      data->GetNumberOfPolys() == 0)
+    {
+    return data;
+    }
+  if (data->GetNumberOfVerts() > 0 || data->GetNumberOfLines() > 0 ||
+      data->GetNumberOfStrips() > 0)
+    {
+    std::cout << "Not computing normals for a mesh with cells other than "
+                 "polygons." << std::endl;
+    return data;
+    }
+  // Groups and triangles are numbered with 32 bits, as in gvBVH:
+  if (data->GetNumberOfPoints() >=
+        std::numeric_limits<std::uint32_t>::max() ||
+      data->GetNumberOfPolys() >=
+        std::numeric_limits<std::uint32_t>::max() / 3)
+    {
+    std::cout << "Not computing normals for a mesh this large." << std::endl;
+    return data;
+    }
+
+  Clock::time_point start = Clock::now();
+  unsigned int threads = gvParallel::resolveThreads(numberOfThreads);
+  vtkDataArray *positions = data->GetPoints()->GetData();
+  std::size_t numberOfSplits = 0;
+  vtkSmartPointer<vtkPolyData> output;
+  if (positions->GetDataType() == VTK_FLOAT)
+    {
+    output = computeNormals(
+      data, static_cast<vtkFloatArray*>(positions)->GetPointer(0),
+      featureAngle, threads, numberOfSplits);
+    }
+  else
+    {
+    vtkSmartPointer<vtkDoubleArray> converted;
+    if (positions->GetDataType() != VTK_DOUBLE)
+      {
+      converted = vtkSmartPointer<vtkDoubleArray>::New();
+      converted->DeepCopy(positions);
+      positions = converted;
+      }
+    output = computeNormals(
+      data, static_cast<vtkDoubleArray*>(positions)->GetPointer(0),
+      featureAngle, threads, numberOfSplits);
+    }
+
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  std::cout << "Computed normals in " << elapsed.count() << " s ("
+            << threads << " threads): " << data->GetNumberOfPoints()
+            << " points, " << numberOfSplits << " copied along edges "
+            << "sharper than " << featureAngle << " degrees" << std::endl;
+  return output;
+}
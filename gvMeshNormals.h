@@ -0,0 +1,37 @@
+#ifndef GVMESHNORMALS_H
+#define GVMESHNORMALS_H
+
+#include <vtkSmartPointer.h>
+
+class vtkPolyData;
+
+// Point normals for meshes that come without them, computed on worker
+// threads instead of vtkPolyDataNormals' single one:
+//
+//  - a point's normal is the sum of its triangles' unit normals weighted by
+//    their angles at the point (Thuermer and Wuethrich, "Computing Vertex
+//    Normals from Polygonal Facets", JGT 1998), so it doesn't depend on how
+//    the surface happens to be triangulated;
+//  - points at the same position count as one, so seams where a reader
+//    duplicated points for texture coordinates are smoothed over;
+//  - around each point, triangles meeting at an edge at more than the
+//    feature angle are put in separate groups, each shaded from its own
+//    copy of the point, so creases stay sharp.
+//
+// Triangles are expected to be consistently oriented; unlike
+// vtkPolyDataNormals, nothing is flipped.
+class gvMeshNormals
+{
+public:
+  // A copy of data with normals, or data itself if it has normals already,
+  // has no polygons, or has vertices, lines or strips. A feature angle of
+  // 180 degrees or more gives every point one normal and keeps the cells.
+  // Otherwise polygons are fanned into triangles if points were split, and
+  // the copies are appended after the original points. Prints the time
+  // taken and the number of points split.
+  static vtkSmartPointer<vtkPolyData> compute(
+      vtkPolyData *data, double featureAngle,
+      unsigned int numberOfThreads = 0);
+};
+
+#endif // GVMESHNORMALS_H
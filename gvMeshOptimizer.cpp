@@ -0,0 +1,641 @@
+#include "gvMeshOptimizer.h"
+
+#include "gvMeshUtilities.h"
+#include "gvParallel.h"
+
+#include <vtkDataArray.h>
+#include <vtkIdList.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <utility>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Triangles per spatially compact block that is ordered on its own. Larger
+// blocks cost a little more cache efficiency at their borders than they
+// save, and enough of them keep every worker busy.
+const std::size_t BlockTriangles = 1 << 16;
+
+gvMeshOptimizer::Statistics simulateCache(const std::vector<vtkIdType> &ids,
+                                          std::size_t numberOfPoints)
+{
+  // FIFO: a point is cached while fewer than CacheSize misses happened
+  // since its own. Miss times start at 1 so 0 means never seen.
+  std::vector<std::size_t> missTime(numberOfPoints, 0);
+  std::size_t misses = 0;
+  std::size_t used = 0;
+  for (std::size_t i = 0; i < ids.size(); ++i)
+    {
+    std::size_t &time = missTime[ids[i]];
+    if (time == 0)
+      {
+      ++used;
+      }
+    if (time == 0 || misses - time >= gvMeshOptimizer::CacheSize)
+      {
+      time = ++misses;
+      }
+    }
+
+  gvMeshOptimizer::Statistics statistics;
+  statistics.numberOfPoints = used;
+  statistics.numberOfTriangles = ids.size() / 3;
+  statistics.acmr = statistics.numberOfTriangles ?
+    static_cast<double>(misses) / statistics.numberOfTriangles : 0.;
+  statistics.atvr = used ? static_cast<double>(misses) / used : 0.;
+  return statistics;
+}
+
+//------------------------------------------------------------------------------
+// Welding
+
+// FNV-1a over the point's attribute values, so that only points with equal
+// attributes sort next to each other.
+std::uint64_t attributeHash(vtkPointData *pointData, vtkIdType point)
+{
+  const std::uint64_t prime = 0x100000001b3ULL;
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (int a = 0; a < pointData->GetNumberOfArrays(); ++a)
+    {
+    vtkDataArray *array = pointData->GetArray(a);
+    if (!array)
+      {
+      continue;
+      }
+    for (int c = 0; c < array->GetNumberOfComponents(); ++c)
+      {
+      double value = array->GetComponent(point, c);
+      std::uint64_t bits;
+      std::memcpy(&bits, &value, sizeof(bits));
+      hash = (hash ^ bits) * prime;
+      }
+    }
+  return hash;
+}
+
+bool sameAttributes(vtkPointData *pointData, vtkIdType a, vtkIdType b)
+{
+  for (int i = 0; i < pointData->GetNumberOfArrays(); ++i)
+    {
+    vtkDataArray *array = pointData->GetArray(i);
+    if (!array)
+      {
+      continue;
+      }
+    for (int c = 0; c < array->GetNumberOfComponents(); ++c)
+      {
+      if (array->GetComponent(a, c) != array->GetComponent(b, c))
+        {
+        return false;
+        }
+      }
+    }
+  return true;
+}
+
+struct WeldKey
+{
+  std::int64_t cell[3];
+  std::uint64_t attributes;
+  vtkIdType point;
+
+  bool sameClass(const WeldKey &other) const
+  {
+    return cell[0] == other.cell[0] && cell[1] == other.cell[1] &&
+      cell[2] == other.cell[2] && attributes == other.attributes;
+  }
+
+  bool operator<(const WeldKey &other) const
+  {
+    for (int i = 0; i < 3; ++i)
+      {
+      if (cell[i] != other.cell[i])
+        {
+        return cell[i] < other.cell[i];
+        }
+      }
+    if (attributes != other.attributes)
+      {
+      return attributes < other.attributes;
+      }
+    return point < other.point;
+  }
+};
+
+// Map every point to the lowest numbered point it is welded with.
+void weld(vtkPolyData *data, double tolerance, unsigned int threads,
+          std::vector<vtkIdType> &representative)
+{
+  std::size_t numberOfPoints =
+    static_cast<std::size_t>(data->GetNumberOfPoints());
+  representative.resize(numberOfPoints);
+  if (tolerance < 0.)
+    {
+    for (std::size_t i = 0; i < numberOfPoints; ++i)
+      {
+      representative[i] = static_cast<vtkIdType>(i);
+      }
+    return;
+    }
+
+  double bounds[6];
+  data->GetBounds(bounds);
+  double diagonal = 0.;
+  for (int i = 0; i < 3; ++i)
+    {
+    diagonal += (bounds[2 * i + 1] - bounds[2 * i]) *
+      (bounds[2 * i + 1] - bounds[2 * i]);
+    }
+  double spacing = tolerance * std::sqrt(diagonal);
+
+  vtkPoints *points = data->GetPoints();
+  vtkPointData *pointData = data->GetPointData();
+  std::vector<WeldKey> keys(numberOfPoints);
+  gvParallel::forRange(numberOfPoints, [&](std::size_t first,
+                                           std::size_t last)
+    {
+    for (std::size_t i = first; i < last; ++i)
+      {
+      WeldKey &key = keys[i];
+      key.point = static_cast<vtkIdType>(i);
+      double p[3];
+      points->GetPoint(key.point, p);
+      for (int j = 0; j < 3; ++j)
+        {
+        if (spacing > 0.)
+          {
+          key.cell[j] = static_cast<std::int64_t>(
+            std::floor((p[j] - bounds[2 * j]) / spacing));
+          }
+        else
+          {
+          std::memcpy(&key.cell[j], &p[j], sizeof(key.cell[j]));
+          }
+        }
+      key.attributes = attributeHash(pointData, key.point);
+      }
+    }, threads);
+
+  gvParallel::sort(keys.begin(), keys.end(), std::less<WeldKey>(), threads);
+
+  // Hash collisions within a class are told apart by their attributes:
+  std::vector<vtkIdType> classRepresentatives;
+  for (std::size_t i = 0; i < numberOfPoints; ++i)
+    {
+    if (i == 0 || !keys[i].sameClass(keys[i - 1]))
+      {
+      classRepresentatives.clear();
+      }
+    vtkIdType point = keys[i].point;
+    vtkIdType match = point;
+    for (std::size_t r = 0; r < classRepresentatives.size(); ++r)
+      {
+      if (sameAttributes(pointData, classRepresentatives[r], point))
+        {
+        match = classRepresentatives[r];
+        break;
+        }
+      }
+    if (match == point)
+      {
+      classRepresentatives.push_back(point);
+      }
+    representative[point] = match;
+    }
+}
+
+//------------------------------------------------------------------------------
+// Triangle order
+
+// 21 bits of x spread to every third bit.
+std::uint64_t spreadBits(std::uint64_t x)
+{
+  x &= 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffffULL;
+  x = (x | x << 16) & 0x1f0000ff0000ffULL;
+  x = (x | x << 8) & 0x100f00f00f00f00fULL;
+  x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+  x = (x | x << 2) & 0x1249249249249249ULL;
+  return x;
+}
+
+// Tipsify from Sander et al.: walk the triangles of a block fan by fan,
+// moving on to the neighbor that stays longest in a cache of CacheSize
+// entries. order receives the block's triangles in drawing order, and a
+// cluster starts wherever the walk has to jump to a point outside the
+// cache.
+void tipsify(const vtkIdType *triangles, std::size_t count,
+             std::vector<std::uint32_t> &order,
+             std::vector<std::size_t> &clusterStarts)
+{
+  const std::size_t cacheSize = gvMeshOptimizer::CacheSize;
+
+  std::vector<vtkIdType> vertices(triangles, triangles + 3 * count);
+  std::sort(vertices.begin(), vertices.end());
+  vertices.erase(std::unique(vertices.begin(), vertices.end()),
+                 vertices.end());
+  std::size_t numberOfVertices = vertices.size();
+  std::vector<std::uint32_t> corners(3 * count);
+  for (std::size_t c = 0; c < corners.size(); ++c)
+    {
+    corners[c] = static_cast<std::uint32_t>(
+      std::lower_bound(vertices.begin(), vertices.end(), triangles[c]) -
+      vertices.begin());
+    }
+
+  // The triangles around each vertex:
+  std::vector<std::uint32_t> offsets(numberOfVertices + 1, 0);
+  for (std::size_t c = 0; c < corners.size(); ++c)
+    {
+    ++offsets[corners[c] + 1];
+    }
+  for (std::size_t v = 0; v < numberOfVertices; ++v)
+    {
+    offsets[v + 1] += offsets[v];
+    }
+  std::vector<std::uint32_t> adjacency(corners.size());
+  std::vector<std::uint32_t> fill(offsets.begin(), offsets.end() - 1);
+  for (std::size_t c = 0; c < corners.size(); ++c)
+    {
+    adjacency[fill[corners[c]]++] = static_cast<std::uint32_t>(c / 3);
+    }
+
+  std::vector<std::uint32_t> live(numberOfVertices);
+  for (std::size_t v = 0; v < numberOfVertices; ++v)
+    {
+    live[v] = offsets[v + 1] - offsets[v];
+    }
+  std::vector<std::size_t> cacheTime(numberOfVertices, 0);
+  std::vector<bool> emitted(count, false);
+  std::vector<std::uint32_t> deadEnds;
+  std::vector<std::uint32_t> candidates;
+  std::size_t time = cacheSize + 1;
+  std::size_t cursor = 0;
+
+  order.clear();
+  clusterStarts.assign(1, 0);
+  std::int64_t fanning = count > 0 ? 0 : -1;
+  while (fanning >= 0)
+    {
+    std::size_t f = static_cast<std::size_t>(fanning);
+    candidates.clear();
+    for (std::uint32_t a = offsets[f]; a < offsets[f + 1]; ++a)
+      {
+      std::uint32_t t = adjacency[a];
+      if (emitted[t])
+        {
+        continue;
+        }
+      for (int k = 0; k < 3; ++k)
+        {
+        std::uint32_t v = corners[3 * t + k];
+        deadEnds.push_back(v);
+        candidates.push_back(v);
+        --live[v];
+        if (time - cacheTime[v] > cacheSize)
+          {
+          cacheTime[v] = time++;
+          }
+        }
+      emitted[t] = true;
+      order.push_back(t);
+      }
+
+    // Prefer the candidate whose remaining triangles fit in the cache and
+    // that entered it first:
+    std::int64_t next = -1;
+    std::int64_t best = -1;
+    for (std::size_t i = 0; i < candidates.size(); ++i)
+      {
+      std::uint32_t v = candidates[i];
+      if (live[v] == 0)
+        {
+        continue;
+        }
+      std::int64_t priority = 0;
+      if (time - cacheTime[v] + 2 * live[v] <= cacheSize)
+        {
+        priority = static_cast<std::int64_t>(time - cacheTime[v]);
+        }
+      if (priority > best)
+        {
+        best = priority;
+        next = v;
+        }
+      }
+    if (next < 0)
+      {
+      while (!deadEnds.empty() && next < 0)
+        {
+        std::uint32_t v = deadEnds.back();
+        deadEnds.pop_back();
+        if (live[v] > 0)
+          {
+          next = v;
+          }
+        }
+      while (next < 0 && cursor < numberOfVertices)
+        {
+        if (live[cursor] > 0)
+          {
+          next = static_cast<std::int64_t>(cursor);
+          }
+        ++cursor;
+        }
+      if (next >= 0 &&
+          time - cacheTime[static_cast<std::size_t>(next)] > cacheSize)
+        {
+        clusterStarts.push_back(order.size());
+        }
+      }
+    fanning = next;
+    }
+}
+
+struct Cluster
+{
+  std::size_t block;
+  std::size_t begin; // In the block's order
+  std::size_t end;
+  std::size_t first; // In the output
+  double key;        // Drawn in decreasing order
+};
+
+} // end anon namespace
+
+gvMeshOptimizer::Statistics gvMeshOptimizer::measure(vtkPolyData *data)
+{
+  std::vector<vtkIdType> ids;
+  gvMeshUtilities::extractTriangles(data, ids);
+  return simulateCache(ids,
+                       static_cast<std::size_t>(data->GetNumberOfPoints()));
+}
+
+vtkSmartPointer<vtkPolyData> gvMeshOptimizer::optimize(
+    vtkPolyData *data, double weldTolerance, unsigned int numberOfThreads)
+{
+  Clock::time_point start = Clock::now();
+  unsigned int threads = gvParallel::resolveThreads(numberOfThreads);
+
+  if (data->GetNumberOfVerts() > 0 || data->GetNumberOfLines() > 0 ||
+      data->GetNumberOfStrips() > 0)
+    {
+    std::cout << "Not optimizing a mesh with cells other than polygons."
+              << std::endl;
+    return data;
+    }
+  std::vector<vtkIdType> ids;
+  gvMeshUtilities::extractTriangles(data, ids);
+  if (ids.empty())
+    {
+    return data;
+    }
+  std::size_t numberOfPoints =
+    static_cast<std::size_t>(data->GetNumberOfPoints());
+  Statistics before = simulateCache(ids, numberOfPoints);
+
+  // Welding collapses triangles with points closer than the tolerance:
+  std::vector<vtkIdType> representative;
+  weld(data, weldTolerance, threads, representative);
+  std::size_t numberOfTriangles = 0;
+  for (std::size_t t = 0; t < ids.size() / 3; ++t)
+    {
+    vtkIdType a = representative[ids[3 * t]];
+    vtkIdType b = representative[ids[3 * t + 1]];
+    vtkIdType c = representative[ids[3 * t + 2]];
+    if (a != b && b != c && a != c)
+      {
+      ids[3 * numberOfTriangles] = a;
+      ids[3 * numberOfTriangles + 1] = b;
+      ids[3 * numberOfTriangles + 2] = c;
+      ++numberOfTriangles;
+      }
+    }
+  ids.resize(3 * numberOfTriangles);
+  std::vector<vtkIdType>().swap(representative);
+
+  // Blocks of neighboring triangles along a Morton curve through their
+  // centroids:
+  vtkPoints *points = data->GetPoints();
+  double bounds[6];
+  data->GetBounds(bounds);
+  double scale[3];
+  for (int i = 0; i < 3; ++i)
+    {
+    double extent = bounds[2 * i + 1] - bounds[2 * i];
+    scale[i] = extent > 0. ? 2097151. / extent : 0.;
+    }
+  typedef std::pair<std::uint64_t, std::size_t> Code;
+  std::vector<Code> codes(numberOfTriangles);
+  gvParallel::forRange(numberOfTriangles, [&](std::size_t first,
+                                              std::size_t last)
+    {
+    for (std::size_t t = first; t < last; ++t)
+      {
+      double centroid[3] = {0., 0., 0.};
+      for (int k = 0; k < 3; ++k)
+        {
+        double p[3];
+        points->GetPoint(ids[3 * t + k], p);
+        for (int i = 0; i < 3; ++i)
+          {
+          centroid[i] += p[i] / 3.;
+          }
+        }
+      std::uint64_t code = 0;
+      for (int i = 0; i < 3; ++i)
+        {
+        double cell = (centroid[i] - bounds[2 * i]) * scale[i];
+        code |= spreadBits(static_cast<std::uint64_t>(
+          std::min(std::max(cell, 0.), 2097151.))) << i;
+        }
+      codes[t] = Code(code, t);
+      }
+    }, threads);
+  gvParallel::sort(codes.begin(), codes.end(), std::less<Code>(), threads);
+
+  std::vector<vtkIdType> sorted(ids.size());
+  gvParallel::forRange(numberOfTriangles, [&](std::size_t first,
+                                              std::size_t last)
+    {
+    for (std::size_t t = first; t < last; ++t)
+      {
+      std::copy(&ids[3 * codes[t].second], &ids[3 * codes[t].second] + 3,
+                &sorted[3 * t]);
+      }
+    }, threads);
+  std::vector<Code>().swap(codes);
+  ids.swap(sorted);
+  std::vector<vtkIdType>().swap(sorted);
+
+  std::size_t numberOfBlocks =
+    (numberOfTriangles + BlockTriangles - 1) / BlockTriangles;
+  std::vector<std::vector<std::uint32_t> > blockOrders(numberOfBlocks);
+  std::vector<std::vector<std::size_t> > blockClusters(numberOfBlocks);
+  gvParallel::forEach(numberOfBlocks, [&](std::size_t b)
+    {
+    std::size_t first = b * BlockTriangles;
+    std::size_t count = std::min(BlockTriangles, numberOfTriangles - first);
+    tipsify(&ids[3 * first], count, blockOrders[b], blockClusters[b]);
+    }, threads);
+
+  // Clusters facing away from the mesh's center are on its outside and
+  // likely to occlude the others, so they go first. The key is the offset
+  // of a cluster's centroid from the mesh centroid along its mean normal.
+  std::vector<Cluster> clusters;
+  for (std::size_t b = 0; b < numberOfBlocks; ++b)
+    {
+    const std::vector<std::size_t> &starts = blockClusters[b];
+    for (std::size_t c = 0; c < starts.size(); ++c)
+      {
+      Cluster cluster;
+      cluster.block = b;
+      cluster.begin = starts[c];
+      cluster.end = c + 1 < starts.size() ? starts[c + 1] :
+        blockOrders[b].size();
+      cluster.first = 0;
+      cluster.key = 0.;
+      clusters.push_back(cluster);
+      }
+    }
+  std::vector<double> moments(7 * clusters.size(), 0.);
+  gvParallel::forEach(clusters.size(), [&](std::size_t c)
+    {
+    const Cluster &cluster = clusters[c];
+    double *moment = &moments[7 * c]; // Area, area * centroid, normal
+    for (std::size_t i = cluster.begin; i < cluster.end; ++i)
+      {
+      std::size_t t = cluster.block * BlockTriangles +
+        blockOrders[cluster.block][i];
+      double p[3][3];
+      for (int k = 0; k < 3; ++k)
+        {
+        points->GetPoint(ids[3 * t + k], p[k]);
+        }
+      double u[3], v[3];
+      for (int j = 0; j < 3; ++j)
+        {
+        u[j] = p[1][j] - p[0][j];
+        v[j] = p[2][j] - p[0][j];
+        }
+      double n[3] = {u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2],
+                     u[0] * v[1] - u[1] * v[0]};
+      double area = .5 * std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      moment[0] += area;
+      for (int j = 0; j < 3; ++j)
+        {
+        moment[1 + j] += area * (p[0][j] + p[1][j] + p[2][j]) / 3.;
+        moment[4 + j] += n[j];
+        }
+      }
+    }, threads);
+  double totalArea = 0.;
+  double center[3] = {0., 0., 0.};
+  for (std::size_t c = 0; c < clusters.size(); ++c)
+    {
+    totalArea += moments[7 * c];
+    for (int j = 0; j < 3; ++j)
+      {
+      center[j] += moments[7 * c + 1 + j];
+      }
+    }
+  for (int j = 0; j < 3; ++j)
+    {
+    center[j] = totalArea > 0. ? center[j] / totalArea : 0.;
+    }
+  for (std::size_t c = 0; c < clusters.size(); ++c)
+    {
+    const double *moment = &moments[7 * c];
+    double length = std::sqrt(moment[4] * moment[4] + moment[5] * moment[5] +
+                              moment[6] * moment[6]);
+    if (moment[0] > 0. && length > 0.)
+      {
+      for (int j = 0; j < 3; ++j)
+        {
+        clusters[c].key +=
+          (moment[1 + j] / moment[0] - center[j]) * moment[4 + j] / length;
+        }
+      }
+    }
+  std::vector<double>().swap(moments);
+  std::stable_sort(clusters.begin(), clusters.end(),
+                   [](const Cluster &a, const Cluster &b)
+    {
+    return a.key > b.key;
+    });
+
+  std::vector<vtkIdType> ordered(ids.size());
+  std::size_t next = 0;
+  for (std::size_t c = 0; c < clusters.size(); ++c)
+    {
+    clusters[c].first = next;
+    next += clusters[c].end - clusters[c].begin;
+    }
+  gvParallel::forEach(clusters.size(), [&](std::size_t c)
+    {
+    const Cluster &cluster = clusters[c];
+    vtkIdType *out = &ordered[3 * cluster.first];
+    for (std::size_t i = cluster.begin; i < cluster.end; ++i)
+      {
+      std::size_t t = cluster.block * BlockTriangles +
+        blockOrders[cluster.block][i];
+      std::copy(&ids[3 * t], &ids[3 * t] + 3, out);
+      out += 3;
+      }
+    }, threads);
+  std::vector<vtkIdType>().swap(ids);
+
+  // Points in the order the triangles first use them:
+  std::vector<vtkIdType> renumbered(numberOfPoints, -1);
+  vtkNew<vtkIdList> pointIds;
+  for (std::size_t c = 0; c < ordered.size(); ++c)
+    {
+    vtkIdType &id = renumbered[ordered[c]];
+    if (id < 0)
+      {
+      id = pointIds->InsertNextId(ordered[c]);
+      }
+    ordered[c] = id;
+    }
+
+  vtkDataArray *positions = points->GetData();
+  vtkDataArray *outPositions = positions->NewInstance();
+  outPositions->SetNumberOfComponents(3);
+  outPositions->SetNumberOfTuples(pointIds->GetNumberOfIds());
+  positions->GetTuples(pointIds.Get(), outPositions);
+  vtkNew<vtkPoints> outPoints;
+  outPoints->SetData(outPositions);
+  outPositions->Delete();
+
+  vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+  output->SetPoints(outPoints.Get());
+  output->SetPolys(gvMeshUtilities::newTriangles(ordered.data(),
+                                                 numberOfTriangles));
+  gvMeshUtilities::copyPointData(data->GetPointData(), pointIds.Get(),
+                                 output->GetPointData());
+
+  Statistics after = simulateCache(
+    ordered, static_cast<std::size_t>(pointIds->GetNumberOfIds()));
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  std::cout << "Optimized mesh in " << elapsed.count() << " s ("
+            << threads << " threads): " << before.numberOfPoints << " -> "
+            << after.numberOfPoints << " points, "
+            << before.numberOfTriangles << " -> " << after.numberOfTriangles
+            << " triangles, ACMR " << before.acmr << " -> " << after.acmr
+            << ", ATVR " << before.atvr << " -> " << after.atvr
+            << " (cache of " << CacheSize << ")" << std::endl;
+  return output;
+}
@@ -0,0 +1,49 @@
+#ifndef GVMESHOPTIMIZER_H
+#define GVMESHOPTIMIZER_H
+
+#include <vtkSmartPointer.h>
+
+#include <cstddef>
+
+class vtkPolyData;
+
+// Rearranges a triangle mesh for the GPU before it is handed to a mapper:
+//
+//  1. Points within a tolerance of each other whose attributes (normals,
+//     texture coordinates, colors, ...) are equal are welded into one.
+//  2. Triangles are ordered for the post-transform vertex cache and grouped
+//     into clusters drawn roughly front to back from any viewpoint, after
+//     Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex
+//     Locality and Reduced Overdraw" (SIGGRAPH 2007). The mesh is split into
+//     spatially sorted blocks that are ordered in parallel.
+//  3. Points are renumbered in the order the triangles first use them, so
+//     vertex fetches walk memory forward.
+class gvMeshOptimizer
+{
+public:
+  // Entries of the simulated FIFO post-transform vertex cache.
+  static const int CacheSize = 32;
+
+  struct Statistics
+  {
+    std::size_t numberOfPoints;
+    std::size_t numberOfTriangles;
+    double acmr; // Cache misses per triangle: 3 at worst, about 0.5 at best
+    double atvr; // Cache misses per point used: 1 at best
+  };
+
+  // Simulate the vertex cache over data's polygons, fanned into triangles.
+  static Statistics measure(vtkPolyData *data);
+
+  // An optimized copy of data's polygons as triangles, with all point
+  // attributes. Points are welded if they fall in the same cell of a grid
+  // whose spacing is weldTolerance times the diagonal of data's bounds; 0
+  // welds only identical points and a negative tolerance none. Prints the
+  // statistics before and after. Meshes with vertices, lines or strips are
+  // returned as they are.
+  static vtkSmartPointer<vtkPolyData> optimize(
+      vtkPolyData *data, double weldTolerance,
+      unsigned int numberOfThreads = 0);
+};
+
+#endif // GVMESHOPTIMIZER_H
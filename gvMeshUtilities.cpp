@@ -0,0 +1,160 @@
+#include "gvMeshUtilities.h"
+
+#include <vtkCellArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkDataArray.h>
+#include <vtkIdList.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <utility>
+
+vtkSmartPointer<vtkCellArray> gvMeshUtilities::newTriangles(
+    const vtkIdType *ids, std::size_t numberOfTriangles)
+{
+  return newCells(ids, 3, numberOfTriangles);
+}
+
+vtkSmartPointer<vtkCellArray> gvMeshUtilities::newCells(
+    const vtkIdType *ids, std::size_t cellSize, std::size_t numberOfCells)
+{
+  vtkSmartPointer<vtkCellArray> cells = vtkSmartPointer<vtkCellArray>::New();
+  vtkIdType count = static_cast<vtkIdType>(numberOfCells);
+  vtkIdType size = static_cast<vtkIdType>(cellSize);
+#if VTK_MAJOR_VERSION >= 9
+  vtkNew<vtkIdTypeArray> offsets;
+  offsets->SetNumberOfValues(count + 1);
+  vtkIdType *offset = offsets->GetPointer(0);
+  for (vtkIdType i = 0; i <= count; ++i)
+    {
+    offset[i] = size * i;
+    }
+  vtkNew<vtkIdTypeArray> connectivity;
+  connectivity->SetNumberOfValues(size * count);
+  std::copy(ids, ids + size * count, connectivity->GetPointer(0));
+  cells->SetData(offsets.Get(), connectivity.Get());
+#else
+  vtkNew<vtkIdTypeArray> legacy;
+  legacy->SetNumberOfValues((size + 1) * count);
+  vtkIdType *out = legacy->GetPointer(0);
+  for (vtkIdType i = 0; i < count; ++i)
+    {
+    *out++ = size;
+    out = std::copy(ids + size * i, ids + size * (i + 1), out);
+    }
+  cells->SetCells(count, legacy.Get());
+#endif
+  return cells;
+}
+
+void gvMeshUtilities::uniqueEdges(const vtkIdType *ids,
+                                  std::size_t numberOfTriangles,
+                                  std::vector<vtkIdType> &edges)
+{
+  std::vector<std::pair<vtkIdType, vtkIdType> > pairs;
+  pairs.reserve(3 * numberOfTriangles);
+  for (std::size_t t = 0; t < numberOfTriangles; ++t)
+    {
+    const vtkIdType *triangle = ids + 3 * t;
+    for (int v = 0; v < 3; ++v)
+      {
+      vtkIdType a = triangle[v];
+      vtkIdType b = triangle[v == 2 ? 0 : v + 1];
+      if (a != b)
+        {
+        pairs.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+        }
+      }
+    }
+  std::sort(pairs.begin(), pairs.end());
+  pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+  edges.reserve(edges.size() + 2 * pairs.size());
+  for (std::size_t e = 0; e < pairs.size(); ++e)
+    {
+    edges.push_back(pairs[e].first);
+    edges.push_back(pairs[e].second);
+    }
+}
+
+void gvMeshUtilities::extractTriangles(vtkPolyData *data,
+                                       std::vector<vtkIdType> &ids)
+{
+  vtkCellArray *polys = data->GetPolys();
+  if (!polys)
+    {
+    return;
+    }
+
+  ids.reserve(ids.size() + 3 * static_cast<std::size_t>(
+                polys->GetNumberOfCells()));
+  vtkIdType npts;
+  gvCellPointIds pts;
+  for (polys->InitTraversal(); polys->GetNextCell(npts, pts);)
+    {
+    for (vtkIdType i = 2; i < npts; ++i)
+      {
+      ids.push_back(pts[0]);
+      ids.push_back(pts[i - 1]);
+      ids.push_back(pts[i]);
+      }
+    }
+}
+
+void gvMeshUtilities::copyPointData(vtkPointData *source,
+                                    vtkIdList *pointIds,
+                                    vtkPointData *target)
+{
+  for (int a = 0; a < source->GetNumberOfArrays(); ++a)
+    {
+    vtkAbstractArray *in = source->GetAbstractArray(a);
+    vtkAbstractArray *out = in->NewInstance();
+    out->SetNumberOfComponents(in->GetNumberOfComponents());
+    out->SetNumberOfTuples(pointIds->GetNumberOfIds());
+    out->SetName(in->GetName());
+    in->GetTuples(pointIds, out);
+    target->AddArray(out);
+    out->Delete();
+    }
+
+  if (vtkDataArray *normals = source->GetNormals())
+    {
+    target->SetActiveNormals(normals->GetName());
+    }
+  if (vtkDataArray *tcoords = source->GetTCoords())
+    {
+    target->SetActiveTCoords(tcoords->GetName());
+    }
+  if (vtkDataArray *scalars = source->GetScalars())
+    {
+    target->SetActiveScalars(scalars->GetName());
+    }
+}
+
+void gvMeshUtilities::prepareForSharing(vtkPolyData *data)
+{
+  data->ComputeBounds();
+  data->BuildCells();
+  if (data->GetPoints())
+    {
+    data->GetPoints()->GetBounds();
+    }
+
+  vtkPointData *pointData = data->GetPointData();
+  for (int a = 0; a < pointData->GetNumberOfArrays(); ++a)
+    {
+    vtkDataArray *array = pointData->GetArray(a);
+    if (!array)
+      {
+      continue;
+      }
+    for (int c = -1; c < array->GetNumberOfComponents(); ++c)
+      {
+      double range[2];
+      array->GetRange(range, c);
+      }
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef GVMESHUTILITIES_H
+#define GVMESHUTILITIES_H
+
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+#include <vtkVersion.h>
+
+#include <cstddef>
+#include <vector>
+
+class vtkCellArray;
+class vtkIdList;
+class vtkPointData;
+class vtkPolyData;
+
+// Point id pointer handed out by vtkCellArray traversal.
+#if VTK_MAJOR_VERSION >= 9
+typedef const vtkIdType* gvCellPointIds;
+#else
+typedef vtkIdType* gvCellPointIds;
+#endif
+
+// Helpers for moving triangle lists in and out of VTK's cell arrays, whose
+// layout differs between VTK versions.
+class gvMeshUtilities
+{
+public:
+  // Build a cell array of numberOfTriangles triangles from 3 ids each.
+  static vtkSmartPointer<vtkCellArray> newTriangles(
+      const vtkIdType *ids, std::size_t numberOfTriangles);
+
+  // Build a cell array of numberOfCells cells from cellSize ids each.
+  static vtkSmartPointer<vtkCellArray> newCells(
+      const vtkIdType *ids, std::size_t cellSize, std::size_t numberOfCells);
+
+  // Append every edge of numberOfTriangles triangles from 3 ids each to
+  // edges once, as a pair of ids with the smaller first. Edges are sorted,
+  // so they follow the points' order.
+  static void uniqueEdges(const vtkIdType *ids, std::size_t numberOfTriangles,
+                          std::vector<vtkIdType> &edges);
+
+  // Append the polygons of data to ids as triangles, fanning polygons with
+  // more than three points.
+  static void extractTriangles(vtkPolyData *data, std::vector<vtkIdType> &ids);
+
+  // Copy the tuples of pointIds from every point array of source into new
+  // arrays of target, keeping the active normals, texture coordinates and
+  // scalars.
+  static void copyPointData(vtkPointData *source, vtkIdList *pointIds,
+                            vtkPointData *target);
+
+  // Do the lazy work VTK caches inside a dataset (dataset and point bounds,
+  // the cell table of BuildCells(), array ranges) before data is handed to
+  // the GL contexts, so that mappers rendering on different threads only
+  // ever read it. Point-to-cell links are not built; nothing that renders
+  // shared data asks for them.
+  static void prepareForSharing(vtkPolyData *data);
+};
+
+#endif // GVMESHUTILITIES_H
@@ -0,0 +1,157 @@
+#ifndef GVOBJPARSING_H
+#define GVOBJPARSING_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Allocation-free scanning helpers shared by the OBJ readers. They work on
+// memory-mapped text and never read past end.
+namespace gvOBJParsing
+{
+
+inline bool isBlank(char c)
+{
+  return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool isDigit(char c)
+{
+  return c >= '0' && c <= '9';
+}
+
+inline const char* skipBlanks(const char *p, const char *end)
+{
+  while (p < end && isBlank(*p))
+    {
+    ++p;
+    }
+  return p;
+}
+
+inline const char* nextLine(const char *p, const char *end)
+{
+  const char *eol = static_cast<const char*>(
+    std::memchr(p, '\n', static_cast<std::size_t>(end - p)));
+  return eol ? eol + 1 : end;
+}
+
+inline double powerOfTen(int exponent)
+{
+  static const double table[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+  if (exponent >= 0 && exponent <= 22)
+    {
+    return table[exponent];
+    }
+  if (exponent < 0 && exponent >= -22)
+    {
+    return 1. / table[-exponent];
+    }
+  return std::pow(10., exponent);
+}
+
+// Parse a decimal floating point number in place, without allocating or
+// going through the C locale.
+inline bool parseFloat(const char *&p, const char *end, float &value)
+{
+  p = skipBlanks(p, end);
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+'))
+    {
+    negative = *p == '-';
+    ++p;
+    }
+
+  std::uint64_t mantissa = 0;
+  int exponent = 0;
+  bool digits = false;
+  const std::uint64_t mantissaLimit = 100000000000000000ULL; // 1e17
+  for (; p < end && isDigit(*p); ++p)
+    {
+    if (mantissa < mantissaLimit)
+      {
+      mantissa = mantissa * 10 + static_cast<std::uint64_t>(*p - '0');
+      }
+    else
+      {
+      ++exponent;
+      }
+    digits = true;
+    }
+  if (p < end && *p == '.')
+    {
+    for (++p; p < end && isDigit(*p); ++p)
+      {
+      if (mantissa < mantissaLimit)
+        {
+        mantissa = mantissa * 10 + static_cast<std::uint64_t>(*p - '0');
+        --exponent;
+        }
+      digits = true;
+      }
+    }
+  if (!digits)
+    {
+    return false;
+    }
+  if (p < end && (*p == 'e' || *p == 'E'))
+    {
+    const char *exponentStart = p++;
+    bool negativeExponent = false;
+    if (p < end && (*p == '-' || *p == '+'))
+      {
+      negativeExponent = *p == '-';
+      ++p;
+      }
+    if (p < end && isDigit(*p))
+      {
+      int e = 0;
+      for (; p < end && isDigit(*p); ++p)
+        {
+        e = std::min(e * 10 + (*p - '0'), 10000);
+        }
+      exponent += negativeExponent ? -e : e;
+      }
+    else
+      {
+      p = exponentStart;
+      }
+    }
+
+  double result = static_cast<double>(mantissa);
+  if (exponent != 0)
+    {
+    result = exponent < 0 ? result / powerOfTen(-exponent)
+                          : result * powerOfTen(exponent);
+    }
+  value = static_cast<float>(negative ? -result : result);
+  return true;
+}
+
+inline bool parseIndex(const char *&p, const char *end, std::int64_t &value)
+{
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+'))
+    {
+    negative = *p == '-';
+    ++p;
+    }
+  if (p >= end || !isDigit(*p))
+    {
+    return false;
+    }
+  std::int64_t result = 0;
+  for (; p < end && isDigit(*p); ++p)
+    {
+    result = result * 10 + (*p - '0');
+    }
+  value = negative ? -result : result;
+  return true;
+}
+
+} // end namespace gvOBJParsing
+
+#endif // GVOBJPARSING_H
@@ -0,0 +1,535 @@
+#include "gvOBJReader.h"
+
+#include "gvMappedFile.h"
+#include "gvOBJParsing.h"
+#include "gvParallel.h"
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkVersion.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <vector>
+
+namespace {
+
+using namespace gvOBJParsing;
+
+// Face corner indices are resolved once all chunks are parsed. Positive OBJ
+// indices are absolute and stored as 2 * index; negative ones are relative
+// to the records parsed so far, so they are stored as 2 * local + 1 where
+// local is relative to the start of the chunk.
+typedef std::int64_t EncodedIndex;
+const EncodedIndex NoIndex = std::numeric_limits<EncodedIndex>::min();
+
+EncodedIndex encodeIndex(std::int64_t objIndex, std::size_t localCount)
+{
+  if (objIndex > 0)
+    {
+    return (objIndex - 1) * 2;
+    }
+  return (static_cast<std::int64_t>(localCount) + objIndex) * 2 + 1;
+}
+
+std::int64_t decodeIndex(EncodedIndex index, std::size_t chunkBase)
+{
+  if (index & 1)
+    {
+    return static_cast<std::int64_t>(chunkBase) + (index - 1) / 2;
+    }
+  return index / 2;
+}
+
+struct Chunk
+{
+  const char *begin;
+  const char *end;
+
+  std::vector<float> positions; // xyz
+  std::vector<float> normals;   // xyz
+  std::vector<float> tcoords;   // uv
+  std::vector<EncodedIndex> vertexIds;
+  std::vector<EncodedIndex> tcoordIds;
+  std::vector<EncodedIndex> normalIds;
+  std::vector<std::uint32_t> faceSizes;
+
+  // Offsets of this chunk's records in the stitched output:
+  std::size_t pointBase;
+  std::size_t normalBase;
+  std::size_t tcoordBase;
+  std::size_t cornerBase;
+  std::size_t faceBase;
+
+  bool usesNormals;
+  bool usesTCoords;
+  bool sharedNormals; // Every corner's normal index equals its vertex index
+  bool sharedTCoords;
+  bool valid;
+};
+
+void parseFace(const char *p, const char *end, Chunk &chunk)
+{
+  std::uint32_t corners = 0;
+  for (p = skipBlanks(p, end); p < end && *p != '\n' && *p != '#';
+       p = skipBlanks(p, end))
+    {
+    std::int64_t index;
+    if (!parseIndex(p, end, index) || index == 0)
+      {
+      chunk.valid = false;
+      return;
+      }
+    chunk.vertexIds.push_back(
+      encodeIndex(index, chunk.positions.size() / 3));
+
+    EncodedIndex tcoord = NoIndex;
+    EncodedIndex normal = NoIndex;
+    if (p < end && *p == '/')
+      {
+      ++p;
+      if (p < end && *p != '/' && parseIndex(p, end, index))
+        {
+        tcoord = encodeIndex(index, chunk.tcoords.size() / 2);
+        }
+      if (p < end && *p == '/')
+        {
+        ++p;
+        if (parseIndex(p, end, index))
+          {
+          normal = encodeIndex(index, chunk.normals.size() / 3);
+          }
+        }
+      }
+    chunk.tcoordIds.push_back(tcoord);
+    chunk.normalIds.push_back(normal);
+    chunk.usesTCoords |= tcoord != NoIndex;
+    chunk.usesNormals |= normal != NoIndex;
+
+    // Skip anything else glued to the corner:
+    while (p < end && !isBlank(*p) && *p != '\n')
+      {
+      ++p;
+      }
+    ++corners;
+    }
+  chunk.faceSizes.push_back(corners);
+}
+
+void parseChunk(Chunk &chunk)
+{
+  // Rough reservation so the vectors rarely grow (~30 bytes per record):
+  std::size_t estimate = static_cast<std::size_t>(chunk.end - chunk.begin) / 30;
+  chunk.positions.reserve(estimate);
+  chunk.vertexIds.reserve(estimate);
+
+  for (const char *p = chunk.begin; p < chunk.end;
+       p = nextLine(p, chunk.end))
+    {
+    const char *line = skipBlanks(p, chunk.end);
+    if (chunk.end - line < 2)
+      {
+      continue;
+      }
+
+    float x, y, z;
+    if (line[0] == 'v' && isBlank(line[1]))
+      {
+      const char *q = line + 2;
+      if (parseFloat(q, chunk.end, x) && parseFloat(q, chunk.end, y) &&
+          parseFloat(q, chunk.end, z))
+        {
+        chunk.positions.push_back(x);
+        chunk.positions.push_back(y);
+        chunk.positions.push_back(z);
+        }
+      else
+        {
+        chunk.valid = false;
+        }
+      }
+    else if (line[0] == 'v' && line[1] == 'n')
+      {
+      const char *q = line + 2;
+      if (parseFloat(q, chunk.end, x) && parseFloat(q, chunk.end, y) &&
+          parseFloat(q, chunk.end, z))
+        {
+        chunk.normals.push_back(x);
+        chunk.normals.push_back(y);
+        chunk.normals.push_back(z);
+        }
+      else
+        {
+        chunk.valid = false;
+        }
+      }
+    else if (line[0] == 'v' && line[1] == 't')
+      {
+      const char *q = line + 2;
+      if (parseFloat(q, chunk.end, x))
+        {
+        // The v coordinate is optional:
+        if (!parseFloat(q, chunk.end, y))
+          {
+          y = 0.f;
+          }
+        chunk.tcoords.push_back(x);
+        chunk.tcoords.push_back(y);
+        }
+      else
+        {
+        chunk.valid = false;
+        }
+      }
+    else if (line[0] == 'f' && isBlank(line[1]))
+      {
+      parseFace(line + 2, chunk.end, chunk);
+      }
+    }
+}
+
+// Resolve the face corners of a chunk and check whether normals and texture
+// coordinates are indexed exactly like the vertices.
+void resolveChunk(Chunk &chunk, std::size_t numberOfPoints,
+                  std::size_t numberOfNormals, std::size_t numberOfTCoords)
+{
+  chunk.sharedNormals = true;
+  chunk.sharedTCoords = true;
+  for (std::size_t i = 0; i < chunk.vertexIds.size(); ++i)
+    {
+    std::int64_t vertex = decodeIndex(chunk.vertexIds[i], chunk.pointBase);
+    if (vertex < 0 || vertex >= static_cast<std::int64_t>(numberOfPoints))
+      {
+      chunk.valid = false;
+      return;
+      }
+    chunk.vertexIds[i] = vertex;
+
+    std::int64_t normal = -1;
+    if (chunk.normalIds[i] != NoIndex)
+      {
+      normal = decodeIndex(chunk.normalIds[i], chunk.normalBase);
+      if (normal < 0 || normal >= static_cast<std::int64_t>(numberOfNormals))
+        {
+        chunk.valid = false;
+        return;
+        }
+      }
+    chunk.normalIds[i] = normal;
+    chunk.sharedNormals &= normal == vertex;
+
+    std::int64_t tcoord = -1;
+    if (chunk.tcoordIds[i] != NoIndex)
+      {
+      tcoord = decodeIndex(chunk.tcoordIds[i], chunk.tcoordBase);
+      if (tcoord < 0 || tcoord >= static_cast<std::int64_t>(numberOfTCoords))
+        {
+        chunk.valid = false;
+        return;
+        }
+      }
+    chunk.tcoordIds[i] = tcoord;
+    chunk.sharedTCoords &= tcoord == vertex;
+    }
+}
+
+vtkSmartPointer<vtkFloatArray> newFloatArray(const char *name, int components,
+                                             std::size_t tuples)
+{
+  vtkSmartPointer<vtkFloatArray> array = vtkSmartPointer<vtkFloatArray>::New();
+  if (name)
+    {
+    array->SetName(name);
+    }
+  array->SetNumberOfComponents(components);
+  array->SetNumberOfTuples(static_cast<vtkIdType>(tuples));
+  return array;
+}
+
+} // end anon namespace
+
+vtkSmartPointer<vtkPolyData> gvOBJReader::read(const std::string &fileName,
+                                               unsigned int numberOfThreads)
+{
+  typedef std::chrono::steady_clock Clock;
+  Clock::time_point start = Clock::now();
+
+  gvMappedFile file;
+  if (!file.open(fileName))
+    {
+    std::cerr << "ERROR: Cannot map " << fileName << std::endl;
+    return nullptr;
+    }
+  file.adviseSequential();
+
+  // Split the file into line-aligned chunks, several per worker so that
+  // regions dense in faces don't stall the others:
+  unsigned int threads = gvParallel::resolveThreads(numberOfThreads);
+  const std::size_t minimumChunkSize = 1 << 20;
+  std::size_t numberOfChunks = std::max<std::size_t>(1,
+    std::min<std::size_t>(threads * 4, file.size() / minimumChunkSize));
+  std::vector<Chunk> chunks(numberOfChunks);
+  const char *data = file.data();
+  const char *dataEnd = data + file.size();
+  const char *begin = data;
+  for (std::size_t c = 0; c < numberOfChunks; ++c)
+    {
+    const char *end = c + 1 == numberOfChunks ? dataEnd :
+      nextLine(std::max(begin, data + file.size() * (c + 1) / numberOfChunks),
+               dataEnd);
+    chunks[c].begin = begin;
+    chunks[c].end = end;
+    chunks[c].usesNormals = false;
+    chunks[c].usesTCoords = false;
+    chunks[c].valid = true;
+    begin = end;
+    }
+
+  gvParallel::forEach(chunks.size(), [&](std::size_t c)
+    {
+    parseChunk(chunks[c]);
+    }, threads);
+
+  // Each chunk's records start where the previous chunk's ended:
+  std::size_t numberOfPoints = 0;
+  std::size_t numberOfNormals = 0;
+  std::size_t numberOfTCoords = 0;
+  std::size_t numberOfCorners = 0;
+  std::size_t numberOfFaces = 0;
+  for (std::size_t c = 0; c < chunks.size(); ++c)
+    {
+    Chunk &chunk = chunks[c];
+    chunk.pointBase = numberOfPoints;
+    chunk.normalBase = numberOfNormals;
+    chunk.tcoordBase = numberOfTCoords;
+    chunk.cornerBase = numberOfCorners;
+    chunk.faceBase = numberOfFaces;
+    numberOfPoints += chunk.positions.size() / 3;
+    numberOfNormals += chunk.normals.size() / 3;
+    numberOfTCoords += chunk.tcoords.size() / 2;
+    numberOfCorners += chunk.vertexIds.size();
+    numberOfFaces += chunk.faceSizes.size();
+    }
+
+  gvParallel::forEach(chunks.size(), [&](std::size_t c)
+    {
+    resolveChunk(chunks[c], numberOfPoints, numberOfNormals,
+                 numberOfTCoords);
+    }, threads);
+
+  bool usesNormals = false;
+  bool usesTCoords = false;
+  bool sharedNormals = true;
+  bool sharedTCoords = true;
+  for (std::size_t c = 0; c < chunks.size(); ++c)
+    {
+    if (!chunks[c].valid)
+      {
+      std::cerr << "ERROR: Malformed OBJ records or face indices in "
+                << fileName << std::endl;
+      return nullptr;
+      }
+    usesNormals |= chunks[c].usesNormals;
+    usesTCoords |= chunks[c].usesTCoords;
+    sharedNormals &= chunks[c].sharedNormals;
+    sharedTCoords &= chunks[c].sharedTCoords;
+    }
+
+  // Like vtkOBJReader, vertices are only shared between faces if normals and
+  // texture coordinates are indexed identically; otherwise every face corner
+  // becomes its own point.
+  bool unrolled = (usesNormals && !sharedNormals) ||
+                  (usesTCoords && !sharedTCoords);
+  std::size_t outputPoints = unrolled ? numberOfCorners : numberOfPoints;
+
+  vtkSmartPointer<vtkFloatArray> positions =
+    newFloatArray(nullptr, 3, outputPoints);
+  vtkSmartPointer<vtkFloatArray> normals;
+  vtkSmartPointer<vtkFloatArray> tcoords;
+  if (usesNormals)
+    {
+    normals = newFloatArray("Normals", 3, outputPoints);
+    }
+  if (usesTCoords)
+    {
+    tcoords = newFloatArray("TCoords", 2, outputPoints);
+    }
+
+#if VTK_MAJOR_VERSION >= 9
+  vtkNew<vtkIdTypeArray> offsets;
+  offsets->SetNumberOfValues(static_cast<vtkIdType>(numberOfFaces + 1));
+  vtkNew<vtkIdTypeArray> connectivity;
+  connectivity->SetNumberOfValues(static_cast<vtkIdType>(numberOfCorners));
+  vtkIdType *outOffsets = offsets->GetPointer(0);
+  outOffsets[numberOfFaces] = static_cast<vtkIdType>(numberOfCorners);
+#else
+  vtkNew<vtkIdTypeArray> legacyCells;
+  legacyCells->SetNumberOfValues(
+    static_cast<vtkIdType>(numberOfFaces + numberOfCorners));
+#endif
+
+  // Gather every flat array a chunk reads from, so corners may refer to
+  // records in other chunks:
+  std::vector<const float*> chunkPositions(chunks.size());
+  std::vector<const float*> chunkNormals(chunks.size());
+  std::vector<const float*> chunkTCoords(chunks.size());
+  std::vector<std::size_t> pointBases(chunks.size());
+  std::vector<std::size_t> normalBases(chunks.size());
+  std::vector<std::size_t> tcoordBases(chunks.size());
+  for (std::size_t c = 0; c < chunks.size(); ++c)
+    {
+    chunkPositions[c] = chunks[c].positions.data();
+    chunkNormals[c] = chunks[c].normals.data();
+    chunkTCoords[c] = chunks[c].tcoords.data();
+    pointBases[c] = chunks[c].pointBase;
+    normalBases[c] = chunks[c].normalBase;
+    tcoordBases[c] = chunks[c].tcoordBase;
+    }
+  // Find the record for a global index by binary search over chunk bases:
+  auto lookup = [](const std::vector<std::size_t> &bases,
+                   const std::vector<const float*> &values, int components,
+                   std::int64_t index) -> const float*
+    {
+    std::size_t c = static_cast<std::size_t>(
+      std::upper_bound(bases.begin(), bases.end(),
+                       static_cast<std::size_t>(index)) - bases.begin()) - 1;
+    return values[c] +
+      (static_cast<std::size_t>(index) - bases[c]) * components;
+    };
+
+  float *outPositions = positions->GetPointer(0);
+  float *outNormals = normals ? normals->GetPointer(0) : nullptr;
+  float *outTCoords = tcoords ? tcoords->GetPointer(0) : nullptr;
+
+  // With shared indexing, normal and texture coordinate records line up with
+  // the vertices and are copied as-is; points without one are zeroed.
+  if (!unrolled && outNormals)
+    {
+    std::fill(outNormals, outNormals + outputPoints * 3, 0.f);
+    }
+  if (!unrolled && outTCoords)
+    {
+    std::fill(outTCoords, outTCoords + outputPoints * 2, 0.f);
+    }
+
+  gvParallel::forEach(chunks.size(), [&](std::size_t c)
+    {
+    const Chunk &chunk = chunks[c];
+
+    if (!unrolled)
+      {
+      std::copy(chunk.positions.begin(), chunk.positions.end(),
+                outPositions + chunk.pointBase * 3);
+      if (outNormals && chunk.normalBase < outputPoints)
+        {
+        std::size_t count = std::min(chunk.normals.size() / 3,
+                                     outputPoints - chunk.normalBase);
+        std::copy(chunk.normals.begin(), chunk.normals.begin() + count * 3,
+                  outNormals + chunk.normalBase * 3);
+        }
+      if (outTCoords && chunk.tcoordBase < outputPoints)
+        {
+        std::size_t count = std::min(chunk.tcoords.size() / 2,
+                                     outputPoints - chunk.tcoordBase);
+        std::copy(chunk.tcoords.begin(), chunk.tcoords.begin() + count * 2,
+                  outTCoords + chunk.tcoordBase * 2);
+        }
+      }
+
+    std::size_t corner = 0;
+    for (std::size_t f = 0; f < chunk.faceSizes.size(); ++f)
+      {
+      std::size_t face = chunk.faceBase + f;
+      std::uint32_t size = chunk.faceSizes[f];
+#if VTK_MAJOR_VERSION >= 9
+      outOffsets[face] = static_cast<vtkIdType>(chunk.cornerBase + corner);
+      vtkIdType *ids = connectivity->GetPointer(0) + chunk.cornerBase + corner;
+#else
+      vtkIdType *ids = legacyCells->GetPointer(0) + face +
+        chunk.cornerBase + corner;
+      *ids++ = static_cast<vtkIdType>(size);
+#endif
+      for (std::uint32_t i = 0; i < size; ++i, ++corner)
+        {
+        std::int64_t vertex = chunk.vertexIds[corner];
+        std::int64_t normal = chunk.normalIds[corner];
+        std::int64_t tcoord = chunk.tcoordIds[corner];
+        std::size_t point = unrolled ? chunk.cornerBase + corner :
+          static_cast<std::size_t>(vertex);
+        ids[i] = static_cast<vtkIdType>(point);
+
+        if (!unrolled)
+          {
+          continue;
+          }
+
+        const float *xyz = lookup(pointBases, chunkPositions, 3, vertex);
+        std::copy(xyz, xyz + 3, outPositions + point * 3);
+        if (outNormals)
+          {
+          float *n = outNormals + point * 3;
+          if (normal >= 0)
+            {
+            const float *xyz = lookup(normalBases, chunkNormals, 3, normal);
+            std::copy(xyz, xyz + 3, n);
+            }
+          else
+            {
+            n[0] = n[1] = n[2] = 0.f;
+            }
+          }
+        if (outTCoords)
+          {
+          float *t = outTCoords + point * 2;
+          if (tcoord >= 0)
+            {
+            const float *uv = lookup(tcoordBases, chunkTCoords, 2, tcoord);
+            std::copy(uv, uv + 2, t);
+            }
+          else
+            {
+            t[0] = t[1] = 0.f;
+            }
+          }
+        }
+      }
+    }, threads);
+
+  vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+  vtkNew<vtkPoints> points;
+  points->SetData(positions);
+  output->SetPoints(points.Get());
+  if (normals)
+    {
+    output->GetPointData()->SetNormals(normals);
+    }
+  if (tcoords)
+    {
+    output->GetPointData()->SetTCoords(tcoords);
+    }
+
+  vtkNew<vtkCellArray> polys;
+#if VTK_MAJOR_VERSION >= 9
+  polys->SetData(offsets.Get(), connectivity.Get());
+#else
+  polys->SetCells(static_cast<vtkIdType>(numberOfFaces), legacyCells.Get());
+#endif
+  output->SetPolys(polys.Get());
+
+  std::chrono::duration<double> elapsed = Clock::now() - start;
+  double megabytes = static_cast<double>(file.size()) / (1024. * 1024.);
+  std::cout << "Parsed " << megabytes << " MB of OBJ in " << elapsed.count()
+            << " s (" << megabytes / elapsed.count() << " MB/s, " << threads
+            << " threads)" << std::endl;
+
+  return output;
+}
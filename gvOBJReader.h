@@ -0,0 +1,25 @@
+#ifndef GVOBJREADER_H
+#define GVOBJREADER_H
+
+#include <vtkSmartPointer.h>
+
+#include <string>
+
+class vtkPolyData;
+
+// Multi-threaded reader for the v/vn/vt/f subset of Wavefront OBJ. The file
+// is memory-mapped and split into line-aligned chunks that are parsed in
+// parallel without per-record allocations, then stitched into one
+// vtkPolyData laid out like vtkOBJReader's output: float points, "Normals"
+// and "TCoords" point arrays, and polygons. Other records (groups,
+// materials, lines, ...) are skipped.
+class gvOBJReader
+{
+public:
+  // Read fileName using numberOfThreads workers; 0 uses all cores. Returns
+  // null if the file can't be mapped.
+  static vtkSmartPointer<vtkPolyData> read(const std::string &fileName,
+                                           unsigned int numberOfThreads = 0);
+};
+
+#endif // GVOBJREADER_H
@@ -0,0 +1,117 @@
+#ifndef GVPARALLEL_H
+#define GVPARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Minimal work distribution on std::thread used by the load and
+// preprocessing stages. Work items are handed out dynamically, so uneven
+// items (e.g. file chunks with long face lists) still balance.
+class gvParallel
+{
+public:
+  // Number of workers to use for a request of numberOfThreads; 0 means one
+  // per hardware thread.
+  static unsigned int resolveThreads(unsigned int numberOfThreads)
+  {
+    if (numberOfThreads == 0)
+      {
+      numberOfThreads = std::thread::hardware_concurrency();
+      }
+    return std::max(numberOfThreads, 1u);
+  }
+
+  // Call functor(i) for every i in [0, count) on up to numberOfThreads
+  // workers. Returns once all items are done.
+  template <typename Functor>
+  static void forEach(std::size_t count, Functor functor,
+                      unsigned int numberOfThreads = 0)
+  {
+    unsigned int workers = static_cast<unsigned int>(
+      std::min<std::size_t>(resolveThreads(numberOfThreads), count));
+    if (workers <= 1)
+      {
+      for (std::size_t i = 0; i < count; ++i)
+        {
+        functor(i);
+        }
+      return;
+      }
+
+    std::atomic<std::size_t> next(0);
+    auto work = [&]()
+      {
+      for (std::size_t i = next++; i < count; i = next++)
+        {
+        functor(i);
+        }
+      };
+
+    std::vector<std::thread> threads;
+    for (unsigned int t = 1; t < workers; ++t)
+      {
+      threads.push_back(std::thread(work));
+      }
+    work();
+    for (std::size_t t = 0; t < threads.size(); ++t)
+      {
+      threads[t].join();
+      }
+  }
+
+  // Split [0, count) into about blocksPerThread blocks per worker and call
+  // functor(begin, end) for each block.
+  template <typename Functor>
+  static void forRange(std::size_t count, Functor functor,
+                       unsigned int numberOfThreads = 0,
+                       std::size_t blocksPerThread = 4)
+  {
+    std::size_t blocks = std::max<std::size_t>(
+      1, std::min<std::size_t>(count, resolveThreads(numberOfThreads) *
+                               blocksPerThread));
+    forEach(blocks, [&](std::size_t block)
+      {
+      functor(count * block / blocks, count * (block + 1) / blocks);
+      }, numberOfThreads);
+  }
+
+  // Sort [first, last) by less on up to numberOfThreads workers: one block
+  // per worker is sorted, then neighboring blocks are merged pairwise.
+  template <typename Iterator, typename Less>
+  static void sort(Iterator first, Iterator last, Less less,
+                   unsigned int numberOfThreads = 0)
+  {
+    std::size_t count = static_cast<std::size_t>(last - first);
+    std::size_t blocks = std::max<std::size_t>(
+      1, std::min<std::size_t>(resolveThreads(numberOfThreads), count));
+    std::vector<Iterator> bounds(blocks + 1);
+    for (std::size_t i = 0; i <= blocks; ++i)
+      {
+      bounds[i] = first + count * i / blocks;
+      }
+    forEach(blocks, [&](std::size_t block)
+      {
+      std::sort(bounds[block], bounds[block + 1], less);
+      }, numberOfThreads);
+    for (std::size_t width = 1; width < blocks; width *= 2)
+      {
+      std::size_t pairs = (blocks + 2 * width - 1) / (2 * width);
+      forEach(pairs, [&](std::size_t pair)
+        {
+        std::size_t begin = 2 * width * pair;
+        std::size_t middle = std::min(begin + width, blocks);
+        std::size_t end = std::min(begin + 2 * width, blocks);
+        if (middle < end)
+          {
+          std::inplace_merge(bounds[begin], bounds[middle], bounds[end],
+                             less);
+          }
+        }, numberOfThreads);
+      }
+  }
+};
+
+#endif // GVPARALLEL_H
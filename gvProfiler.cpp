@@ -0,0 +1,226 @@
+#include "gvProfiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <utility>
+
+std::atomic<gvProfiler*> gvProfiler::s_active(nullptr);
+
+namespace {
+
+struct Summary
+{
+  std::size_t count;
+  double mean;
+  double p50;
+  double p90;
+  double p99;
+  double max;
+};
+
+// Nearest-rank percentile of sorted values.
+double percentile(const std::vector<double> &sorted, double p)
+{
+  std::size_t rank = static_cast<std::size_t>(p * (sorted.size() - 1) + .5);
+  return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+Summary summarize(std::vector<double> &seconds)
+{
+  std::sort(seconds.begin(), seconds.end());
+  Summary summary;
+  summary.count = seconds.size();
+  summary.mean = 0.;
+  for (std::size_t i = 0; i < seconds.size(); ++i)
+    {
+    summary.mean += seconds[i];
+    }
+  summary.mean /= seconds.size();
+  summary.p50 = percentile(seconds, .5);
+  summary.p90 = percentile(seconds, .9);
+  summary.p99 = percentile(seconds, .99);
+  summary.max = seconds.back();
+  return summary;
+}
+
+} // end anon namespace
+
+void gvProfiler::enable(const std::string &fileName, std::size_t capacity)
+{
+  // Never freed: scopes on other threads may still hold it at exit.
+  gvProfiler *profiler = new gvProfiler(fileName, capacity);
+  s_active.store(profiler, std::memory_order_release);
+}
+
+gvProfiler::gvProfiler(const std::string &fileName, std::size_t capacity)
+  : m_fileName(fileName),
+    m_epoch(Clock::now()),
+    m_ring(std::max<std::size_t>(capacity, 1)),
+    m_next(0)
+{
+}
+
+void gvProfiler::record(Phase phase, int window, int eye,
+                        Clock::time_point start, Clock::time_point end)
+{
+  std::uint32_t info =
+    static_cast<std::uint32_t>(static_cast<std::uint16_t>(window)) |
+    static_cast<std::uint32_t>(static_cast<std::uint8_t>(eye)) << 16 |
+    static_cast<std::uint32_t>(phase) << 24;
+
+  // Mark the slot as being written, fill it in, then publish it under this
+  // sample's ticket:
+  std::uint64_t ticket = m_next.fetch_add(1, std::memory_order_relaxed);
+  Slot &slot = m_ring[ticket % m_ring.size()];
+  slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.start.store(std::chrono::duration<double>(start - m_epoch).count(),
+                   std::memory_order_relaxed);
+  slot.seconds.store(
+    static_cast<float>(std::chrono::duration<double>(end - start).count()),
+    std::memory_order_relaxed);
+  slot.info.store(info, std::memory_order_relaxed);
+  slot.sequence.store(2 * ticket + 2, std::memory_order_release);
+}
+
+std::vector<gvProfiler::Sample> gvProfiler::samples() const
+{
+  std::uint64_t next = m_next.load(std::memory_order_acquire);
+  std::uint64_t count = std::min<std::uint64_t>(next, m_ring.size());
+  std::vector<Sample> result;
+  result.reserve(static_cast<std::size_t>(count));
+  for (std::uint64_t i = next - count; i < next; ++i)
+    {
+    // Skip slots that are still being written or were overwritten by a
+    // later ticket while this one was read:
+    const Slot &slot = m_ring[i % m_ring.size()];
+    std::uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence != 2 * i + 2)
+      {
+      continue;
+      }
+    Sample sample;
+    sample.start = slot.start.load(std::memory_order_relaxed);
+    sample.seconds = slot.seconds.load(std::memory_order_relaxed);
+    std::uint32_t info = slot.info.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != sequence)
+      {
+      continue;
+      }
+    sample.window = static_cast<std::int16_t>(info & 0xffff);
+    sample.eye = static_cast<std::int8_t>((info >> 16) & 0xff);
+    sample.phase = static_cast<std::uint8_t>(info >> 24);
+    result.push_back(sample);
+    }
+  return result;
+}
+
+const char* gvProfiler::phaseName(Phase phase)
+{
+  switch (phase)
+    {
+    case Frame:
+      return "frame";
+    case Display:
+      return "display";
+    case InitContext:
+      return "initContext";
+    case Load:
+      return "load";
+    case Locator:
+      return "locator";
+    default:
+      return "unknown";
+    }
+}
+
+bool gvProfiler::write() const
+{
+  std::vector<Sample> samples = this->samples();
+
+  // Percentiles per phase, and per window for display():
+  std::map<std::pair<int, int>, std::vector<double> > groups;
+  for (std::size_t i = 0; i < samples.size(); ++i)
+    {
+    const Sample &sample = samples[i];
+    int window = sample.phase == Display ? sample.window : -1;
+    groups[std::make_pair(static_cast<int>(sample.phase), window)]
+      .push_back(sample.seconds);
+    }
+  std::vector<std::pair<std::pair<int, int>, Summary> > summaries;
+  for (std::map<std::pair<int, int>, std::vector<double> >::iterator it =
+         groups.begin(); it != groups.end(); ++it)
+    {
+    summaries.push_back(std::make_pair(it->first, summarize(it->second)));
+    }
+
+  std::ofstream out(m_fileName.c_str());
+  if (!out)
+    {
+    std::cerr << "ERROR: Could not write profile " << m_fileName
+              << std::endl;
+    return false;
+    }
+
+  bool json = m_fileName.size() >= 5 &&
+    m_fileName.compare(m_fileName.size() - 5, 5, ".json") == 0;
+  if (json)
+    {
+    out << "{\n  \"summary\": [";
+    for (std::size_t i = 0; i < summaries.size(); ++i)
+      {
+      const Summary &s = summaries[i].second;
+      out << (i ? ",\n" : "\n")
+          << "    {\"phase\": \""
+          << phaseName(static_cast<Phase>(summaries[i].first.first))
+          << "\", \"window\": " << summaries[i].first.second
+          << ", \"count\": " << s.count
+          << ", \"meanMs\": " << 1e3 * s.mean
+          << ", \"p50Ms\": " << 1e3 * s.p50
+          << ", \"p90Ms\": " << 1e3 * s.p90
+          << ", \"p99Ms\": " << 1e3 * s.p99
+          << ", \"maxMs\": " << 1e3 * s.max << "}";
+      }
+    out << "\n  ],\n  \"samples\": [";
+    for (std::size_t i = 0; i < samples.size(); ++i)
+      {
+      const Sample &sample = samples[i];
+      out << (i ? ",\n" : "\n")
+          << "    {\"phase\": \""
+          << phaseName(static_cast<Phase>(sample.phase))
+          << "\", \"window\": " << sample.window
+          << ", \"eye\": " << static_cast<int>(sample.eye)
+          << ", \"start\": " << sample.start
+          << ", \"ms\": " << 1e3 * sample.seconds << "}";
+      }
+    out << "\n  ]\n}\n";
+    }
+  else
+    {
+    // Summary table, a blank line, then the samples:
+    out << "phase,window,count,mean_ms,p50_ms,p90_ms,p99_ms,max_ms\n";
+    for (std::size_t i = 0; i < summaries.size(); ++i)
+      {
+      const Summary &s = summaries[i].second;
+      out << phaseName(static_cast<Phase>(summaries[i].first.first)) << ","
+          << summaries[i].first.second << "," << s.count << ","
+          << 1e3 * s.mean << "," << 1e3 * s.p50 << "," << 1e3 * s.p90
+          << "," << 1e3 * s.p99 << "," << 1e3 * s.max << "\n";
+      }
+    out << "\nphase,window,eye,start_s,ms\n";
+    for (std::size_t i = 0; i < samples.size(); ++i)
+      {
+      const Sample &sample = samples[i];
+      out << phaseName(static_cast<Phase>(sample.phase)) << ","
+          << sample.window << "," << static_cast<int>(sample.eye) << ","
+          << sample.start << "," << 1e3 * sample.seconds << "\n";
+      }
+    }
+
+  std::cout << "Wrote " << samples.size() << " profile samples to "
+            << m_fileName << std::endl;
+  return static_cast<bool>(out);
+}
@@ -0,0 +1,130 @@
+#ifndef GVPROFILER_H
+#define GVPROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scoped timers for the phases of a frame. Samples go into a fixed-size
+// ring that any thread appends to without locks; once it is full the oldest
+// samples are overwritten. Each slot carries a sequence number that is only
+// set once its sample is complete, so readers skip samples still being
+// written instead of reading them half done. write() dumps the samples
+// together with per-phase percentiles as CSV, or as JSON if the file name
+// ends in .json.
+//
+// Profiling is off unless enable() was called; a Scope then costs one
+// atomic load.
+class gvProfiler
+{
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  enum Phase
+  {
+    Frame,
+    Display,
+    InitContext,
+    Load,
+    Locator,
+    NumberOfPhases
+  };
+
+  // Times its lifetime as one sample of phase. window and eye are -1 where
+  // they don't apply.
+  class Scope
+  {
+  public:
+    explicit Scope(Phase phase, int window = -1, int eye = -1)
+      : m_profiler(gvProfiler::active()),
+        m_phase(phase),
+        m_window(window),
+        m_eye(eye)
+    {
+      if (m_profiler)
+        {
+        m_start = Clock::now();
+        }
+    }
+    ~Scope()
+    {
+      if (m_profiler)
+        {
+        m_profiler->record(m_phase, m_window, m_eye, m_start, Clock::now());
+        }
+    }
+
+  private:
+    Scope(const Scope&) = delete;
+    void operator=(const Scope&) = delete;
+
+    gvProfiler *m_profiler;
+    Phase m_phase;
+    int m_window;
+    int m_eye;
+    Clock::time_point m_start;
+  };
+
+  // Start profiling into fileName, keeping the last capacity samples.
+  static void enable(const std::string &fileName,
+                     std::size_t capacity = 1 << 20);
+
+  // The profiler if profiling is enabled, else null.
+  static gvProfiler* active()
+  {
+    return s_active.load(std::memory_order_acquire);
+  }
+
+  void record(Phase phase, int window, int eye, Clock::time_point start,
+              Clock::time_point end);
+
+  // Dump the samples recorded so far. Returns false if the file can't be
+  // written. Samples recorded while writing may or may not be included.
+  bool write() const;
+
+  const std::string& fileName() const { return m_fileName; }
+
+  static const char* phaseName(Phase phase);
+
+private:
+  struct Sample
+  {
+    double start;   // Seconds since enable()
+    float seconds;
+    std::int16_t window;
+    std::int8_t eye;
+    std::uint8_t phase;
+  };
+
+  // A ring entry. sequence is 2 * ticket + 2 once the sample with that
+  // ticket is published, odd while a sample is being written, and 0 before
+  // the first one. The fields are atomic so that a reader racing a writer
+  // sees stale or new values rather than a data race; the sequence tells it
+  // which.
+  struct Slot
+  {
+    Slot() : sequence(0), start(0.), seconds(0.f), info(0) {}
+
+    std::atomic<std::uint64_t> sequence;
+    std::atomic<double> start;
+    std::atomic<float> seconds;
+    std::atomic<std::uint32_t> info; // window, eye and phase, packed
+  };
+
+  gvProfiler(const std::string &fileName, std::size_t capacity);
+
+  // The retained, published samples in recording order.
+  std::vector<Sample> samples() const;
+
+  static std::atomic<gvProfiler*> s_active;
+
+  std::string m_fileName;
+  Clock::time_point m_epoch;
+  std::vector<Slot> m_ring;
+  std::atomic<std::uint64_t> m_next;
+};
+
+#endif // GVPROFILER_H
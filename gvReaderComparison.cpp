@@ -0,0 +1,326 @@
+// Checks gvGeometryReader's fast readers against VTK's on a corpus of mesh
+// files.
+//
+// Each file is read twice, by the fast path and by the VTK reader for its
+// format, and the outputs are compared: point and cell counts, the point
+// arrays by name, and every polygon corner by its position and point array
+// values. Corners are compared through their points rather than their ids,
+// so a reader that numbers the same points differently still matches. One
+// line is printed per file, followed by the first differences found; the
+// exit status is nonzero if any file differs or can't be read.
+
+#include "gvGeometryReader.h"
+#include "gvMeshUtilities.h"
+
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkMath.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+void printUsage()
+{
+  std::cout << "USAGE: gvReaderComparison [-threads <int>] "
+               "[-tolerance <float>] [-differences <int>]\n"
+               "\t\t<mesh>...\n\n"
+               "Reads each mesh with gvGeometryReader's fast reader and with "
+               "VTK's reader and\nreports where the outputs differ. "
+               "Positions match within tolerance (default\n1e-6) times the "
+               "mesh's diagonal, point array values within tolerance times\n"
+               "their magnitude, at least 1. At most -differences "
+               "(default 10) are listed per\nfile." << std::endl;
+}
+
+// Collects the differences between two outputs, listing the first few.
+class Differences
+{
+public:
+  explicit Differences(std::size_t maximum)
+    : m_maximum(maximum),
+      m_count(0)
+  {
+  }
+
+  void add(const std::string &message)
+  {
+    if (m_count++ < m_maximum)
+      {
+      m_messages.push_back(message);
+      }
+  }
+
+  std::size_t count() const { return m_count; }
+  const std::vector<std::string>& messages() const { return m_messages; }
+
+private:
+  std::size_t m_maximum;
+  std::size_t m_count;
+  std::vector<std::string> m_messages;
+};
+
+bool near(double a, double b, double tolerance)
+{
+  return std::fabs(a - b) <= tolerance;
+}
+
+// Point arrays of fast paired by name with those of reference; unnamed
+// arrays are paired by their attribute role.
+void pairArrays(vtkPointData *fast, vtkPointData *reference,
+                std::vector<std::pair<vtkDataArray*, vtkDataArray*> > &pairs,
+                Differences &differences)
+{
+  for (int i = 0; i < reference->GetNumberOfArrays(); ++i)
+    {
+    vtkDataArray *expected = reference->GetArray(i);
+    if (!expected)
+      {
+      continue;
+      }
+    const char *name = expected->GetName();
+    vtkDataArray *actual = nullptr;
+    if (name && *name)
+      {
+      actual = fast->GetArray(name);
+      }
+    else
+      {
+      int attribute = reference->IsArrayAnAttribute(i);
+      actual = attribute >= 0 ? fast->GetAttribute(attribute) : nullptr;
+      }
+    std::string label = name && *name ? name : "(unnamed)";
+    if (!actual)
+      {
+      differences.add("point array " + label + " is missing");
+      }
+    else if (actual->GetNumberOfComponents() !=
+               expected->GetNumberOfComponents() ||
+             actual->GetNumberOfTuples() != expected->GetNumberOfTuples())
+      {
+      std::ostringstream message;
+      message << "point array " << label << " has "
+              << actual->GetNumberOfTuples() << " x "
+              << actual->GetNumberOfComponents() << " values instead of "
+              << expected->GetNumberOfTuples() << " x "
+              << expected->GetNumberOfComponents();
+      differences.add(message.str());
+      }
+    else
+      {
+      pairs.push_back(std::make_pair(actual, expected));
+      }
+    }
+  for (int i = 0; i < fast->GetNumberOfArrays(); ++i)
+    {
+    vtkDataArray *actual = fast->GetArray(i);
+    const char *name = actual ? actual->GetName() : nullptr;
+    if (name && *name && !reference->GetArray(name))
+      {
+      differences.add(std::string("point array ") + name + " is extra");
+      }
+    }
+}
+
+void compareCounts(const char *what, vtkIdType actual, vtkIdType expected,
+                   Differences &differences)
+{
+  if (actual != expected)
+    {
+    std::ostringstream message;
+    message << actual << " " << what << " instead of " << expected;
+    differences.add(message.str());
+    }
+}
+
+void compare(vtkPolyData *fast, vtkPolyData *reference, double tolerance,
+             Differences &differences)
+{
+  compareCounts("points", fast->GetNumberOfPoints(),
+                reference->GetNumberOfPoints(), differences);
+  compareCounts("vertex cells", fast->GetNumberOfVerts(),
+                reference->GetNumberOfVerts(), differences);
+  compareCounts("line cells", fast->GetNumberOfLines(),
+                reference->GetNumberOfLines(), differences);
+  compareCounts("polygons", fast->GetNumberOfPolys(),
+                reference->GetNumberOfPolys(), differences);
+  compareCounts("strips", fast->GetNumberOfStrips(),
+                reference->GetNumberOfStrips(), differences);
+
+  std::vector<std::pair<vtkDataArray*, vtkDataArray*> > arrays;
+  pairArrays(fast->GetPointData(), reference->GetPointData(), arrays,
+             differences);
+
+  if (reference->GetNumberOfPoints() == 0)
+    {
+    return;
+    }
+  double bounds[6];
+  reference->GetBounds(bounds);
+  double corners[6] = { bounds[0], bounds[2], bounds[4],
+                        bounds[1], bounds[3], bounds[5] };
+  double diagonal = std::sqrt(vtkMath::Distance2BetweenPoints(corners,
+                                                              corners + 3));
+  double positionTolerance = tolerance * diagonal;
+
+  // Polygons in order, corner by corner:
+  vtkCellArray *fastPolys = fast->GetPolys();
+  vtkCellArray *referencePolys = reference->GetPolys();
+  vtkIdType actualSize, expectedSize;
+  gvCellPointIds actualIds, expectedIds;
+  fastPolys->InitTraversal();
+  referencePolys->InitTraversal();
+  for (vtkIdType cell = 0;
+       fastPolys->GetNextCell(actualSize, actualIds) &&
+       referencePolys->GetNextCell(expectedSize, expectedIds); ++cell)
+    {
+    if (actualSize != expectedSize)
+      {
+      std::ostringstream message;
+      message << "polygon " << cell << " has " << actualSize
+              << " corners instead of " << expectedSize;
+      differences.add(message.str());
+      continue;
+      }
+    for (vtkIdType c = 0; c < actualSize; ++c)
+      {
+      vtkIdType actualId = actualIds[c];
+      vtkIdType expectedId = expectedIds[c];
+      if (actualId < 0 || actualId >= fast->GetNumberOfPoints())
+        {
+        std::ostringstream message;
+        message << "polygon " << cell << " uses point " << actualId
+                << ", which doesn't exist";
+        differences.add(message.str());
+        continue;
+        }
+
+      double actual[3], expected[3];
+      fast->GetPoint(actualId, actual);
+      reference->GetPoint(expectedId, expected);
+      if (!near(actual[0], expected[0], positionTolerance) ||
+          !near(actual[1], expected[1], positionTolerance) ||
+          !near(actual[2], expected[2], positionTolerance))
+        {
+        std::ostringstream message;
+        message << "polygon " << cell << " corner " << c << " is at ("
+                << actual[0] << ", " << actual[1] << ", " << actual[2]
+                << ") instead of (" << expected[0] << ", " << expected[1]
+                << ", " << expected[2] << ")";
+        differences.add(message.str());
+        }
+
+      for (std::size_t a = 0; a < arrays.size(); ++a)
+        {
+        vtkDataArray *actualArray = arrays[a].first;
+        vtkDataArray *expectedArray = arrays[a].second;
+        for (int k = 0; k < expectedArray->GetNumberOfComponents(); ++k)
+          {
+          double value = actualArray->GetComponent(actualId, k);
+          double wanted = expectedArray->GetComponent(expectedId, k);
+          if (!near(value, wanted,
+                    tolerance * std::max(1., std::fabs(wanted))))
+            {
+            std::ostringstream message;
+            const char *name = expectedArray->GetName();
+            message << "polygon " << cell << " corner " << c << " has "
+                    << (name && *name ? name : "(unnamed)") << "[" << k
+                    << "] = " << value << " instead of " << wanted;
+            differences.add(message.str());
+            }
+          }
+        }
+      }
+    }
+}
+
+} // end anon namespace
+
+int main(int argc, char *argv[])
+{
+  unsigned int threads = 0;
+  double tolerance = 1e-6;
+  std::size_t maximumDifferences = 10;
+  std::vector<std::string> inputs;
+  for (int i = 1; i < argc; ++i)
+    {
+    if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+      {
+      threads = static_cast<unsigned int>(atoi(argv[++i]));
+      }
+    else if (strcmp(argv[i], "-tolerance") == 0 && i + 1 < argc)
+      {
+      tolerance = atof(argv[++i]);
+      }
+    else if (strcmp(argv[i], "-differences") == 0 && i + 1 < argc)
+      {
+      maximumDifferences = static_cast<std::size_t>(atoi(argv[++i]));
+      }
+    else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "-help") == 0)
+      {
+      printUsage();
+      return 0;
+      }
+    else
+      {
+      inputs.push_back(argv[i]);
+      }
+    }
+  if (inputs.empty())
+    {
+    printUsage();
+    return 1;
+    }
+
+  std::size_t failures = 0;
+  for (std::size_t i = 0; i < inputs.size(); ++i)
+    {
+    const std::string &fileName = inputs[i];
+    gvGeometryReader::Format format = gvGeometryReader::format(fileName);
+    vtkSmartPointer<vtkPolyData> fast =
+      gvGeometryReader::read(fileName, threads, true);
+    vtkSmartPointer<vtkPolyData> reference =
+      gvGeometryReader::read(fileName, threads, false);
+    if (!fast || !reference)
+      {
+      std::cerr << "ERROR: Could not read " << fileName << " with "
+                << (fast ? "VTK's reader." : "the fast reader.") << std::endl;
+      ++failures;
+      continue;
+      }
+
+    Differences differences(maximumDifferences);
+    compare(fast, reference, tolerance, differences);
+    if (differences.count() == 0)
+      {
+      std::cout << "OK      " << fileName << " ("
+                << gvGeometryReader::formatName(format) << ", "
+                << reference->GetNumberOfPoints() << " points, "
+                << reference->GetNumberOfPolys() << " polygons)" << std::endl;
+      continue;
+      }
+    std::cout << "DIFFERS " << fileName << " ("
+              << gvGeometryReader::formatName(format) << "): "
+              << differences.count() << " differences" << std::endl;
+    for (std::size_t m = 0; m < differences.messages().size(); ++m)
+      {
+      std::cout << "  " << differences.messages()[m] << std::endl;
+      }
+    ++failures;
+    }
+
+  std::cout << inputs.size() - failures << " of " << inputs.size()
+            << " files match." << std::endl;
+  return failures == 0 ? 0 : 1;
+}
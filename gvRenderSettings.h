@@ -0,0 +1,72 @@
+#ifndef GVRENDERSETTINGS_H
+#define GVRENDERSETTINGS_H
+
+// Display settings shared by every GL context: the headlight, the actor's
+// property and how translucent surfaces are blended. The application state
+// versions them so contexts only touch their VTK objects when something
+// changed.
+struct gvRenderSettings
+{
+  gvRenderSettings()
+    : intensity(1.f),
+      opacity(1.),
+      representation(2),
+      transparency(Unsorted),
+      maximumPeels(4),
+      peelingBudget(0.004)
+  {
+    for (int i = 0; i < 3; ++i)
+      {
+      ambient[i] = 0.f;
+      diffuse[i] = 1.f;
+      specular[i] = 0.f;
+      }
+  }
+
+  bool operator==(const gvRenderSettings &other) const
+  {
+    for (int i = 0; i < 3; ++i)
+      {
+      if (ambient[i] != other.ambient[i] ||
+          diffuse[i] != other.diffuse[i] ||
+          specular[i] != other.specular[i])
+        {
+        return false;
+        }
+      }
+    return intensity == other.intensity &&
+      opacity == other.opacity &&
+      representation == other.representation &&
+      transparency == other.transparency &&
+      maximumPeels == other.maximumPeels &&
+      peelingBudget == other.peelingBudget;
+  }
+  bool operator!=(const gvRenderSettings &other) const
+  {
+    return !(*this == other);
+  }
+
+  // Headlight:
+  float intensity;
+  float ambient[3];
+  float diffuse[3];
+  float specular[3];
+
+  // Actor: VTK_POINTS, VTK_WIREFRAME, VTK_SURFACE, or 3 for the surface
+  // with edges.
+  double opacity;
+  int representation;
+
+  // Blending while opacity is below 1; see gvTransparency.
+  enum Transparency
+  {
+    Unsorted,     // In draw order
+    SortedChunks, // Actors sorted back to front by their bounds
+    DepthPeeling
+  };
+  int transparency;
+  int maximumPeels;
+  double peelingBudget; // Seconds per render, 0 to always peel the maximum
+};
+
+#endif // GVRENDERSETTINGS_H
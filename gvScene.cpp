@@ -0,0 +1,465 @@
+#include "gvScene.h"
+
+#include "gvMeshChunks.h"
+
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <sstream>
+
+namespace {
+
+typedef std::array<double, 16> Matrix;
+
+Matrix identity()
+{
+  Matrix m;
+  for (int i = 0; i < 16; ++i)
+    {
+    m[i] = i % 5 == 0 ? 1. : 0.;
+    }
+  return m;
+}
+
+// a * b, row-major.
+Matrix multiply(const Matrix &a, const Matrix &b)
+{
+  Matrix m;
+  for (int i = 0; i < 4; ++i)
+    {
+    for (int j = 0; j < 4; ++j)
+      {
+      double sum = 0.;
+      for (int k = 0; k < 4; ++k)
+        {
+        sum += a[4 * i + k] * b[4 * k + j];
+        }
+      m[4 * i + j] = sum;
+      }
+    }
+  return m;
+}
+
+bool isIdentity(const Matrix &m)
+{
+  return m == identity();
+}
+
+// Rotation by degrees about axis, which needn't be normalized.
+bool rotation(const double axis[3], double degrees, Matrix &m)
+{
+  double length =
+    std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+  if (length <= 0.)
+    {
+    return false;
+    }
+  double x = axis[0] / length;
+  double y = axis[1] / length;
+  double z = axis[2] / length;
+  double angle = degrees * M_PI / 180.;
+  double c = std::cos(angle);
+  double s = std::sin(angle);
+  double t = 1. - c;
+  m = identity();
+  m[0] = t * x * x + c;
+  m[1] = t * x * y - s * z;
+  m[2] = t * x * z + s * y;
+  m[4] = t * x * y + s * z;
+  m[5] = t * y * y + c;
+  m[6] = t * y * z - s * x;
+  m[8] = t * x * z - s * y;
+  m[9] = t * y * z + s * x;
+  m[10] = t * z * z + c;
+  return true;
+}
+
+bool isAbsolute(const std::string &fileName)
+{
+  return !fileName.empty() && fileName[0] == '/';
+}
+
+// A translation from 3 values or a row-major matrix from 16.
+bool instanceTransform(const std::vector<double> &values, Matrix &m)
+{
+  m = identity();
+  if (values.size() == 3)
+    {
+    for (int i = 0; i < 3; ++i)
+      {
+      m[4 * i + 3] = values[i];
+      }
+    return true;
+    }
+  if (values.size() == 16)
+    {
+    std::copy(values.begin(), values.end(), m.begin());
+    return true;
+    }
+  return false;
+}
+
+bool readValues(std::istream &in, std::vector<double> &values)
+{
+  values.clear();
+  double value;
+  while (in >> value)
+    {
+    values.push_back(value);
+    }
+  return in.eof();
+}
+
+// One instance per line of fileName; '#' starts a comment.
+bool readInstances(const std::string &fileName, std::vector<Matrix> &instances)
+{
+  std::ifstream in(fileName.c_str());
+  if (!in)
+    {
+    std::cerr << "ERROR: Could not open instances " << fileName << std::endl;
+    return false;
+    }
+  std::string line;
+  std::vector<double> values;
+  int lineNumber = 0;
+  while (std::getline(in, line))
+    {
+    ++lineNumber;
+    std::string::size_type comment = line.find('#');
+    if (comment != std::string::npos)
+      {
+      line.erase(comment);
+      }
+    std::istringstream fields(line);
+    bool valid = readValues(fields, values);
+    if (valid && values.empty())
+      {
+      continue;
+      }
+    Matrix m;
+    if (!valid || !instanceTransform(values, m))
+      {
+      std::cerr << "ERROR: " << fileName << ":" << lineNumber
+                << ": Can't read \"" << line << "\"" << std::endl;
+      return false;
+      }
+    instances.push_back(m);
+    }
+  return true;
+}
+
+} // end anon namespace
+
+gvScene::Entry::Entry()
+  : transform(identity()),
+    visible(true)
+{
+}
+
+gvScene::gvScene()
+{
+  for (int i = 0; i < 6; ++i)
+    {
+    m_bounds[i] = 0.;
+    }
+}
+
+void gvScene::addModel(const Entry &entry, vtkPolyData *geometry,
+                       const std::shared_ptr<gvBVH> &index,
+                       const std::shared_ptr<gvMeshChunks> &chunks,
+                       const std::shared_ptr<const gvCompactMesh> &compact,
+                       std::size_t entryIndex)
+{
+  Model model;
+  model.fileName = entry.fileName;
+  model.geometry = geometry;
+  model.entry = entryIndex;
+  model.index = index;
+  model.chunks = chunks;
+  model.compact = compact;
+  double bounds[6];
+  geometry->GetBounds(bounds);
+  if (!entry.instances.empty())
+    {
+    vtkNew<vtkMatrix4x4> instance;
+    for (std::size_t i = 0; i < entry.instances.size(); ++i)
+      {
+      model.instances.push_back(entry.instances[i]);
+      instance->DeepCopy(model.instances.back().data());
+      double instanceBounds[6];
+      transformBounds(instance.Get(), bounds, instanceBounds);
+      for (int j = 0; j < 3; ++j)
+        {
+        model.bounds[2 * j] = i == 0 ? instanceBounds[2 * j] :
+          std::min(model.bounds[2 * j], instanceBounds[2 * j]);
+        model.bounds[2 * j + 1] = i == 0 ? instanceBounds[2 * j + 1] :
+          std::max(model.bounds[2 * j + 1], instanceBounds[2 * j + 1]);
+        }
+      }
+    m_models.push_back(model);
+    return;
+    }
+
+  if (!isIdentity(entry.transform))
+    {
+    model.transform = vtkSmartPointer<vtkMatrix4x4>::New();
+    model.transform->DeepCopy(entry.transform.data());
+    }
+  transformBounds(model.transform, bounds, model.bounds);
+  if (chunks)
+    {
+    model.chunkBounds.resize(chunks->chunks().size());
+    for (std::size_t i = 0; i < chunks->chunks().size(); ++i)
+      {
+      transformBounds(model.transform, chunks->chunks()[i].bounds,
+                      model.chunkBounds[i].data());
+      }
+    }
+  m_models.push_back(model);
+}
+
+void gvScene::buildHierarchy()
+{
+  m_nodes.clear();
+  if (m_models.empty())
+    {
+    return;
+    }
+  std::vector<int> models(m_models.size());
+  for (std::size_t i = 0; i < models.size(); ++i)
+    {
+    models[i] = static_cast<int>(i);
+    }
+  m_nodes.reserve(2 * models.size() - 1);
+  this->buildNode(models, 0, models.size());
+  std::copy(m_nodes[0].bounds, m_nodes[0].bounds + 6, m_bounds);
+}
+
+int gvScene::buildNode(std::vector<int> &models, std::size_t begin,
+                       std::size_t end)
+{
+  int index = static_cast<int>(m_nodes.size());
+  m_nodes.push_back(Node());
+  Node &node = m_nodes.back();
+  node.children[0] = -1;
+  node.children[1] = -1;
+  node.model = -1;
+
+  // Bounds of the models and of their centers:
+  double centers[6];
+  for (int i = 0; i < 3; ++i)
+    {
+    node.bounds[2 * i] = std::numeric_limits<double>::max();
+    node.bounds[2 * i + 1] = -std::numeric_limits<double>::max();
+    centers[2 * i] = node.bounds[2 * i];
+    centers[2 * i + 1] = node.bounds[2 * i + 1];
+    }
+  for (std::size_t m = begin; m < end; ++m)
+    {
+    const double *bounds = m_models[models[m]].bounds;
+    for (int i = 0; i < 3; ++i)
+      {
+      double center = .5 * (bounds[2 * i] + bounds[2 * i + 1]);
+      node.bounds[2 * i] = std::min(node.bounds[2 * i], bounds[2 * i]);
+      node.bounds[2 * i + 1] =
+        std::max(node.bounds[2 * i + 1], bounds[2 * i + 1]);
+      centers[2 * i] = std::min(centers[2 * i], center);
+      centers[2 * i + 1] = std::max(centers[2 * i + 1], center);
+      }
+    }
+
+  if (end - begin == 1)
+    {
+    node.model = models[begin];
+    return index;
+    }
+
+  // Median split along the longest axis of the centers:
+  int axis = 0;
+  for (int i = 1; i < 3; ++i)
+    {
+    if (centers[2 * i + 1] - centers[2 * i] >
+        centers[2 * axis + 1] - centers[2 * axis])
+      {
+      axis = i;
+      }
+    }
+  std::size_t middle = begin + (end - begin) / 2;
+  std::nth_element(models.begin() + begin, models.begin() + middle,
+                   models.begin() + end, [this, axis](int a, int b)
+    {
+    const double *ba = m_models[a].bounds;
+    const double *bb = m_models[b].bounds;
+    return ba[2 * axis] + ba[2 * axis + 1] < bb[2 * axis] + bb[2 * axis + 1];
+    });
+
+  // Children may reallocate m_nodes, so node is not used past here:
+  int left = this->buildNode(models, begin, middle);
+  int right = this->buildNode(models, middle, end);
+  m_nodes[index].children[0] = left;
+  m_nodes[index].children[1] = right;
+  return index;
+}
+
+bool gvScene::readManifest(const std::string &fileName,
+                           std::vector<Entry> &entries)
+{
+  std::ifstream in(fileName.c_str());
+  if (!in)
+    {
+    std::cerr << "ERROR: Could not open scene " << fileName << std::endl;
+    return false;
+    }
+  std::string directory;
+  std::size_t slash = fileName.rfind('/');
+  if (slash != std::string::npos)
+    {
+    directory = fileName.substr(0, slash + 1);
+    }
+
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(in, line))
+    {
+    ++lineNumber;
+    std::string::size_type comment = line.find('#');
+    if (comment != std::string::npos)
+      {
+      line.erase(comment);
+      }
+    std::istringstream fields(line);
+    std::string keyword;
+    if (!(fields >> keyword))
+      {
+      continue;
+      }
+
+    bool valid = true;
+    if (keyword == "model")
+      {
+      Entry entry;
+      std::getline(fields >> std::ws, entry.fileName);
+      entry.fileName.erase(entry.fileName.find_last_not_of(" \t\r") + 1);
+      valid = !entry.fileName.empty();
+      if (valid && !isAbsolute(entry.fileName) &&
+          entry.fileName.compare(0, 10, "synthetic:") != 0)
+        {
+        entry.fileName = directory + entry.fileName;
+        }
+      entries.push_back(entry);
+      }
+    else if (entries.empty())
+      {
+      valid = false;
+      }
+    else if (keyword == "hidden")
+      {
+      entries.back().visible = false;
+      }
+    else if (keyword == "instances")
+      {
+      std::string instances;
+      std::getline(fields >> std::ws, instances);
+      instances.erase(instances.find_last_not_of(" \t\r") + 1);
+      if (!isAbsolute(instances))
+        {
+        instances = directory + instances;
+        }
+      std::vector<Matrix> &copies = entries.back().instances;
+      std::size_t first = copies.size();
+      if (!readInstances(instances, copies))
+        {
+        return false;
+        }
+      // Placed by the lines so far, as for a single instance:
+      for (std::size_t i = first; i < copies.size(); ++i)
+        {
+        copies[i] = multiply(copies[i], entries.back().transform);
+        }
+      }
+    else if (keyword == "instance")
+      {
+      std::vector<double> values;
+      Matrix m;
+      valid = readValues(fields, values) && instanceTransform(values, m);
+      // The transform so far is applied now, so later lines don't move
+      // this copy:
+      entries.back().instances.push_back(
+        multiply(m, entries.back().transform));
+      }
+    else
+      {
+      std::vector<double> values;
+      valid = readValues(fields, values);
+
+      Matrix m = identity();
+      if (keyword == "scale" && (values.size() == 1 || values.size() == 3))
+        {
+        for (int i = 0; i < 3; ++i)
+          {
+          m[5 * i] = values[values.size() == 1 ? 0 : i];
+          }
+        }
+      else if (keyword == "rotate" && values.size() == 4)
+        {
+        valid = valid && rotation(values.data(), values[3], m);
+        }
+      else if (keyword == "translate" && values.size() == 3)
+        {
+        for (int i = 0; i < 3; ++i)
+          {
+          m[4 * i + 3] = values[i];
+          }
+        }
+      else if (keyword == "matrix" && values.size() == 16)
+        {
+        std::copy(values.begin(), values.end(), m.begin());
+        }
+      else
+        {
+        valid = false;
+        }
+      entries.back().transform = multiply(m, entries.back().transform);
+      }
+
+    if (!valid)
+      {
+      std::cerr << "ERROR: " << fileName << ":" << lineNumber
+                << ": Can't read \"" << line << "\"" << std::endl;
+      return false;
+      }
+    }
+  return true;
+}
+
+void gvScene::transformBounds(vtkMatrix4x4 *transform, const double bounds[6],
+                              double result[6])
+{
+  if (!transform)
+    {
+    std::copy(bounds, bounds + 6, result);
+    return;
+    }
+
+  // The extent along each output axis is the sum of the input extents,
+  // scaled by the absolute matrix entries:
+  for (int i = 0; i < 3; ++i)
+    {
+    double center = transform->GetElement(i, 3);
+    double extent = 0.;
+    for (int j = 0; j < 3; ++j)
+      {
+      double m = transform->GetElement(i, j);
+      center += m * .5 * (bounds[2 * j] + bounds[2 * j + 1]);
+      extent += std::fabs(m) * .5 * (bounds[2 * j + 1] - bounds[2 * j]);
+      }
+    result[2 * i] = center - extent;
+    result[2 * i + 1] = center + extent;
+    }
+}
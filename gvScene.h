@@ -0,0 +1,134 @@
+#ifndef GVSCENE_H
+#define GVSCENE_H
+
+#include <vtkSmartPointer.h>
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+
+class gvBVH;
+class gvCompactMesh;
+class gvMeshChunks;
+class vtkMatrix4x4;
+class vtkPolyData;
+
+// The models on display, each placed by its own transform, and a bounding
+// hierarchy over them so whole models outside the view are culled with a
+// few box tests. A scene is built by the loader and shared read-only by the
+// GL contexts once published.
+class gvScene
+{
+public:
+  // A model to load, from the command line or a scene manifest.
+  struct Entry
+  {
+    Entry();
+
+    std::string fileName;
+
+    // Model to scene coordinates, row-major.
+    std::array<double, 16> transform;
+
+    // Model to scene transforms of copies of the model, row-major, each
+    // already including transform as it stood when the copy was added.
+    // Empty draws the model once, by transform.
+    std::vector<std::array<double, 16> > instances;
+
+    // Shown when the scene is first displayed.
+    bool visible;
+  };
+
+  struct Model
+  {
+    std::string fileName;
+    vtkSmartPointer<vtkPolyData> geometry;
+
+    // Index of the entry it was loaded from. Entries that failed to load
+    // have no model, so this can be larger than the model's own index.
+    std::size_t entry;
+
+    // In model coordinates, like geometry. Either may be null.
+    std::shared_ptr<gvBVH> index;
+    std::shared_ptr<gvMeshChunks> chunks;
+
+    // Quantized copy of the chunks that the OpenGL2 backend draws instead
+    // of their poly data, or null.
+    std::shared_ptr<const gvCompactMesh> compact;
+
+    // Model to scene coordinates, or null for the identity.
+    vtkSmartPointer<vtkMatrix4x4> transform;
+
+    // Row-major model to scene transforms of an instanced model, which has
+    // no transform and no chunks; it is drawn whole, once per instance.
+    std::vector<std::array<double, 16> > instances;
+
+    // Scene coordinates:
+    double bounds[6];
+    std::vector<std::array<double, 6> > chunkBounds;
+  };
+
+  struct Node
+  {
+    double bounds[6];
+    int children[2]; // -1 on leaves
+    int model;       // Model of a leaf, else -1
+  };
+
+  gvScene();
+
+  // Add a model loaded from the entry at entryIndex of the list being
+  // loaded, and compute its bounds in scene coordinates.
+  void addModel(const Entry &entry, vtkPolyData *geometry,
+                const std::shared_ptr<gvBVH> &index,
+                const std::shared_ptr<gvMeshChunks> &chunks,
+                const std::shared_ptr<const gvCompactMesh> &compact =
+                  nullptr,
+                std::size_t entryIndex = 0);
+
+  // Build the hierarchy and the scene bounds. Call after the last addModel().
+  void buildHierarchy();
+
+  const std::vector<Model>& models() const { return m_models; }
+
+  // The root is the first node; empty if the scene has no models.
+  const std::vector<Node>& nodes() const { return m_nodes; }
+
+  // Combined bounds of all models in scene coordinates.
+  const double* bounds() const { return m_bounds; }
+
+  // Read a manifest listing one model per "model <file>" line, each followed
+  // by optional lines that place it, applied in order:
+  //
+  //   model <file>             relative to the manifest's directory
+  //   scale <s> | <sx sy sz>
+  //   rotate <ax ay az> <deg>  about an axis through the origin
+  //   translate <x y z>
+  //   matrix <16 values>       row-major
+  //   hidden                   start with the model hidden
+  //   instance <x y z> | <16 values>
+  //                            add a copy moved by a translation or a
+  //                            row-major matrix after the lines above;
+  //                            lines below don't move it
+  //   instances <file>         add the copies listed one per line of file,
+  //                            in the same form
+  //
+  // '#' starts a comment. Returns false and prints the offending line if the
+  // manifest can't be read.
+  static bool readManifest(const std::string &fileName,
+                           std::vector<Entry> &entries);
+
+  // The axis-aligned box around bounds after transform (null: identity).
+  static void transformBounds(vtkMatrix4x4 *transform, const double bounds[6],
+                              double result[6]);
+
+private:
+  int buildNode(std::vector<int> &models, std::size_t begin, std::size_t end);
+
+  std::vector<Model> m_models;
+  std::vector<Node> m_nodes;
+  double m_bounds[6];
+};
+
+#endif // GVSCENE_H
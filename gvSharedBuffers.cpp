@@ -0,0 +1,184 @@
+#include "gvSharedBuffers.h"
+
+#include <vtkOpenGLBufferObject.h>
+#include <vtk_glew.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// Groups of this process, for join() to search:
+std::mutex groupsMutex;
+std::vector<std::weak_ptr<gvSharedBuffers> > groups;
+unsigned int groupsCreated = 0;
+
+} // end anon namespace
+
+std::shared_ptr<gvSharedBuffers> gvSharedBuffers::current()
+{
+  std::lock_guard<std::mutex> lock(groupsMutex);
+  for (std::size_t i = 0; i < groups.size(); ++i)
+    {
+    std::shared_ptr<gvSharedBuffers> group = groups[i].lock();
+    if (group && group->isCurrent())
+      {
+      return group;
+      }
+    }
+
+  groups.erase(std::remove_if(groups.begin(), groups.end(),
+                              [](const std::weak_ptr<gvSharedBuffers> &g)
+                                { return g.expired(); }),
+               groups.end());
+
+  // A tag no other group of this process has:
+  std::shared_ptr<gvSharedBuffers> group(new gvSharedBuffers);
+  std::uintptr_t address = reinterpret_cast<std::uintptr_t>(group.get());
+  group->m_tag[0] = 0x67765342; // "gvSB"
+  group->m_tag[1] = ++groupsCreated;
+  group->m_tag[2] = static_cast<unsigned int>(address);
+  group->m_tag[3] = static_cast<unsigned int>(
+    static_cast<std::uint64_t>(address) >> 32);
+
+  GLint previous = 0;
+  glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &previous);
+  glGenBuffers(1, &group->m_probe);
+  glBindBuffer(GL_ARRAY_BUFFER, group->m_probe);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(group->m_tag), group->m_tag,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, static_cast<GLuint>(previous));
+  // Contexts created from now on may look for it on other threads:
+  glFinish();
+
+  groups.push_back(group);
+  return group;
+}
+
+std::shared_ptr<gvSharedBuffers> gvSharedBuffers::join()
+{
+  std::shared_ptr<gvSharedBuffers> group = current();
+  std::lock_guard<std::mutex> lock(group->m_mutex);
+  ++group->m_contexts;
+  return group;
+}
+
+void gvSharedBuffers::leave()
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  --m_contexts;
+}
+
+int gvSharedBuffers::numberOfContexts() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_contexts;
+}
+
+std::size_t gvSharedBuffers::bytes() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_bytes;
+}
+
+gvSharedBuffers::gvSharedBuffers()
+  : m_bytes(0),
+    m_contexts(0),
+    m_probe(0)
+{
+  std::fill(m_tag, m_tag + 4, 0u);
+}
+
+gvSharedBuffers::~gvSharedBuffers()
+{
+  for (std::map<std::pair<const void*, int>, Entry>::iterator it =
+         m_buffers.begin(); it != m_buffers.end(); ++it)
+    {
+    release(it->second);
+    }
+  if (m_probe)
+    {
+    glDeleteBuffers(1, &m_probe);
+    }
+}
+
+bool gvSharedBuffers::isCurrent() const
+{
+  // Binding a name the context doesn't know would create it, so ask first:
+  if (!m_probe || !glIsBuffer(m_probe))
+    {
+    return false;
+    }
+
+  GLint previous = 0;
+  glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &previous);
+  glBindBuffer(GL_ARRAY_BUFFER, m_probe);
+  GLint size = 0;
+  glGetBufferParameteriv(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+  unsigned int tag[4] = { 0, 0, 0, 0 };
+  if (size == static_cast<GLint>(sizeof(tag)))
+    {
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(tag), tag);
+    }
+  glBindBuffer(GL_ARRAY_BUFFER, static_cast<GLuint>(previous));
+  return std::equal(tag, tag + 4, m_tag);
+}
+
+vtkOpenGLBufferObject* gvSharedBuffers::buffer(
+    const std::shared_ptr<const void> &owner, int part,
+    const std::function<std::size_t(vtkOpenGLBufferObject*)> &upload)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  std::pair<const void*, int> key(owner.get(), part);
+  std::map<std::pair<const void*, int>, Entry>::iterator it =
+    m_buffers.find(key);
+  if (it != m_buffers.end() && !it->second.owner.expired())
+    {
+    // Another context may have uploaded it; its commands must be done
+    // before this context's draws read the buffer:
+    glWaitSync(static_cast<GLsync>(it->second.fence), 0, GL_TIMEOUT_IGNORED);
+    return it->second.object.Get();
+    }
+
+  // A new owner, maybe at the address of one that is gone:
+  this->releaseExpired();
+  Entry entry;
+  entry.owner = owner;
+  entry.object = vtkSmartPointer<vtkOpenGLBufferObject>::New();
+  entry.bytes = upload(entry.object.Get());
+  entry.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  // Without a flush the fence might never reach the GPU for the others:
+  glFlush();
+  m_bytes += entry.bytes;
+  return (m_buffers[key] = entry).object.Get();
+}
+
+void gvSharedBuffers::release(Entry &entry)
+{
+  entry.object->ReleaseGraphicsResources();
+  if (entry.fence)
+    {
+    glDeleteSync(static_cast<GLsync>(entry.fence));
+    entry.fence = nullptr;
+    }
+}
+
+void gvSharedBuffers::releaseExpired()
+{
+  std::map<std::pair<const void*, int>, Entry>::iterator it =
+    m_buffers.begin();
+  while (it != m_buffers.end())
+    {
+    if (it->second.owner.expired())
+      {
+      release(it->second);
+      m_bytes -= it->second.bytes;
+      m_buffers.erase(it++);
+      }
+    else
+      {
+      ++it;
+      }
+    }
+}
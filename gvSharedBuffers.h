@@ -0,0 +1,87 @@
+#ifndef GVSHAREDBUFFERS_H
+#define GVSHAREDBUFFERS_H
+
+#include <vtkSmartPointer.h>
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+class vtkOpenGLBufferObject;
+
+// Buffer objects shared by the GL contexts of one share group, so data
+// drawn in several contexts is uploaded once per group instead of once per
+// context. Vertex array objects and programs can't be shared and stay with
+// each context's mappers.
+//
+// The group of the current context is found by looking for the probe
+// buffer each group creates in its first context: a buffer of that name
+// with the group's tag in it can only be seen by contexts sharing objects
+// with that one. Contexts that share nothing get a group of their own.
+//
+// Buffers are kept per owner and part, and released once the owner is gone
+// and another buffer is requested, or with the group. The group goes when
+// the last context state or mapper holding it lets go, which must happen
+// with a context of the group current.
+class gvSharedBuffers
+{
+public:
+  // The current context's share group, created if no other context of
+  // this process belongs to it. Call with the context current.
+  static std::shared_ptr<gvSharedBuffers> current();
+
+  // current(), counted as one more context drawing from the group until it
+  // calls leave().
+  static std::shared_ptr<gvSharedBuffers> join();
+  void leave();
+
+  // Number of contexts that joined and haven't left.
+  int numberOfContexts() const;
+
+  // Bytes uploaded into the group's buffers.
+  std::size_t bytes() const;
+
+  // The buffer holding part of owner's data. The first context to ask for
+  // it calls upload, which fills the buffer and returns the bytes it
+  // uploaded; other contexts wait on the GPU for the upload to finish when
+  // they get the buffer. The buffer lives as long as owner does. Call with
+  // a context of the group current.
+  vtkOpenGLBufferObject* buffer(
+    const std::shared_ptr<const void> &owner, int part,
+    const std::function<std::size_t(vtkOpenGLBufferObject*)> &upload);
+
+  ~gvSharedBuffers();
+
+private:
+  gvSharedBuffers();
+  gvSharedBuffers(const gvSharedBuffers&) = delete;
+  void operator=(const gvSharedBuffers&) = delete;
+
+  // True if the current context sees this group's probe buffer.
+  bool isCurrent() const;
+
+  // Drop the buffers of owners that are gone. Expects m_mutex held.
+  void releaseExpired();
+
+  struct Entry
+  {
+    std::weak_ptr<const void> owner;
+    vtkSmartPointer<vtkOpenGLBufferObject> object;
+    std::size_t bytes;
+    void *fence; // GLsync set after the upload
+  };
+
+  static void release(Entry &entry);
+
+  mutable std::mutex m_mutex;
+  std::map<std::pair<const void*, int>, Entry> m_buffers;
+  std::size_t m_bytes;
+  int m_contexts;
+  unsigned int m_probe; // GL name of the probe buffer
+  unsigned int m_tag[4];
+};
+
+#endif // GVSHAREDBUFFERS_H
@@ -0,0 +1,403 @@
+#include "gvSyntheticMesh.h"
+
+#include "gvMeshUtilities.h"
+#include "gvParallel.h"
+
+#include <vtkCellArray.h>
+#include <vtkFloatArray.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+const char prefix[] = "synthetic:";
+
+// Triangles per part of an assembly.
+const std::size_t partTriangles = 20000;
+
+// Rows of points or quads handed to a worker at once.
+const std::size_t rowsPerTask = 64;
+
+std::uint64_t mix(std::uint64_t x)
+{
+  // splitmix64 finalizer
+  x += 0x9e3779b97f4a7c15ull;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+// Uniform in [0, 1) for a seed and up to three integer coordinates.
+double hash(unsigned int seed, std::int64_t a, std::int64_t b = 0,
+            std::int64_t c = 0)
+{
+  std::uint64_t h = mix(seed);
+  h = mix(h ^ static_cast<std::uint64_t>(a));
+  h = mix(h ^ static_cast<std::uint64_t>(b));
+  h = mix(h ^ static_cast<std::uint64_t>(c));
+  return (h >> 11) * (1. / 9007199254740992.);
+}
+
+// Smoothly interpolated lattice noise in [0, 1).
+double valueNoise(unsigned int seed, double x, double y)
+{
+  double fx = std::floor(x);
+  double fy = std::floor(y);
+  std::int64_t ix = static_cast<std::int64_t>(fx);
+  std::int64_t iy = static_cast<std::int64_t>(fy);
+  double sx = x - fx;
+  double sy = y - fy;
+  sx = sx * sx * (3. - 2. * sx);
+  sy = sy * sy * (3. - 2. * sy);
+  double a = hash(seed, ix, iy);
+  double b = hash(seed, ix + 1, iy);
+  double c = hash(seed, ix, iy + 1);
+  double d = hash(seed, ix + 1, iy + 1);
+  return (a + (b - a) * sx) + ((c + (d - c) * sx) - (a + (b - a) * sx)) * sy;
+}
+
+// A grid of quads mapped onto a surface. Its triangles are taken in row
+// order and the last row may be partial, which is what makes the triangle
+// count exact.
+struct Patch
+{
+  std::size_t columns;
+  std::size_t rows;
+  std::size_t numberOfTriangles;
+  std::size_t firstPoint;
+  std::size_t firstTriangle;
+
+  // Cube face 0-5 bent into a superquadric, or -1 for the terrain:
+  int face;
+  double exponent;
+  double center[3];
+  double scale[3];
+};
+
+struct Task
+{
+  std::size_t patch;
+  std::size_t begin;
+  std::size_t end;
+};
+
+class Generator
+{
+public:
+  Generator(const gvSyntheticMesh::Specification &specification)
+    : m_kind(specification.kind),
+      m_seed(specification.seed),
+      m_numberOfPoints(0),
+      m_numberOfTriangles(0)
+  {
+    // Sphere bumps:
+    for (int i = 0; i < 3; ++i)
+      {
+      m_frequency[i] = 8. + 16. * hash(m_seed, -1, i);
+      m_phase[i] = 2. * M_PI * hash(m_seed, -2, i);
+      }
+
+    std::size_t total = specification.numberOfTriangles;
+    if (m_kind == gvSyntheticMesh::Terrain)
+      {
+      Patch patch = Patch();
+      patch.face = -1;
+      this->addPatch(patch, total);
+      }
+    else if (m_kind == gvSyntheticMesh::Sphere)
+      {
+      double center[3] = { 0., 0., 0. };
+      double scale[3] = { 1., 1., 1. };
+      this->addBox(center, scale, 2., total);
+      }
+    else
+      {
+      std::size_t parts = std::max<std::size_t>(1, total / partTriangles);
+      std::size_t side = static_cast<std::size_t>(
+        std::ceil(std::sqrt(static_cast<double>(parts))));
+      double cell = 2. / side;
+      for (std::size_t k = 0; k < parts; ++k)
+        {
+        // Boxy or round, flat or tall, on a plate at z = 0:
+        double scale[3];
+        scale[0] = cell * (.2 + .25 * hash(m_seed, k, 0));
+        scale[1] = cell * (.2 + .25 * hash(m_seed, k, 1));
+        scale[2] = cell * (.1 + .5 * hash(m_seed, k, 2));
+        double center[3];
+        center[0] = -1. + cell * (k % side + .5);
+        center[1] = -1. + cell * (k / side + .5);
+        center[2] = scale[2];
+        double exponent = 2. + 8. * hash(m_seed, k, 3);
+        this->addBox(center, scale, exponent,
+                     total / parts + (k < total % parts ? 1 : 0));
+        }
+      }
+  }
+
+  vtkSmartPointer<vtkPolyData> generate(unsigned int numberOfThreads) const
+  {
+    vtkNew<vtkFloatArray> positions;
+    positions->SetNumberOfComponents(3);
+    positions->SetNumberOfTuples(static_cast<vtkIdType>(m_numberOfPoints));
+    float *points = positions->GetPointer(0);
+    std::vector<vtkIdType> ids(3 * m_numberOfTriangles);
+
+    std::vector<Task> tasks;
+    for (std::size_t p = 0; p < m_patches.size(); ++p)
+      {
+      for (std::size_t row = 0; row <= m_patches[p].rows; row += rowsPerTask)
+        {
+        Task task = { p, row, std::min(row + rowsPerTask,
+                                       m_patches[p].rows + 1) };
+        tasks.push_back(task);
+        }
+      }
+    gvParallel::forEach(tasks.size(), [&](std::size_t t)
+      {
+      const Task &task = tasks[t];
+      this->generatePoints(m_patches[task.patch], task.begin, task.end,
+                           points);
+      this->generateTriangles(m_patches[task.patch], task.begin,
+                              std::min(task.end, m_patches[task.patch].rows),
+                              ids.data());
+      }, numberOfThreads);
+
+    vtkSmartPointer<vtkPolyData> mesh = vtkSmartPointer<vtkPolyData>::New();
+    vtkNew<vtkPoints> meshPoints;
+    meshPoints->SetData(positions.Get());
+    mesh->SetPoints(meshPoints.Get());
+    mesh->SetPolys(gvMeshUtilities::newTriangles(ids.data(),
+                                                 m_numberOfTriangles));
+    return mesh;
+  }
+
+private:
+  void addPatch(Patch patch, std::size_t numberOfTriangles)
+  {
+    if (numberOfTriangles == 0)
+      {
+      return;
+      }
+    patch.columns = std::max<std::size_t>(1, static_cast<std::size_t>(
+      std::sqrt(numberOfTriangles / 2.)));
+    patch.rows = (numberOfTriangles + 2 * patch.columns - 1) /
+      (2 * patch.columns);
+    patch.numberOfTriangles = numberOfTriangles;
+    patch.firstPoint = m_numberOfPoints;
+    patch.firstTriangle = m_numberOfTriangles;
+    m_numberOfPoints += (patch.rows + 1) * (patch.columns + 1);
+    m_numberOfTriangles += numberOfTriangles;
+    m_patches.push_back(patch);
+  }
+
+  // The six faces of a cube, bent into the superquadric
+  // |x|^e + |y|^e + |z|^e = 1: round for e = 2, boxy as e grows.
+  void addBox(const double center[3], const double scale[3], double exponent,
+              std::size_t numberOfTriangles)
+  {
+    for (int face = 0; face < 6; ++face)
+      {
+      Patch patch = Patch();
+      patch.face = face;
+      patch.exponent = exponent;
+      std::copy(center, center + 3, patch.center);
+      std::copy(scale, scale + 3, patch.scale);
+      this->addPatch(patch, numberOfTriangles / 6 +
+                     (static_cast<std::size_t>(face) < numberOfTriangles % 6 ?
+                      1 : 0));
+      }
+  }
+
+  void generatePoints(const Patch &patch, std::size_t beginRow,
+                      std::size_t endRow, float *points) const
+  {
+    for (std::size_t j = beginRow; j < endRow; ++j)
+      {
+      double v = static_cast<double>(j) / patch.rows;
+      for (std::size_t i = 0; i <= patch.columns; ++i)
+        {
+        double u = static_cast<double>(i) / patch.columns;
+        double x[3];
+        if (patch.face < 0)
+          {
+          this->terrainPoint(u, v, x);
+          }
+        else
+          {
+          this->boxPoint(patch, u, v, x);
+          }
+        float *out =
+          points + 3 * (patch.firstPoint + j * (patch.columns + 1) + i);
+        out[0] = static_cast<float>(x[0]);
+        out[1] = static_cast<float>(x[1]);
+        out[2] = static_cast<float>(x[2]);
+        }
+      }
+  }
+
+  void generateTriangles(const Patch &patch, std::size_t beginRow,
+                         std::size_t endRow, vtkIdType *ids) const
+  {
+    std::size_t end = std::min(2 * patch.columns * endRow,
+                               patch.numberOfTriangles);
+    for (std::size_t t = 2 * patch.columns * beginRow; t < end; ++t)
+      {
+      std::size_t quad = t / 2;
+      std::size_t row = quad / patch.columns;
+      std::size_t column = quad % patch.columns;
+      vtkIdType a = static_cast<vtkIdType>(
+        patch.firstPoint + row * (patch.columns + 1) + column);
+      vtkIdType up = static_cast<vtkIdType>(patch.columns + 1);
+      vtkIdType *out = ids + 3 * (patch.firstTriangle + t);
+      out[0] = a;
+      out[1] = t % 2 ? a + up + 1 : a + 1;
+      out[2] = t % 2 ? a + up : a + up + 1;
+      }
+  }
+
+  // Fractal noise over [-1, 1]^2.
+  void terrainPoint(double u, double v, double x[3]) const
+  {
+    x[0] = 2. * u - 1.;
+    x[1] = 2. * v - 1.;
+    double height = 0.;
+    double amplitude = .25;
+    double frequency = 4.;
+    for (int octave = 0; octave < 8; ++octave)
+      {
+      height += amplitude * (valueNoise(m_seed + octave, frequency * x[0],
+                                        frequency * x[1]) - .5);
+      amplitude *= .5;
+      frequency *= 2.;
+      }
+    x[2] = height;
+  }
+
+  void boxPoint(const Patch &patch, double u, double v, double x[3]) const
+  {
+    // Outward-facing cube face with (u, v) in [-1, 1]^2:
+    int axis = patch.face / 2;
+    double sign = patch.face % 2 ? -1. : 1.;
+    double p[3];
+    p[axis] = sign;
+    p[(axis + 1) % 3] = sign * (2. * u - 1.);
+    p[(axis + 2) % 3] = 2. * v - 1.;
+
+    double norm = 0.;
+    for (int i = 0; i < 3; ++i)
+      {
+      norm += std::pow(std::fabs(p[i]), patch.exponent);
+      }
+    norm = std::pow(norm, 1. / patch.exponent);
+
+    double radius = 1.;
+    if (m_kind == gvSyntheticMesh::Sphere)
+      {
+      radius += .03 * std::sin(m_frequency[0] * p[0] / norm + m_phase[0]) *
+        std::sin(m_frequency[1] * p[1] / norm + m_phase[1]) *
+        std::sin(m_frequency[2] * p[2] / norm + m_phase[2]);
+      }
+    for (int i = 0; i < 3; ++i)
+      {
+      x[i] = patch.center[i] + patch.scale[i] * radius * p[i] / norm;
+      }
+  }
+
+  gvSyntheticMesh::Kind m_kind;
+  unsigned int m_seed;
+  double m_frequency[3];
+  double m_phase[3];
+  std::vector<Patch> m_patches;
+  std::size_t m_numberOfPoints;
+  std::size_t m_numberOfTriangles;
+};
+
+} // end anon namespace
+
+bool gvSyntheticMesh::parse(const std::string &name,
+                            Specification &specification)
+{
+  std::size_t prefixLength = sizeof(prefix) - 1;
+  if (name.compare(0, prefixLength, prefix) != 0)
+    {
+    return false;
+    }
+
+  std::size_t kindEnd = name.find(':', prefixLength);
+  if (kindEnd == std::string::npos)
+    {
+    return false;
+    }
+  std::string kind = name.substr(prefixLength, kindEnd - prefixLength);
+  if (kind == "sphere")
+    {
+    specification.kind = Sphere;
+    }
+  else if (kind == "terrain")
+    {
+    specification.kind = Terrain;
+    }
+  else if (kind == "assembly")
+    {
+    specification.kind = Assembly;
+    }
+  else
+    {
+    return false;
+    }
+
+  const char *count = name.c_str() + kindEnd + 1;
+  char *end;
+  double triangles = strtod(count, &end);
+  switch (*end)
+    {
+    case 'k':
+    case 'K':
+      triangles *= 1e3;
+      ++end;
+      break;
+    case 'm':
+    case 'M':
+      triangles *= 1e6;
+      ++end;
+      break;
+    case 'g':
+    case 'G':
+      triangles *= 1e9;
+      ++end;
+      break;
+    default:
+      break;
+    }
+  if (end == count || triangles < 1.)
+    {
+    return false;
+    }
+  specification.numberOfTriangles = static_cast<std::size_t>(triangles + .5);
+
+  specification.seed = 1;
+  if (*end == ':')
+    {
+    const char *seed = end + 1;
+    specification.seed = static_cast<unsigned int>(strtoul(seed, &end, 10));
+    if (end == seed)
+      {
+      return false;
+      }
+    }
+  return *end == '\0';
+}
+
+vtkSmartPointer<vtkPolyData> gvSyntheticMesh::generate(
+    const Specification &specification, unsigned int numberOfThreads)
+{
+  Generator generator(specification);
+  return generator.generate(numberOfThreads);
+}
@@ -0,0 +1,44 @@
+#ifndef GVSYNTHETICMESH_H
+#define GVSYNTHETICMESH_H
+
+#include <vtkSmartPointer.h>
+
+#include <cstddef>
+#include <string>
+
+class vtkPolyData;
+
+// Procedural meshes of an exact triangle count for load and render
+// benchmarks. Every point is a function of the seed and its position in the
+// mesh, so the output is the same for any number of threads.
+//
+// A mesh is named "synthetic:<kind>:<triangles>[:<seed>]", where kind is
+// sphere (a bumpy cube-mapped sphere), terrain (a fractal height field) or
+// assembly (a plate of rounded boxes and cylinders, like a CAD model), and
+// triangles takes a K, M or G suffix, e.g. "synthetic:terrain:100M:7".
+class gvSyntheticMesh
+{
+public:
+  enum Kind
+  {
+    Sphere,
+    Terrain,
+    Assembly
+  };
+
+  struct Specification
+  {
+    Kind kind;
+    std::size_t numberOfTriangles;
+    unsigned int seed;
+  };
+
+  // Parse a synthetic mesh name. Returns false if name isn't one.
+  static bool parse(const std::string &name, Specification &specification);
+
+  // Generate the mesh using numberOfThreads workers; 0 uses all cores.
+  static vtkSmartPointer<vtkPolyData> generate(
+      const Specification &specification, unsigned int numberOfThreads = 0);
+};
+
+#endif // GVSYNTHETICMESH_H
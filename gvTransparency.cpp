@@ -0,0 +1,92 @@
+#include "gvTransparency.h"
+
+#include "gvDepthSortCuller.h"
+#include "gvRenderSettings.h"
+
+#include <vtkRenderer.h>
+
+#include <algorithm>
+
+namespace {
+
+// Renders at one number of peels before it is changed again, so the
+// smoothed time settles first:
+const int SettleRenders = 15;
+
+} // end anon namespace
+
+gvTransparency::gvTransparency(vtkRenderer *renderer)
+  : m_renderer(renderer),
+    m_maximumPeels(-1),
+    m_budget(0.),
+    m_peels(1),
+    m_renderTime(0.),
+    m_renders(0)
+{
+  m_renderer->AddCuller(m_culler.Get());
+}
+
+gvTransparency::~gvTransparency()
+{
+}
+
+void gvTransparency::apply(const gvRenderSettings &settings)
+{
+  bool translucent = settings.opacity < 1.;
+  m_culler->setEnabled(translucent &&
+    settings.transparency == gvRenderSettings::SortedChunks);
+  bool peel = translucent &&
+    settings.transparency == gvRenderSettings::DepthPeeling;
+
+  int maximumPeels = std::max(1, settings.maximumPeels);
+  if (maximumPeels != m_maximumPeels || settings.peelingBudget != m_budget)
+    {
+    m_maximumPeels = maximumPeels;
+    m_budget = settings.peelingBudget;
+    m_peels = m_maximumPeels;
+    m_renders = 0;
+    }
+
+  // Zero peels would mean no limit to VTK:
+  m_renderer->SetMaximumNumberOfPeels(m_peels);
+  m_renderer->SetUseDepthPeeling(peel ? 1 : 0);
+}
+
+void gvTransparency::update()
+{
+  if (!m_renderer->GetUseDepthPeeling() || m_budget <= 0.)
+    {
+    return;
+    }
+
+  // VTK reads each peel's occlusion query back before starting the next,
+  // so the render time includes the GPU's peeling:
+  double seconds = m_renderer->GetLastRenderTimeInSeconds();
+  m_renderTime = m_renders > 0 ? 0.8 * m_renderTime + 0.2 * seconds
+                               : seconds;
+  if (++m_renders < SettleRenders)
+    {
+    return;
+    }
+
+  int peels = m_peels;
+  if (m_renderTime > m_budget && peels > 1)
+    {
+    --peels;
+    }
+  else if (m_renderTime < 0.75 * m_budget && peels < m_maximumPeels)
+    {
+    ++peels;
+    }
+  if (peels != m_peels)
+    {
+    m_peels = peels;
+    m_renderer->SetMaximumNumberOfPeels(m_peels);
+    m_renders = 0;
+    }
+}
+
+int gvTransparency::numberOfPeels() const
+{
+  return m_renderer->GetUseDepthPeeling() ? m_peels : 0;
+}
@@ -0,0 +1,45 @@
+#ifndef GVTRANSPARENCY_H
+#define GVTRANSPARENCY_H
+
+#include <vtkNew.h>
+
+class gvDepthSortCuller;
+struct gvRenderSettings;
+class vtkRenderer;
+
+// Blending of translucent surfaces in one renderer, as gvRenderSettings
+// selects it: in draw order, with the renderer's props sorted back to front
+// by gvDepthSortCuller, or by depth peeling. Peeling starts at the settings'
+// maximum number of peels and drops one peel at a time while the smoothed
+// render time is over the budget, taking it back once renders are well
+// under it. Opaque settings turn sorting and peeling off, so the opaque
+// path costs nothing extra.
+class gvTransparency
+{
+public:
+  // Adds its culler to renderer, which must outlive this.
+  explicit gvTransparency(vtkRenderer *renderer);
+  ~gvTransparency();
+
+  void apply(const gvRenderSettings &settings);
+
+  // Call after each render of the renderer to keep peeling within budget.
+  void update();
+
+  // Peels allowed for the next render, 0 while not peeling.
+  int numberOfPeels() const;
+
+private:
+  gvTransparency(const gvTransparency&) = delete;
+  void operator=(const gvTransparency&) = delete;
+
+  vtkRenderer *m_renderer;
+  vtkNew<gvDepthSortCuller> m_culler;
+  int m_maximumPeels;
+  double m_budget;
+  int m_peels;
+  double m_renderTime;
+  int m_renders; // Since peels last changed
+};
+
+#endif // GVTRANSPARENCY_H
@@ -1,17 +1,70 @@
 // STD includes
+#include <cstdlib>
 #include <iostream>
 #include <string>
+#include <vector>
 
 // GeometryViewer includes
 #include "GeometryViewer.h"
+#include "gvProfiler.h"
+#include "gvRenderSettings.h"
+#include "gvScene.h"
+#include "gvSyntheticMesh.h"
 
 void printUsage(void)
 {
   std::cout << "\nGeometryViewer - Render VTK objects in the VRUI context" << std::endl;
-  std::cout << "\nUSAGE:\n\t./GeometryViewer [-f <string>] [-h]" << std::endl;
+  std::cout << "\nUSAGE:\n\t./GeometryViewer [-f <string>]... " <<
+    "[-scene <string>] [-h]" << std::endl;
   std::cout << "\nWhere:" << std::endl;
   std::cout << "\t-f <string>, -fileName <string>" << std::endl;
-  std::cout << "\tName of OBJ file to load using VTK.\n" << std::endl;
+  std::cout << "\tName of an OBJ, PLY, STL, VTP or legacy VTK file to " <<
+    "load, chosen by extension. Repeat to load several models into one " <<
+    "scene.\n" << std::endl;
+  std::cout << "\t-scene <string>" << std::endl;
+  std::cout << "\tScene manifest listing models, each on a " <<
+    "\"model <file>\" line followed by optional \"scale\", \"rotate " <<
+    "<axis> <degrees>\", \"translate\", \"matrix\" and \"hidden\" " <<
+    "lines.\n" << std::endl;
+  std::cout << "\t-synthetic <kind>:<triangles>[:<seed>]" << std::endl;
+  std::cout << "\tGenerate a mesh of exactly the given number of " <<
+    "triangles instead of loading a file. kind is sphere, terrain or " <<
+    "assembly; triangles takes a K, M or G suffix (e.g. terrain:100M).\n" <<
+    std::endl;
+  std::cout << "\t-reader <parallel|vtk>" << std::endl;
+  std::cout << "\tMesh readers to use: the built-in parallel readers " <<
+    "for OBJ, binary PLY and binary STL (default), or VTK's reader for " <<
+    "every format.\n" << std::endl;
+  std::cout << "\t-readerThreads <int>" << std::endl;
+  std::cout << "\tNumber of threads for the parallel reader and the " <<
+    "synthetic mesh generator (default: all cores).\n" << std::endl;
+  std::cout << "\t-stream" << std::endl;
+  std::cout << "\tStream the model from on-disk bricks even if it fits " <<
+    "in the streaming memory budget.\n" << std::endl;
+  std::cout << "\t-optimize" << std::endl;
+  std::cout << "\tWeld duplicate points and reorder triangles and points " <<
+    "for the GPU's vertex cache after loading, printing the cache " <<
+    "statistics before and after.\n" << std::endl;
+  std::cout << "\t-compact" << std::endl;
+  std::cout << "\tStore chunks of large meshes on the GPU as quantized " <<
+    "16-bit positions and octahedral normals (OpenGL2 only).\n" << std::endl;
+  std::cout << "\t-transparency <unsorted|sorted|peeling>" << std::endl;
+  std::cout << "\tBlend surfaces below full opacity in draw order " <<
+    "(default), with chunks sorted back to front, or by depth peeling " <<
+    "within the maximumDepthPeels and depthPeelingBudget configuration " <<
+    "settings.\n" << std::endl;
+  std::cout << "\t-cullingStats" << std::endl;
+  std::cout << "\tPrint submitted and culled triangles per window " <<
+    "every 5 seconds.\n" << std::endl;
+  std::cout << "\t-frameStats" << std::endl;
+  std::cout << "\tPrint the frame rate and the aggregate frame rate of " <<
+    "all windows every 5 seconds, and the GPU buffer memory of each GL " <<
+    "context.\n" << std::endl;
+  std::cout << "\t-profile <string>" << std::endl;
+  std::cout << "\tTime frame(), display(), initContext(), loading and " <<
+    "locator callbacks and write the samples with percentiles to the " <<
+    "given file on exit (JSON if it ends in .json, else CSV).\n" <<
+    std::endl;
   std::cout << "\t-showfps" << std::endl;
   std::cout << "\tShow the FPS display by default.\n" << std::endl;
   std::cout << "\t-h, -help" << std::endl;
@@ -33,8 +86,17 @@ int main(int argc, char* argv[])
 {
   try
     {
-    std::string name;
+    std::vector<gvScene::Entry> models;
+    gvScene::Entry entry;
     bool showFPS = false;
+    bool parallelReader = true;
+    unsigned int readerThreads = 0;
+    bool streaming = false;
+    bool optimize = false;
+    bool compact = false;
+    int transparency = gvRenderSettings::Unsorted;
+    bool cullingStats = false;
+    bool frameStats = false;
     if(argc > 1)
       {
       /* Parse the command-line arguments */
@@ -42,7 +104,86 @@ int main(int argc, char* argv[])
         {
         if(strcmp(argv[i], "-f")==0 || strcmp(argv[i], "-filename")==0)
           {
-          name.assign(argv[i+1]);
+          entry.fileName.assign(argv[i+1]);
+          models.push_back(entry);
+          ++i;
+          }
+        if(strcmp(argv[i], "-scene")==0 && i+1 < argc)
+          {
+          if(!gvScene::readManifest(argv[i+1], models))
+            {
+            return 1;
+            }
+          ++i;
+          }
+        if(strcmp(argv[i], "-synthetic")==0 && i+1 < argc)
+          {
+          entry.fileName = std::string("synthetic:") + argv[i+1];
+          models.push_back(entry);
+          gvSyntheticMesh::Specification specification;
+          if(!gvSyntheticMesh::parse(entry.fileName, specification))
+            {
+            std::cerr << "Invalid synthetic mesh " << argv[i+1] << std::endl;
+            printUsage();
+            return 1;
+            }
+          ++i;
+          }
+        if(strcmp(argv[i], "-reader")==0 && i+1 < argc)
+          {
+          parallelReader = strcmp(argv[i+1], "vtk") != 0;
+          ++i;
+          }
+        if(strcmp(argv[i], "-readerThreads")==0 && i+1 < argc)
+          {
+          readerThreads = static_cast<unsigned int>(atoi(argv[i+1]));
+          ++i;
+          }
+        if(strcmp(argv[i], "-stream")==0)
+          {
+          streaming = true;
+          }
+        if(strcmp(argv[i], "-optimize")==0)
+          {
+          optimize = true;
+          }
+        if(strcmp(argv[i], "-compact")==0)
+          {
+          compact = true;
+          }
+        if(strcmp(argv[i], "-transparency")==0 && i+1 < argc)
+          {
+          if(strcmp(argv[i+1], "unsorted")==0)
+            {
+            transparency = gvRenderSettings::Unsorted;
+            }
+          else if(strcmp(argv[i+1], "sorted")==0)
+            {
+            transparency = gvRenderSettings::SortedChunks;
+            }
+          else if(strcmp(argv[i+1], "peeling")==0)
+            {
+            transparency = gvRenderSettings::DepthPeeling;
+            }
+          else
+            {
+            std::cerr << "Invalid transparency " << argv[i+1] << std::endl;
+            printUsage();
+            return 1;
+            }
+          ++i;
+          }
+        if(strcmp(argv[i], "-cullingStats")==0)
+          {
+          cullingStats = true;
+          }
+        if(strcmp(argv[i], "-frameStats")==0)
+          {
+          frameStats = true;
+          }
+        if(strcmp(argv[i], "-profile")==0 && i+1 < argc)
+          {
+          gvProfiler::enable(argv[i+1]);
           ++i;
           }
         if(strcmp(argv[i], "-showfps")==0)
@@ -59,12 +200,21 @@ int main(int argc, char* argv[])
 
     GeometryViewer application(argc, argv);
     application.setShowFPS(showFPS);
+    application.setReaderOptions(parallelReader, readerThreads);
+    application.setStreaming(streaming);
+    application.setOptimizeMesh(optimize);
+    application.setCompactStorage(compact);
+    application.setTransparency(transparency);
+    application.setCullingStatistics(cullingStats);
+    application.setFrameRateStatistics(frameStats);
+    /* Before initialize() so the main menu lists the models */
+    application.setModels(models);
     application.initialize();
-    if(!name.empty())
+    application.run();
+    if (gvProfiler *profiler = gvProfiler::active())
       {
-      application.setFileName(name.c_str());
+      profiler->write();
       }
-    application.run();
     return 0;
     }
   catch (std::runtime_error e)
@@ -0,0 +1,58 @@
+#!/bin/sh
+# Aggregate frame rate of GeometryViewer with 1, 2, 4 and 8 windows rendered
+# on their own threads (Vrui's windowsMultithreaded).
+#
+# USAGE: ./windowScalingBenchmark.sh <GeometryViewer> <model> [seconds] [rootSection]
+#
+# Each run opens the windows side by side on the default display, merges
+# them into the root section of the Vrui configuration and prints the last
+# -frameStats report before it is stopped.
+
+if [ $# -lt 2 ]; then
+  echo "USAGE: $0 <GeometryViewer> <model> [seconds] [rootSection]"
+  exit 1
+fi
+
+viewer=$1
+model=$2
+seconds=${3:-30}
+root=${4:-3dtv}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+for windows in 1 2 4 8; do
+  config="$work/windows$windows.cfg"
+  names=""
+  sections=""
+  i=0
+  while [ $i -lt $windows ]; do
+    x=$(( (i % 4) * 480 ))
+    y=$(( (i / 4) * 300 ))
+    names="$names${names:+, }ScalingWindow$i"
+    sections="$sections
+		section ScalingWindow$i
+			windowPos ($x, $y), (480, 270)
+			windowFullscreen false
+			windowType Mono
+			screenName Screen
+			viewerName Viewer
+			showFps false
+		endsection"
+    i=$((i + 1))
+  done
+
+  cat > "$config" <<EOF
+section Vrui
+	section $root
+		windowsMultithreaded true
+		windowNames ($names)
+$sections
+	endsection
+endsection
+EOF
+
+  result=$(timeout "$seconds" "$viewer" -rootSection "$root" \
+    -mergeConfig "$config" -frameStats -f "$model" 2>/dev/null |
+    grep "window frames/s" | tail -n 1)
+  echo "${result:-$windows windows: no report (run longer than 5 seconds)}"
+done